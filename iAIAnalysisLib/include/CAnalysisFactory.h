@@ -0,0 +1,46 @@
+#pragma once
+#include "macro_define.h"
+#include <analysis_type.h>
+
+class CObjDetector;
+class CReID;
+class CMotionGate;
+class CTracker;
+class CEmbeddingCache;
+
+// Class of the factory creating the networks and the per-stream components of the analysis parameters
+// It is shared by CAIAnalysis, which creates the networks of one stream, and CStreamManager, which shares them by all the streams
+// and creates the motion gate, the tracker and the re-id embedding cache of each stream.
+class CAnalysisFactory
+{
+public:
+	// Create the detection network of the analysis parameters
+	// @param[in] stParam: analysis parameters
+	// @param[in] nSessionPoolSize: number of sessions added to the session pool of the network, that is the number of concurrent runs
+	// @return: the valid detection network. nullptr if it fails
+	static CObjDetector* CreateObjDetector(const S_AnalysisParam& stParam, int nSessionPoolSize);
+
+	// Create the re-id network of the analysis parameters
+	// @param[in] stParam: analysis parameters
+	// @param[in] nSessionPoolSize: number of sessions added to the session pool of the network, that is the number of concurrent runs
+	// @return: the valid re-id network. nullptr if it fails
+	static CReID* CreateReID(const S_AnalysisParam& stParam, int nSessionPoolSize);
+
+	// Create the motion gate of the analysis parameters
+	// @param[in] stParam: analysis parameters
+	// @param[out] pMotionGate: the motion gate. nullptr if disabled
+	// @return: true if the motion gate is created or disabled, false otherwise
+	static bool CreateMotionGate(const S_AnalysisParam& stParam, CMotionGate*& pMotionGate);
+
+	// Create the multi-object tracker of the analysis parameters
+	// @param[in] stParam: analysis parameters
+	// @param[out] pTracker: the tracker. nullptr if disabled
+	// @return: true if the tracker is created or disabled, false otherwise
+	static bool CreateTracker(const S_AnalysisParam& stParam, CTracker*& pTracker);
+
+	// Create the re-id embedding cache of the analysis parameters
+	// @param[in] stParam: analysis parameters
+	// @param[out] pReIDCache: the re-id embedding cache. nullptr if disabled
+	// @return: true if the re-id embedding cache is created or disabled, false otherwise
+	static bool CreateReIDCache(const S_AnalysisParam& stParam, CEmbeddingCache*& pReIDCache);
+};
@@ -0,0 +1,29 @@
+#pragma once
+#include "macro_define.h"
+#include <analysis_type.h>
+#include <opencv2/opencv.hpp>
+
+// Class of the helpers on the detected objects shared by CAIAnalysis and CStreamManager
+class CAnalysisUtil
+{
+public:
+	// Crop the detected objects from the frame
+	// @param[in] cvBGRFrame: the input BGR format frame
+	// @param[in] vObjBoxes: the detection result
+	// @param[out] vCropImgs: the cropped images sharing the buffer of the frame
+	static void CropObjects(const cv::Mat& cvBGRFrame, const ObjBoxArr& vObjBoxes, std::vector<cv::Mat>& vCropImgs);
+
+	// Clip the tracked objects to the frame and remove the ones out of it
+	// @param[in] cvFrameSize: the size of the frame
+	// @param[in/out] vObjBoxes: the tracked objects
+	// [Note] The boxes predicted by the tracker may go over the border of the frame, while the cropping needs the boxes inside it.
+	static void ClipObjects(const cv::Size& cvFrameSize, ObjBoxArr& vObjBoxes);
+
+	// Merge the objects detected in the motion region into the previous objects of the frame
+	// @param[in] vPrevBoxes: the previous objects of the frame
+	// @param[in] vRegionBoxes: the objects detected in the motion region, in the coordinates of the region
+	// @param[in] cvRegion: the motion region of the frame
+	// @param[out] vObjBoxes: the objects of the frame
+	// [Note] The previous objects whose centre is out of the region have not moved, so they are kept.
+	static void MergeRegionObjects(const ObjBoxArr& vPrevBoxes, const ObjBoxArr& vRegionBoxes, const cv::Rect& cvRegion, ObjBoxArr& vObjBoxes);
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include "macro_define.h"
+#include <analysis_type.h>
+#include <opencv2/opencv.hpp>
+
+// Structure to hold the state of one tracked object
+typedef struct _Track
+{
+	int		nTrackID;		// persistent ID of the track
+	int		nClassID;		// class ID of the latest associated detection
+	float	fScore;			// score of the latest associated detection
+	int		nHits;			// number of associated detections
+	int		nLostFrames;	// number of detection frames since the latest associated detection
+	bool	bConfirmed;		// whether the track is confirmed by nMinHits detections
+	cv::KalmanFilter cvKF;	// Kalman filter of the box. State: (cx, cy, aspect ratio, height) and their velocities
+
+	_Track(int _nTrackID = -1, int _nClassID = -1, float _fScore = 0.0f)
+	{
+		nTrackID = _nTrackID;
+		nClassID = _nClassID;
+		fScore = _fScore;
+		nHits = 0;
+		nLostFrames = 0;
+		bConfirmed = false;
+	}
+}Track;
+
+// Class of the multi-object tracker assigning the persistent track IDs to the detected objects
+// The motion of each object is predicted by a constant velocity Kalman filter, and the detections are associated to the tracks
+// by IoU in the stages of ByteTrack: the confident detections to all the confirmed tracks first, the low score detections
+// to the remaining tracked ones next, and the remaining confident detections to the unconfirmed tracks last.
+// [Note] The frames should be given in the capture order of one camera. Create one tracker per camera.
+class CTracker
+{
+public:
+	// @param[in] stParam: tracker parameters
+	// @param[in] fHighScoreThresh: minimum score of the confident detections, which can start the new tracks
+	CTracker(const S_TrackerParam& stParam, float fHighScoreThresh);
+	~CTracker();
+
+	// Check whether the detector runs on the given frame
+	// @param[in] nFrameIdx: index of the frame in the capture order
+	// @return: true if the detector runs on the frame, false if the tracks are only predicted
+	bool IsDetectionFrame(uint64_t nFrameIdx) const;
+
+	// Associate the detections of the next frame to the tracks
+	// @param[in/out] vObjBoxes: detections of the frame, replaced with the boxes of the tracked objects carrying the track IDs
+	void Update(ObjBoxArr& vObjBoxes);
+
+	// Predict the tracks on the next frame without any detection
+	// @param[out] vObjBoxes: predicted boxes of the tracked objects carrying the track IDs
+	void Propagate(ObjBoxArr& vObjBoxes);
+
+	// Remove all the tracks
+	void Reset();
+
+private:
+	// Predict the state of all the tracks on the next frame
+	void Predict();
+
+	// Associate the given detections to the given tracks greedily in the descending order of IoU
+	// @param[in] vTrackIdx: indices of the tracks
+	// @param[in] vObjBoxes: all the detections
+	// @param[in] vDetIdx: indices of the detections
+	// @param[in] fIoUThresh: minimum IoU to associate
+	// @param[out] vUnmatchedTracks: indices of the tracks without any detection
+	// @param[out] vUnmatchedDets: indices of the detections without any track
+	void Associate(const std::vector<int>& vTrackIdx, const ObjBoxArr& vObjBoxes, const std::vector<int>& vDetIdx, float fIoUThresh,
+		std::vector<int>& vUnmatchedTracks, std::vector<int>& vUnmatchedDets);
+
+	// Start a new track from the given detection
+	// @param[in] stBox: detection
+	void StartTrack(const ObjBBox& stBox);
+
+	// Get the box of the track from its state
+	// @param[in] stTrack: track
+	// @return: box of the track
+	ObjBBox GetTrackBox(const Track& stTrack) const;
+
+	// Get the boxes of the tracked objects
+	// @param[out] vObjBoxes: boxes of the confirmed tracks associated on the latest detection frame
+	void GetTrackedBoxes(ObjBoxArr& vObjBoxes) const;
+
+private:
+	S_TrackerParam		m_stParam;			// tracker parameters
+	float				m_fHighScoreThresh;	// minimum score of the confident detections
+	std::vector<Track>	m_vTracks;			// tracks
+	int					m_nNextTrackID;		// ID of the next new track
+};
@@ -2,8 +2,11 @@
 #include <analysis_define.h>
 
 #define DL_YOLO7_OBJ_DET_ONNX_MODEL_PATH	"./models/yolo7/yolov7-tiny_384x640.onnx"
+#define DL_YOLO7_OBJ_DET_INT8_ONNX_MODEL_PATH	"./models/yolo7/yolov7-tiny_384x640_int8.onnx"
 #define DL_YOLO7_OBJ_CLASS_NAME_PATH		"./models/yolo7/class.names"
 
 #define DL_YOUREID_ONNX_MODEL_PATH			"./models/youreid/youreid_s.onnx"
+#define DL_YOUREID_INT8_ONNX_MODEL_PATH		"./models/youreid/youreid_s_int8.onnx"
 
-#define DL_TORCHREID_ONNX_MODEL_PATH 		"./models/torchreid/osnet_x1_0_same_domain_d.onnx"
\ No newline at end of file
+#define DL_TORCHREID_ONNX_MODEL_PATH 		"./models/torchreid/osnet_x1_0_same_domain_d.onnx"
+#define DL_TORCHREID_INT8_ONNX_MODEL_PATH	"./models/torchreid/osnet_x1_0_same_domain_d_int8.onnx"
@@ -1,19 +1,60 @@
 #include "CAIAnalysis.h"
-#include "macro_define.h"
-#include "CORTYoloV7.h"
-#include "CORTYouReID.h"
-#include "CORTTorchReID.h"
+#include "CAnalysisFactory.h"
+#include "CAnalysisUtil.h"
+#include "CObjDetector.h"
+#include "CReID.h"
 #include "CVideoWriter.h"
-
-#define DEVICE_ID	-1
+#include "CORTRuntime.h"
+#include "CTaskExecutor.h"
+#include "CStagePipeline.h"
+#include "CMotionGate.h"
+#include "CTracker.h"
+#include "CEmbeddingCache.h"
+
+// Frame of the pipelined RunTaskAsync() passed from stage to stage
+typedef struct _PipelineFrame
+{
+	std::shared_ptr<std::promise<S_AnalysisResult>>	pPromise;	// promise of the result
+	AnalysisCallback		fnCallback;			// callback invoked with the result. It can be nullptr
+	S_AnalysisResult		stResult;			// result of the frame
+	cv::Mat					cvFrame;			// copy of the input frame. The render stage draws the result on it
+	std::vector<float>		vQueryFeature;		// query feature taken at the call
+	ReIDQueryArr			vQueries;			// query set taken at the call
+	cv::Mat					cvQueryFeatures;	// feature matrix of the query set taken at the call
+	E_MotionGateResult		eGate;				// decision of the motion gate on the frame
+	cv::Rect				cvRegion;			// motion region of the frame
+	uint64_t				nGateSeq;			// sequence number of the frame checked by the motion gate
+	uint64_t				nSeq;				// call sequence number of the frame
+	E_AnalysisTaskType		eWriteType;			// type of result written to video, taken at the call
+	bool					bWrite;				// true if the drawn frame is written to video
+
+	_PipelineFrame()
+	{
+		eGate = E_MotionGateResult::eMgFullFrame;
+		nGateSeq = 0;
+		nSeq = 0;
+		eWriteType = E_AnalysisTaskType::eAttUnknown;
+		bWrite = false;
+	}
+}PipelineFrame;
 
 CAIAnalysis::CAIAnalysis(const S_AnalysisParam& stParam)
-	: m_stParam(stParam)
+	: m_bValid(false)
+	, m_pVideoWriter(nullptr)
 	, m_pObjDetector(nullptr)
 	, m_pReID(nullptr)
-	, m_pVideoWriter(nullptr)
+	, m_stParam(stParam)
 	, m_eWriteResultType(E_AnalysisTaskType::eAttUnknown)
-	, m_bValid(false)
+	, m_pExecutor(nullptr)
+	, m_pPipeline(nullptr)
+	, m_nSubmitSeq(0)
+	, m_nWriteSeq(0)
+	, m_pMotionGate(nullptr)
+	, m_nGateSeq(0)
+	, m_nGateTurnSeq(0)
+	, m_pTracker(nullptr)
+	, m_nTrackSeq(0)
+	, m_pReIDCache(nullptr)
 {
 	m_bValid = Init();
 }
@@ -23,6 +64,24 @@ CAIAnalysis::~CAIAnalysis()
 	Release();
 }
 
+// Configure the process-wide inference runtime shared by all the CAIAnalysis instances
+// @param[in] stRuntimeParam: the runtime parameters such as the sizes of the global thread pools
+// @return true if the runtime is configured successfully, otherwise false
+// [Note] This function must be called before the first CAIAnalysis instance is created.
+bool CAIAnalysis::ConfigureRuntime(const S_RuntimeParam& stRuntimeParam)
+{
+	ORTRuntimeConfig stORTRuntimeConfig = {
+		stRuntimeParam.bGlobalThreadPools,
+		stRuntimeParam.nIntraOpThreads,
+		stRuntimeParam.nInterOpThreads,
+		stRuntimeParam.bAllowSpinning,
+		stRuntimeParam.bModelCache,
+		stRuntimeParam.sModelCacheDir
+	};
+
+	return CORTRuntime::GetInstance().Configure(stORTRuntimeConfig);
+}
+
 // Run the given analysis task
 // @param[in] eTaskType: the type of analysis task
 // @param[in] cvBGRFrame: the input BGR format frame
@@ -59,6 +118,148 @@ bool CAIAnalysis::RunTask(const E_AnalysisTaskType& eTaskType, const cv::Mat& cv
 	return bRes;
 }
 
+// Run the given analysis task asynchronously
+// @param[in] eTaskType: the type of analysis task
+// @param[in] cvBGRFrame: the input BGR format frame. It is copied, so the caller can reuse its buffer for the next frame
+// @param[in] nFrameID: the frame id returned in the result
+// @param[in] fnCallback: the callback invoked with the result when the task is finished. It can be nullptr
+// @return the future of the result
+// [Note] - Up to S_AnalysisParam::nAsyncWorkers frames run at the same time, and it blocks while as many frames are waiting.
+//        - The results may finish out of order, so use nFrameID to match them. The result video is written in the call order.
+//        - The results are returned only through the future and the callback. GetDetectionResult() and GetReIDResult() are not updated.
+//        - The registration task runs synchronously, so the frames called after it use the new query.
+//        - The callback runs on a worker thread. It must not call RunTaskAsync() or WaitAsyncTasks() of this instance.
+std::future<S_AnalysisResult> CAIAnalysis::RunTaskAsync(const E_AnalysisTaskType& eTaskType, const cv::Mat& cvBGRFrame, int64_t nFrameID,
+	const AnalysisCallback& fnCallback/* = nullptr*/)
+{
+	std::shared_ptr<std::promise<S_AnalysisResult>> pPromise = std::make_shared<std::promise<S_AnalysisResult>>();
+	std::future<S_AnalysisResult> future = pPromise->get_future();
+
+	S_AnalysisResult stResult(nFrameID, eTaskType, false);
+
+	// Complete the frame on the caller thread if it cannot be run by the workers
+	bool bRunNow = (!m_bValid || (!m_pExecutor && !m_pPipeline) || cvBGRFrame.empty() ||
+		(eTaskType != E_AnalysisTaskType::eAttPersonDetection && eTaskType != E_AnalysisTaskType::eAttPersonReID));
+	if (bRunNow)
+	{
+		// The registration changes the query used by the later frames, so it runs synchronously
+		if (m_bValid && !cvBGRFrame.empty() && eTaskType == E_AnalysisTaskType::eAttPersonRegister)
+			stResult.bSuccess = RunRegistration(cvBGRFrame);
+
+		if (fnCallback)
+			fnCallback(stResult);
+		pPromise->set_value(std::move(stResult));
+		return future;
+	}
+
+	// The frame is copied and the query is taken at the call, so the caller can go on with the next frame
+	cv::Mat cvFrame = cvBGRFrame.clone();
+	// The query feature matrix is allocated again when the query set changes, so the copy is a snapshot
+	std::vector<float> vQueryFeature;
+	ReIDQueryArr vQueries;
+	cv::Mat cvQueryFeatures;
+	if (eTaskType == E_AnalysisTaskType::eAttPersonReID && m_pReID)
+	{
+		vQueryFeature = m_pReID->GetQueryFeature();
+		vQueries = m_pReID->GetQueries();
+		cvQueryFeatures = m_pReID->GetQueryFeatures();
+	}
+
+	// The sequence number and the queue are in the same order, so the ordered video writing never waits for a frame behind it
+	std::lock_guard<std::mutex> lock(m_submitMutex);
+	uint64_t nSeq = m_nSubmitSeq;
+
+	// The motion is checked in the call order, before the frames run out of order on the workers
+	cv::Rect cvRegion;
+	uint64_t nGateSeq = 0;
+	E_MotionGateResult eGate = CheckMotion(cvFrame, cvRegion, nGateSeq);
+
+	bool bSubmitted = false;
+	if (m_pPipeline)
+	{
+		// The frame is owned by the pipeline from here, and the encoding stage completes it
+		PipelineFrame* pFrame = new PipelineFrame();
+		pFrame->pPromise = pPromise;
+		pFrame->fnCallback = fnCallback;
+		pFrame->stResult = stResult;
+		pFrame->cvFrame = cvFrame;
+		pFrame->vQueryFeature = vQueryFeature;
+		pFrame->vQueries = vQueries;
+		pFrame->cvQueryFeatures = cvQueryFeatures;
+		pFrame->eGate = eGate;
+		pFrame->cvRegion = cvRegion;
+		pFrame->nGateSeq = nGateSeq;
+		pFrame->nSeq = nSeq;
+		{
+			std::lock_guard<std::mutex> writeLock(m_writeMutex);
+			pFrame->eWriteType = m_eWriteResultType;
+		}
+
+		bSubmitted = m_pPipeline->Submit(pFrame);
+		if (!bSubmitted)
+		{
+			delete pFrame; pFrame = nullptr;
+		}
+	}
+	else
+	{
+		bSubmitted = m_pExecutor->Submit([this, pPromise, stResult, cvFrame, vQueryFeature, vQueries, cvQueryFeatures, nSeq, eGate, cvRegion, nGateSeq, fnCallback]() mutable
+		{
+			try
+			{
+				stResult.bSuccess = RunTaskCore(cvFrame, vQueryFeature, vQueries, cvQueryFeatures, eGate, cvRegion, nGateSeq, nSeq, stResult);
+			}
+			catch (std::exception& e)
+			{
+				const char* msg = e.what();
+				std::cout << msg << std::endl;
+				stResult.bSuccess = false;
+			}
+
+			WriteResultVideoInOrder(nSeq, stResult, cvFrame);
+
+			if (fnCallback)
+			{
+				try
+				{
+					fnCallback(stResult);
+				}
+				catch (std::exception& e)
+				{
+					const char* msg = e.what();
+					std::cout << msg << std::endl;
+				}
+			}
+			pPromise->set_value(std::move(stResult));
+		});
+	}
+
+	if (bSubmitted)
+	{
+		m_nSubmitSeq++;
+	}
+	else
+	{
+		// The frames behind this one wait for its gate turn
+		PassGateTurn(nGateSeq);
+		if (fnCallback)
+			fnCallback(stResult);
+		pPromise->set_value(std::move(stResult));
+	}
+
+	return future;
+}
+
+// Wait until all the frames run by RunTaskAsync() are finished
+void CAIAnalysis::WaitAsyncTasks()
+{
+	if (m_pExecutor)
+		m_pExecutor->WaitIdle();
+
+	if (m_pPipeline)
+		m_pPipeline->WaitIdle();
+}
+
 // Begin to write task results to video, given the result type
 // @param[in] eWriteTaskType: the type of result to write to video
 // @param[in] sVideoPath: the path of the video to write. The file extension should be "mp4" or "avi".
@@ -73,6 +274,7 @@ bool CAIAnalysis::BeginVideoWriter(const E_AnalysisTaskType& eWriteTaskType, con
 	if (!m_pVideoWriter)
 		return false;
 
+	std::lock_guard<std::mutex> lock(m_writeMutex);
 	m_eWriteResultType = eWriteTaskType;
 
 	if(!m_pVideoWriter->Open(sVideoPath, nW, nH, nFPS) || !m_pVideoWriter->IsValid())
@@ -87,6 +289,10 @@ bool CAIAnalysis::BeginVideoWriter(const E_AnalysisTaskType& eWriteTaskType, con
 // @return true if the video writer is closed successfully, otherwise false
 bool CAIAnalysis::EndVideoWriter()
 {
+	// Write the frames in flight before closing the video
+	WaitAsyncTasks();
+
+	std::lock_guard<std::mutex> lock(m_writeMutex);
 	m_eWriteResultType = E_AnalysisTaskType::eAttUnknown;
 
 	if(!m_pVideoWriter || !m_pVideoWriter->IsValid())
@@ -104,7 +310,7 @@ const ObjBoxArr* CAIAnalysis::GetDetectionResult() const
 	if (!m_bValid)
 		return nullptr;
 
-	return &m_pObjDetector->GetObjBoxes();
+	return &m_vObjBoxes;
 }
 
 // Get the re-identification result
@@ -117,6 +323,100 @@ const ReIDResArr* CAIAnalysis::GetReIDResult() const
 	return &m_pReID->GetReIDRes();
 }
 
+// Add the person of interest to the query set matched by the re-identification task
+// @param[in] nQueryID: the query ID returned in the results. The query of the same ID is replaced
+// @param[in] cvBGRImg: the input BGR format image of the person
+// @param[in] nTopK: the top k of the query. 0 or less means S_AnalysisParam::nReIDTopK
+// @param[in] fSimThresh: the similarity threshold of the query. Less than 0 means S_AnalysisParam::fReIDConfThresh
+// @return true if the query is added successfully, otherwise false
+// [Note] The frames called by RunTaskAsync() after it use the new query set.
+bool CAIAnalysis::AddQuery(int nQueryID, const cv::Mat& cvBGRImg, int nTopK/* = 0*/, float fSimThresh/* = -1.0f*/)
+{
+	if (!m_bValid || !m_pReID || cvBGRImg.empty())
+		return false;
+
+	ReIDQuery stQuery(nQueryID,
+		(nTopK > 0) ? nTopK : m_stParam.nReIDTopK,
+		(fSimThresh >= 0.0f) ? fSimThresh : m_stParam.fReIDConfThresh);
+
+	return m_pReID->AddQuery(stQuery, cvBGRImg);
+}
+
+// Remove the person of interest from the query set
+// @param[in] nQueryID: the query ID
+// @return true if the query is removed, otherwise false
+bool CAIAnalysis::RemoveQuery(int nQueryID)
+{
+	if (!m_bValid || !m_pReID)
+		return false;
+
+	return m_pReID->RemoveQuery(nQueryID);
+}
+
+// Remove all the persons of interest from the query set
+void CAIAnalysis::ClearQueries()
+{
+	if (m_pReID)
+		m_pReID->ClearQueries();
+}
+
+// Get the query set
+// @return the queries of the query set
+const ReIDQueryArr* CAIAnalysis::GetQueries() const
+{
+	if (!m_bValid)
+		return nullptr;
+
+	return &m_pReID->GetQueries();
+}
+
+// Get the re-identification result of each query of the query set
+// @return the re-identification result of each query
+const QueryReIDResArr* CAIAnalysis::GetQueryReIDResult() const
+{
+	if (!m_bValid)
+		return nullptr;
+
+	return &m_pReID->GetQueryReIDRes();
+}
+
+// Get the counters of the motion gate decisions
+// @param[out] stStats: the counters of the skipped, region and whole frame detections
+// @return true if the motion gate is enabled, otherwise false
+bool CAIAnalysis::GetMotionGateStats(MotionGateStats& stStats) const
+{
+	if (!m_pMotionGate)
+		return false;
+
+	stStats = m_pMotionGate->GetStats();
+	return true;
+}
+
+// Get the counters of the re-id embedding cache
+// @param[out] stStats: the counters of the requested and extracted features
+// @return true if the re-id embedding cache is enabled, otherwise false
+bool CAIAnalysis::GetReIDCacheStats(EmbeddingCacheStats& stStats) const
+{
+	if (!m_pReIDCache)
+		return false;
+
+	stStats = m_pReIDCache->GetStats();
+	return true;
+}
+
+// Get the counters of the stages of the pipelined RunTaskAsync()
+// @param[out] vStats: the queue depth and the busy time of each stage. Indexed by E_PipelineStage
+// @return true if the pipeline is enabled, otherwise false
+bool CAIAnalysis::GetPipelineStats(std::vector<PipelineStageStats>& vStats) const
+{
+	vStats.clear();
+	if (!m_pPipeline)
+		return false;
+
+	m_pPipeline->GetStats(vStats);
+	return true;
+}
+
 // Check if the analysis library is valid
 // @return true if the analysis library is valid, otherwise false
 const bool CAIAnalysis::IsValid() const
@@ -134,32 +434,58 @@ bool CAIAnalysis::DrawResult(const E_AnalysisTaskType& eDrawTaskType, bool bChec
 	if (!m_bValid)
 		return false;
 
+	return DrawResultCore(eDrawTaskType, bCheckResultExistence, m_vObjBoxes, m_pReID->GetReIDRes(), m_pReID->GetQueryReIDRes(), cvBGRFrame);
+}
+
+// Draw the result of RunTaskAsync() on the given frame
+// @param[in] stResult: the result returned by RunTaskAsync()
+// @param[in] bCheckResultExistence: true if the result existence should be checked, otherwise false
+// @param[in/out] cvBGRFrame: the input BGR format frame
+bool CAIAnalysis::DrawResult(const S_AnalysisResult& stResult, bool bCheckResultExistence, cv::Mat& cvBGRFrame)
+{
+	if (!m_bValid || !stResult.bSuccess)
+		return false;
+
+	return DrawResultCore(stResult.eTaskType, bCheckResultExistence, stResult.vObjBoxes, stResult.vReIDRes, stResult.vQueryReIDRes, cvBGRFrame);
+}
+
+// Draw the given result on the given frame
+// @param[in] eDrawTaskType: the type of analysis task
+// @param[in] bCheckResultExistence: true if the result existence should be checked, otherwise false
+// @param[in] vObjBoxes: the detection result
+// @param[in] vReIDRes: the re-identification result
+// @param[in/out] cvBGRFrame: the input BGR format frame
+bool CAIAnalysis::DrawResultCore(const E_AnalysisTaskType& eDrawTaskType, bool bCheckResultExistence,
+	const ObjBoxArr& vObjBoxes, const ReIDResArr& vReIDRes, const QueryReIDResArr& vQueryReIDRes, cv::Mat& cvBGRFrame)
+{
 	if (eDrawTaskType == E_AnalysisTaskType::eAttPersonDetection)
 	{
 		// If the result existence should be checked, the result will be drawn only if the result exists.
-		if (bCheckResultExistence && m_pObjDetector->GetObjBoxes().empty())
+		if (bCheckResultExistence && vObjBoxes.empty())
 			return false;
 
-		m_pObjDetector->DrawBBox(cvBGRFrame, m_pObjDetector->GetObjBoxes(), false, true);
+		m_pObjDetector->DrawBBox(cvBGRFrame, vObjBoxes, false, true);
 	}
 	else if (eDrawTaskType == E_AnalysisTaskType::eAttPersonReID)
 	{
-		const ObjBoxArr& vObjBoxes = m_pObjDetector->GetObjBoxes();
-		const ReIDResArr& vReIDRes = m_pReID->GetReIDRes();
+		// The matches of the registered query and of all the queries of the query set are drawn together
+		ReIDResArr vAllReIDRes = vReIDRes;
+		for (const QueryReIDRes& stQueryReIDRes : vQueryReIDRes)
+			vAllReIDRes.insert(vAllReIDRes.end(), stQueryReIDRes.vReIDRes.begin(), stQueryReIDRes.vReIDRes.end());
 
 		// If the result existence should be checked, the result will be drawn only if the result exists.
-		if(bCheckResultExistence && (vObjBoxes.empty() || vReIDRes.empty()))
+		if(bCheckResultExistence && (vObjBoxes.empty() || vAllReIDRes.empty()))
 			return false;
 
 		ObjBoxArr vDrawBoxes;
-		for (int i = 0; i < vReIDRes.size(); i++)
+		for (int i = 0; i < vAllReIDRes.size(); i++)
 		{
-			int nImgId = vReIDRes[i].nImgID;
+			int nImgId = vAllReIDRes[i].nImgID;
 			if (nImgId < 0 || nImgId >= vObjBoxes.size())
 				continue;
 
 			ObjBBox stObjBox = vObjBoxes[nImgId];
-			stObjBox.fScore = vReIDRes[i].fSimilarity;
+			stObjBox.fScore = vAllReIDRes[i].fSimilarity;
 			vDrawBoxes.push_back(stObjBox);
 		}
 
@@ -184,131 +510,158 @@ bool CAIAnalysis::Init()
 	if (!InitVideoWriter())
 		return false;
 
-	return true;
-}
-
-bool CAIAnalysis::InitObjDetector()
-{
-	if (m_stParam.eDeviceType != E_DeviceType::eDtCPU)
+	if (!InitMotionGate())
 		return false;
 
-	if (m_stParam.eRuntimeType != E_InferenceRuntimeType::eIrtOnnx)
+	if (!InitTracker())
 		return false;
 
-	if (m_stParam.eDetectionMode != E_DetectionMode::eDMYoloV7)
+	if (!InitReIDCache())
 		return false;
 
-	ObjDetNetConfig stObjDetNetConfig = {
-		m_stParam.fDetConfThresh,
-		0.5f,
-		DL_YOLO7_OBJ_DET_ONNX_MODEL_PATH,
-		DL_YOLO7_OBJ_CLASS_NAME_PATH
-	};
-
-	NetDetailsConfig stNetDetailsConfig = {
-		DEVICE_ID,
-		0, 0, 0,
-		(double)1.0 / 255,
-		(double)1.0 / 255,
-		(double)1.0 / 255
-	};
+	if (!InitPipeline())
+		return false;
 
+	return true;
+}
 
-	m_pObjDetector = new CORTYoloV7(stObjDetNetConfig, stNetDetailsConfig);
+bool CAIAnalysis::InitObjDetector()
+{
+	m_pObjDetector = CAnalysisFactory::CreateObjDetector(m_stParam, _MAX(1, m_stParam.nAsyncWorkers));
 	if (!m_pObjDetector)
 		return false;
 
-	if (!((CORTYoloV7*)m_pObjDetector)->IsValid())
-	{
-		delete m_pObjDetector; m_pObjDetector = nullptr;
-		return false;
-	}
-
-	// Limit object detector to detect person only
-	ObjClsArr vClsNames2Detect{ "person" };
-	m_pObjDetector->SetClsNames2Detect(vClsNames2Detect);
-
 	return true;
 }
 
 bool CAIAnalysis::InitReID()
 {
-	if (m_stParam.eDeviceType != E_DeviceType::eDtCPU)
+	m_pReID = CAnalysisFactory::CreateReID(m_stParam, _MAX(1, m_stParam.nAsyncWorkers));
+	if (!m_pReID)
 		return false;
 
-	if (m_stParam.eRuntimeType != E_InferenceRuntimeType::eIrtOnnx)
+	return true;
+}
+
+bool CAIAnalysis::InitVideoWriter()
+{
+	// Create video writer backed by OpenCV Video Writer
+	m_pVideoWriter = new CVideoWriter(E_WriterEngineType::eWETOpenCV);
+	if (!m_pVideoWriter)
 		return false;
 
-	if (m_stParam.eReIDMode == E_ReIDMode::eRmTorchReID)
+	return true;
+}
+
+bool CAIAnalysis::InitMotionGate()
+{
+	return CAnalysisFactory::CreateMotionGate(m_stParam, m_pMotionGate);
+}
+
+bool CAIAnalysis::InitTracker()
+{
+	return CAnalysisFactory::CreateTracker(m_stParam, m_pTracker);
+}
+
+bool CAIAnalysis::InitReIDCache()
+{
+	return CAnalysisFactory::CreateReIDCache(m_stParam, m_pReIDCache);
+}
+
+bool CAIAnalysis::InitPipeline()
+{
+	const S_PipelineParam& stPipeline = m_stParam.stPipeline;
+	if (!stPipeline.bEnable)
 	{
-		ReIDNetConfig stReIDNetCfg = {
-			m_stParam.nReIDTopK,
-			m_stParam.fReIDConfThresh,
-			DL_TORCHREID_ONNX_MODEL_PATH,
-		};
-
-		NetDetailsConfig stTorchReIDNetDetailsCfg = {
-			DEVICE_ID,
-			(double)0.406f * 255,
-			(double)0.456f * 255,
-			(double)0.485f * 255,
-			(double)1.0 / ((double)0.225f * 255),
-			(double)1.0 / ((double)0.224f * 255),
-			(double)1.0 / ((double)0.229f * 255),
-		};
-
-		m_pReID = new CORTTorchReID(stReIDNetCfg, stTorchReIDNetDetailsCfg);
-		if (!m_pReID)
+		// Workers of RunTaskAsync(). As many frames as the workers can wait in the queue
+		int nAsyncWorkers = _MAX(1, m_stParam.nAsyncWorkers);
+		m_pExecutor = new CTaskExecutor(nAsyncWorkers, nAsyncWorkers);
+		if (!m_pExecutor)
 			return false;
 
-		if (!((CORTTorchReID*)m_pReID)->IsValid())
-		{
-			delete m_pReID; m_pReID = nullptr;
-			return false;
-		}
+		return true;
 	}
-	else if (m_stParam.eReIDMode == E_ReIDMode::eRmYouReID)
+
+	// Each stage has one thread, so the frames go through the tracker and the video writer in the call order without waiting
+	std::vector<CStagePipeline::StageFunc> vStages(E_PipelineStage::ePsCount);
+	vStages[E_PipelineStage::ePsDetection] = [this](void* pItem)
 	{
-		ReIDNetConfig stReIDNetCfg = {
-			m_stParam.nReIDTopK,
-			m_stParam.fReIDConfThresh,
-			DL_YOUREID_ONNX_MODEL_PATH,
-		};
-
-		NetDetailsConfig stYouReIDNetDetailsCfg = {
-			DEVICE_ID,
-			(double)0.406f * 255,
-			(double)0.456f * 255,
-			(double)0.485f * 255,
-			(double)1.0 / ((double)0.225f * 255),
-			(double)1.0 / ((double)0.224f * 255),
-			(double)1.0 / ((double)0.229f * 255),
-		};
-
-		m_pReID = new CORTYouReID(stReIDNetCfg, stYouReIDNetDetailsCfg);
-		if (!m_pReID)
-			return false;
+		PipelineFrame* pFrame = (PipelineFrame*)pItem;
+		pFrame->stResult.bSuccess = RunDetectionCore(pFrame->cvFrame, pFrame->eGate, pFrame->cvRegion, pFrame->nGateSeq, pFrame->nSeq,
+			pFrame->stResult);
+	};
+	vStages[E_PipelineStage::ePsReID] = [this](void* pItem)
+	{
+		PipelineFrame* pFrame = (PipelineFrame*)pItem;
+		if (!pFrame->stResult.bSuccess || pFrame->stResult.eTaskType == E_AnalysisTaskType::eAttPersonDetection)
+			return;
+
+		// The result stays failed if the re-identification throws
+		pFrame->stResult.bSuccess = false;
+		pFrame->stResult.bSuccess = RunReIDCore(pFrame->cvFrame, pFrame->vQueryFeature, pFrame->vQueries, pFrame->cvQueryFeatures,
+			pFrame->stResult);
+	};
+	vStages[E_PipelineStage::ePsRender] = [this](void* pItem)
+	{
+		PipelineFrame* pFrame = (PipelineFrame*)pItem;
+		if (!pFrame->stResult.bSuccess ||
+			pFrame->eWriteType <= E_AnalysisTaskType::eAttUnknown || pFrame->eWriteType >= E_AnalysisTaskType::eAttCount)
+			return;
+
+		// The frame is a private copy no later stage reads, so the result is drawn on it directly.
+		// The frame without result is skipped as same as RunTask()
+		const S_AnalysisResult& stResult = pFrame->stResult;
+		pFrame->bWrite = DrawResultCore(pFrame->eWriteType, true, stResult.vObjBoxes, stResult.vReIDRes, stResult.vQueryReIDRes,
+			pFrame->cvFrame);
+	};
+	vStages[E_PipelineStage::ePsEncode] = [this](void* pItem)
+	{
+		PipelineFrame* pFrame = (PipelineFrame*)pItem;
 
-		if (!((CORTYouReID*)m_pReID)->IsValid())
+		// [Note] The frame must be completed even if the writing or the callback fails, so all the exceptions are caught here.
+		//        Otherwise the future of the caller and WaitIdle() would wait for it forever
+		if (pFrame->bWrite)
 		{
-			delete m_pReID; m_pReID = nullptr;
-			return false;
+			try
+			{
+				std::lock_guard<std::mutex> lock(m_writeMutex);
+				if (m_pVideoWriter)
+					m_pVideoWriter->WriteFrame(pFrame->cvFrame);
+			}
+			catch (std::exception& e)
+			{
+				const char* msg = e.what();
+				std::cout << msg << std::endl;
+			}
+			catch (...)
+			{
+				std::cout << "CAIAnalysis: Unknown exception when writing the frame" << std::endl;
+			}
 		}
-	}
-	else
-	{
-		return false;
-	}
 
-	return true;
+		if (pFrame->fnCallback)
+		{
+			try
+			{
+				pFrame->fnCallback(pFrame->stResult);
+			}
+			catch (std::exception& e)
+			{
+				const char* msg = e.what();
+				std::cout << msg << std::endl;
+			}
+			catch (...)
+			{
+				std::cout << "CAIAnalysis: Unknown exception in the result callback" << std::endl;
+			}
+		}
+		pFrame->pPromise->set_value(std::move(pFrame->stResult));
 
-}
+		delete pFrame; pFrame = nullptr;
+	};
 
-bool CAIAnalysis::InitVideoWriter()
-{
-	// Create video writer backed by OpenCV Video Writer
-	m_pVideoWriter = new CVideoWriter(E_WriterEngineType::eWETOpenCV);
-	if (!m_pVideoWriter)
+	m_pPipeline = new CStagePipeline(vStages, stPipeline.nQueueDepth);
+	if (!m_pPipeline)
 		return false;
 
 	return true;
@@ -316,6 +669,13 @@ bool CAIAnalysis::InitVideoWriter()
 
 void CAIAnalysis::Release()
 {
+	// Finish the frames in flight before releasing the networks they use
+	if (m_pExecutor)
+		delete m_pExecutor; m_pExecutor = nullptr;
+
+	if (m_pPipeline)
+		delete m_pPipeline; m_pPipeline = nullptr;
+
 	if (m_pObjDetector)
 		delete m_pObjDetector; m_pObjDetector = nullptr;
 
@@ -325,6 +685,15 @@ void CAIAnalysis::Release()
 	if (m_pVideoWriter)
 		delete m_pVideoWriter; m_pVideoWriter = nullptr;
 
+	if (m_pMotionGate)
+		delete m_pMotionGate; m_pMotionGate = nullptr;
+
+	if (m_pTracker)
+		delete m_pTracker; m_pTracker = nullptr;
+
+	if (m_pReIDCache)
+		delete m_pReIDCache; m_pReIDCache = nullptr;
+
 	m_eWriteResultType = E_AnalysisTaskType::eAttUnknown;
 	m_bValid = false;
 }
@@ -333,13 +702,42 @@ void CAIAnalysis::Release()
 // Run the detection task
 // @param[in] cvBGRFrame: the input BGR format frame
 // @return true if the task is run successfully, otherwise false
+// [Note] If the tracker is enabled, the detector runs on every nDetectInterval frames and the tracks are predicted on the others.
 bool CAIAnalysis::RunDetection(const cv::Mat& cvBGRFrame)
 {
 	if (!m_pObjDetector)
 		return false;
 
-	if (!m_pObjDetector->Detect(cvBGRFrame))
-		return false;
+	cv::Rect cvRegion;
+	uint64_t nGateSeq = 0;
+	E_MotionGateResult eGate = CheckMotion(cvBGRFrame, cvRegion, nGateSeq);
+
+	bool bDetected = false;
+	if (!m_pTracker || m_pTracker->IsDetectionFrame(nGateSeq))
+	{
+		bDetected = DetectGated(cvBGRFrame, eGate, cvRegion, nGateSeq, m_vObjBoxes);
+		if (!bDetected)
+		{
+			m_vObjBoxes.clear();
+			if (!m_pTracker)
+				return false;
+		}
+	}
+	else
+	{
+		PassGateTurn(nGateSeq);
+	}
+
+	if (m_pTracker)
+	{
+		std::lock_guard<std::mutex> lock(m_trackMutex);
+		if (bDetected)
+			m_pTracker->Update(m_vObjBoxes);
+		else
+			m_pTracker->Propagate(m_vObjBoxes);
+
+		CAnalysisUtil::ClipObjects(cvBGRFrame.size(), m_vObjBoxes);
+	}
 
 	return true;
 }
@@ -352,6 +750,9 @@ bool CAIAnalysis::RunReID(const cv::Mat& cvBGRFrame)
 	if (!m_pReID)
 		return false;
 
+	// The results of the previous frame must not be drawn on the boxes of this one if the matching is skipped
+	m_pReID->ClearResults();
+
 	// Run detection first
 	if (!RunDetection(cvBGRFrame))
 		return false;
@@ -359,19 +760,21 @@ bool CAIAnalysis::RunReID(const cv::Mat& cvBGRFrame)
 	// Get the detection result
 	const ObjBoxArr* pDetRes = GetDetectionResult();
 
-	// Create gallery images from the detection result by cropping the detected person
-	std::vector<cv::Mat> vGalleryImgs;
-	for (const ObjBBox& stObjBox : *pDetRes)
-	{
-		const cv::Mat& cvCropImg = cvBGRFrame(
-			cv::Range((int)stObjBox.fY1, (int)stObjBox.fY2),
-			cv::Range((int)stObjBox.fX1, (int)stObjBox.fX2));
+	bool bQuery = !m_pReID->GetQueryFeature().empty();
+	bool bQuerySet = !m_pReID->GetQueries().empty();
+	if (!bQuery && !bQuerySet)
+		return false;
 
-		vGalleryImgs.push_back(cvCropImg);
-	}
+	// Extract the features of the detected persons once for the registered query and all the queries of the query set
+	cv::Mat cvGalleryFeatures;
+	if (!GetGalleryFeatures(cvBGRFrame, *pDetRes, cvGalleryFeatures))
+		return false;
 
 	// Run re-identification
-	if (!m_pReID->ReID(vGalleryImgs))
+	if (bQuery && !m_pReID->MatchFeatures(cvGalleryFeatures))
+		return false;
+
+	if (bQuerySet && !m_pReID->MatchQueries(cvGalleryFeatures))
 		return false;
 
 	return true;
@@ -396,6 +799,8 @@ bool CAIAnalysis::WriteResultVideo(const cv::Mat& cvBGRFrame)
 	if(!m_bValid)
 		return false;
 
+	std::lock_guard<std::mutex> lock(m_writeMutex);
+
 	if (m_eWriteResultType <= E_AnalysisTaskType::eAttUnknown || m_eWriteResultType >= E_AnalysisTaskType::eAttCount)
 		return true; // must return true to ignore the case not to write result to video
 
@@ -412,3 +817,278 @@ bool CAIAnalysis::WriteResultVideo(const cv::Mat& cvBGRFrame)
 	return true;
 }
 
+// Run the task on the given frame into the given result without touching the state of the networks
+// @param[in] cvBGRFrame: the input BGR format frame
+// @param[in] vQueryFeature: the query feature of the re-identification task
+// @param[in] vQueries: the query set of the re-identification task
+// @param[in] cvQueryFeatures: the feature matrix of the query set
+// @param[in] eGate: the decision of the motion gate on the frame
+// @param[in] cvRegion: the motion region of the frame
+// @param[in] nGateSeq: the sequence number of the frame checked by the motion gate
+// @param[in] nSeq: the call sequence number of the frame
+// @param[in/out] stResult: the result of the task. The task type is given in it
+// @return true if the task is run successfully, otherwise false
+bool CAIAnalysis::RunTaskCore(const cv::Mat& cvBGRFrame, const std::vector<float>& vQueryFeature, const ReIDQueryArr& vQueries, const cv::Mat& cvQueryFeatures,
+	E_MotionGateResult eGate, const cv::Rect& cvRegion, uint64_t nGateSeq, uint64_t nSeq, S_AnalysisResult& stResult)
+{
+	// Both tasks run detection first
+	if (!RunDetectionCore(cvBGRFrame, eGate, cvRegion, nGateSeq, nSeq, stResult))
+		return false;
+
+	if (stResult.eTaskType == E_AnalysisTaskType::eAttPersonDetection)
+		return true;
+
+	return RunReIDCore(cvBGRFrame, vQueryFeature, vQueries, cvQueryFeatures, stResult);
+}
+
+// Run the detection and the tracking of the task into the given result
+// @param[in] cvBGRFrame: the input BGR format frame
+// @param[in] eGate: the decision of the motion gate on the frame
+// @param[in] cvRegion: the motion region of the frame
+// @param[in] nGateSeq: the sequence number of the frame checked by the motion gate
+// @param[in] nSeq: the call sequence number of the frame
+// @param[in/out] stResult: the result of the task. The detection result is set to it
+// @return true if the objects are detected or tracked successfully, otherwise false
+// [Note] It must be called once for every frame submitted to the workers, as the tracker waits for the turn of each frame.
+bool CAIAnalysis::RunDetectionCore(const cv::Mat& cvBGRFrame, E_MotionGateResult eGate, const cv::Rect& cvRegion, uint64_t nGateSeq, uint64_t nSeq,
+	S_AnalysisResult& stResult)
+{
+	bool bDetected = false;
+	if (m_pObjDetector && (!m_pTracker || m_pTracker->IsDetectionFrame(nGateSeq)))
+	{
+		// [Note] The tracking turn must be passed to the next frame even if the detection fails, so the exception is caught here
+		try
+		{
+			bDetected = DetectGated(cvBGRFrame, eGate, cvRegion, nGateSeq, stResult.vObjBoxes);
+		}
+		catch (std::exception& e)
+		{
+			const char* msg = e.what();
+			std::cout << msg << std::endl;
+		}
+		if (!bDetected)
+			stResult.vObjBoxes.clear();
+	}
+	else
+	{
+		PassGateTurn(nGateSeq);
+	}
+
+	if (m_pTracker)
+		TrackInOrder(nSeq, bDetected, cvBGRFrame.size(), stResult.vObjBoxes);
+	else if (!bDetected)
+		return false;
+
+	if (!m_pObjDetector)
+		return false;
+
+	return true;
+}
+
+// Run the re-identification of the task on the detection result into the given result
+// @param[in] cvBGRFrame: the input BGR format frame
+// @param[in] vQueryFeature: the query feature of the re-identification task
+// @param[in] vQueries: the query set of the re-identification task
+// @param[in] cvQueryFeatures: the feature matrix of the query set
+// @param[in/out] stResult: the result of the task holding the detection result. The re-identification result is set to it
+// @return true if the task is run successfully, otherwise false
+bool CAIAnalysis::RunReIDCore(const cv::Mat& cvBGRFrame, const std::vector<float>& vQueryFeature, const ReIDQueryArr& vQueries, const cv::Mat& cvQueryFeatures,
+	S_AnalysisResult& stResult)
+{
+	if (stResult.eTaskType != E_AnalysisTaskType::eAttPersonReID || !m_pReID)
+		return false;
+
+	if (vQueryFeature.empty() && vQueries.empty())
+		return false;
+
+	cv::Mat cvGalleryFeatures;
+	if (!GetGalleryFeatures(cvBGRFrame, stResult.vObjBoxes, cvGalleryFeatures))
+		return false;
+
+	if (!vQueryFeature.empty() && !m_pReID->MatchFeatures(vQueryFeature, cvGalleryFeatures, stResult.vReIDRes))
+		return false;
+
+	if (!vQueries.empty() && !m_pReID->MatchQueries(vQueries, cvQueryFeatures, cvGalleryFeatures, stResult.vQueryReIDRes))
+		return false;
+
+	return true;
+}
+
+// Check the motion of the frame before the detection
+// @param[in] cvBGRFrame: the input BGR format frame
+// @param[out] cvRegion: the motion region of the frame
+// @param[out] nGateSeq: the sequence number of the frame
+// @return the decision of the motion gate. eMgFullFrame if the motion gate is disabled
+// [Note] The frames must be checked in the capture order.
+E_MotionGateResult CAIAnalysis::CheckMotion(const cv::Mat& cvBGRFrame, cv::Rect& cvRegion, uint64_t& nGateSeq)
+{
+	cvRegion = cv::Rect(0, 0, cvBGRFrame.cols, cvBGRFrame.rows);
+	nGateSeq = m_nGateSeq++;
+
+	if (!m_pMotionGate)
+		return E_MotionGateResult::eMgFullFrame;
+
+	E_MotionGateResult eGate = m_pMotionGate->Check(cvBGRFrame, cvRegion);
+	if (eGate == E_MotionGateResult::eMgUnknown)
+		return E_MotionGateResult::eMgFullFrame;
+
+	return eGate;
+}
+
+// Detect the objects in the frame as decided by the motion gate
+// @param[in] cvBGRFrame: the input BGR format frame
+// @param[in] eGate: the decision of the motion gate on the frame
+// @param[in] cvRegion: the motion region of the frame
+// @param[in] nGateSeq: the sequence number of the frame checked by the motion gate
+// @param[out] vObjBoxes: the detection result
+// @return true if the detection is successful, otherwise false
+// [Note] - The skipped frame reuses the latest result, and the region result keeps the previous objects out of the region.
+//        - The results are resolved in the gate order, so the skipped frame waits for the detection of the frames before it.
+bool CAIAnalysis::DetectGated(const cv::Mat& cvBGRFrame, E_MotionGateResult eGate, const cv::Rect& cvRegion, uint64_t nGateSeq,
+	ObjBoxArr& vObjBoxes)
+{
+	if (!m_pMotionGate)
+		return m_pObjDetector->Detect(cvBGRFrame, vObjBoxes);
+
+	// The detector runs before the turn, so the frames of RunTaskAsync() are still detected in parallel
+	// [Note] The gate turn must be passed to the next frame even if the detection fails, so the exception is caught here
+	bool bDetected = false;
+	ObjBoxArr vRegionBoxes;
+	try
+	{
+		if (eGate == E_MotionGateResult::eMgSkip)
+			bDetected = true;	// Nothing moved, so the detector is not run at all
+		else if (eGate == E_MotionGateResult::eMgRegion)
+			bDetected = m_pObjDetector->Detect(cvBGRFrame(cvRegion), vRegionBoxes);
+		else
+			bDetected = m_pObjDetector->Detect(cvBGRFrame, vObjBoxes);
+	}
+	catch (std::exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+	}
+
+	// Each result builds on the one of the frame before it, so wait for the frames before this one to be resolved
+	std::unique_lock<std::mutex> lock(m_gateMutex);
+	m_cvGateTurn.wait(lock, [this, nGateSeq]() { return m_nGateTurnSeq == nGateSeq; });
+
+	if (bDetected)
+	{
+		if (eGate == E_MotionGateResult::eMgSkip)
+		{
+			vObjBoxes = m_vGateBoxes;
+		}
+		else
+		{
+			// The previous objects whose centre is out of the region have not moved, so they are kept
+			if (eGate == E_MotionGateResult::eMgRegion)
+				CAnalysisUtil::MergeRegionObjects(m_vGateBoxes, vRegionBoxes, cvRegion, vObjBoxes);
+
+			m_vGateBoxes = vObjBoxes;
+		}
+	}
+
+	m_nGateTurnSeq++;
+	m_cvGateTurn.notify_all();
+
+	return bDetected;
+}
+
+// Pass the gate turn of the frame without detection to the next frame
+// @param[in] nGateSeq: the sequence number of the frame checked by the motion gate
+// [Note] It must be called once for every frame checked by the motion gate but not given to DetectGated().
+void CAIAnalysis::PassGateTurn(uint64_t nGateSeq)
+{
+	if (!m_pMotionGate)
+		return;
+
+	std::unique_lock<std::mutex> lock(m_gateMutex);
+	m_cvGateTurn.wait(lock, [this, nGateSeq]() { return m_nGateTurnSeq == nGateSeq; });
+
+	m_nGateTurnSeq++;
+	m_cvGateTurn.notify_all();
+}
+
+// Write the result of RunTaskAsync() to video in the call order
+// @param[in] nSeq: the call sequence number of the frame
+// @param[in] stResult: the result of the frame
+// @param[in] cvBGRFrame: the input BGR format frame
+void CAIAnalysis::WriteResultVideoInOrder(uint64_t nSeq, const S_AnalysisResult& stResult, const cv::Mat& cvBGRFrame)
+{
+	std::unique_lock<std::mutex> lock(m_writeMutex);
+
+	// Wait for the turn of this frame. The frames before it have been taken by the other workers
+	m_cvWriteTurn.wait(lock, [this, nSeq]() { return m_nWriteSeq == nSeq; });
+
+	if (stResult.bSuccess && m_pVideoWriter &&
+		m_eWriteResultType > E_AnalysisTaskType::eAttUnknown && m_eWriteResultType < E_AnalysisTaskType::eAttCount)
+	{
+		// [Note] The turn must be passed to the next frame even if the writing fails, so the exception is caught here
+		try
+		{
+			cv::Mat cvWriteFrame = cvBGRFrame.clone();
+
+			// The frame without result is skipped as same as RunTask()
+			if (DrawResultCore(m_eWriteResultType, true, stResult.vObjBoxes, stResult.vReIDRes, stResult.vQueryReIDRes, cvWriteFrame))
+				m_pVideoWriter->WriteFrame(cvWriteFrame);
+		}
+		catch (std::exception& e)
+		{
+			const char* msg = e.what();
+			std::cout << msg << std::endl;
+		}
+	}
+
+	m_nWriteSeq++;
+	m_cvWriteTurn.notify_all();
+}
+
+// Track the objects of the frame of RunTaskAsync() in the call order
+// @param[in] nSeq: the call sequence number of the frame
+// @param[in] bDetected: true if the objects are detected on the frame, false if the tracks are only predicted
+// @param[in] cvFrameSize: the size of the frame
+// @param[in/out] vObjBoxes: the detection result, replaced with the tracked objects
+// [Note] It must be called once for every frame submitted to the workers, even if the detection fails.
+void CAIAnalysis::TrackInOrder(uint64_t nSeq, bool bDetected, const cv::Size& cvFrameSize, ObjBoxArr& vObjBoxes)
+{
+	std::unique_lock<std::mutex> lock(m_trackMutex);
+
+	// The tracks move frame by frame, so wait for the frames before this one to be tracked
+	m_cvTrackTurn.wait(lock, [this, nSeq]() { return m_nTrackSeq == nSeq; });
+
+	try
+	{
+		if (bDetected)
+			m_pTracker->Update(vObjBoxes);
+		else
+			m_pTracker->Propagate(vObjBoxes);
+
+		CAnalysisUtil::ClipObjects(cvFrameSize, vObjBoxes);
+	}
+	catch (std::exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+	}
+
+	m_nTrackSeq++;
+	m_cvTrackTurn.notify_all();
+}
+
+// Get the re-id features of the detected objects
+// @param[in] cvBGRFrame: the input BGR format frame
+// @param[in] vObjBoxes: the detection result
+// @param[out] cvGalleryFeatures: the feature matrix. Each row is the feature vector of the relevant object
+// @return true if the features are obtained successfully, otherwise false
+// [Note] The cached features of the tracked objects are reused if the re-id embedding cache is enabled.
+bool CAIAnalysis::GetGalleryFeatures(const cv::Mat& cvBGRFrame, const ObjBoxArr& vObjBoxes, cv::Mat& cvGalleryFeatures)
+{
+	std::vector<cv::Mat> vGalleryImgs;
+	CAnalysisUtil::CropObjects(cvBGRFrame, vObjBoxes, vGalleryImgs);
+
+	if (!m_pReIDCache)
+		return m_pReID->ExtractFeatures(vGalleryImgs, cvGalleryFeatures);
+
+	return m_pReIDCache->GetFeatures(m_pReID, vObjBoxes, vGalleryImgs, cvGalleryFeatures);
+}
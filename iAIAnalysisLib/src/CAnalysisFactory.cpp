@@ -0,0 +1,307 @@
+#include <filesystem>
+#include "CAnalysisFactory.h"
+#include "CORTYoloV7.h"
+#include "CCVYoloV7.h"
+#include "CORTYouReID.h"
+#include "CCVYouReID.h"
+#include "CORTTorchReID.h"
+#include "CCVTorchReID.h"
+#include "CMotionGate.h"
+#include "CTracker.h"
+#include "CEmbeddingCache.h"
+
+#define DEVICE_ID	-1
+
+// Convert the threading parameters of the analysis into the threading policy of the networks
+// @param[in] stThreading: threading parameters of the analysis
+// @return: threading policy applied to the detection and re-id networks
+static ThreadingPolicy ToThreadingPolicy(const S_ThreadingParam& stThreading)
+{
+	return ThreadingPolicy(
+		stThreading.bOwnThreadPools,
+		stThreading.nIntraOpThreads,
+		stThreading.nInterOpThreads,
+		stThreading.bParallelExecution,
+		stThreading.bAllowSpinning,
+		stThreading.nCPUAffinityMask);
+}
+
+// Select the model path of the given precision
+// @param[in] ePrecision: numeric precision of the network
+// @param[in] sFP32ModelPath: path to the FP32 model
+// @param[in] sINT8ModelPath: path to the INT8 model generated by the calibration tool
+// @return: the model path. Empty if the precision is not supported
+// [Note] If the INT8 model has not been generated yet, the FP32 model is used with the warning message.
+static std::string SelectModelPath(E_Precision ePrecision, const std::string& sFP32ModelPath, const std::string& sINT8ModelPath)
+{
+	if (ePrecision == E_Precision::ePrFP32)
+		return sFP32ModelPath;
+
+	if (ePrecision != E_Precision::ePrINT8)
+		return "";
+
+	std::error_code ec;
+	if (!std::filesystem::exists(sINT8ModelPath, ec))
+	{
+		std::cout << "INT8 model is not found, so the FP32 model is used: " << sINT8ModelPath << std::endl;
+		return sFP32ModelPath;
+	}
+
+	return sINT8ModelPath;
+}
+
+// Select the inference runtime of the network
+// @param[in] eNetRuntimeType: runtime type chosen for the network. eIrtUnknown means the default runtime type
+// @param[in] eDefaultRuntimeType: default runtime type of all the networks
+// @return: the runtime type. eIrtUnknown if the runtime is not supported
+// [Note] The runtime can be chosen per network, as the faster runtime differs by the model and the CPU.
+static E_InferenceRuntimeType SelectRuntimeType(E_InferenceRuntimeType eNetRuntimeType, E_InferenceRuntimeType eDefaultRuntimeType)
+{
+	E_InferenceRuntimeType eRuntimeType = (eNetRuntimeType != E_InferenceRuntimeType::eIrtUnknown) ? eNetRuntimeType : eDefaultRuntimeType;
+
+	if (eRuntimeType != E_InferenceRuntimeType::eIrtOnnx && eRuntimeType != E_InferenceRuntimeType::eIrtOpenCVDNN)
+		return E_InferenceRuntimeType::eIrtUnknown;
+
+	return eRuntimeType;
+}
+
+// Create the detection network of the analysis parameters
+// @param[in] stParam: analysis parameters
+// @param[in] nSessionPoolSize: number of sessions added to the session pool of the network, that is the number of concurrent runs
+// @return: the valid detection network. nullptr if it fails
+CObjDetector* CAnalysisFactory::CreateObjDetector(const S_AnalysisParam& stParam, int nSessionPoolSize)
+{
+	CObjDetector* pObjDetector = nullptr;
+
+	if (stParam.eDeviceType != E_DeviceType::eDtCPU)
+		return nullptr;
+
+	E_InferenceRuntimeType eRuntimeType = SelectRuntimeType(stParam.eDetRuntimeType, stParam.eRuntimeType);
+	if (eRuntimeType == E_InferenceRuntimeType::eIrtUnknown)
+		return nullptr;
+
+	if (stParam.eDetectionMode != E_DetectionMode::eDMYoloV7)
+		return nullptr;
+
+	std::string sModelPath = SelectModelPath(stParam.ePrecision, DL_YOLO7_OBJ_DET_ONNX_MODEL_PATH, DL_YOLO7_OBJ_DET_INT8_ONNX_MODEL_PATH);
+	if (sModelPath.empty())
+		return nullptr;
+
+	// The tracker associates the low score detections to the existing tracks, so the detector keeps them
+	float fDetConfThresh = stParam.fDetConfThresh;
+	if (stParam.stTracker.bEnable)
+		fDetConfThresh = _MIN(fDetConfThresh, stParam.stTracker.fLowScoreThresh);
+
+	ObjDetNetConfig stObjDetNetConfig = {
+		fDetConfThresh,
+		stParam.fDetNMSThresh,
+		sModelPath,
+		DL_YOLO7_OBJ_CLASS_NAME_PATH,
+		stParam.eDetNMSMethod
+	};
+
+	NetDetailsConfig stNetDetailsConfig = {
+		DEVICE_ID,
+		0, 0, 0,
+		(double)1.0 / 255,
+		(double)1.0 / 255,
+		(double)1.0 / 255
+	};
+	stNetDetailsConfig.bIoBinding = true;
+	stNetDetailsConfig.stThreading = ToThreadingPolicy(stParam.stThreading);
+	stNetDetailsConfig.nSessionPoolSize = _MAX(1, nSessionPoolSize);
+	if (stParam.stDetTiling.bEnable)
+		stNetDetailsConfig.nSessionPoolSize = _MAX(stNetDetailsConfig.nSessionPoolSize, stParam.stDetTiling.nParallelRuns);
+
+
+	if (eRuntimeType == E_InferenceRuntimeType::eIrtOpenCVDNN)
+		pObjDetector = new CCVYoloV7(stObjDetNetConfig, stNetDetailsConfig);
+	else
+		pObjDetector = new CORTYoloV7(stObjDetNetConfig, stNetDetailsConfig);
+	if (!pObjDetector)
+		return nullptr;
+
+	if (!((CYoloV7*)pObjDetector)->IsValid())
+	{
+		delete pObjDetector; pObjDetector = nullptr;
+		return nullptr;
+	}
+
+	// Limit object detector to detect person only
+	ObjClsArr vClsNames2Detect{ "person" };
+	pObjDetector->SetClsNames2Detect(vClsNames2Detect);
+
+	const S_TileParam& stTiling = stParam.stDetTiling;
+	pObjDetector->SetTileConfig(TileConfig(stTiling.bEnable, stTiling.nTileW, stTiling.nTileH, stTiling.nOverlap,
+		stTiling.bFullFrame, stTiling.nParallelRuns, stTiling.vActiveTiles));
+
+	return pObjDetector;
+}
+
+// Create the re-id network of the analysis parameters
+// @param[in] stParam: analysis parameters
+// @param[in] nSessionPoolSize: number of sessions added to the session pool of the network, that is the number of concurrent runs
+// @return: the valid re-id network. nullptr if it fails
+CReID* CAnalysisFactory::CreateReID(const S_AnalysisParam& stParam, int nSessionPoolSize)
+{
+	CReID* pReID = nullptr;
+
+	if (stParam.eDeviceType != E_DeviceType::eDtCPU)
+		return nullptr;
+
+	E_InferenceRuntimeType eRuntimeType = SelectRuntimeType(stParam.eReIDRuntimeType, stParam.eRuntimeType);
+	if (eRuntimeType == E_InferenceRuntimeType::eIrtUnknown)
+		return nullptr;
+
+	if (stParam.eReIDMode == E_ReIDMode::eRmTorchReID)
+	{
+		std::string sModelPath = SelectModelPath(stParam.ePrecision, DL_TORCHREID_ONNX_MODEL_PATH, DL_TORCHREID_INT8_ONNX_MODEL_PATH);
+		if (sModelPath.empty())
+			return nullptr;
+
+		ReIDNetConfig stReIDNetCfg = {
+			stParam.nReIDTopK,
+			stParam.fReIDConfThresh,
+			sModelPath,
+		};
+
+		NetDetailsConfig stTorchReIDNetDetailsCfg = {
+			DEVICE_ID,
+			(double)0.406f * 255,
+			(double)0.456f * 255,
+			(double)0.485f * 255,
+			(double)1.0 / ((double)0.225f * 255),
+			(double)1.0 / ((double)0.224f * 255),
+			(double)1.0 / ((double)0.229f * 255),
+			stParam.nReIDMaxBatchSize,
+		};
+		stTorchReIDNetDetailsCfg.bIoBinding = true;
+		stTorchReIDNetDetailsCfg.stThreading = ToThreadingPolicy(stParam.stThreading);
+		stTorchReIDNetDetailsCfg.nSessionPoolSize = _MAX(1, nSessionPoolSize);
+
+		if (eRuntimeType == E_InferenceRuntimeType::eIrtOpenCVDNN)
+			pReID = new CCVTorchReID(stReIDNetCfg, stTorchReIDNetDetailsCfg);
+		else
+			pReID = new CORTTorchReID(stReIDNetCfg, stTorchReIDNetDetailsCfg);
+		if (!pReID)
+			return nullptr;
+
+		if (!((CTorchReID*)pReID)->IsValid())
+		{
+			delete pReID; pReID = nullptr;
+			return nullptr;
+		}
+	}
+	else if (stParam.eReIDMode == E_ReIDMode::eRmYouReID)
+	{
+		std::string sModelPath = SelectModelPath(stParam.ePrecision, DL_YOUREID_ONNX_MODEL_PATH, DL_YOUREID_INT8_ONNX_MODEL_PATH);
+		if (sModelPath.empty())
+			return nullptr;
+
+		ReIDNetConfig stReIDNetCfg = {
+			stParam.nReIDTopK,
+			stParam.fReIDConfThresh,
+			sModelPath,
+		};
+
+		NetDetailsConfig stYouReIDNetDetailsCfg = {
+			DEVICE_ID,
+			(double)0.406f * 255,
+			(double)0.456f * 255,
+			(double)0.485f * 255,
+			(double)1.0 / ((double)0.225f * 255),
+			(double)1.0 / ((double)0.224f * 255),
+			(double)1.0 / ((double)0.229f * 255),
+			stParam.nReIDMaxBatchSize,
+		};
+		stYouReIDNetDetailsCfg.bIoBinding = true;
+		stYouReIDNetDetailsCfg.stThreading = ToThreadingPolicy(stParam.stThreading);
+		stYouReIDNetDetailsCfg.nSessionPoolSize = _MAX(1, nSessionPoolSize);
+
+		if (eRuntimeType == E_InferenceRuntimeType::eIrtOpenCVDNN)
+			pReID = new CCVYouReID(stReIDNetCfg, stYouReIDNetDetailsCfg);
+		else
+			pReID = new CORTYouReID(stReIDNetCfg, stYouReIDNetDetailsCfg);
+		if (!pReID)
+			return nullptr;
+
+		if (!((CYouReID*)pReID)->IsValid())
+		{
+			delete pReID; pReID = nullptr;
+			return nullptr;
+		}
+	}
+	else
+	{
+		return nullptr;
+	}
+
+	return pReID;
+}
+
+// Create the motion gate of the analysis parameters
+// @param[in] stParam: analysis parameters
+// @param[out] pMotionGate: the motion gate. nullptr if disabled
+// @return: true if the motion gate is created or disabled, false otherwise
+bool CAnalysisFactory::CreateMotionGate(const S_AnalysisParam& stParam, CMotionGate*& pMotionGate)
+{
+	pMotionGate = nullptr;
+
+	const S_MotionGateParam& stGate = stParam.stMotionGate;
+	if (!stGate.bEnable)
+		return true;
+
+	MotionGateConfig stConfig(stGate.bEnable, stGate.nProcWidth, stGate.nDiffThresh, stGate.fMinMotionRatio,
+		stGate.fLearningRate, stGate.nRegionMargin, stGate.fMaxRegionRatio, stGate.nRefreshInterval);
+
+	pMotionGate = new CMotionGate(stConfig);
+	if (!pMotionGate)
+		return false;
+
+	return true;
+}
+
+// Create the multi-object tracker of the analysis parameters
+// @param[in] stParam: analysis parameters
+// @param[out] pTracker: the tracker. nullptr if disabled
+// @return: true if the tracker is created or disabled, false otherwise
+bool CAnalysisFactory::CreateTracker(const S_AnalysisParam& stParam, CTracker*& pTracker)
+{
+	pTracker = nullptr;
+
+	if (!stParam.stTracker.bEnable)
+		return true;
+
+	// The detections over the confidence threshold of the analysis are the confident ones which start the tracks
+	pTracker = new CTracker(stParam.stTracker, stParam.fDetConfThresh);
+	if (!pTracker)
+		return false;
+
+	return true;
+}
+
+// Create the re-id embedding cache of the analysis parameters
+// @param[in] stParam: analysis parameters
+// @param[out] pReIDCache: the re-id embedding cache. nullptr if disabled
+// @return: true if the re-id embedding cache is created or disabled, false otherwise
+bool CAnalysisFactory::CreateReIDCache(const S_AnalysisParam& stParam, CEmbeddingCache*& pReIDCache)
+{
+	pReIDCache = nullptr;
+
+	const S_ReIDCacheParam& stCache = stParam.stReIDCache;
+	if (!stCache.bEnable)
+		return true;
+
+	// The features are cached by the track ID, so the objects are extracted on every frame without the tracker
+	if (!stParam.stTracker.bEnable)
+		std::cout << "Re-id embedding cache needs the tracker, so the features are extracted on every frame" << std::endl;
+
+	EmbeddingCacheConfig stConfig(stCache.bEnable, stCache.nRefreshInterval, stCache.fScaleChangeRatio, stCache.fAppearanceThresh,
+		stCache.fMomentum, stCache.nMaxIdleFrames);
+
+	pReIDCache = new CEmbeddingCache(stConfig);
+	if (!pReIDCache)
+		return false;
+
+	return true;
+}
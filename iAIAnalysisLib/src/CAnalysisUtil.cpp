@@ -0,0 +1,65 @@
+#include "CAnalysisUtil.h"
+
+// Crop the detected objects from the frame
+// @param[in] cvBGRFrame: the input BGR format frame
+// @param[in] vObjBoxes: the detection result
+// @param[out] vCropImgs: the cropped images sharing the buffer of the frame
+void CAnalysisUtil::CropObjects(const cv::Mat& cvBGRFrame, const ObjBoxArr& vObjBoxes, std::vector<cv::Mat>& vCropImgs)
+{
+	vCropImgs.clear();
+	vCropImgs.reserve(vObjBoxes.size());
+	for (const ObjBBox& stObjBox : vObjBoxes)
+	{
+		const cv::Mat& cvCropImg = cvBGRFrame(
+			cv::Range((int)stObjBox.fY1, (int)stObjBox.fY2),
+			cv::Range((int)stObjBox.fX1, (int)stObjBox.fX2));
+
+		vCropImgs.push_back(cvCropImg);
+	}
+}
+
+// Clip the tracked objects to the frame and remove the ones out of it
+// @param[in] cvFrameSize: the size of the frame
+// @param[in/out] vObjBoxes: the tracked objects
+// [Note] The boxes predicted by the tracker may go over the border of the frame, while the cropping needs the boxes inside it.
+void CAnalysisUtil::ClipObjects(const cv::Size& cvFrameSize, ObjBoxArr& vObjBoxes)
+{
+	ObjBoxArr vClipped;
+	vClipped.reserve(vObjBoxes.size());
+	for (ObjBBox stObjBox : vObjBoxes)
+	{
+		stObjBox.fX1 = _MAX(0.0f, stObjBox.fX1);
+		stObjBox.fY1 = _MAX(0.0f, stObjBox.fY1);
+		stObjBox.fX2 = _MIN((float)cvFrameSize.width, stObjBox.fX2);
+		stObjBox.fY2 = _MIN((float)cvFrameSize.height, stObjBox.fY2);
+		if ((int)stObjBox.fX2 > (int)stObjBox.fX1 && (int)stObjBox.fY2 > (int)stObjBox.fY1)
+			vClipped.push_back(stObjBox);
+	}
+	vObjBoxes.swap(vClipped);
+}
+
+// Merge the objects detected in the motion region into the previous objects of the frame
+// @param[in] vPrevBoxes: the previous objects of the frame
+// @param[in] vRegionBoxes: the objects detected in the motion region, in the coordinates of the region
+// @param[in] cvRegion: the motion region of the frame
+// @param[out] vObjBoxes: the objects of the frame
+// [Note] The previous objects whose centre is out of the region have not moved, so they are kept.
+void CAnalysisUtil::MergeRegionObjects(const ObjBoxArr& vPrevBoxes, const ObjBoxArr& vRegionBoxes, const cv::Rect& cvRegion, ObjBoxArr& vObjBoxes)
+{
+	vObjBoxes.clear();
+	for (const ObjBBox& stBox : vPrevBoxes)
+	{
+		cv::Point2f cvCentre((stBox.fX1 + stBox.fX2) * 0.5f, (stBox.fY1 + stBox.fY2) * 0.5f);
+		if (!cv::Rect2f(cvRegion).contains(cvCentre))
+			vObjBoxes.push_back(stBox);
+	}
+
+	for (ObjBBox stBox : vRegionBoxes)
+	{
+		stBox.fX1 += cvRegion.x;
+		stBox.fY1 += cvRegion.y;
+		stBox.fX2 += cvRegion.x;
+		stBox.fY2 += cvRegion.y;
+		vObjBoxes.push_back(stBox);
+	}
+}
@@ -0,0 +1,678 @@
+#include "CStreamManager.h"
+#include "CAnalysisFactory.h"
+#include "CAnalysisUtil.h"
+#include "CObjDetector.h"
+#include "CReID.h"
+#include "CMotionGate.h"
+#include "CTracker.h"
+#include "CEmbeddingCache.h"
+#include <chrono>
+
+// Frame of a stream waiting for or being run by a round
+struct CStreamManager::StreamFrame
+{
+	StreamContext*		pStream;		// stream of the frame
+	cv::Mat				cvFrame;		// copy of the submitted frame
+	S_AnalysisResult	stResult;		// result of the frame. The frame id and the task type are given at the submission
+	E_MotionGateResult	eGate;			// decision of the motion gate on the frame
+	cv::Rect			cvRegion;		// motion region of the frame
+	EmbeddingLookup		stLookup;		// lookup of the re-id embedding cache
+	int					nCropFirst;		// index of the 1st crop of the frame in the re-id batch
+	int					nCropCount;		// number of crops of the frame in the re-id batch
+	bool				bReID;			// true if the frame takes part in the re-id batch
+
+	StreamFrame()
+	{
+		pStream = nullptr;
+		eGate = E_MotionGateResult::eMgFullFrame;
+		nCropFirst = 0;
+		nCropCount = 0;
+		bReID = false;
+	}
+};
+
+// State of a stream. Only the scheduler thread touches the motion gate, the tracker and the cache
+struct CStreamManager::StreamContext
+{
+	AnalysisCallback			fnCallback;		// callback of the results
+	std::deque<StreamFrame>		dqFrames;		// frames waiting for a round
+	bool						bBusy;			// true while a frame of the stream is in the running round
+
+	CMotionGate*				pMotionGate;	// motion gate before the detection. nullptr if disabled
+	ObjBoxArr					vGateBoxes;		// latest detection result reused by the frames without motion
+	uint64_t					nGateSeq;		// sequence number of the next frame checked by the motion gate
+	CTracker*					pTracker;		// multi-object tracker after the detection. nullptr if disabled
+	CEmbeddingCache*			pReIDCache;		// re-id features of the tracked objects. nullptr if disabled
+
+	StreamContext()
+	{
+		bBusy = false;
+		pMotionGate = nullptr;
+		nGateSeq = 0;
+		pTracker = nullptr;
+		pReIDCache = nullptr;
+	}
+
+	~StreamContext()
+	{
+		if (pMotionGate)
+			delete pMotionGate; pMotionGate = nullptr;
+
+		if (pTracker)
+			delete pTracker; pTracker = nullptr;
+
+		if (pReIDCache)
+			delete pReIDCache; pReIDCache = nullptr;
+	}
+};
+
+// Invoke the callback of a stream with the result of a frame
+// @param[in] fnCallback: the callback. It can be nullptr
+// @param[in] stResult: the result of the frame
+static void InvokeCallback(const AnalysisCallback& fnCallback, const S_AnalysisResult& stResult)
+{
+	if (!fnCallback)
+		return;
+
+	try
+	{
+		fnCallback(stResult);
+	}
+	catch (std::exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+	}
+}
+
+CStreamManager::CStreamManager(const S_AnalysisParam& stParam, const S_StreamManagerParam& stStreamParam/* = S_StreamManagerParam()*/)
+	: m_bValid(false)
+	, m_stParam(stParam)
+	, m_stStreamParam(stStreamParam)
+	, m_pObjDetector(nullptr)
+	, m_pReID(nullptr)
+	, m_nNextStreamID(0)
+	, m_nNextTurn(0)
+	, m_nPending(0)
+	, m_bRunning(false)
+	, m_bStop(false)
+{
+	m_bValid = Init();
+}
+
+CStreamManager::~CStreamManager()
+{
+	Release();
+}
+
+// Add a stream
+// @param[in] fnCallback: the callback invoked with the result of each frame of the stream. It can be nullptr
+// @return the stream ID. -1 if it fails
+// [Note] The callback runs on the scheduler thread, so it should return quickly. It must not call the functions of this instance.
+int CStreamManager::AddStream(const AnalysisCallback& fnCallback)
+{
+	if (!m_bValid)
+		return -1;
+
+	StreamContext* pStream = new StreamContext();
+	if (!pStream)
+		return -1;
+
+	pStream->fnCallback = fnCallback;
+	if (!CAnalysisFactory::CreateMotionGate(m_stParam, pStream->pMotionGate) ||
+		!CAnalysisFactory::CreateTracker(m_stParam, pStream->pTracker) ||
+		!CAnalysisFactory::CreateReIDCache(m_stParam, pStream->pReIDCache))
+	{
+		delete pStream; pStream = nullptr;
+		return -1;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int nStreamID = m_nNextStreamID++;
+	m_mapStreams[nStreamID] = pStream;
+
+	return nStreamID;
+}
+
+// Remove a stream
+// @param[in] nStreamID: the stream ID
+// @return true if the stream is removed, otherwise false
+// [Note] It waits for the frame of the stream being run. The waiting frames are completed with bSuccess false.
+bool CStreamManager::RemoveStream(int nStreamID)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	std::map<int, StreamContext*>::iterator it = m_mapStreams.find(nStreamID);
+	if (it == m_mapStreams.end())
+		return false;
+
+	// The stream is taken out first, so no round takes its frames and no frame is submitted to it any more
+	StreamContext* pStream = it->second;
+	m_mapStreams.erase(it);
+	m_nPending -= (int)pStream->dqFrames.size();
+	m_cvSpace.notify_all();
+	m_cvIdle.notify_all();
+
+	m_cvIdle.wait(lock, [pStream]() { return !pStream->bBusy; });
+	lock.unlock();
+
+	for (StreamFrame& stFrame : pStream->dqFrames)
+		InvokeCallback(pStream->fnCallback, stFrame.stResult);
+
+	delete pStream; pStream = nullptr;
+
+	return true;
+}
+
+// Submit a frame of the stream
+// @param[in] nStreamID: the stream ID
+// @param[in] eTaskType: the type of analysis task. Only the detection and the re-identification tasks are supported
+// @param[in] cvBGRFrame: the input BGR format frame. It is copied, so the caller can reuse its buffer for the next frame
+// @param[in] nFrameID: the frame id returned in the result
+// @return true if the frame is queued, otherwise false
+// [Note] - The frames of a stream are run in the submission order, and the results are returned in the same order.
+//        - If S_StreamManagerParam::nMaxPendingFrames frames are waiting, it blocks or drops the oldest one by bDropOldFrames.
+bool CStreamManager::SubmitFrame(int nStreamID, const E_AnalysisTaskType& eTaskType, const cv::Mat& cvBGRFrame, int64_t nFrameID)
+{
+	if (!m_bValid || cvBGRFrame.empty())
+		return false;
+
+	if (eTaskType != E_AnalysisTaskType::eAttPersonDetection && eTaskType != E_AnalysisTaskType::eAttPersonReID)
+		return false;
+
+	StreamFrame stFrame;
+	stFrame.cvFrame = cvBGRFrame.clone();
+	stFrame.stResult = S_AnalysisResult(nFrameID, eTaskType, false);
+
+	int nMaxPending = _MAX(1, m_stStreamParam.nMaxPendingFrames);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	StreamContext* pStream = nullptr;
+	while (true)
+	{
+		// The stream is looked up again after the waiting, as it may be removed meanwhile
+		std::map<int, StreamContext*>::iterator it = m_mapStreams.find(nStreamID);
+		if (m_bStop || it == m_mapStreams.end())
+			return false;
+
+		pStream = it->second;
+		if ((int)pStream->dqFrames.size() < nMaxPending || m_stStreamParam.bDropOldFrames)
+			break;
+
+		m_cvSpace.wait(lock);
+	}
+
+	// The live cameras need the latest frame rather than all of them, so the oldest waiting frame gives its place
+	StreamFrame stDropped;
+	bool bDropped = false;
+	if ((int)pStream->dqFrames.size() >= nMaxPending)
+	{
+		stDropped = std::move(pStream->dqFrames.front());
+		pStream->dqFrames.pop_front();
+		m_nPending--;
+		m_stStats.nDropped++;
+		bDropped = true;
+	}
+
+	stFrame.pStream = pStream;
+	pStream->dqFrames.push_back(std::move(stFrame));
+	m_nPending++;
+	AnalysisCallback fnCallback = pStream->fnCallback;
+	lock.unlock();
+	m_cvFrame.notify_one();
+
+	if (bDropped)
+		InvokeCallback(fnCallback, stDropped.stResult);
+
+	return true;
+}
+
+// Wait until all the submitted frames are finished
+void CStreamManager::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cvIdle.wait(lock, [this]() { return m_nPending == 0 && !m_bRunning; });
+}
+
+// Add the person of interest to the query set matched by the re-identification task of all the streams
+// @param[in] nQueryID: the query ID returned in the results. The query of the same ID is replaced
+// @param[in] cvBGRImg: the input BGR format image of the person
+// @param[in] nTopK: the top k of the query. 0 or less means S_AnalysisParam::nReIDTopK
+// @param[in] fSimThresh: the similarity threshold of the query. Less than 0 means S_AnalysisParam::fReIDConfThresh
+// @return true if the query is added successfully, otherwise false
+// [Note] The rounds started after it use the new query set.
+bool CStreamManager::AddQuery(int nQueryID, const cv::Mat& cvBGRImg, int nTopK/* = 0*/, float fSimThresh/* = -1.0f*/)
+{
+	if (!m_bValid || !m_pReID || cvBGRImg.empty())
+		return false;
+
+	ReIDQuery stQuery(nQueryID,
+		(nTopK > 0) ? nTopK : m_stParam.nReIDTopK,
+		(fSimThresh >= 0.0f) ? fSimThresh : m_stParam.fReIDConfThresh);
+
+	std::lock_guard<std::mutex> lock(m_queryMutex);
+	return m_pReID->AddQuery(stQuery, cvBGRImg);
+}
+
+// Remove the person of interest from the query set
+// @param[in] nQueryID: the query ID
+// @return true if the query is removed, otherwise false
+bool CStreamManager::RemoveQuery(int nQueryID)
+{
+	if (!m_bValid || !m_pReID)
+		return false;
+
+	std::lock_guard<std::mutex> lock(m_queryMutex);
+	return m_pReID->RemoveQuery(nQueryID);
+}
+
+// Remove all the persons of interest from the query set
+void CStreamManager::ClearQueries()
+{
+	if (!m_pReID)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_queryMutex);
+	m_pReID->ClearQueries();
+}
+
+// Get the counters of the batches
+// @param[out] stStats: the counters of the frames and the batch runs
+void CStreamManager::GetStats(S_StreamManagerStats& stStats) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	stStats = m_stStats;
+}
+
+// Check if the stream manager is valid
+// @return true if the stream manager is valid, otherwise false
+const bool CStreamManager::IsValid() const
+{
+	return m_bValid;
+}
+
+bool CStreamManager::Init()
+{
+	// The networks are shared by all the streams and run by the scheduler thread only, so one session is enough
+	m_pObjDetector = CAnalysisFactory::CreateObjDetector(m_stParam, 1);
+	if (!m_pObjDetector)
+		return false;
+
+	m_pReID = CAnalysisFactory::CreateReID(m_stParam, 1);
+	if (!m_pReID)
+		return false;
+
+	m_scheduler = std::thread(&CStreamManager::SchedulerLoop, this);
+
+	return true;
+}
+
+void CStreamManager::Release()
+{
+	// Finish the waiting frames before releasing the networks they use
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStop = true;
+	}
+	m_cvFrame.notify_all();
+	m_cvSpace.notify_all();
+
+	if (m_scheduler.joinable())
+		m_scheduler.join();
+
+	for (std::pair<const int, StreamContext*>& stPair : m_mapStreams)
+	{
+		if (stPair.second)
+			delete stPair.second; stPair.second = nullptr;
+	}
+	m_mapStreams.clear();
+
+	if (m_pObjDetector)
+		delete m_pObjDetector; m_pObjDetector = nullptr;
+
+	if (m_pReID)
+		delete m_pReID; m_pReID = nullptr;
+
+	m_bValid = false;
+}
+
+// Main loop of the scheduler thread
+void CStreamManager::SchedulerLoop()
+{
+	std::vector<StreamFrame> vRound;
+	while (TakeRound(vRound))
+	{
+		// [Note] The streams of the round must be released even if the round fails, so the exception is caught here
+		try
+		{
+			RunRound(vRound);
+		}
+		catch (std::exception& e)
+		{
+			const char* msg = e.what();
+			std::cout << msg << std::endl;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (StreamFrame& stFrame : vRound)
+				stFrame.pStream->bBusy = false;
+			m_bRunning = false;
+		}
+		m_cvIdle.notify_all();
+	}
+}
+
+// Take the frames of the next round
+// @param[out] vRound: the frames of the round. One frame per stream at most
+// @return true if the frames are taken, false if the stream manager is stopping
+// [Note] It waits up to S_StreamManagerParam::nBatchTimeoutMs for more streams to fill the batch.
+bool CStreamManager::TakeRound(std::vector<StreamFrame>& vRound)
+{
+	vRound.clear();
+
+	int nMaxBatch = _MAX(1, m_stStreamParam.nMaxBatchFrames);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cvFrame.wait(lock, [this]() { return m_bStop || m_nPending > 0; });
+
+	// The waiting frames are finished before the stream manager stops
+	if (m_nPending == 0)
+		return false;
+
+	// Wait for the other streams up to the timeout, as a larger batch runs faster per frame
+	std::function<bool()> fnBatchFull = [this, nMaxBatch]()
+	{
+		int nReady = 0;
+		for (const std::pair<const int, StreamContext*>& stPair : m_mapStreams)
+			nReady += stPair.second->dqFrames.empty() ? 0 : 1;
+
+		return m_bStop || nReady >= _MIN(nMaxBatch, (int)m_mapStreams.size());
+	};
+	std::chrono::steady_clock::time_point tpDeadline = std::chrono::steady_clock::now() +
+		std::chrono::milliseconds(_MAX(0, m_stStreamParam.nBatchTimeoutMs));
+	m_cvFrame.wait_until(lock, tpDeadline, fnBatchFull);
+
+	// Take the oldest frame of each stream in turn from the stream after the last one of the previous round
+	std::map<int, StreamContext*>::iterator itStart = m_mapStreams.lower_bound(m_nNextTurn);
+	std::map<int, StreamContext*>::iterator it = itStart;
+	for (size_t i = 0; i < m_mapStreams.size() && (int)vRound.size() < nMaxBatch; i++)
+	{
+		if (it == m_mapStreams.end())
+			it = m_mapStreams.begin();
+
+		StreamContext* pStream = it->second;
+		if (!pStream->dqFrames.empty())
+		{
+			vRound.push_back(std::move(pStream->dqFrames.front()));
+			pStream->dqFrames.pop_front();
+			pStream->bBusy = true;
+			m_nPending--;
+			m_nNextTurn = it->first + 1;
+		}
+		++it;
+	}
+
+	if (vRound.empty())
+		return !m_bStop || m_nPending > 0;
+
+	m_bRunning = true;
+	m_stStats.nFrames += vRound.size();
+	lock.unlock();
+	m_cvSpace.notify_all();
+
+	return true;
+}
+
+// Run the frames of a round and invoke the callbacks of the streams
+// @param[in/out] vRound: the frames of the round
+void CStreamManager::RunRound(std::vector<StreamFrame>& vRound)
+{
+	if (vRound.empty())
+		return;
+
+	std::vector<bool> vDetected;
+	DetectRound(vRound, vDetected);
+
+	// Track the objects of each stream. A stream has one frame per round, so the frames are tracked in the capture order
+	for (size_t i = 0; i < vRound.size(); i++)
+	{
+		StreamFrame& stFrame = vRound[i];
+		StreamContext* pStream = stFrame.pStream;
+
+		if (!pStream->pTracker)
+		{
+			stFrame.stResult.bSuccess = vDetected[i];
+			continue;
+		}
+
+		try
+		{
+			if (vDetected[i])
+				pStream->pTracker->Update(stFrame.stResult.vObjBoxes);
+			else
+				pStream->pTracker->Propagate(stFrame.stResult.vObjBoxes);
+
+			CAnalysisUtil::ClipObjects(stFrame.cvFrame.size(), stFrame.stResult.vObjBoxes);
+			stFrame.stResult.bSuccess = true;
+		}
+		catch (std::exception& e)
+		{
+			const char* msg = e.what();
+			std::cout << msg << std::endl;
+		}
+	}
+
+	ReIDRound(vRound);
+
+	for (StreamFrame& stFrame : vRound)
+		InvokeCallback(stFrame.pStream->fnCallback, stFrame.stResult);
+}
+
+// Detect the frames of a round in one batch run
+// @param[in/out] vRound: the frames of the round. The detection result is set to the result of each frame
+// @param[out] vDetected: true if the objects of the frame are detected, false if they are only predicted or the detection fails
+void CStreamManager::DetectRound(std::vector<StreamFrame>& vRound, std::vector<bool>& vDetected)
+{
+	vDetected.assign(vRound.size(), false);
+
+	// Decide the input of each frame: the whole frame, the motion region, or nothing
+	std::vector<cv::Mat> vInputs;
+	std::vector<int> vOwners;
+	for (int i = 0; i < (int)vRound.size(); i++)
+	{
+		StreamFrame& stFrame = vRound[i];
+		StreamContext* pStream = stFrame.pStream;
+
+		stFrame.cvRegion = cv::Rect(0, 0, stFrame.cvFrame.cols, stFrame.cvFrame.rows);
+		stFrame.eGate = E_MotionGateResult::eMgFullFrame;
+		uint64_t nGateSeq = pStream->nGateSeq++;
+
+		if (pStream->pMotionGate)
+		{
+			stFrame.eGate = pStream->pMotionGate->Check(stFrame.cvFrame, stFrame.cvRegion);
+			if (stFrame.eGate == E_MotionGateResult::eMgUnknown)
+				stFrame.eGate = E_MotionGateResult::eMgFullFrame;
+		}
+
+		if (pStream->pTracker && !pStream->pTracker->IsDetectionFrame(nGateSeq))
+			continue;
+
+		// Nothing moved, so the frame does not take part in the batch at all
+		if (stFrame.eGate == E_MotionGateResult::eMgSkip)
+		{
+			stFrame.stResult.vObjBoxes = pStream->vGateBoxes;
+			vDetected[i] = true;
+			continue;
+		}
+
+		if (stFrame.eGate == E_MotionGateResult::eMgRegion)
+			vInputs.push_back(stFrame.cvFrame(stFrame.cvRegion));
+		else
+			vInputs.push_back(stFrame.cvFrame);
+		vOwners.push_back(i);
+	}
+
+	if (vInputs.empty())
+		return;
+
+	// The tiled detection batches the tiles of each frame instead, so the frames are detected one by one
+	std::vector<ObjBoxArr> vInputBoxes(vInputs.size());
+	std::vector<bool> vInputDetected(vInputs.size(), false);
+	try
+	{
+		if (m_stParam.stDetTiling.bEnable)
+		{
+			for (size_t k = 0; k < vInputs.size(); k++)
+				vInputDetected[k] = m_pObjDetector->Detect(vInputs[k], vInputBoxes[k]);
+		}
+		else if (m_pObjDetector->DetectBatch(vInputs, vInputBoxes))
+		{
+			vInputDetected.assign(vInputs.size(), true);
+		}
+	}
+	catch (std::exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+		vInputDetected.assign(vInputs.size(), false);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stStats.nDetBatches++;
+		m_stStats.nDetFrames += vInputs.size();
+	}
+
+	// Route the detections back to the frames
+	for (size_t k = 0; k < vInputs.size(); k++)
+	{
+		if (!vInputDetected[k])
+			continue;
+
+		StreamFrame& stFrame = vRound[vOwners[k]];
+		StreamContext* pStream = stFrame.pStream;
+
+		if (stFrame.eGate == E_MotionGateResult::eMgRegion)
+			CAnalysisUtil::MergeRegionObjects(pStream->vGateBoxes, vInputBoxes[k], stFrame.cvRegion, stFrame.stResult.vObjBoxes);
+		else
+			stFrame.stResult.vObjBoxes.swap(vInputBoxes[k]);
+
+		if (pStream->pMotionGate)
+			pStream->vGateBoxes = stFrame.stResult.vObjBoxes;
+
+		vDetected[vOwners[k]] = true;
+	}
+}
+
+// Extract the re-id features of a round in one batch run and match them with the queries
+// @param[in/out] vRound: the frames of the round. The re-id result is set to the result of each frame
+void CStreamManager::ReIDRound(std::vector<StreamFrame>& vRound)
+{
+	// The query set is taken once per round, so all the frames of the round are matched with the same queries
+	std::vector<float> vQueryFeature;
+	ReIDQueryArr vQueries;
+	cv::Mat cvQueryFeatures;
+	{
+		std::lock_guard<std::mutex> lock(m_queryMutex);
+		vQueryFeature = m_pReID->GetQueryFeature();
+		vQueries = m_pReID->GetQueries();
+		cvQueryFeatures = m_pReID->GetQueryFeatures();
+	}
+
+	// Gather the crops to extract of all the frames. The cached features of the tracked objects are not extracted again
+	std::vector<cv::Mat> vCrops;
+	for (StreamFrame& stFrame : vRound)
+	{
+		if (!stFrame.stResult.bSuccess || stFrame.stResult.eTaskType != E_AnalysisTaskType::eAttPersonReID)
+			continue;
+
+		if (vQueryFeature.empty() && vQueries.empty())
+		{
+			stFrame.stResult.bSuccess = false;
+			continue;
+		}
+
+		std::vector<cv::Mat> vFrameCrops;
+		CAnalysisUtil::CropObjects(stFrame.cvFrame, stFrame.stResult.vObjBoxes, vFrameCrops);
+
+		stFrame.nCropFirst = (int)vCrops.size();
+		if (stFrame.pStream->pReIDCache)
+		{
+			if (!stFrame.pStream->pReIDCache->Lookup(stFrame.stResult.vObjBoxes, vFrameCrops, stFrame.stLookup))
+			{
+				stFrame.stResult.bSuccess = false;
+				continue;
+			}
+
+			for (int nIdx : stFrame.stLookup.vExtractIdx)
+				vCrops.push_back(vFrameCrops[nIdx]);
+		}
+		else
+		{
+			vCrops.insert(vCrops.end(), vFrameCrops.begin(), vFrameCrops.end());
+		}
+		stFrame.nCropCount = (int)vCrops.size() - stFrame.nCropFirst;
+		stFrame.bReID = true;
+	}
+
+	// Extract the crops of all the streams together. CReID splits them into the runs of nReIDMaxBatchSize
+	cv::Mat cvFeatures;
+	bool bExtracted = true;
+	if (!vCrops.empty())
+	{
+		try
+		{
+			bExtracted = m_pReID->ExtractFeatures(vCrops, cvFeatures);
+		}
+		catch (std::exception& e)
+		{
+			const char* msg = e.what();
+			std::cout << msg << std::endl;
+			bExtracted = false;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stStats.nReIDBatches++;
+		m_stStats.nReIDCrops += vCrops.size();
+	}
+
+	// Route the features back to the frames and match them
+	for (StreamFrame& stFrame : vRound)
+	{
+		if (!stFrame.bReID)
+			continue;
+
+		S_AnalysisResult& stResult = stFrame.stResult;
+		if (!bExtracted)
+		{
+			stResult.bSuccess = false;
+			continue;
+		}
+
+		cv::Mat cvExtracted;
+		if (stFrame.nCropCount > 0)
+			cvExtracted = cvFeatures.rowRange(stFrame.nCropFirst, stFrame.nCropFirst + stFrame.nCropCount);
+
+		cv::Mat cvGalleryFeatures;
+		if (stFrame.pStream->pReIDCache)
+		{
+			if (!stFrame.pStream->pReIDCache->Complete(stFrame.stLookup, stResult.vObjBoxes, cvExtracted, cvGalleryFeatures))
+			{
+				stResult.bSuccess = false;
+				continue;
+			}
+		}
+		else
+		{
+			cvGalleryFeatures = cvExtracted;
+		}
+
+		if (!vQueryFeature.empty() && !m_pReID->MatchFeatures(vQueryFeature, cvGalleryFeatures, stResult.vReIDRes))
+			stResult.bSuccess = false;
+
+		if (!vQueries.empty() && !m_pReID->MatchQueries(vQueries, cvQueryFeatures, cvGalleryFeatures, stResult.vQueryReIDRes))
+			stResult.bSuccess = false;
+	}
+}
\ No newline at end of file
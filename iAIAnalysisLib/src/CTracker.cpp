@@ -0,0 +1,309 @@
+#include "CTracker.h"
+#include <algorithm>
+
+// Weights of the standard deviations of the position and the velocity relative to the box height
+#define KF_STD_WEIGHT_POSITION	(1.0f / 20)
+#define KF_STD_WEIGHT_VELOCITY	(1.0f / 160)
+
+// Minimum IoU to associate a low score detection to a track in the 2nd stage
+#define LOW_SCORE_MATCH_IOU		0.5f
+
+
+// Calculate the IoU of two boxes
+// @param[in] stA: 1st box
+// @param[in] stB: 2nd box
+// @return: IoU of the boxes
+static float BoxIoU(const ObjBBox& stA, const ObjBBox& stB)
+{
+	float fW = _MAX(0.0f, _MIN(stA.fX2, stB.fX2) - _MAX(stA.fX1, stB.fX1));
+	float fH = _MAX(0.0f, _MIN(stA.fY2, stB.fY2) - _MAX(stA.fY1, stB.fY1));
+	float fInter = fW * fH;
+	float fUnion = (stA.fX2 - stA.fX1) * (stA.fY2 - stA.fY1) + (stB.fX2 - stB.fX1) * (stB.fY2 - stB.fY1) - fInter;
+
+	return (fUnion > 0) ? fInter / fUnion : 0.0f;
+}
+
+// Convert the box into the measurement of the Kalman filter
+// @param[in] stBox: box
+// @return: measurement (cx, cy, aspect ratio, height)
+static cv::Mat BoxToMeasurement(const ObjBBox& stBox)
+{
+	float fW = stBox.fX2 - stBox.fX1;
+	float fH = _MAX(1.0f, stBox.fY2 - stBox.fY1);
+
+	return (cv::Mat_<float>(4, 1) << stBox.fX1 + 0.5f * fW, stBox.fY1 + 0.5f * fH, fW / fH, fH);
+}
+
+// Set the process noise of the Kalman filter relative to the current box height
+// @param[in/out] cvKF: Kalman filter
+static void SetProcessNoise(cv::KalmanFilter& cvKF)
+{
+	float fH = _MAX(1.0f, cvKF.statePost.at<float>(3));
+	float fPos = KF_STD_WEIGHT_POSITION * fH;
+	float fVel = KF_STD_WEIGHT_VELOCITY * fH;
+
+	cv::Mat cvStd = (cv::Mat_<float>(8, 1) << fPos, fPos, 1e-2f, fPos, fVel, fVel, 1e-5f, fVel);
+	cvKF.processNoiseCov = cv::Mat::diag(cvStd.mul(cvStd));
+}
+
+// Set the measurement noise of the Kalman filter relative to the predicted box height
+// @param[in/out] cvKF: Kalman filter
+static void SetMeasurementNoise(cv::KalmanFilter& cvKF)
+{
+	float fH = _MAX(1.0f, cvKF.statePre.at<float>(3));
+	float fPos = KF_STD_WEIGHT_POSITION * fH;
+
+	cv::Mat cvStd = (cv::Mat_<float>(4, 1) << fPos, fPos, 1e-1f, fPos);
+	cvKF.measurementNoiseCov = cv::Mat::diag(cvStd.mul(cvStd));
+}
+
+
+CTracker::CTracker(const S_TrackerParam& stParam, float fHighScoreThresh)
+	: m_stParam(stParam)
+	, m_fHighScoreThresh(fHighScoreThresh)
+	, m_nNextTrackID(0)
+{
+
+}
+
+CTracker::~CTracker()
+{
+	m_vTracks.clear();
+}
+
+// Check whether the detector runs on the given frame
+// @param[in] nFrameIdx: index of the frame in the capture order
+// @return: true if the detector runs on the frame, false if the tracks are only predicted
+bool CTracker::IsDetectionFrame(uint64_t nFrameIdx) const
+{
+	if (m_stParam.nDetectInterval <= 1)
+		return true;
+
+	return (nFrameIdx % m_stParam.nDetectInterval) == 0;
+}
+
+// Associate the detections of the next frame to the tracks
+// @param[in/out] vObjBoxes: detections of the frame, replaced with the boxes of the tracked objects carrying the track IDs
+void CTracker::Update(ObjBoxArr& vObjBoxes)
+{
+	Predict();
+
+	// Split the detections by score
+	std::vector<int> vHighDets, vLowDets;
+	for (int i = 0; i < int(vObjBoxes.size()); i++)
+	{
+		if (vObjBoxes[i].fScore >= m_fHighScoreThresh)
+			vHighDets.push_back(i);
+		else if (vObjBoxes[i].fScore >= m_stParam.fLowScoreThresh)
+			vLowDets.push_back(i);
+	}
+
+	std::vector<int> vConfirmed, vUnconfirmed;
+	for (int t = 0; t < int(m_vTracks.size()); t++)
+	{
+		if (m_vTracks[t].bConfirmed)
+			vConfirmed.push_back(t);
+		else
+			vUnconfirmed.push_back(t);
+	}
+
+	// 1st stage: the confident detections to all the confirmed tracks, including the lost ones
+	std::vector<int> vRemainTracks, vRemainHighDets;
+	Associate(vConfirmed, vObjBoxes, vHighDets, m_stParam.fMatchIoUThresh, vRemainTracks, vRemainHighDets);
+
+	// 2nd stage: the low score detections to the remaining tracks tracked on the previous detection frame
+	// [Note] The occluded person often has a low score, so the track goes on without starting a new track from it.
+	std::vector<int> vTrackedTracks, vLostTracks, vUnusedLowDets;
+	for (int t : vRemainTracks)
+	{
+		if (m_vTracks[t].nLostFrames == 0)
+			vTrackedTracks.push_back(t);
+		else
+			vLostTracks.push_back(t);
+	}
+
+	std::vector<int> vUnmatchedTracks;
+	Associate(vTrackedTracks, vObjBoxes, vLowDets, LOW_SCORE_MATCH_IOU, vUnmatchedTracks, vUnusedLowDets);
+	vLostTracks.insert(vLostTracks.end(), vUnmatchedTracks.begin(), vUnmatchedTracks.end());
+
+	// 3rd stage: the remaining confident detections to the unconfirmed tracks
+	std::vector<int> vUnmatchedUnconfirmed, vNewDets;
+	Associate(vUnconfirmed, vObjBoxes, vRemainHighDets, m_stParam.fMatchIoUThresh, vUnmatchedUnconfirmed, vNewDets);
+
+	// The unmatched unconfirmed tracks are removed at once, and the lost tracks are removed after nMaxLostFrames
+	std::vector<bool> vRemove(m_vTracks.size(), false);
+	for (int t : vUnmatchedUnconfirmed)
+		vRemove[t] = true;
+
+	for (int t : vLostTracks)
+	{
+		m_vTracks[t].nLostFrames++;
+		if (m_vTracks[t].nLostFrames > m_stParam.nMaxLostFrames)
+			vRemove[t] = true;
+	}
+
+	int nIdx = 0;
+	m_vTracks.erase(std::remove_if(m_vTracks.begin(), m_vTracks.end(), [&nIdx, &vRemove](const Track&) { return vRemove[nIdx++]; }),
+		m_vTracks.end());
+
+	// Start the new tracks from the remaining confident detections
+	for (int d : vNewDets)
+		StartTrack(vObjBoxes[d]);
+
+	GetTrackedBoxes(vObjBoxes);
+}
+
+// Predict the tracks on the next frame without any detection
+// @param[out] vObjBoxes: predicted boxes of the tracked objects carrying the track IDs
+void CTracker::Propagate(ObjBoxArr& vObjBoxes)
+{
+	// [Note] cv::KalmanFilter::predict() also takes the predicted state as the posterior state until the next correction
+	Predict();
+
+	GetTrackedBoxes(vObjBoxes);
+}
+
+// Remove all the tracks
+void CTracker::Reset()
+{
+	m_vTracks.clear();
+}
+
+// Predict the state of all the tracks on the next frame
+void CTracker::Predict()
+{
+	for (Track& stTrack : m_vTracks)
+	{
+		// The velocity of the height is not kept for the lost track, so its box does not shrink to nothing
+		if (stTrack.nLostFrames > 0)
+			stTrack.cvKF.statePost.at<float>(7) = 0;
+
+		SetProcessNoise(stTrack.cvKF);
+		stTrack.cvKF.predict();
+	}
+}
+
+// Associate the given detections to the given tracks greedily in the descending order of IoU
+// @param[in] vTrackIdx: indices of the tracks
+// @param[in] vObjBoxes: all the detections
+// @param[in] vDetIdx: indices of the detections
+// @param[in] fIoUThresh: minimum IoU to associate
+// @param[out] vUnmatchedTracks: indices of the tracks without any detection
+// @param[out] vUnmatchedDets: indices of the detections without any track
+void CTracker::Associate(const std::vector<int>& vTrackIdx, const ObjBoxArr& vObjBoxes, const std::vector<int>& vDetIdx, float fIoUThresh,
+	std::vector<int>& vUnmatchedTracks, std::vector<int>& vUnmatchedDets)
+{
+	// Collect the candidate pairs over the threshold
+	typedef struct _Pair { float fIoU; int nTrack; int nDet; } Pair;
+	std::vector<Pair> vPairs;
+	std::vector<ObjBBox> vTrackBoxes(vTrackIdx.size());
+	for (int t = 0; t < int(vTrackIdx.size()); t++)
+	{
+		vTrackBoxes[t] = GetTrackBox(m_vTracks[vTrackIdx[t]]);
+		for (int d = 0; d < int(vDetIdx.size()); d++)
+		{
+			float fIoU = BoxIoU(vTrackBoxes[t], vObjBoxes[vDetIdx[d]]);
+			if (fIoU >= fIoUThresh)
+				vPairs.push_back(Pair{ fIoU, t, d });
+		}
+	}
+
+	std::sort(vPairs.begin(), vPairs.end(), [](const Pair& a, const Pair& b) { return a.fIoU > b.fIoU; });
+
+	std::vector<bool> vTrackUsed(vTrackIdx.size(), false), vDetUsed(vDetIdx.size(), false);
+	for (const Pair& stPair : vPairs)
+	{
+		if (vTrackUsed[stPair.nTrack] || vDetUsed[stPair.nDet])
+			continue;
+
+		vTrackUsed[stPair.nTrack] = true;
+		vDetUsed[stPair.nDet] = true;
+
+		// Correct the track by the detection
+		Track& stTrack = m_vTracks[vTrackIdx[stPair.nTrack]];
+		const ObjBBox& stBox = vObjBoxes[vDetIdx[stPair.nDet]];
+
+		SetMeasurementNoise(stTrack.cvKF);
+		stTrack.cvKF.correct(BoxToMeasurement(stBox));
+		stTrack.nClassID = stBox.nClassID;
+		stTrack.fScore = stBox.fScore;
+		stTrack.nHits++;
+		stTrack.nLostFrames = 0;
+		if (stTrack.nHits >= m_stParam.nMinHits)
+			stTrack.bConfirmed = true;
+	}
+
+	vUnmatchedTracks.clear();
+	for (int t = 0; t < int(vTrackIdx.size()); t++)
+	{
+		if (!vTrackUsed[t])
+			vUnmatchedTracks.push_back(vTrackIdx[t]);
+	}
+
+	vUnmatchedDets.clear();
+	for (int d = 0; d < int(vDetIdx.size()); d++)
+	{
+		if (!vDetUsed[d])
+			vUnmatchedDets.push_back(vDetIdx[d]);
+	}
+}
+
+// Start a new track from the given detection
+// @param[in] stBox: detection
+void CTracker::StartTrack(const ObjBBox& stBox)
+{
+	Track stTrack(m_nNextTrackID++, stBox.nClassID, stBox.fScore);
+	stTrack.nHits = 1;
+	stTrack.bConfirmed = (m_stParam.nMinHits <= 1);
+
+	// Constant velocity model on (cx, cy, aspect ratio, height)
+	cv::KalmanFilter& cvKF = stTrack.cvKF;
+	cvKF.init(8, 4, 0, CV_32F);
+	cv::setIdentity(cvKF.transitionMatrix);
+	for (int i = 0; i < 4; i++)
+		cvKF.transitionMatrix.at<float>(i, i + 4) = 1.0f;
+	cv::setIdentity(cvKF.measurementMatrix);
+
+	cv::Mat cvMeasurement = BoxToMeasurement(stBox);
+	cvKF.statePost = cv::Mat::zeros(8, 1, CV_32F);
+	cvMeasurement.copyTo(cvKF.statePost.rowRange(0, 4));
+
+	float fH = cvMeasurement.at<float>(3);
+	float fPos = 2 * KF_STD_WEIGHT_POSITION * fH;
+	float fVel = 10 * KF_STD_WEIGHT_VELOCITY * fH;
+	cv::Mat cvStd = (cv::Mat_<float>(8, 1) << fPos, fPos, 1e-2f, fPos, fVel, fVel, 1e-5f, fVel);
+	cvKF.errorCovPost = cv::Mat::diag(cvStd.mul(cvStd));
+
+	m_vTracks.push_back(stTrack);
+}
+
+// Get the box of the track from its state
+// @param[in] stTrack: track
+// @return: box of the track
+ObjBBox CTracker::GetTrackBox(const Track& stTrack) const
+{
+	const cv::Mat& cvState = stTrack.cvKF.statePost;
+	float fH = cvState.at<float>(3);
+	float fW = cvState.at<float>(2) * fH;
+	float fCX = cvState.at<float>(0);
+	float fCY = cvState.at<float>(1);
+
+	return ObjBBox(fCX - 0.5f * fW, fCY - 0.5f * fH, fCX + 0.5f * fW, fCY + 0.5f * fH, stTrack.fScore, stTrack.nClassID, stTrack.nTrackID);
+}
+
+// Get the boxes of the tracked objects
+// @param[out] vObjBoxes: boxes of the confirmed tracks associated on the latest detection frame
+void CTracker::GetTrackedBoxes(ObjBoxArr& vObjBoxes) const
+{
+	vObjBoxes.clear();
+	for (const Track& stTrack : m_vTracks)
+	{
+		if (!stTrack.bConfirmed || stTrack.nLostFrames > 0)
+			continue;
+
+		ObjBBox stBox = GetTrackBox(stTrack);
+		stBox.fX1 = _MAX(0.0f, stBox.fX1);
+		stBox.fY1 = _MAX(0.0f, stBox.fY1);
+		vObjBoxes.push_back(stBox);
+	}
+}
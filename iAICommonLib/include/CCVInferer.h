@@ -0,0 +1,55 @@
+#pragma once
+#include "CInferer.h"
+#include <mutex>
+
+// Structure to pass the output blobs of a network run to the postprocessing
+typedef struct _CVOutputData
+{
+	const std::vector<cv::Mat>*	pvOutputBlobs;		// output blobs of the network run
+	int							nBatchIdx;			// index of the image in the batch
+	size_t						nImageStride;		// number of elements of the 1st output blob per image
+}CVOutputData;
+
+// Base abstract class for OpenCV DNN inference.
+// All the specific OpenCV DNN inference classes should inherit from this class together with the model class of the network.
+// [Note] - The model is run by the OpenCV's own CPU kernels (or its CUDA backend if the device id is set), without onnxruntime.
+//          Some small models run faster than onnxruntime on some CPUs, so the runtime can be chosen per model by measuring both.
+//        - cv::dnn::Net is not thread-safe, so the runs of one network are serialised. Create one network per stream
+//          for the concurrent streams. The threads of the runs are controlled by cv::setNumThreads() process-wide.
+class IAICOMMONLIB_API CCVInferer : public virtual CInferer
+{
+public:
+	CCVInferer(const NetDetailsConfig& stConfig);
+
+	virtual ~CCVInferer();
+
+	// Read the onnx model from the given path
+	// @param[in] sModelPath: path to the onnx model
+	// @param[in] sPairedFilePath: path to the paired file
+	// @param[in] sLogTitle: title for logging
+	// @return: true if success, otherwise false
+	virtual bool ReadModel(const std::string& sModelPath, const std::string& sPairedFilePath = "", const std::string& sLogTitle = "opencv-dnn");
+
+protected:
+	// Validate the network configuration before inference
+	virtual bool Validate();
+
+	// Run the network once on the given images packed into one batch
+	// @param[in] pFrames: input images
+	// @param[out] ppResultData: output data of each input image
+	// @param[in] nCount: number of input images. It should not be greater than GetMaxBatchSize()
+	// @return: true if success, otherwise false
+	virtual bool RunBatch(const cv::Mat* pFrames, void* const* ppResultData, int nCount);
+
+	// Core function for postprocessing the output blob
+	// @param[in] pTensorData: output blob data to be postprocessed
+	// @return: pointer to the 1st output data of the relevant image in the batch
+	virtual const void* PostProcessCore(const void* pTensorData) const;
+
+private:
+	cv::dnn::Net				m_cvNet;			// OpenCV DNN network
+	std::vector<cv::String>		m_vOutputNames;		// names of the output layers
+	std::vector<int>			m_vNetOutputDims;	// dims of the 1st output of the network
+	std::mutex					m_netMutex;			// mutex to serialise the runs of the network and the postprocessing of their outputs
+
+};
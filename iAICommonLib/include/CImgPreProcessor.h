@@ -0,0 +1,65 @@
+#pragma once
+#include "type_define.h"
+#include <opencv2/opencv.hpp>
+
+// Class of the fused image preprocessing kernels for the deep learning networks
+// The kernels do resizing, channel swapping, normalisation and HWC to CHW transposition in one pass,
+// and write the result into the input tensor buffer directly without any intermediate image.
+class IAICOMMONLIB_API CImgPreProcessor
+{
+public:
+	// Preprocess the BGR image into the planar CHW float tensor
+	// @param[in] cvImg: input image of CV_8UC3
+	// @param[in] nDstW: width of the output tensor
+	// @param[in] nDstH: height of the output tensor
+	// @param[in] pMean: mean value of each channel of the input image
+	// @param[in] pScale: scale value of each channel of the input image
+	// @param[in] bSwapRB: whether to swap the R and B channels
+	// @param[out] pDst: output tensor buffer of 3 x nDstH x nDstW floats
+	// @return: true if success, otherwise false
+	// [Note] - The output value is (src - pMean[c]) * pScale[c], where c is the channel index of the input image.
+	//        - The image is resized by bilinear interpolation with the same pixel mapping as cv::resize(INTER_LINEAR).
+	//        - The AVX-512 or AVX2 path is selected at runtime if supported by the CPU.
+	static bool BlobFromImage(const cv::Mat& cvImg, int nDstW, int nDstH,
+		const float pMean[3], const float pScale[3], bool bSwapRB, float* pDst);
+
+	// Preprocess the regions of the BGR image into the consecutive planar CHW float tensors of a batch
+	// @param[in] cvImg: input image of CV_8UC3
+	// @param[in] pRois: regions of the input image, such as the boxes of the detected objects
+	// @param[in] nRois: number of the regions
+	// @param[in] nDstW: width of the output tensor of each region
+	// @param[in] nDstH: height of the output tensor of each region
+	// @param[in] pMean: mean value of each channel of the input image
+	// @param[in] pScale: scale value of each channel of the input image
+	// @param[in] bSwapRB: whether to swap the R and B channels
+	// @param[out] pDst: output tensor buffer of nRois x 3 x nDstH x nDstW floats
+	// @return: true if success, otherwise false
+	// [Note] - Each region is sampled from the input image directly, without cropping it into an intermediate image.
+	//          The result of the region of integer coordinates is the same as BlobFromImage() of its crop.
+	//        - All the regions are processed in one parallel pass, split into the stripes of rows of each region.
+	//        - It fails if any region is empty or out of the image.
+	static bool BlobFromRois(const cv::Mat& cvImg, const cv::Rect2f* pRois, int nRois, int nDstW, int nDstH,
+		const float pMean[3], const float pScale[3], bool bSwapRB, float* pDst);
+
+private:
+	// Interpolate one source row horizontally into three planar float rows
+	// @param[in] pSrcRow: source row of BGR pixels
+	// @param[in] pXOfs0: byte offset of the left neighbour pixel of each output column
+	// @param[in] pXOfs1: byte offset of the right neighbour pixel of each output column
+	// @param[in] pAlpha: weight of the right neighbour pixel of each output column
+	// @param[in] nDstW: width of the output rows
+	// @param[out] pRows: three output rows of nDstW floats, one for each channel of the source image
+	static void HorzLinear(const uchar* pSrcRow, const int* pXOfs0, const int* pXOfs1, const float* pAlpha,
+		int nDstW, float* pRows);
+
+	// Interpolate two rows vertically, normalise and store the result into one output plane row
+	// @param[in] pRow0: upper row
+	// @param[in] pRow1: lower row
+	// @param[in] fBeta: weight of the lower row
+	// @param[in] fScale: normalisation scale
+	// @param[in] fBias: normalisation bias, that is -mean * scale
+	// @param[out] pDst: output plane row
+	// @param[in] nLen: length of the rows
+	static void VertLinearNorm(const float* pRow0, const float* pRow1, float fBeta, float fScale, float fBias,
+		float* pDst, int nLen);
+};
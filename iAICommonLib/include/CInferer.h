@@ -0,0 +1,125 @@
+#pragma once
+#include "type_define.h"
+#include <opencv2/opencv.hpp>
+
+// Base abstract class for deep learning inference, independent of the inference runtime.
+// Each runtime (onnxruntime, OpenCV DNN, ...) implements the model reading and the batch run in its own inferer class,
+// and each network implements the preprocessing and the postprocessing once in its model class for all the runtimes.
+// [Note] The runtime inferers and the model classes inherit this class virtually, so a network class made of
+//        one model class and one runtime inferer shares the single network state below.
+class IAICOMMONLIB_API CInferer
+{
+public:
+	CInferer(const NetDetailsConfig& stConfig);
+
+	virtual ~CInferer();
+
+	// Check whether the network is valid or not
+	// @return: true if valid, otherwise false
+	inline bool IsValid() const { return m_bValid; }
+
+	// Do inference on the input image
+	// @param[in] cvFrame: input image
+	// @param[out] pResultData: output data
+	// @return: true if success, otherwise false
+	virtual bool Inference(const cv::Mat& cvFrame, void* pResultData);
+
+	// Do batch inference on the input images
+	// @param[in] vFrames: input images
+	// @param[out] vResultData: output data of each input image. The size should be the same as vFrames
+	// @return: true if success, otherwise false
+	// [Note] - The images are packed into NCHW tensors and run in as few runs as possible.
+	//        - For the dynamic batch model, each run contains at most NetDetailsConfig::nMaxBatchSize images.
+	//        - For the fixed batch model, each run contains the fixed batch size of images, padded with zeros if necessary.
+	//        - The result of each image is returned through PostProcess() as same as Inference().
+	virtual bool BatchInference(const std::vector<cv::Mat>& vFrames, const std::vector<void*>& vResultData);
+
+	// Read the model from the given path
+	// @param[in] sModelPath: path to the model
+	// @param[in] sPairedFilePath: path to the paired file
+	// @param[in] sLogTitle: title for logging
+	// @return: true if success, otherwise false
+	virtual bool ReadModel(const std::string& sModelPath, const std::string& sPairedFilePath = "", const std::string& sLogTitle = "") = 0;
+
+protected:
+	// Preprocess the input image
+	// @param[in] cvImg: input image to be preprocessed
+	// @param[out] cvProcImg: preprocessed image
+	virtual void PreProcess(const cv::Mat& cvImg, cv::Mat& cvProcImg) = 0;
+
+	// Postprocess the output tensor
+	// @param[in] cvOrgImgSize: original image size
+	// @param[in] pTensorData: output tensor data to be postprocessed
+	// @param[out] pPostProcessData: postprocessed data
+	virtual void PostProcess(const cv::Size& cvOrgImgSize, const void* pTensorData, void* pPostProcessData) = 0;
+
+	// Validate the network configuration before inference
+	virtual bool Validate();
+
+	// Get the maximum number of images that can be packed into one run
+	// @return: the maximum batch size
+	int GetMaxBatchSize() const;
+
+	// Run the network once on the given images packed into one batch
+	// @param[in] pFrames: input images
+	// @param[out] ppResultData: output data of each input image
+	// @param[in] nCount: number of input images. It should not be greater than GetMaxBatchSize()
+	// @return: true if success, otherwise false
+	virtual bool RunBatch(const cv::Mat* pFrames, void* const* ppResultData, int nCount) = 0;
+
+	// Preprocess the input image into the given tensor buffer of one image
+	// @param[in] cvImg: input image to be preprocessed
+	// @param[out] pTensor: tensor buffer of 3 x m_nNetInputH x m_nNetInputW floats
+	// @return: true if success, otherwise false
+	bool PreProcessToTensor(const cv::Mat& cvImg, float* pTensor);
+
+	// Preprocess the input images into the given batch tensor buffer
+	// @param[in] pFrames: input images
+	// @param[in] nCount: number of input images
+	// @param[out] pTensor: tensor buffer of nCount x 3 x m_nNetInputH x m_nNetInputW floats
+	// @return: true if success, otherwise false
+	// [Note] The default implementation preprocesses the images one by one by PreProcessToTensor().
+	virtual bool PreProcessBatch(const cv::Mat* pFrames, int nCount, float* pTensor);
+
+protected:
+	// Core function for preprocessing the input image
+	// @param[in] cvImg: input image to be preprocessed
+	// @param[in] bSwapRB: whether to swap the R and B channels
+	// @param[out] cvProcImg: preprocessed image. If it is preallocated as 1x3xHxW CV_32F, the result is written into its buffer
+	inline void PreProcessCore(const cv::Mat& cvImg, bool bSwapRB, cv::Mat& cvProcImg) const;
+
+	// Core function for preprocessing the input images into the batch tensor buffer
+	// @param[in] pFrames: input images
+	// @param[in] nCount: number of input images
+	// @param[in] bSwapRB: whether to swap the R and B channels
+	// @param[out] pTensor: tensor buffer of nCount x 3 x m_nNetInputH x m_nNetInputW floats
+	// @return: true if success, otherwise false
+	// [Note] - The consecutive images which are the regions of the same BGR image, such as the crops of the detected objects,
+	//          are sampled from that image in one parallel pass. The result is the same as PreProcessCore() of each image.
+	//        - The other images are preprocessed one by one by PreProcessCore().
+	bool PreProcessBatchCore(const cv::Mat* pFrames, int nCount, bool bSwapRB, float* pTensor) const;
+
+	// Core function for postprocessing the output tensor
+	// @param[in] pTensorData: output tensor data passed to PostProcess() by the runtime
+	// @return: pointer to the 1st output data of the relevant image in the batch
+	// [Note] The layout of pTensorData depends on the runtime, so each runtime inferer implements it.
+	virtual const void* PostProcessCore(const void* pTensorData) const = 0;
+
+private:
+	// Get the normalisation parameters of the fused preprocessing kernels
+	// @param[in] bSwapRB: whether to swap the R and B channels
+	// @param[out] pMean: mean value of each channel of the input image
+	// @param[out] pScale: scale value of each channel of the input image
+	void GetNormParams(bool bSwapRB, float pMean[3], float pScale[3]) const;
+
+protected:
+	NetDetailsConfig m_NetDetailsConfig;	// network details configuration
+	bool	m_bValid;						// whether the network is valid or not
+
+	int		m_nNetInputW;					// input image width to the network
+	int		m_nNetInputH;					// input image height to the network
+	int		m_nNetOutputs;					// number of network outputs
+	int		m_nNetProposals;				// number of proposals of network
+	int		m_nNetBatch;					// batch size of network input. -1 means the dynamic batch size
+
+};
@@ -1,29 +1,21 @@
 #pragma once
-#include "type_define.h"
-#include <opencv2/opencv.hpp>
-
+#include "CInferer.h"
+#include <memory>
 
+namespace Ort { struct SessionOptions; }
 class CORTPars;
+class CORTSessionPool;
+struct _ORTBindingSlot;
 
 // Base abstract class for onnxruntime inference.
-// All the specific onnxruntime inference classes should inherit from this class.
-class IAICOMMONLIB_API CORTInferer
+// All the specific onnxruntime inference classes should inherit from this class together with the model class of the network.
+class IAICOMMONLIB_API CORTInferer : public virtual CInferer
 {
 public:
 	CORTInferer(const NetDetailsConfig& stConfig);
 
 	virtual ~CORTInferer();
 
-	// Check whether the network is valid or not
-	// @return: true if valid, otherwise false
-	inline bool IsValid() const { return m_bValid; }
-
-	// Do inference on the input image using onnxruntime
-	// @param[in] cvFrame: input image
-	// @param[out] pResultData: output data
-	// @return: true if success, otherwise false
-	virtual bool Inference(const cv::Mat& cvFrame, void* pResultData);
-
 	// Read the onnx model from the given path
 	// @param[in] sModelPath: path to the onnx model
 	// @param[in] sPairedFilePath: path to the paired file
@@ -32,46 +24,65 @@ public:
 	virtual bool ReadModel(const std::string& sModelPath, const std::string& sPairedFilePath = "", const std::string& sLogTitle = "onnxruntime");
 
 protected:
-	// Preprocess the input image
-	// @param[in] cvImg: input image to be preprocessed
-	// @param[out] cvProcImg: preprocessed image
-	virtual void PreProcess(const cv::Mat& cvImg, cv::Mat& cvProcImg) = 0;
-
-	// Postprocess the output tensor
-	// @param[in] cvOrgImgSize: original image size
-	// @param[in] pTensorData: output tensor data to be postprocessed
-	// @param[out] pPostProcessData: postprocessed data
-	virtual void PostProcess(const cv::Size& cvOrgImgSize, const void* pTensorData, void* pPostProcessData) = 0;
-
 	// Validate the network configuration before inference
 	virtual bool Validate();
 
+	// Run the session once on the given images packed into one batch
+	// @param[in] pFrames: input images
+	// @param[out] ppResultData: output data of each input image
+	// @param[in] nCount: number of input images. It should not be greater than GetMaxBatchSize()
+	// @return: true if success, otherwise false
+	virtual bool RunBatch(const cv::Mat* pFrames, void* const* ppResultData, int nCount);
 
-protected:
-	// Core function for preprocessing the input image
-	// @param[in] cvImg: input image to be preprocessed
-	// @param[in] bSwapRB: whether to swap the R and B channels
-	// @param[out] cvProcImg: preprocessed image
-	inline void PreProcessCore(const cv::Mat& cvImg, bool bSwapRB, cv::Mat& cvProcImg) const;
-	
-	// Core function for postprocessing the input image
+	// Core function for postprocessing the output tensor
 	// @param[in] pTensorData: output tensor data to be postprocessed
 	// @return: postprocessed data pointer by a default core function
-	inline const void* PostProcessCore(const void* pTensorData) const;
+	// [Note] - For batch inference, the returned pointer is the start of the output data of the relevant image in the batch
+	virtual const void* PostProcessCore(const void* pTensorData) const;
 
-protected:
-	NetDetailsConfig m_NetDetailsConfig;	// network details configuration
-	bool	m_bValid;						// whether the network is valid or not
+private:
+	// Initialise the persistent tensors of the io binding mode of the session
+	// @param[in/out] pPars: the session
+	// @return: true if success, otherwise false
+	// [Note] If the model has the dynamic dims other than the batch size, io binding is disabled and the normal mode is used.
+	bool InitIoBinding(CORTPars* pPars);
+
+	// Get the binding slot of the session for the given batch size. The slot is created at the first use and reused afterwards.
+	// @param[in/out] pPars: the session
+	// @param[in] nBatch: batch size
+	// @return: the binding slot. nullptr if io binding is disabled or the batch size exceeds the binding capacity
+	struct _ORTBindingSlot* GetBindingSlot(CORTPars* pPars, int nBatch);
 
-	int		m_nNetInputW;					// input image width to the network
-	int		m_nNetInputH;					// input image height to the network
-	int		m_nNetOutputs;					// number of network outputs
-	int		m_nNetProposals;				// number of proposals of network
+	// Initialise the session pool of the model. The first network of the model creates the sessions, and the others reuse them.
+	// @param[in] sModelPath: path to the onnx model
+	// @param[in] sLogID: log id of the onnxruntime session
+	// @return: true if success, otherwise false
+	bool InitSessionPool(const std::string& sModelPath, const std::string& sLogID);
+
+	// Get the key of the session pool. The networks of the same key share the sessions
+	// @param[in] sModelPath: path to the onnx model
+	// @return: the key made of the model path and the configuration affecting the sessions
+	std::string GetSessionPoolKey(const std::string& sModelPath) const;
+
+	// Initialise the session options with the settings of the network
+	// @param[out] sessionOptions: session options to be initialised
+	// @param[in] sLogID: log id of the onnxruntime session
+	// @param[in] bOptimise: true: run the graph optimiser. false: disable it, for the model already optimised
+	void InitSessionOptions(Ort::SessionOptions& sessionOptions, const std::string& sLogID, bool bOptimise);
+
+	// Apply the threading policy of the network to the session options
+	// @param[in/out] sessionOptions: session options
+	// [Note] - The execution mode is always applied. The pool settings are applied only if the session creates its own pools,
+	//          that is the policy requests its own pools or the runtime does not use the global pools.
+	//        - Any pool setting other than the default, such as the thread counts or the affinity, requests the own pools,
+	//          as it would be lost on the global pools.
+	//        - The affinity pins each intra-op pool thread to one CPU of the mask in round-robin order.
+	void ApplyThreadingPolicy(Ort::SessionOptions& sessionOptions);
 
 private:
 	std::vector<std::vector<int64_t>> m_vNetInputNodeDims;
 	std::vector<std::vector<int64_t>> m_vNetOuputNodeDims;
 
-	CORTPars* m_pORTPars;					// ONNX Runtime parameters
+	std::shared_ptr<CORTSessionPool> m_pSessionPool;	// pool of the sessions shared by the networks of the same model
 
 };
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+#include <onnxruntime_cxx_api.h>
+#include <string>
+#include <vector>
+
+// Class of the initializers of one model shared by all the sessions of the model
+// The initializers are read from the model once and added to the session options by AddInitializer(), so the sessions use
+// the same tensors instead of loading their own copies. onnxruntime shares the prepacked weights of the kernels only for the
+// initializers shared in this way, so it is also what lets the sessions share one PrepackedWeightsContainer.
+// [Note] - The initializers of the ORT format model are used from the model bytes directly, so the bytes must outlive the sessions.
+//          The ones of the onnx model are copied, as the raw data in the protobuf is not aligned.
+//        - Only the top-level initializers with the raw data are shared. The others, such as the external data and the strings,
+//          are still loaded by each session.
+class CORTInitializers
+{
+public:
+	CORTInitializers();
+	~CORTInitializers();
+
+	// Read the initializers of the model
+	// @param[in] vModelBytes: bytes of the model
+	// @param[in] bORTFormat: whether the model is in ORT format or not
+	// @return: true if the model is parsed successfully, otherwise false
+	bool Read(const std::vector<char>& vModelBytes, bool bORTFormat);
+
+	// Add the initializers to the session options
+	// @param[in/out] sessionOptions: session options of the sessions sharing the initializers
+	// [Note] The initializers must outlive the sessions created with the options.
+	void AddTo(Ort::SessionOptions& sessionOptions) const;
+
+	// Release the initializers
+	void Clear();
+
+	// Get the number of the initializers
+	// @return: number of the initializers
+	size_t GetCount() const { return m_vValues.size(); }
+
+	// Get the size of the data of the initializers
+	// @return: size in bytes
+	size_t GetBytes() const { return m_nBytes; }
+
+private:
+	// Read the initializers of the onnx model from the protobuf
+	// @param[in] pData: bytes of the model
+	// @param[in] nSize: number of bytes
+	// @return: true if the model is parsed successfully, otherwise false
+	bool ReadOnnx(const uint8_t* pData, size_t nSize);
+
+	// Read the initializers of the ORT format model from the flatbuffer
+	// @param[in] pData: bytes of the model
+	// @param[in] nSize: number of bytes
+	// @return: true if the model is parsed successfully, otherwise false
+	bool ReadOrt(const uint8_t* pData, size_t nSize);
+
+	// Add an initializer. It is skipped if the data does not match the shape and the type
+	// @param[in] sName: name of the initializer
+	// @param[in] nDataType: onnx data type of the elements
+	// @param[in] vDims: shape of the initializer
+	// @param[in] pData: raw data of the elements
+	// @param[in] nBytes: size of the raw data in bytes
+	// @param[in] bCopy: true: copy the data. false: use the data directly
+	void AddTensor(const std::string& sName, int nDataType, const std::vector<int64_t>& vDims, const uint8_t* pData,
+		size_t nBytes, bool bCopy);
+
+	CORTInitializers(const CORTInitializers&) = delete;
+	CORTInitializers& operator=(const CORTInitializers&) = delete;
+
+private:
+	Ort::MemoryInfo						m_memoryInfo{ nullptr };	// cpu memory info of the initializers
+	std::vector<std::string>			m_vNames;			// names of the initializers
+	std::vector<Ort::Value>				m_vValues;			// tensors of the initializers
+	std::vector<std::vector<uint64_t>>	m_vBuffers;			// copied data of the initializers. 8 bytes aligned
+	size_t								m_nBytes;			// size of the data of the initializers
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include "type_define.h"
+
+// Directory name of the model cache created next to the original model if no cache directory is given
+#define ORT_MODEL_CACHE_DIR_NAME	"ort_cache"
+
+// Class of the cache entry of one optimised onnxruntime model
+// The optimised graph is saved in ORT format at the first start and loaded directly at the later starts without
+// running the graph optimiser again. The file name of the entry contains the key hashed from the model bytes,
+// onnxruntime version, optimisation level, execution provider and CPU features, so any change of them creates a new entry.
+class IAICOMMONLIB_API CORTModelCache
+{
+public:
+	// Constructor
+	// @param[in] sModelPath: path to the original onnx model
+	// @param[in] sCacheDir: directory of the cache. If empty, ORT_MODEL_CACHE_DIR_NAME next to the model is used
+	// @param[in] nOptLevel: graph optimisation level used to optimise the model
+	// @param[in] nDeviceID: device id of the execution provider. -1 means CPU
+	CORTModelCache(const std::string& sModelPath, const std::string& sCacheDir, int nOptLevel, int nDeviceID);
+	~CORTModelCache();
+
+	// Check whether the key of the entry is computed successfully
+	// @return: true if valid, otherwise false
+	bool IsValid() const { return m_bValid; }
+
+	// Check whether the optimised model of the entry exists in the cache
+	// @return: true if exists, otherwise false
+	bool Exists() const;
+
+	// Get the path to the optimised model of the entry
+	// @return: path to the cached ORT format model
+	const std::string& GetCachePath() const { return m_sCachePath; }
+
+	// Get the temporary path that the optimised model is written to before committed
+	// @return: path to the temporary ORT format model
+	const std::string& GetTempPath() const { return m_sTempPath; }
+
+	// Move the temporary model written by the session to the cache path, and remove the stale entries of the same model
+	// @return: true if success, otherwise false
+	// [Note] The rename is atomic, so the other processes never read the partially written model.
+	bool Commit();
+
+	// Remove the cached and temporary models of the entry. It is used when the cached model fails to be loaded.
+	void Discard();
+
+private:
+	// Hash the bytes of the file
+	// @param[in] sPath: path to the file
+	// @param[out] nHash: 64-bit FNV-1a style hash of the file
+	// @return: true if success, otherwise false
+	static bool HashFile(const std::string& sPath, uint64_t& nHash);
+
+	// Combine the value into the hash
+	// @param[in/out] nHash: 64-bit FNV-1a style hash
+	// @param[in] pData: data to be combined
+	// @param[in] nSize: size of the data in bytes
+	// [Note] The data is combined in 64-bit words rather than bytes, which is 8 times faster for the large models.
+	static void HashBytes(uint64_t& nHash, const void* pData, size_t nSize);
+
+	// Get the bitmask of the CPU features that affect the kernels selected by the optimiser
+	// @return: bitmask of the CPU features
+	static uint64_t GetCPUFeatures();
+
+private:
+	bool		m_bValid;		// whether the key is computed or not
+	std::string	m_sModelStem;	// file name of the original model without extension
+	std::string	m_sCacheDir;	// directory of the cache
+	std::string	m_sCachePath;	// path to the cached ORT format model
+	std::string	m_sTempPath;	// path to the temporary ORT format model
+};
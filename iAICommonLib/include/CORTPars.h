@@ -1,5 +1,16 @@
 #pragma once
 #include <onnxruntime_cxx_api.h>
+#include <memory>
+
+// Structure to hold the persistent tensors bound to the session for a given batch size
+// [Note] The tensors are the views of the persistent buffers in CORTPars, so no memory is allocated per session run.
+typedef struct _ORTBindingSlot
+{
+	Ort::IoBinding				ioBinding{ nullptr };	// ONNX runtime io binding
+	Ort::Value					inputTensor{ nullptr };	// input tensor bound to the session
+	std::vector<Ort::Value>		vOutputTensors;			// output tensors bound to the session
+	size_t						nImageStride;			// number of elements of the 1st output tensor per image
+}ORTBindingSlot;
 
 // Class to handle the ONNX runtime session params
 class CORTPars
@@ -8,13 +19,13 @@ public:
 	CORTPars() {};
 	~CORTPars() 
 	{
+		m_vBindingSlots.clear();
 		m_vInputNamesPtr.clear();
 		m_vOutputNamesPtr.clear();
 		m_vInputNames.clear();
 		m_vOutputNames.clear();
 	};
 
-	Ort::Env env{ nullptr };								// ONNX runtime environment
 	Ort::SessionOptions sessionOptions{ nullptr };			// ONNX runtime session options
 	Ort::Session session{ nullptr };						// ONNX runtime session
 	Ort::AllocatorWithDefaultOptions allocator;				// ONNX runtime allocator
@@ -23,4 +34,22 @@ public:
 	std::vector<Ort::AllocatedStringPtr> m_vOutputNamesPtr; // ONNX runtime output names
 	std::vector<const char*> m_vInputNames;					// ONNX runtime input names
 	std::vector<const char*> m_vOutputNames;				// ONNX runtime output names
+
+	// Persistent resources of the io binding mode, allocated once when the model is read
+	Ort::MemoryInfo memoryInfo{ nullptr };					// ONNX runtime cpu memory info of the bound tensors
+	Ort::RunOptions runOptions{ nullptr };					// ONNX runtime run options reused by every session run
+	bool m_bBindingReady = false;							// whether the io binding resources of this session are initialised
+	int m_nBindingCapacity = 0;								// maximum batch size of the bound tensors. 0 means io binding is disabled
+	std::vector<float> m_vInputBuffer;						// input tensor buffer for the maximum batch size
+	std::vector<std::vector<float>> m_vOutputBuffers;		// output tensor buffers for the maximum batch size
+	std::vector<size_t> m_vOutputImageSizes;				// number of elements per image of each output
+	std::vector<std::unique_ptr<ORTBindingSlot>> m_vBindingSlots;	// binding slots indexed by the batch size
 };
+
+// Structure to pass the output tensors of a session run to the postprocessing
+typedef struct _ORTOutputData
+{
+	std::vector<Ort::Value>*	pvOutputTensors;	// output tensors of the session run
+	int							nBatchIdx;			// index of the image in the batch
+	size_t						nImageStride;		// number of elements of the 1st output tensor per image
+}ORTOutputData;
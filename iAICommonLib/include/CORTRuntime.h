@@ -0,0 +1,43 @@
+#pragma once
+#include "type_define.h"
+#include <mutex>
+
+namespace Ort { struct Env; }
+
+// Singleton class of the process-wide onnxruntime runtime
+// All the onnxruntime sessions in the process share one environment of this class.
+// If the global thread pools are enabled, the sessions also share the intra-op and inter-op thread pools of the environment
+// instead of creating their own pools, which avoids the oversubscription of CPU cores when many sessions are running.
+class IAICOMMONLIB_API CORTRuntime
+{
+public:
+	// Get the singleton instance
+	// @return: the process-wide runtime instance
+	static CORTRuntime& GetInstance();
+
+	// Configure the runtime
+	// @param[in] stConfig: runtime configuration
+	// @return: true if success, otherwise false
+	// [Note] The configuration can only be changed before the environment is created, that is, before the first model is read.
+	bool Configure(const ORTRuntimeConfig& stConfig);
+
+	// Get the runtime configuration
+	// @return: the runtime configuration
+	const ORTRuntimeConfig& GetConfig() const;
+
+	// Get the shared onnxruntime environment. It is created with the current configuration at the first call.
+	// @return: the onnxruntime environment
+	Ort::Env& GetEnv();
+
+private:
+	CORTRuntime();
+	~CORTRuntime();
+
+	CORTRuntime(const CORTRuntime&) = delete;
+	CORTRuntime& operator=(const CORTRuntime&) = delete;
+
+private:
+	std::mutex			m_mutex;		// mutex to protect the creation of the environment
+	ORTRuntimeConfig	m_stConfig;		// runtime configuration
+	Ort::Env*			m_pEnv;			// shared onnxruntime environment
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <map>
+#include "CORTPars.h"
+#include "CORTInitializers.h"
+
+// Class of the pool of the onnxruntime sessions of the same model
+// The networks of the same model and configuration share one pool, and each of them adds its own sessions to the capacity.
+// The sessions are created lazily up to the capacity. The initializers of the model are read once and added to the sessions as
+// the shared initializers, and the sessions are created with one PrepackedWeightsContainer, so both the raw weights and the
+// prepacked weights of the kernels are stored once for all the sessions. The ORT format model bytes are also shared, and its
+// initializers are used from the bytes directly.
+// [Note] The onnx model is shared only if the pool has more than one session at Init(), as a single session frees its raw
+//        weights after prepacking them.
+// A caller checks out a session for the duration of one inference run through CORTSessionLease.
+class CORTSessionPool
+{
+public:
+	CORTSessionPool();
+	~CORTSessionPool();
+
+	// Get the pool shared by the networks of the given key. It is created at the first call of the key.
+	// @param[in] sKey: key of the model and configuration of the networks
+	// @return: the shared pool
+	// [Note] The pool is released when the last network of the key releases it.
+	static std::shared_ptr<CORTSessionPool> GetShared(const std::string& sKey);
+
+	// Add the sessions of one network to the capacity of the pool
+	// @param[in] nSessions: number of sessions. It is at least 1
+	void AddCapacity(int nSessions);
+
+	// Remove the sessions of one network from the capacity of the pool
+	// @param[in] nSessions: number of sessions given to AddCapacity()
+	void RemoveCapacity(int nSessions);
+
+	// Get the mutex that serialises the initialisation of the pool among the networks sharing it
+	// @return: the initialisation mutex
+	std::mutex& GetInitMutex() { return m_initMutex; }
+
+	// Check whether the pool is initialised or not
+	// @return: true if initialised, otherwise false
+	bool IsInitialised() const { return m_bInitialised; }
+
+	// Initialise the pool and create the first session
+	// @param[in] pFirstPars: first session created by the caller. If nullptr, the first session is created by the pool
+	//                        It is released and created again if the pool shares the initializers, as it holds its own weights
+	//                        It is released and created again if the pool shares the initializers, as it holds its own weights
+	// @param[in] sModelPath: path to the model that the sessions of the pool are created from
+	// @param[in] bORTFormat: whether the model is in ORT format or not
+	// @param[in] sessionOptions: session options of the sessions of the pool
+	// @return: true if success, otherwise false
+	bool Init(std::unique_ptr<CORTPars> pFirstPars, const std::wstring& sModelPath, bool bORTFormat,
+		Ort::SessionOptions&& sessionOptions);
+
+	// Check out a session. It waits until a session is available if all the sessions are in use and the pool is full.
+	// @return: the session. nullptr if the pool is not initialised or the session fails to be created
+	CORTPars* Acquire();
+
+	// Return the session checked out by Acquire()
+	// @param[in] pPars: the session
+	void Release(CORTPars* pPars);
+
+private:
+	// Create a new session of the pool
+	// @return: the session. nullptr if failed
+	std::unique_ptr<CORTPars> CreateSession();
+
+	// Read the input and output names of the session
+	// @param[in/out] pPars: the session
+	static void ReadNames(CORTPars* pPars);
+
+	CORTSessionPool(const CORTSessionPool&) = delete;
+	CORTSessionPool& operator=(const CORTSessionPool&) = delete;
+
+private:
+	std::mutex				m_initMutex;			// mutex to serialise the initialisation of the pool
+	std::mutex				m_mutex;				// mutex to protect the sessions
+	std::condition_variable	m_cvAvailable;			// notified when a session is returned to the pool
+	bool					m_bInitialised;			// whether the pool is initialised or not
+	int						m_nCapacity;			// maximum number of sessions
+	int						m_nCreating;			// number of sessions being created
+
+	Ort::SessionOptions		m_sessionOptions{ nullptr };	// session options of the sessions of the pool
+	std::wstring			m_sModelPath;			// path to the model of the sessions
+	bool					m_bORTFormat;			// whether the model is in ORT format or not
+	std::vector<char>		m_vModelBytes;			// bytes of the ORT format model shared by the sessions
+	CORTInitializers		m_initializers;			// initializers of the model shared by the sessions
+	OrtPrepackedWeightsContainer*	m_pPrepackedWeights;	// prepacked weights of the shared initializers. nullptr if not shared
+
+	std::vector<std::unique_ptr<CORTPars>>	m_vSessions;	// all the sessions of the pool
+	std::vector<CORTPars*>					m_vAvailable;	// sessions not checked out
+
+	static std::mutex s_registryMutex;											// mutex to protect the registry
+	static std::map<std::string, std::weak_ptr<CORTSessionPool>> s_mapRegistry;	// pools indexed by the key
+};
+
+// Class to check out a session from the pool for the lifetime of the object
+class CORTSessionLease
+{
+public:
+	CORTSessionLease(CORTSessionPool* pPool) : m_pPool(pPool), m_pPars(pPool ? pPool->Acquire() : nullptr) {}
+	~CORTSessionLease() { if (m_pPars) m_pPool->Release(m_pPars); }
+
+	// Get the session checked out
+	// @return: the session. nullptr if failed to check out
+	CORTPars* Get() const { return m_pPars; }
+
+private:
+	CORTSessionLease(const CORTSessionLease&) = delete;
+	CORTSessionLease& operator=(const CORTSessionLease&) = delete;
+
+private:
+	CORTSessionPool*	m_pPool;	// pool the session belongs to
+	CORTPars*			m_pPars;	// session checked out
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include "type_define.h"
+#include <atomic>
+#include <vector>
+
+// Class of the bounded lock-free ring buffer between one producer thread and one consumer thread
+// The producer only writes the tail and the consumer only writes the head, so a push and a pop never take a lock.
+// A full queue blocks the producer and an empty one blocks the consumer by waiting on the atomic signals, which sleeps
+// instead of spinning so the waiting stage leaves the CPU to the others.
+// [Note] - Push() must be called from one thread at a time, and so must Pop().
+//        - The slots are reused in place, so T should be cheap to move, such as a pointer.
+template<typename T>
+class CSPSCQueue
+{
+public:
+	// @param[in] nCapacity: maximum number of items in the queue. It is at least 1
+	CSPSCQueue(int nCapacity)
+		: m_vSlots(_MAX(1, nCapacity))
+		, m_nHead(0)
+		, m_nTail(0)
+		, m_nPushSignal(0)
+		, m_nPopSignal(0)
+		, m_nMaxSize(0)
+		, m_bClosed(false)
+	{
+	}
+
+	// Push an item. It waits until the queue has room if the queue is full
+	// @param[in] item: item to push
+	// @return: true if the item is pushed, false if the queue is closed
+	bool Push(T item)
+	{
+		size_t nTail = m_nTail.load(std::memory_order_relaxed);
+		while (true)
+		{
+			// The signal is taken before the check, so a pop between the check and the waiting wakes it up
+			uint32_t nSignal = m_nPopSignal.load(std::memory_order_acquire);
+			if (m_bClosed.load(std::memory_order_acquire))
+				return false;
+
+			if (nTail - m_nHead.load(std::memory_order_acquire) < m_vSlots.size())
+				break;
+
+			m_nPopSignal.wait(nSignal, std::memory_order_acquire);
+		}
+
+		m_vSlots[nTail % m_vSlots.size()] = std::move(item);
+		m_nTail.store(nTail + 1, std::memory_order_release);
+
+		int nSize = (int)(nTail + 1 - m_nHead.load(std::memory_order_acquire));
+		if (nSize > m_nMaxSize.load(std::memory_order_relaxed))
+			m_nMaxSize.store(nSize, std::memory_order_relaxed);
+
+		m_nPushSignal.fetch_add(1, std::memory_order_release);
+		m_nPushSignal.notify_one();
+
+		return true;
+	}
+
+	// Pop an item. It waits until an item is pushed if the queue is empty
+	// @param[out] item: popped item
+	// @return: true if an item is popped, false if the queue is closed and empty
+	// [Note] The items pushed before Close() are still popped.
+	bool Pop(T& item)
+	{
+		size_t nHead = m_nHead.load(std::memory_order_relaxed);
+		while (true)
+		{
+			uint32_t nSignal = m_nPushSignal.load(std::memory_order_acquire);
+			if (m_nTail.load(std::memory_order_acquire) != nHead)
+				break;
+
+			// The tail is read again, as the producer may push the last item and close the queue after the check above
+			if (m_bClosed.load(std::memory_order_acquire))
+			{
+				if (m_nTail.load(std::memory_order_acquire) != nHead)
+					break;
+
+				return false;
+			}
+
+			m_nPushSignal.wait(nSignal, std::memory_order_acquire);
+		}
+
+		item = std::move(m_vSlots[nHead % m_vSlots.size()]);
+		m_nHead.store(nHead + 1, std::memory_order_release);
+
+		m_nPopSignal.fetch_add(1, std::memory_order_release);
+		m_nPopSignal.notify_one();
+
+		return true;
+	}
+
+	// Close the queue. The later pushes fail, and the pops fail once the queue is empty
+	void Close()
+	{
+		m_bClosed.store(true, std::memory_order_release);
+
+		// Both sides may be waiting, so both signals are changed to wake them up
+		m_nPushSignal.fetch_add(1, std::memory_order_release);
+		m_nPushSignal.notify_all();
+		m_nPopSignal.fetch_add(1, std::memory_order_release);
+		m_nPopSignal.notify_all();
+	}
+
+	// Get the number of items in the queue
+	// @return: the number of items. It may be outdated as soon as it returns
+	int GetSize() const
+	{
+		size_t nHead = m_nHead.load(std::memory_order_acquire);
+		size_t nTail = m_nTail.load(std::memory_order_acquire);
+		return (nTail > nHead) ? (int)(nTail - nHead) : 0;
+	}
+
+	// Get the maximum number of items seen in the queue
+	// @return: the maximum number of items
+	int GetMaxSize() const { return m_nMaxSize.load(std::memory_order_relaxed); }
+
+	// Get the capacity of the queue
+	// @return: the maximum number of items in the queue
+	int GetCapacity() const { return (int)m_vSlots.size(); }
+
+private:
+	CSPSCQueue(const CSPSCQueue&) = delete;
+	CSPSCQueue& operator=(const CSPSCQueue&) = delete;
+
+private:
+	std::vector<T>					m_vSlots;		// slots of the ring buffer
+	alignas(64) std::atomic<size_t>	m_nHead;		// count of the popped items. Written by the consumer only
+	alignas(64) std::atomic<size_t>	m_nTail;		// count of the pushed items. Written by the producer only
+	alignas(64) std::atomic<uint32_t>	m_nPushSignal;	// changed on every push and on Close(). The consumer waits on it
+	alignas(64) std::atomic<uint32_t>	m_nPopSignal;	// changed on every pop and on Close(). The producer waits on it
+	std::atomic<int>				m_nMaxSize;		// maximum number of items seen in the queue. Written by the producer only
+	std::atomic<bool>				m_bClosed;		// whether the queue is closed or not
+};
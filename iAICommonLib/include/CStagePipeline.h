@@ -0,0 +1,58 @@
+#pragma once
+#include "type_define.h"
+#include "CSPSCQueue.h"
+#include <functional>
+#include <thread>
+
+// Class of the chain of stages, each running on its own thread and connected to the next one by a bounded ring buffer
+// An item submitted to the pipeline goes through all the stages in the order, so the stages work on the different items at the
+// same time and the throughput approaches the rate of the slowest stage instead of the sum of all the stages.
+// Each stage has one thread, so the items leave every stage in the submission order. A full queue blocks the stage in front of it,
+// so a slow stage holds back the submission instead of queueing the items without limit.
+// [Note] The item is owned by the pipeline after the submission, and the last stage should release it.
+class IAICOMMONLIB_API CStagePipeline
+{
+public:
+	// Function of a stage run on each item
+	typedef std::function<void(void* pItem)> StageFunc;
+
+	// @param[in] vStages: functions of the stages in the order of running
+	// @param[in] nQueueDepth: capacity of the queue in front of each stage. It is at least 1
+	CStagePipeline(const std::vector<StageFunc>& vStages, int nQueueDepth);
+
+	// [Note] The submitted items are finished by all the stages before the threads are joined.
+	~CStagePipeline();
+
+	// Submit an item to the 1st stage. It waits until the queue has room if the queue is full
+	// @param[in] pItem: item to run
+	// @return: true if the item is queued, false if the pipeline is stopping
+	// [Note] It must be called from one thread at a time.
+	bool Submit(void* pItem);
+
+	// Wait until all the submitted items leave the last stage
+	void WaitIdle();
+
+	// Get the counters of the stages
+	// @param[out] vStats: counters of each stage in the order of running
+	void GetStats(std::vector<PipelineStageStats>& vStats) const;
+
+	// Get the number of stages
+	// @return: the number of stages
+	int GetStageCount() const { return (int)m_vStages.size(); }
+
+private:
+	// Main loop of the thread of a stage
+	// @param[in] nStage: index of the stage
+	void StageLoop(int nStage);
+
+	CStagePipeline(const CStagePipeline&) = delete;
+	CStagePipeline& operator=(const CStagePipeline&) = delete;
+
+private:
+	std::vector<StageFunc>				m_vStages;		// functions of the stages
+	std::vector<CSPSCQueue<void*>*>		m_vQueues;		// queue in front of each stage
+	std::vector<std::thread>			m_vWorkers;		// thread of each stage
+	std::atomic<uint64_t>*				m_pProcessed;	// number of items run by each stage
+	std::atomic<uint64_t>*				m_pBusyUs;		// time in microseconds spent running the items by each stage
+	std::atomic<int>					m_nInFlight;	// number of items submitted and not yet out of the last stage
+};
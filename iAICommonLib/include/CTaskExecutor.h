@@ -0,0 +1,53 @@
+#pragma once
+#include "type_define.h"
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <deque>
+#include <vector>
+
+// Class of a fixed set of worker threads running the submitted tasks in the submission order
+// The number of pending tasks is bounded, so a producer faster than the workers is blocked in Submit()
+// instead of queueing the frames without limit.
+class IAICOMMONLIB_API CTaskExecutor
+{
+public:
+	// @param[in] nWorkers: number of worker threads. It is at least 1
+	// @param[in] nMaxPending: maximum number of tasks waiting for a worker. 0 means no limit
+	CTaskExecutor(int nWorkers, int nMaxPending = 0);
+
+	// [Note] The pending tasks are finished before the workers are joined.
+	~CTaskExecutor();
+
+	// Submit a task. It waits until the queue has room if the queue is full.
+	// @param[in] fnTask: task to run on a worker thread
+	// @return: true if the task is queued, false if the executor is stopping
+	// [Note] The tasks are started in the submission order, but they may finish in any order if there are several workers.
+	bool Submit(std::function<void()> fnTask);
+
+	// Wait until all the submitted tasks are finished
+	void WaitIdle();
+
+	// Get the number of worker threads
+	// @return: the number of worker threads
+	int GetWorkerCount() const { return (int)m_vWorkers.size(); }
+
+private:
+	// Main loop of the worker threads
+	void WorkerLoop();
+
+	CTaskExecutor(const CTaskExecutor&) = delete;
+	CTaskExecutor& operator=(const CTaskExecutor&) = delete;
+
+private:
+	std::mutex							m_mutex;		// mutex to protect the queue
+	std::condition_variable				m_cvTask;		// notified when a task is queued or the executor stops
+	std::condition_variable				m_cvSpace;		// notified when a task leaves the queue
+	std::condition_variable				m_cvIdle;		// notified when all the tasks are finished
+	std::deque<std::function<void()>>	m_dqTasks;		// tasks waiting for a worker
+	std::vector<std::thread>			m_vWorkers;		// worker threads
+	int									m_nMaxPending;	// maximum number of tasks waiting for a worker. 0 means no limit
+	int									m_nRunning;		// number of tasks being run
+	bool								m_bStop;		// whether the executor is stopping or not
+};
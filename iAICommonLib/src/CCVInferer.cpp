@@ -0,0 +1,193 @@
+#include "CCVInferer.h"
+#include <iostream>
+
+CCVInferer::CCVInferer(const NetDetailsConfig& stConfig)
+	: CInferer(stConfig)
+{
+
+}
+
+CCVInferer::~CCVInferer()
+{
+
+}
+
+// Run the network once on the given images packed into one batch
+// @param[in] pFrames: input images
+// @param[out] ppResultData: output data of each input image
+// @param[in] nCount: number of input images. It should not be greater than GetMaxBatchSize()
+// @return: true if success, otherwise false
+bool CCVInferer::RunBatch(const cv::Mat* pFrames, void* const* ppResultData, int nCount)
+{
+	try
+	{
+		// The fixed batch model always runs the exported batch size. The unused slots are padded with zeros.
+		int nBatch = (m_nNetBatch > 0) ? m_nNetBatch : nCount;
+		if (nCount <= 0 || nCount > nBatch)
+			return false;
+
+		cv::Mat cvInputBlob;
+		if (nBatch == 1)
+		{
+			PreProcess(pFrames[0], cvInputBlob);
+		}
+		else
+		{
+			// Pack the preprocessed images into one NCHW blob
+			int vBatchDims[] = { nBatch, 3, m_nNetInputH, m_nNetInputW };
+			cvInputBlob = cv::Mat(4, vBatchDims, CV_32F, cv::Scalar(0));
+
+			if (!PreProcessBatch(pFrames, nCount, cvInputBlob.ptr<float>()))
+				return false;
+		}
+
+		// [Note] The output blobs share the buffers of the network, so they are postprocessed before the next run
+		std::lock_guard<std::mutex> lock(m_netMutex);
+
+		std::vector<cv::Mat> vOutputBlobs;
+		m_cvNet.setInput(cvInputBlob);
+		m_cvNet.forward(vOutputBlobs, m_vOutputNames);
+
+		if (vOutputBlobs.empty())
+			return false;
+
+		if (vOutputBlobs[0].type() != CV_32F || !vOutputBlobs[0].isContinuous())
+			vOutputBlobs[0].convertTo(vOutputBlobs[0], CV_32F);
+
+		// Postprocess the result of each image in the batch
+		CVOutputData stOutputData{ &vOutputBlobs, 0, vOutputBlobs[0].total() / nBatch };
+
+		for (int i = 0; i < nCount; i++)
+		{
+			stOutputData.nBatchIdx = i;
+			PostProcess(pFrames[i].size(), &stOutputData, ppResultData[i]);
+		}
+	}
+	catch (cv::Exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+		return false;
+	}
+	catch (std::exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Read the onnx deep learning model
+// @param[in] sModelPath: path to the onnx model
+// @param[in] sPairedFilePath: path to the file paired with the onnx model. e.g., the config file or the class name file
+// @param[in] sLogID: title for logging
+// @return: true if success, otherwise false
+bool CCVInferer::ReadModel(const std::string& sModelPath, const std::string& sPairedFilePath/* = ""*/, const std::string& sLogID /*= "opencv-dnn"*/)
+{
+	(void)sPairedFilePath;
+
+	try {
+		m_cvNet = cv::dnn::readNetFromONNX(sModelPath);
+		if (m_cvNet.empty())
+		{
+			std::cout << "[" << sLogID << "] Failed to read the model: " << sModelPath << std::endl;
+			return false;
+		}
+
+		// The OpenCV's own kernels run on CPU. The CUDA backend is used only if OpenCV is built with it
+		if (m_NetDetailsConfig.nDeviceID >= 0)
+		{
+			m_cvNet.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
+			m_cvNet.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
+		}
+		else
+		{
+			m_cvNet.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+			m_cvNet.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+		}
+
+		m_vOutputNames = m_cvNet.getUnconnectedOutLayersNames();
+
+		// Get input node dims from the input layer
+		std::vector<cv::dnn::MatShape> vInputShapes, vOutputShapes;
+		m_cvNet.getLayerShapes(cv::dnn::MatShape(), 0, vInputShapes, vOutputShapes);
+		if (vOutputShapes.empty() || vOutputShapes[0].size() != 4)
+		{
+			std::cout << "[" << sLogID << "] The input of the model should be NCHW: " << sModelPath << std::endl;
+			return false;
+		}
+
+		// [Note] The batch dim of the model exported with the dynamic batch size is not positive
+		const cv::dnn::MatShape& vInputDims = vOutputShapes[0];
+		m_nNetBatch = (vInputDims[0] > 0) ? vInputDims[0] : -1;
+		m_nNetInputH = vInputDims[2];
+		m_nNetInputW = vInputDims[3];
+		if (m_nNetInputH <= 0 || m_nNetInputW <= 0)
+		{
+			std::cout << "[" << sLogID << "] The input size of the model should be fixed: " << sModelPath << std::endl;
+			return false;
+		}
+
+		// Get output node dims by running the network once. It also allocates the buffers of the network in advance
+		int vBatchDims[] = { (m_nNetBatch > 0) ? m_nNetBatch : 1, 3, m_nNetInputH, m_nNetInputW };
+		cv::Mat cvInputBlob(4, vBatchDims, CV_32F, cv::Scalar(0));
+
+		std::vector<cv::Mat> vOutputBlobs;
+		m_cvNet.setInput(cvInputBlob);
+		m_cvNet.forward(vOutputBlobs, m_vOutputNames);
+		if (vOutputBlobs.empty())
+			return false;
+
+		m_vNetOutputDims.assign(vOutputBlobs[0].size.p, vOutputBlobs[0].size.p + vOutputBlobs[0].dims);
+
+		// [Note] If the onnx model was exported without considering the batch size, the output node dims will be 2D
+		// Otherwise, the output node dims will be 3D or more
+		if (m_vNetOutputDims.size() > 2)
+			m_nNetOutputs = m_vNetOutputDims[2];
+
+		m_nNetProposals = (m_vNetOutputDims.size() > 1) ? m_vNetOutputDims[1] : 0;
+	}
+	catch (cv::Exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+		return false;
+	}
+	catch (std::exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Core function for postprocessing the output blob
+// @param[in] pTensorData: output blob data to be postprocessed
+// @return: pointer to the output data of the relevant image in the batch
+const void* CCVInferer::PostProcessCore(const void* pTensorData) const
+{
+	const CVOutputData* pOutputData = (const CVOutputData*)pTensorData;
+
+	const float* pData = pOutputData->pvOutputBlobs->at(0).ptr<float>();
+
+	return (const void*)(pData + pOutputData->nBatchIdx * pOutputData->nImageStride);
+}
+
+// Validate the required parameters
+bool CCVInferer::Validate()
+{
+	if (m_cvNet.empty())
+		return false;
+
+	if (!CInferer::Validate())
+		return false;
+
+	if (m_vNetOutputDims.size() > 2 && m_nNetOutputs == 0)
+		return false;
+
+	return true;
+}
@@ -0,0 +1,291 @@
+#include "CImgPreProcessor.h"
+
+#ifdef _SIMD_X86_
+#include <immintrin.h>
+#endif
+
+// Minimum number of output pixels to run the preprocessing in parallel
+#define PARALLEL_MIN_PIXELS		(64 * 1024)
+
+// Number of output rows processed by each parallel stripe
+#define PARALLEL_STRIPE_ROWS	16
+
+
+#ifdef _SIMD_X86_
+// AVX-512 version of CImgPreProcessor::VertLinearNorm
+_TARGET_AVX512_ static void VertLinearNormAVX512(const float* pRow0, const float* pRow1, float fBeta, float fScale, float fBias,
+	float* pDst, int nLen)
+{
+	__m512 vBeta = _mm512_set1_ps(fBeta);
+	__m512 vScale = _mm512_set1_ps(fScale);
+	__m512 vBias = _mm512_set1_ps(fBias);
+
+	int x = 0;
+	for (; x <= nLen - 16; x += 16)
+	{
+		__m512 v0 = _mm512_loadu_ps(pRow0 + x);
+		__m512 v1 = _mm512_loadu_ps(pRow1 + x);
+		__m512 v = _mm512_fmadd_ps(vBeta, _mm512_sub_ps(v1, v0), v0);
+		_mm512_storeu_ps(pDst + x, _mm512_fmadd_ps(v, vScale, vBias));
+	}
+
+	for (; x < nLen; x++)
+		pDst[x] = (pRow0[x] + fBeta * (pRow1[x] - pRow0[x])) * fScale + fBias;
+}
+
+// AVX2 version of CImgPreProcessor::VertLinearNorm
+_TARGET_AVX2_ static void VertLinearNormAVX2(const float* pRow0, const float* pRow1, float fBeta, float fScale, float fBias,
+	float* pDst, int nLen)
+{
+	__m256 vBeta = _mm256_set1_ps(fBeta);
+	__m256 vScale = _mm256_set1_ps(fScale);
+	__m256 vBias = _mm256_set1_ps(fBias);
+
+	int x = 0;
+	for (; x <= nLen - 8; x += 8)
+	{
+		__m256 v0 = _mm256_loadu_ps(pRow0 + x);
+		__m256 v1 = _mm256_loadu_ps(pRow1 + x);
+		__m256 v = _mm256_fmadd_ps(vBeta, _mm256_sub_ps(v1, v0), v0);
+		_mm256_storeu_ps(pDst + x, _mm256_fmadd_ps(v, vScale, vBias));
+	}
+
+	for (; x < nLen; x++)
+		pDst[x] = (pRow0[x] + fBeta * (pRow1[x] - pRow0[x])) * fScale + fBias;
+}
+#endif
+
+
+// Vertical pixel mapping of one region of the source image to its output tensor
+typedef struct _RoiRowMapping
+{
+	double	dY;			// source y of the top edge of the region
+	double	dScaleY;	// source rows per output row
+	int		nYMin;		// first source row of the region
+	int		nYMax;		// last source row of the region
+
+	_RoiRowMapping()
+	{
+		dY = 0.0;
+		dScaleY = 0.0;
+		nYMin = 0;
+		nYMax = 0;
+	}
+}RoiRowMapping;
+
+
+// Preprocess the BGR image into the planar CHW float tensor
+// @param[in] cvImg: input image of CV_8UC3
+// @param[in] nDstW: width of the output tensor
+// @param[in] nDstH: height of the output tensor
+// @param[in] pMean: mean value of each channel of the input image
+// @param[in] pScale: scale value of each channel of the input image
+// @param[in] bSwapRB: whether to swap the R and B channels
+// @param[out] pDst: output tensor buffer of 3 x nDstH x nDstW floats
+// @return: true if success, otherwise false
+bool CImgPreProcessor::BlobFromImage(const cv::Mat& cvImg, int nDstW, int nDstH,
+	const float pMean[3], const float pScale[3], bool bSwapRB, float* pDst)
+{
+	if (cvImg.empty())
+		return false;
+
+	cv::Rect2f cvRoi(0.0f, 0.0f, (float)cvImg.cols, (float)cvImg.rows);
+	return BlobFromRois(cvImg, &cvRoi, 1, nDstW, nDstH, pMean, pScale, bSwapRB, pDst);
+}
+
+// Preprocess the regions of the BGR image into the consecutive planar CHW float tensors of a batch
+// @param[in] cvImg: input image of CV_8UC3
+// @param[in] pRois: regions of the input image, such as the boxes of the detected objects
+// @param[in] nRois: number of the regions
+// @param[in] nDstW: width of the output tensor of each region
+// @param[in] nDstH: height of the output tensor of each region
+// @param[in] pMean: mean value of each channel of the input image
+// @param[in] pScale: scale value of each channel of the input image
+// @param[in] bSwapRB: whether to swap the R and B channels
+// @param[out] pDst: output tensor buffer of nRois x 3 x nDstH x nDstW floats
+// @return: true if success, otherwise false
+bool CImgPreProcessor::BlobFromRois(const cv::Mat& cvImg, const cv::Rect2f* pRois, int nRois, int nDstW, int nDstH,
+	const float pMean[3], const float pScale[3], bool bSwapRB, float* pDst)
+{
+	if (cvImg.empty() || cvImg.type() != CV_8UC3)
+		return false;
+
+	if (pRois == nullptr || nRois <= 0 || nDstW <= 0 || nDstH <= 0 || pDst == nullptr)
+		return false;
+
+	const int nSrcW = cvImg.cols;
+	const int nSrcH = cvImg.rows;
+	const size_t nPlaneSize = (size_t)nDstW * nDstH;
+
+	// Build the horizontal lookup tables of each region shared by all its rows.
+	// The pixels are sampled inside the region only, as cv::resize(INTER_LINEAR) of the cropped region does
+	cv::AutoBuffer<int> vXOfs((size_t)nRois * nDstW * 2);
+	cv::AutoBuffer<float> vAlpha((size_t)nRois * nDstW);
+	std::vector<RoiRowMapping> vRowMappings(nRois);
+	for (int r = 0; r < nRois; r++)
+	{
+		const cv::Rect2f& cvRoi = pRois[r];
+		int nXMin = _MAX(0, cvFloor(cvRoi.x));
+		int nXMax = _MIN(nSrcW, cvCeil(cvRoi.x + cvRoi.width)) - 1;
+		int nYMin = _MAX(0, cvFloor(cvRoi.y));
+		int nYMax = _MIN(nSrcH, cvCeil(cvRoi.y + cvRoi.height)) - 1;
+		if (!(cvRoi.width > 0.0f) || !(cvRoi.height > 0.0f) || nXMin > nXMax || nYMin > nYMax)
+			return false;
+
+		const double dScaleX = (double)cvRoi.width / nDstW;
+		int* pXOfs0 = vXOfs.data() + (size_t)r * nDstW * 2;
+		int* pXOfs1 = pXOfs0 + nDstW;
+		float* pAlpha = vAlpha.data() + (size_t)r * nDstW;
+		for (int x = 0; x < nDstW; x++)
+		{
+			double dX = cvRoi.x + (x + 0.5) * dScaleX - 0.5;
+			int nX = cvFloor(dX);
+			float fAlpha = (float)(dX - nX);
+
+			if (nX < nXMin) { nX = nXMin; fAlpha = 0.0f; }
+			if (nX >= nXMax) { nX = nXMax; fAlpha = 0.0f; }
+
+			pXOfs0[x] = nX * 3;
+			pXOfs1[x] = _MIN(nX + 1, nXMax) * 3;
+			pAlpha[x] = fAlpha;
+		}
+
+		vRowMappings[r].dY = cvRoi.y;
+		vRowMappings[r].dScaleY = (double)cvRoi.height / nDstH;
+		vRowMappings[r].nYMin = nYMin;
+		vRowMappings[r].nYMax = nYMax;
+	}
+
+	// Normalisation bias and output plane offset of each channel of the input image
+	float vBias[3];
+	size_t vPlaneOfs[3];
+	for (int c = 0; c < 3; c++)
+	{
+		vBias[c] = -pMean[c] * pScale[c];
+		vPlaneOfs[c] = (bSwapRB ? 2 - c : c) * nPlaneSize;
+	}
+
+	// Each task is one stripe of rows of one region, so the small regions of a batch are processed in parallel together
+	const int nStripes = (nDstH + PARALLEL_STRIPE_ROWS - 1) / PARALLEL_STRIPE_ROWS;
+	auto processStripes = [&](const cv::Range& range)
+	{
+		// Two horizontally interpolated source rows. Each one holds three planar channel rows
+		cv::AutoBuffer<float> vRowBuf(nDstW * 6);
+		float* pRows[2] = { vRowBuf.data(), vRowBuf.data() + 3 * nDstW };
+
+		for (int nTask = range.start; nTask < range.end; nTask++)
+		{
+			const int r = nTask / nStripes;
+			const RoiRowMapping& stRowMapping = vRowMappings[r];
+			const int* pXOfs0 = vXOfs.data() + (size_t)r * nDstW * 2;
+			const int* pXOfs1 = pXOfs0 + nDstW;
+			const float* pAlpha = vAlpha.data() + (size_t)r * nDstW;
+			float* pRoiDst = pDst + (size_t)r * 3 * nPlaneSize;
+
+			int vRowTags[2] = { -1, -1 };
+			int nYEnd = _MIN(nDstH, (nTask % nStripes + 1) * PARALLEL_STRIPE_ROWS);
+			for (int y = (nTask % nStripes) * PARALLEL_STRIPE_ROWS; y < nYEnd; y++)
+			{
+				double dY = stRowMapping.dY + (y + 0.5) * stRowMapping.dScaleY - 0.5;
+				int nY0 = cvFloor(dY);
+				float fBeta = (float)(dY - nY0);
+
+				if (nY0 < stRowMapping.nYMin) { nY0 = stRowMapping.nYMin; fBeta = 0.0f; }
+				if (nY0 >= stRowMapping.nYMax) { nY0 = stRowMapping.nYMax; fBeta = 0.0f; }
+				int nY1 = _MIN(nY0 + 1, stRowMapping.nYMax);
+
+				// Reuse the interpolated rows of the previous output row as much as possible
+				if (vRowTags[0] != nY0 && vRowTags[1] == nY0)
+				{
+					std::swap(pRows[0], pRows[1]);
+					std::swap(vRowTags[0], vRowTags[1]);
+				}
+
+				if (vRowTags[0] != nY0)
+				{
+					HorzLinear(cvImg.ptr<uchar>(nY0), pXOfs0, pXOfs1, pAlpha, nDstW, pRows[0]);
+					vRowTags[0] = nY0;
+				}
+
+				if (fBeta != 0.0f && vRowTags[1] != nY1)
+				{
+					HorzLinear(cvImg.ptr<uchar>(nY1), pXOfs0, pXOfs1, pAlpha, nDstW, pRows[1]);
+					vRowTags[1] = nY1;
+				}
+
+				const float* pLower = (fBeta != 0.0f) ? pRows[1] : pRows[0];
+				for (int c = 0; c < 3; c++)
+				{
+					VertLinearNorm(pRows[0] + c * nDstW, pLower + c * nDstW, fBeta, pScale[c], vBias[c],
+						pRoiDst + vPlaneOfs[c] + (size_t)y * nDstW, nDstW);
+				}
+			}
+		}
+	};
+
+	const int nTasks = nRois * nStripes;
+	if (nPlaneSize * nRois >= PARALLEL_MIN_PIXELS)
+		cv::parallel_for_(cv::Range(0, nTasks), processStripes, nTasks);
+	else
+		processStripes(cv::Range(0, nTasks));
+
+	return true;
+}
+
+// Interpolate one source row horizontally into three planar float rows
+// @param[in] pSrcRow: source row of BGR pixels
+// @param[in] pXOfs0: byte offset of the left neighbour pixel of each output column
+// @param[in] pXOfs1: byte offset of the right neighbour pixel of each output column
+// @param[in] pAlpha: weight of the right neighbour pixel of each output column
+// @param[in] nDstW: width of the output rows
+// @param[out] pRows: three output rows of nDstW floats, one for each channel of the source image
+void CImgPreProcessor::HorzLinear(const uchar* pSrcRow, const int* pXOfs0, const int* pXOfs1, const float* pAlpha,
+	int nDstW, float* pRows)
+{
+	float* pRow0 = pRows;
+	float* pRow1 = pRows + nDstW;
+	float* pRow2 = pRows + 2 * nDstW;
+
+	for (int x = 0; x < nDstW; x++)
+	{
+		const uchar* pA = pSrcRow + pXOfs0[x];
+		const uchar* pB = pSrcRow + pXOfs1[x];
+		float fAlpha = pAlpha[x];
+
+		pRow0[x] = pA[0] + fAlpha * (int(pB[0]) - int(pA[0]));
+		pRow1[x] = pA[1] + fAlpha * (int(pB[1]) - int(pA[1]));
+		pRow2[x] = pA[2] + fAlpha * (int(pB[2]) - int(pA[2]));
+	}
+}
+
+// Interpolate two rows vertically, normalise and store the result into one output plane row
+// @param[in] pRow0: upper row
+// @param[in] pRow1: lower row
+// @param[in] fBeta: weight of the lower row
+// @param[in] fScale: normalisation scale
+// @param[in] fBias: normalisation bias, that is -mean * scale
+// @param[out] pDst: output plane row
+// @param[in] nLen: length of the rows
+void CImgPreProcessor::VertLinearNorm(const float* pRow0, const float* pRow1, float fBeta, float fScale, float fBias,
+	float* pDst, int nLen)
+{
+#ifdef _SIMD_X86_
+	static const bool s_bAVX512 = cv::checkHardwareSupport(CV_CPU_AVX512_SKX);
+	static const bool s_bAVX2 = cv::checkHardwareSupport(CV_CPU_AVX2) && cv::checkHardwareSupport(CV_CPU_FMA3);
+
+	if (s_bAVX512)
+	{
+		VertLinearNormAVX512(pRow0, pRow1, fBeta, fScale, fBias, pDst, nLen);
+		return;
+	}
+
+	if (s_bAVX2)
+	{
+		VertLinearNormAVX2(pRow0, pRow1, fBeta, fScale, fBias, pDst, nLen);
+		return;
+	}
+#endif
+
+	for (int x = 0; x < nLen; x++)
+		pDst[x] = (pRow0[x] + fBeta * (pRow1[x] - pRow0[x])) * fScale + fBias;
+}
@@ -0,0 +1,254 @@
+#include "CInferer.h"
+#include "CImgPreProcessor.h"
+
+CInferer::CInferer(const NetDetailsConfig& stConfig)
+	: m_NetDetailsConfig(stConfig)
+	, m_bValid(false)
+	, m_nNetInputW(0)
+	, m_nNetInputH(0)
+	, m_nNetOutputs(0)
+	, m_nNetProposals(0)
+	, m_nNetBatch(1)
+{
+
+}
+
+CInferer::~CInferer()
+{
+
+}
+
+// Main function to run inference
+// @param[in] cvFrame: input image
+// @param[out] pResultData: output data
+// @return: true if success, otherwise false
+bool CInferer::Inference(const cv::Mat& cvFrame, void* pResultData)
+{
+	if (!m_bValid)
+		return false;
+
+	if (cvFrame.empty())
+		return false;
+
+	if (pResultData == nullptr)
+		return false;
+
+	return RunBatch(&cvFrame, &pResultData, 1);
+}
+
+// Main function to run batch inference
+// @param[in] vFrames: input images
+// @param[out] vResultData: output data of each input image
+// @return: true if success, otherwise false
+bool CInferer::BatchInference(const std::vector<cv::Mat>& vFrames, const std::vector<void*>& vResultData)
+{
+	if (!m_bValid)
+		return false;
+
+	if (vFrames.size() != vResultData.size())
+		return false;
+
+	for (size_t i = 0; i < vFrames.size(); i++)
+	{
+		if (vFrames[i].empty() || vResultData[i] == nullptr)
+			return false;
+	}
+
+	// Split the images into chunks of the maximum batch size and run each chunk at once
+	int nTotal = (int)vFrames.size();
+	int nMaxBatch = GetMaxBatchSize();
+	for (int nStart = 0; nStart < nTotal; nStart += nMaxBatch)
+	{
+		int nCount = _MIN(nMaxBatch, nTotal - nStart);
+		if (!RunBatch(vFrames.data() + nStart, vResultData.data() + nStart, nCount))
+			return false;
+	}
+
+	return true;
+}
+
+// Get the maximum number of images that can be packed into one run
+// @return: the maximum batch size
+int CInferer::GetMaxBatchSize() const
+{
+	// Fixed batch model can only run the exported batch size
+	if (m_nNetBatch > 0)
+		return m_nNetBatch;
+
+	// Dynamic batch model is limited by the configuration only
+	if (m_NetDetailsConfig.nMaxBatchSize > 0)
+		return m_NetDetailsConfig.nMaxBatchSize;
+
+	return INT_MAX;
+}
+
+// Preprocess the input image into the given tensor buffer of one image
+// @param[in] cvImg: input image to be preprocessed
+// @param[out] pTensor: tensor buffer of 3 x m_nNetInputH x m_nNetInputW floats
+// @return: true if success, otherwise false
+bool CInferer::PreProcessToTensor(const cv::Mat& cvImg, float* pTensor)
+{
+	// Wrap the tensor buffer so that the preprocessing writes into it directly
+	int vDims[] = { 1, 3, m_nNetInputH, m_nNetInputW };
+	cv::Mat cvProcImg(4, vDims, CV_32F, pTensor);
+
+	PreProcess(cvImg, cvProcImg);
+
+	// The derived class may have reallocated the output. Copy it back to the tensor buffer in this case
+	if (cvProcImg.ptr<float>() != pTensor)
+	{
+		size_t nImageSize = (size_t)3 * m_nNetInputH * m_nNetInputW;
+		if (cvProcImg.type() != CV_32F || cvProcImg.total() != nImageSize || !cvProcImg.isContinuous())
+			return false;
+
+		memcpy(pTensor, cvProcImg.ptr<float>(), nImageSize * sizeof(float));
+	}
+
+	return true;
+}
+
+// Preprocess the input images into the given batch tensor buffer
+// @param[in] pFrames: input images
+// @param[in] nCount: number of input images
+// @param[out] pTensor: tensor buffer of nCount x 3 x m_nNetInputH x m_nNetInputW floats
+// @return: true if success, otherwise false
+// [Note] The default implementation preprocesses the images one by one by PreProcessToTensor().
+bool CInferer::PreProcessBatch(const cv::Mat* pFrames, int nCount, float* pTensor)
+{
+	size_t nImageSize = (size_t)3 * m_nNetInputH * m_nNetInputW;
+	for (int i = 0; i < nCount; i++)
+	{
+		if (!PreProcessToTensor(pFrames[i], pTensor + i * nImageSize))
+			return false;
+	}
+
+	return true;
+}
+
+// Core function for preprocessing the input image
+// @param[in] cvImg: input image to be preprocessed
+// @param[in] bSwapRB: whether to swap the R and B channels
+// @param[out] cvProcImg: preprocessed image. If it is preallocated as 1x3xHxW CV_32F, the result is written into its buffer
+void CInferer::PreProcessCore(const cv::Mat& cvImg, bool bSwapRB, cv::Mat& cvProcImg) const
+{
+	// The fused kernel only accepts the BGR image of 8 bits. Convert the other formats first
+	cv::Mat cvBGRImg = cvImg;
+	if (cvBGRImg.channels() == 1)
+		cv::cvtColor(cvBGRImg, cvBGRImg, cv::COLOR_GRAY2BGR);
+	else if (cvBGRImg.channels() == 4)
+		cv::cvtColor(cvBGRImg, cvBGRImg, cv::COLOR_BGRA2BGR);
+
+	if (cvBGRImg.depth() != CV_8U)
+		cvBGRImg.convertTo(cvBGRImg, CV_8U);
+
+	// Allocate the output only if it is not preallocated with the same shape
+	int vDims[] = { 1, 3, m_nNetInputH, m_nNetInputW };
+	cvProcImg.create(4, vDims, CV_32F);
+
+	float vMean[3], vScale[3];
+	GetNormParams(bSwapRB, vMean, vScale);
+
+	// Resize, swap, normalise and transpose into the output tensor in one pass
+	CImgPreProcessor::BlobFromImage(cvBGRImg, m_nNetInputW, m_nNetInputH, vMean, vScale, bSwapRB, cvProcImg.ptr<float>());
+}
+
+// Core function for preprocessing the input images into the batch tensor buffer
+// @param[in] pFrames: input images
+// @param[in] nCount: number of input images
+// @param[in] bSwapRB: whether to swap the R and B channels
+// @param[out] pTensor: tensor buffer of nCount x 3 x m_nNetInputH x m_nNetInputW floats
+// @return: true if success, otherwise false
+bool CInferer::PreProcessBatchCore(const cv::Mat* pFrames, int nCount, bool bSwapRB, float* pTensor) const
+{
+	size_t nImageSize = (size_t)3 * m_nNetInputH * m_nNetInputW;
+
+	float vMean[3], vScale[3];
+	GetNormParams(bSwapRB, vMean, vScale);
+
+	std::vector<cv::Rect2f> vRois;
+	vRois.reserve(nCount);
+
+	int nStart = 0;
+	while (nStart < nCount)
+	{
+		const cv::Mat& cvFirst = pFrames[nStart];
+		if (cvFirst.empty())
+			return false;
+
+		// Other formats are converted by PreProcessCore() first
+		if (cvFirst.type() != CV_8UC3)
+		{
+			int vDims[] = { 1, 3, m_nNetInputH, m_nNetInputW };
+			cv::Mat cvProcImg(4, vDims, CV_32F, pTensor + nStart * nImageSize);
+			PreProcessCore(cvFirst, bSwapRB, cvProcImg);
+			nStart++;
+			continue;
+		}
+
+		// Collect the following images sharing the buffer of the same whole image as regions of it
+		cv::Size cvWholeSize;
+		cv::Point cvOfs;
+		cvFirst.locateROI(cvWholeSize, cvOfs);
+
+		vRois.clear();
+		vRois.push_back(cv::Rect2f((float)cvOfs.x, (float)cvOfs.y, (float)cvFirst.cols, (float)cvFirst.rows));
+
+		int nEnd = nStart + 1;
+		for (; nEnd < nCount; nEnd++)
+		{
+			const cv::Mat& cvImg = pFrames[nEnd];
+			if (cvImg.empty() || cvImg.type() != CV_8UC3 || cvImg.datastart != cvFirst.datastart || cvImg.step[0] != cvFirst.step[0])
+				break;
+
+			cv::Size cvSize;
+			cvImg.locateROI(cvSize, cvOfs);
+			if (cvSize != cvWholeSize)
+				break;
+
+			vRois.push_back(cv::Rect2f((float)cvOfs.x, (float)cvOfs.y, (float)cvImg.cols, (float)cvImg.rows));
+		}
+
+		// Sample all the regions from the whole image straight into their slots of the batch tensor
+		cv::Mat cvWholeImg(cvWholeSize, CV_8UC3, (void*)cvFirst.datastart, cvFirst.step[0]);
+		if (!CImgPreProcessor::BlobFromRois(cvWholeImg, vRois.data(), (int)vRois.size(), m_nNetInputW, m_nNetInputH,
+			vMean, vScale, bSwapRB, pTensor + nStart * nImageSize))
+			return false;
+
+		nStart = nEnd;
+	}
+
+	return true;
+}
+
+// Get the normalisation parameters of the fused preprocessing kernels
+// @param[in] bSwapRB: whether to swap the R and B channels
+// @param[out] pMean: mean value of each channel of the input image
+// @param[out] pScale: scale value of each channel of the input image
+void CInferer::GetNormParams(bool bSwapRB, float pMean[3], float pScale[3]) const
+{
+	const double vNormMean[3] = { m_NetDetailsConfig.dNormMean0, m_NetDetailsConfig.dNormMean1, m_NetDetailsConfig.dNormMean2 };
+	const double vNormStd[3] = { m_NetDetailsConfig.dNormStd0, m_NetDetailsConfig.dNormStd1, m_NetDetailsConfig.dNormStd2 };
+
+	// [Note] For the historical reason, the mean values are in the order of the output channels if all the std values are same,
+	//        as cv::dnn::blobFromImage() subtracts the mean after swapping the channels.
+	//        Otherwise, the mean and std values are in the order of the input channels.
+	bool bSameStd = (vNormStd[0] == vNormStd[1] && vNormStd[0] == vNormStd[2]);
+
+	for (int c = 0; c < 3; c++)
+	{
+		pMean[c] = (float)((bSameStd && bSwapRB) ? vNormMean[2 - c] : vNormMean[c]);
+		pScale[c] = (float)vNormStd[c];
+	}
+}
+
+// Validate the required parameters
+bool CInferer::Validate()
+{
+	if (m_nNetInputW == 0 || m_nNetInputH == 0)
+		return false;
+
+	if (m_nNetProposals == 0)
+		return false;
+
+	return true;
+}
@@ -1,81 +1,125 @@
-#include <filesystem>
 #include "CORTInferer.h"
 #include "CORTPars.h"
-
-namespace fs = std::filesystem;
+#include "CORTRuntime.h"
+#include "CORTModelCache.h"
+#include "CORTSessionPool.h"
 
 CORTInferer::CORTInferer(const NetDetailsConfig& stConfig)
-	: m_NetDetailsConfig(stConfig)
-	, m_pORTPars(nullptr)
-	, m_nNetInputW(0)
-	, m_nNetInputH(0)
-	, m_nNetOutputs(0)
-	, m_nNetProposals(0)
-	, m_bValid(false)
+	: CInferer(stConfig)
 {
 
 }
 
 CORTInferer::~CORTInferer()
 {
-	if (!m_pORTPars)
+	if (m_pSessionPool)
 	{
-		delete m_pORTPars;	m_pORTPars = nullptr;
+		m_pSessionPool->RemoveCapacity(m_NetDetailsConfig.nSessionPoolSize);
+		m_pSessionPool.reset();
 	}
 }
 
-// Main function to run inference
-// @param[in] cvFrame: input image
-// @param[out] pResultData: output data
+// Run the session once on the given images packed into one batch
+// @param[in] pFrames: input images
+// @param[out] ppResultData: output data of each input image
+// @param[in] nCount: number of input images. It should not be greater than GetMaxBatchSize()
 // @return: true if success, otherwise false
-bool CORTInferer::Inference(const cv::Mat& cvFrame, void* pResultData)
+bool CORTInferer::RunBatch(const cv::Mat* pFrames, void* const* ppResultData, int nCount)
 {
-	if (!m_bValid)
-		return false;
+	try
+	{
+		// The fixed batch model always runs the exported batch size. The unused slots are padded with zeros.
+		int nBatch = (m_nNetBatch > 0) ? m_nNetBatch : nCount;
+		if (nCount <= 0 || nCount > nBatch)
+			return false;
 
-	if (cvFrame.empty())
-		return false;
+		size_t nImageSize = (size_t)3 * m_nNetInputH * m_nNetInputW;
 
-	if (pResultData == nullptr)
-		return false;
+		// Check out a session of the pool for this run. It is returned to the pool when the run finishes
+		CORTSessionLease sessionLease(m_pSessionPool.get());
+		CORTPars* pPars = sessionLease.Get();
+		if (!pPars)
+			return false;
+
+		if (!pPars->m_bBindingReady && !InitIoBinding(pPars))
+			return false;
+
+		// Io binding mode: preprocess into the bound input buffer and run without any tensor allocation
+		ORTBindingSlot* pSlot = GetBindingSlot(pPars, nBatch);
+		if (pSlot)
+		{
+			float* pInput = pPars->m_vInputBuffer.data();
+			if (!PreProcessBatch(pFrames, nCount, pInput))
+				return false;
+
+			// Clear the padding slots left by the previous run
+			if (nCount < nBatch)
+				memset(pInput + nCount * nImageSize, 0, (nBatch - nCount) * nImageSize * sizeof(float));
+
+			pPars->session.Run(pPars->runOptions, pSlot->ioBinding);
+
+			ORTOutputData stOutputData{ &pSlot->vOutputTensors, 0, pSlot->nImageStride };
+			for (int i = 0; i < nCount; i++)
+			{
+				stOutputData.nBatchIdx = i;
+				PostProcess(pFrames[i].size(), &stOutputData, ppResultData[i]);
+			}
+
+			return true;
+		}
 
-	try
-	{
 		cv::Mat cvInputImg;
-		PreProcess(cvFrame, cvInputImg);
+		if (nBatch == 1)
+		{
+			PreProcess(pFrames[0], cvInputImg);
+		}
+		else
+		{
+			// Pack the preprocessed images into one NCHW tensor
+			int vBatchDims[] = { nBatch, 3, m_nNetInputH, m_nNetInputW };
+			cvInputImg = cv::Mat(4, vBatchDims, CV_32F, cv::Scalar(0));
 
+			if (!PreProcessBatch(pFrames, nCount, cvInputImg.ptr<float>()))
+				return false;
+		}
 
-		std::array<int64_t, 4> inputDims{ 1, 3, m_nNetInputH, m_nNetInputW };
+		std::array<int64_t, 4> inputDims{ nBatch, 3, m_nNetInputH, m_nNetInputW };
 
 		Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(OrtAllocatorType::OrtDeviceAllocator,
 			OrtMemType::OrtMemTypeDefault);
 
 		Ort::Value inputTensor = Ort::Value::CreateTensor<float>(memoryInfo,
 			cvInputImg.ptr<float>(),
-			cvInputImg.total() * sizeof(float),
+			cvInputImg.total(),
 			inputDims.data(),
 			inputDims.size());
 
-		size_t nInputCount = m_pORTPars->m_vInputNames.size();
-		size_t nOutputCount = m_pORTPars->m_vOutputNames.size();
+		size_t nInputCount = pPars->m_vInputNames.size();
+		size_t nOutputCount = pPars->m_vOutputNames.size();
 
 		std::vector<Ort::Value> outputTensors;
-		outputTensors.reserve(m_pORTPars->m_vOutputNames.size());
+		outputTensors.reserve(pPars->m_vOutputNames.size());
 		for (size_t i = 0; i < nOutputCount; i++)
 			outputTensors.emplace_back(nullptr);
 
-		m_pORTPars->session.Run(Ort::RunOptions{ nullptr },
-			&m_pORTPars->m_vInputNames[0],
+		pPars->session.Run(Ort::RunOptions{ nullptr },
+			&pPars->m_vInputNames[0],
 			&inputTensor,
 			nInputCount,
-			m_pORTPars->m_vOutputNames.data(),
+			pPars->m_vOutputNames.data(),
 			outputTensors.data(),
 			nOutputCount);
 
 
-		PostProcess(cvFrame.size(), &outputTensors, pResultData);
-
+		// Postprocess the result of each image in the batch
+		ORTOutputData stOutputData{ &outputTensors, 0, 
+			outputTensors.at(0).GetTensorTypeAndShapeInfo().GetElementCount() / nBatch };
 
+		for (int i = 0; i < nCount; i++)
+		{
+			stOutputData.nBatchIdx = i;
+			PostProcess(pFrames[i].size(), &stOutputData, ppResultData[i]);
+		}
 	}
 	catch (Ort::Exception& e)
 	{
@@ -99,83 +143,146 @@ bool CORTInferer::Inference(const cv::Mat& cvFrame, void* pResultData)
 	return true;
 }
 
+// Initialise the persistent tensors of the io binding mode of the session
+// @param[in/out] pPars: the session
+// @return: true if success, otherwise false
+// [Note] If the model has the dynamic dims other than the batch size, io binding is disabled and the normal mode is used.
+bool CORTInferer::InitIoBinding(CORTPars* pPars)
+{
+	pPars->m_vBindingSlots.clear();
+	pPars->m_nBindingCapacity = 0;
+	pPars->m_bBindingReady = true;
+
+	if (!m_NetDetailsConfig.bIoBinding)
+		return true;
+
+	// Calculate the number of elements per image of each output
+	std::vector<size_t> vOutputImageSizes;
+	for (const std::vector<int64_t>& vDims : m_vNetOuputNodeDims)
+	{
+		size_t nSize = 1;
+		for (size_t k = 1; k < vDims.size(); k++)
+		{
+			if (vDims[k] <= 0)
+			{
+				std::cout << "Io binding is disabled due to the dynamic output dims." << std::endl;
+				return true;
+			}
+			nSize *= (size_t)vDims[k];
+		}
+		vOutputImageSizes.push_back(nSize);
+	}
+
+	// The fixed batch model binds its batch size, and the dynamic batch model binds up to the maximum batch size
+	int nCapacity = (m_nNetBatch > 0) ? m_nNetBatch : _MAX(1, m_NetDetailsConfig.nMaxBatchSize);
+	size_t nImageSize = (size_t)3 * m_nNetInputH * m_nNetInputW;
+
+	pPars->memoryInfo = Ort::MemoryInfo::CreateCpu(OrtAllocatorType::OrtDeviceAllocator,
+		OrtMemType::OrtMemTypeDefault);
+	pPars->runOptions = Ort::RunOptions();
+
+	pPars->m_vInputBuffer.assign(nCapacity * nImageSize, 0.0f);
+	pPars->m_vOutputBuffers.resize(vOutputImageSizes.size());
+	for (size_t i = 0; i < vOutputImageSizes.size(); i++)
+		pPars->m_vOutputBuffers[i].assign(nCapacity * vOutputImageSizes[i], 0.0f);
+
+	pPars->m_vOutputImageSizes = vOutputImageSizes;
+	pPars->m_vBindingSlots.resize(nCapacity + 1);
+	pPars->m_nBindingCapacity = nCapacity;
+
+	// Bind the tensors of the batch size used by the single image inference in advance
+	if (!GetBindingSlot(pPars, (m_nNetBatch > 0) ? m_nNetBatch : 1))
+		return false;
+
+	return true;
+}
+
+// Get the binding slot of the session for the given batch size. The slot is created at the first use and reused afterwards.
+// @param[in/out] pPars: the session
+// @param[in] nBatch: batch size
+// @return: the binding slot. nullptr if io binding is disabled or the batch size exceeds the binding capacity
+ORTBindingSlot* CORTInferer::GetBindingSlot(CORTPars* pPars, int nBatch)
+{
+	if (!pPars || nBatch <= 0 || nBatch > pPars->m_nBindingCapacity)
+		return nullptr;
+
+	std::unique_ptr<ORTBindingSlot>& pSlot = pPars->m_vBindingSlots[nBatch];
+	if (pSlot)
+		return pSlot.get();
+
+	std::unique_ptr<ORTBindingSlot> pNewSlot = std::make_unique<ORTBindingSlot>();
+	pNewSlot->ioBinding = Ort::IoBinding(pPars->session);
+
+	// Bind the input tensor as the view of the persistent input buffer
+	std::array<int64_t, 4> inputDims{ nBatch, 3, m_nNetInputH, m_nNetInputW };
+	pNewSlot->inputTensor = Ort::Value::CreateTensor<float>(pPars->memoryInfo,
+		pPars->m_vInputBuffer.data(),
+		(size_t)nBatch * 3 * m_nNetInputH * m_nNetInputW,
+		inputDims.data(),
+		inputDims.size());
+	pNewSlot->ioBinding.BindInput(pPars->m_vInputNames[0], pNewSlot->inputTensor);
+
+	// Bind the output tensors as the views of the persistent output buffers
+	for (size_t i = 0; i < m_vNetOuputNodeDims.size(); i++)
+	{
+		std::vector<int64_t> vOutputDims = m_vNetOuputNodeDims[i];
+		vOutputDims[0] = nBatch;
+
+		pNewSlot->vOutputTensors.push_back(Ort::Value::CreateTensor<float>(pPars->memoryInfo,
+			pPars->m_vOutputBuffers[i].data(),
+			nBatch * pPars->m_vOutputImageSizes[i],
+			vOutputDims.data(),
+			vOutputDims.size()));
+		pNewSlot->ioBinding.BindOutput(pPars->m_vOutputNames[i], pNewSlot->vOutputTensors.back());
+	}
+	pNewSlot->nImageStride = pPars->m_vOutputImageSizes[0];
+
+	pSlot = std::move(pNewSlot);
+	return pSlot.get();
+}
+
 // TODO: Implement the GPU device configuration in the future. Currently, only CPU is supported as requested by the client.
 // Read the onnx deep learning model
 // @param[in] sModelPath: path to the onnx model
 // @param[in] sPairedFilePath: path to the file paired with the onnx model. e.g., the config file or the class name file
-// @param[in] sLogID: log id of onnxruntime
+// @param[in] sLogID: log id of the onnxruntime session
 // @return: true if success, otherwise false
 bool CORTInferer::ReadModel(const std::string& sModelPath, const std::string& sPairedFilePath/* = ""*/, const std::string& sLogID /*= "onnxruntime"*/)
 {
 	(void)sPairedFilePath;
 
 	try {
-		if(!m_pORTPars)
-			m_pORTPars = new CORTPars();
-
-
-		std::wstring sWideStr = std::wstring(sModelPath.begin(), sModelPath.end());
-
-		// Set log level and log id of onnxruntime
-		m_pORTPars->env = Ort::Env(OrtLoggingLevel::ORT_LOGGING_LEVEL_WARNING, sLogID.c_str());
-
-		// Initialise and set session options
-		m_pORTPars->sessionOptions = Ort::SessionOptions();
-		m_pORTPars->sessionOptions.SetExecutionMode(ExecutionMode::ORT_PARALLEL);
-		m_pORTPars->sessionOptions.EnableMemPattern();
-		m_pORTPars->sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
-		
-		// Generate the onnx optimised file path based on the original onnx model path
-		std::wstring sOptimisedModelPath = sWideStr;
-		sOptimisedModelPath.replace(sOptimisedModelPath.find(L".onnx"), 5, L"_optimised.onnx");
-		// If the optimised file exists, delete it
-		if (fs::exists(sOptimisedModelPath))
-			fs::remove(sOptimisedModelPath);
-
-		// Set the optimised file path
-		m_pORTPars->sessionOptions.SetOptimizedModelFilePath(sOptimisedModelPath.c_str());
-
-		// Add cuda provider if GPU is used
-		if(m_NetDetailsConfig.nDeviceID >= 0)
-		{
-			OrtCUDAProviderOptions cudaProviderOptions;
-			cudaProviderOptions.device_id = m_NetDetailsConfig.nDeviceID;
-			m_pORTPars->sessionOptions.AppendExecutionProvider_CUDA(cudaProviderOptions);
-		}
-		
-		// Initialise session with model
-		m_pORTPars->session = Ort::Session(m_pORTPars->env, sWideStr.c_str(), m_pORTPars->sessionOptions);
-
-		Ort::AllocatorWithDefaultOptions allocator;
-		
-		// Get input node dims and names
-		size_t nNumInputNodes = m_pORTPars->session.GetInputCount();
+		// Create or join the session pool of the model
+		if (!InitSessionPool(sModelPath, sLogID))
+			return false;
+
+		// Read the model information from one session of the pool
+		CORTSessionLease sessionLease(m_pSessionPool.get());
+		CORTPars* pPars = sessionLease.Get();
+		if (!pPars)
+			return false;
+
+		// Get input node dims
+		size_t nNumInputNodes = pPars->session.GetInputCount();
 		for (int i = 0; i < nNumInputNodes; i++)
 		{
-			auto inputName = m_pORTPars->session.GetInputNameAllocated(i, allocator);
-			m_pORTPars->m_vInputNamesPtr.push_back(std::move(inputName));
-			m_pORTPars->m_vInputNames.push_back(m_pORTPars->m_vInputNamesPtr.back().get());
-
-			Ort::TypeInfo inputTypeInfo = m_pORTPars->session.GetInputTypeInfo(i);
+			Ort::TypeInfo inputTypeInfo = pPars->session.GetInputTypeInfo(i);
 			auto inputDims = inputTypeInfo.GetTensorTypeAndShapeInfo().GetShape();
 			m_vNetInputNodeDims.push_back(inputDims);
 		}
 
-		// Get output node dims and names
-		size_t nNnumOutputNodes = m_pORTPars->session.GetOutputCount();
+		// Get output node dims
+		size_t nNnumOutputNodes = pPars->session.GetOutputCount();
 		for (int i = 0; i < nNnumOutputNodes; i++)
 		{
-			auto outputName = m_pORTPars->session.GetOutputNameAllocated(i, allocator);
-			m_pORTPars->m_vOutputNamesPtr.push_back(std::move(outputName));
-			m_pORTPars->m_vOutputNames.push_back(m_pORTPars->m_vOutputNamesPtr.back().get());
-
-
-			Ort::TypeInfo outputTypeInfo = m_pORTPars->session.GetOutputTypeInfo(i);
+			Ort::TypeInfo outputTypeInfo = pPars->session.GetOutputTypeInfo(i);
 			auto outputDims = outputTypeInfo.GetTensorTypeAndShapeInfo().GetShape();
 			m_vNetOuputNodeDims.push_back(outputDims);
 		}
 
 		// Get network basic info such as input size, output size, etc
+		// [Note] The batch dim of the model exported with the dynamic batch size is -1
+		m_nNetBatch = (m_vNetInputNodeDims[0][0] > 0) ? (int)m_vNetInputNodeDims[0][0] : -1;
 		m_nNetInputH = (int)m_vNetInputNodeDims[0][2];
 		m_nNetInputW = (int)m_vNetInputNodeDims[0][3];
 
@@ -185,6 +292,10 @@ bool CORTInferer::ReadModel(const std::string& sModelPath, const std::string& sP
 			m_nNetOutputs = (int)m_vNetOuputNodeDims[0][2];
 
 		m_nNetProposals = (int)m_vNetOuputNodeDims[0][1];
+
+		// Allocate and bind the persistent tensors in advance if io binding is enabled
+		if (!pPars->m_bBindingReady && !InitIoBinding(pPars))
+			return false;
 	}
 	catch (Ort::Exception& e)
 	{
@@ -202,75 +313,203 @@ bool CORTInferer::ReadModel(const std::string& sModelPath, const std::string& sP
 	return true;
 }
 
-// Core function for preprocessing the input image
-// @param[in] cvImg: input image to be preprocessed
-// @param[in] bSwapRB: whether to swap the R and B channels
-// @param[out] cvProcImg: preprocessed image
-void CORTInferer::PreProcessCore(const cv::Mat& cvImg, bool bSwapRB, cv::Mat& cvProcImg) const
+// Core function for postprocessing the output tensor
+// @param[in] pTensorData: output tensor data to be postprocessed
+// @return: pointer to the output data of the relevant image in the batch
+const void* CORTInferer::PostProcessCore(const void* pTensorData) const
+{
+	const ORTOutputData* pOutputData = (const ORTOutputData*)pTensorData;
+
+	Ort::Value& predictions = pOutputData->pvOutputTensors->at(0);
+
+	const float* pData = predictions.GetTensorMutableData<float>();
+
+	return (const void*)(pData + pOutputData->nBatchIdx * pOutputData->nImageStride);
+}
+
+// Validate the required parameters
+bool CORTInferer::Validate()
+{
+	if (!m_pSessionPool)
+		return false;
+
+	if (!CInferer::Validate())
+		return false;
+
+	// [Note] If the onnx model was exported without considering the batch size, the output node dims will be 2D
+	if (m_vNetOuputNodeDims[0].size() > 2 && m_nNetOutputs == 0)
+		return false;
+
+	return true;
+}
+
+// Initialise the session pool of the model. The first network of the model creates the sessions, and the others reuse them.
+// @param[in] sModelPath: path to the onnx model
+// @param[in] sLogID: log id of the onnxruntime session
+// @return: true if success, otherwise false
+bool CORTInferer::InitSessionPool(const std::string& sModelPath, const std::string& sLogID)
 {
-	// If all the std values are same, use the blobFromImage function directly
-	if(m_NetDetailsConfig.dNormStd0 == m_NetDetailsConfig.dNormStd1 && 
-		m_NetDetailsConfig.dNormStd0 == m_NetDetailsConfig.dNormStd2)
+	if (m_pSessionPool)
 	{
-		cvProcImg = cv::dnn::blobFromImage(
-			cvImg,
-			m_NetDetailsConfig.dNormStd0,
-			cv::Size(m_nNetInputW, m_nNetInputH),
-			cv::Scalar(m_NetDetailsConfig.dNormMean0, m_NetDetailsConfig.dNormMean1, m_NetDetailsConfig.dNormMean2),
-			bSwapRB);
+		m_pSessionPool->RemoveCapacity(m_NetDetailsConfig.nSessionPoolSize);
+		m_pSessionPool.reset();
 	}
-	else // Otherwise
+
+	m_pSessionPool = CORTSessionPool::GetShared(GetSessionPoolKey(sModelPath));
+	m_pSessionPool->AddCapacity(m_NetDetailsConfig.nSessionPoolSize);
+
+	std::lock_guard<std::mutex> lock(m_pSessionPool->GetInitMutex());
+	if (m_pSessionPool->IsInitialised())
+		return true;
+
+	std::wstring sWideStr = std::wstring(sModelPath.begin(), sModelPath.end());
+
+	// All the sessions share the process-wide environment
+	CORTRuntime& cRuntime = CORTRuntime::GetInstance();
+	const ORTRuntimeConfig& stRuntimeConfig = cRuntime.GetConfig();
+
+	// The optimised graph is cached in ORT format, so the later starts load it directly without running the optimiser.
+	// The cache is used for CPU only, since the graph optimised for the other execution providers may not be saved.
+	std::unique_ptr<CORTPars> pFirstPars;
+	if (stRuntimeConfig.bModelCache && m_NetDetailsConfig.nDeviceID < 0)
 	{
-		cv::Mat cvTmp = cv::Mat(cvImg.rows, cvImg.cols, CV_32FC3);
-		for (int y = 0; y < cvTmp.rows; y++)
+		CORTModelCache cModelCache(sModelPath, stRuntimeConfig.sModelCacheDir,
+			(int)GraphOptimizationLevel::ORT_ENABLE_EXTENDED, m_NetDetailsConfig.nDeviceID);
+
+		// Optimise the original model once and save the optimised graph into the cache.
+		// The session is kept as the first session of the pool, and the other sessions are created from the cache.
+		if (cModelCache.IsValid() && !cModelCache.Exists())
 		{
-			for (int x = 0; x < cvTmp.cols; x++)
-			{
-				cvTmp.at<cv::Vec3f>(y, x)[0] = (float)(cvImg.at<cv::Vec3b>(y, x)[0] - m_NetDetailsConfig.dNormMean0) * m_NetDetailsConfig.dNormStd0;
-				cvTmp.at<cv::Vec3f>(y, x)[1] = (float)(cvImg.at<cv::Vec3b>(y, x)[1] - m_NetDetailsConfig.dNormMean1) * m_NetDetailsConfig.dNormStd1;
-				cvTmp.at<cv::Vec3f>(y, x)[2] = (float)(cvImg.at<cv::Vec3b>(y, x)[2] - m_NetDetailsConfig.dNormMean2) * m_NetDetailsConfig.dNormStd2;
-			}
+			std::wstring sTempPath = std::wstring(cModelCache.GetTempPath().begin(), cModelCache.GetTempPath().end());
+
+			pFirstPars = std::make_unique<CORTPars>();
+			InitSessionOptions(pFirstPars->sessionOptions, sLogID, true);
+			pFirstPars->sessionOptions.AddConfigEntry("session.save_model_format", "ORT");
+			pFirstPars->sessionOptions.SetOptimizedModelFilePath(sTempPath.c_str());
+			pFirstPars->session = Ort::Session(cRuntime.GetEnv(), sWideStr.c_str(), pFirstPars->sessionOptions);
+
+			if (!cModelCache.Commit())
+				std::cout << "Failed to save the optimised model into the cache: " << cModelCache.GetCachePath() << std::endl;
 		}
 
-		cvProcImg = cv::dnn::blobFromImage(
-			cvTmp,
-			1.0,
-			cv::Size(m_nNetInputW, m_nNetInputH),
-			cv::Scalar(0, 0, 0),
-			bSwapRB);
+		if (cModelCache.Exists())
+		{
+			std::wstring sCachePath = std::wstring(cModelCache.GetCachePath().begin(), cModelCache.GetCachePath().end());
+
+			Ort::SessionOptions sessionOptions;
+			InitSessionOptions(sessionOptions, sLogID, false);
+			if (m_pSessionPool->Init(std::move(pFirstPars), sCachePath, true, std::move(sessionOptions)))
+				return true;
+
+			std::cout << "Failed to load the cached model, so the original model is used: " << cModelCache.GetCachePath() << std::endl;
+			cModelCache.Discard();
+		}
 	}
 
-	
+	Ort::SessionOptions sessionOptions;
+	InitSessionOptions(sessionOptions, sLogID, true);
+	return m_pSessionPool->Init(std::move(pFirstPars), sWideStr, false, std::move(sessionOptions));
 }
 
-const void* CORTInferer::PostProcessCore(const void* pTensorData) const
+// Get the key of the session pool. The networks of the same key share the sessions
+// @param[in] sModelPath: path to the onnx model
+// @return: the key made of the model path and the configuration affecting the sessions
+std::string CORTInferer::GetSessionPoolKey(const std::string& sModelPath) const
 {
-	std::vector<Ort::Value>& outputTensors = *(std::vector<Ort::Value>*)pTensorData;
+	const NetDetailsConfig& stConfig = m_NetDetailsConfig;
+	const ThreadingPolicy& stPolicy = stConfig.stThreading;
+
+	std::string sKey = sModelPath;
+	sKey += "|" + std::to_string(stConfig.nDeviceID);
+	sKey += "|" + std::to_string(stConfig.nMaxBatchSize);
+	sKey += "|" + std::to_string(stConfig.bIoBinding);
+	sKey += "|" + std::to_string(stPolicy.bOwnThreadPools);
+	sKey += "|" + std::to_string(stPolicy.nIntraOpThreads);
+	sKey += "|" + std::to_string(stPolicy.nInterOpThreads);
+	sKey += "|" + std::to_string(stPolicy.bParallelExecution);
+	sKey += "|" + std::to_string(stPolicy.bAllowSpinning);
+	sKey += "|" + std::to_string(stPolicy.nCPUAffinityMask);
+
+	return sKey;
+}
 
-	Ort::Value& predictions = outputTensors.at(0);
+// Initialise the session options with the settings of the network
+// @param[out] sessionOptions: session options to be initialised
+// @param[in] sLogID: log id of the onnxruntime session
+// @param[in] bOptimise: true: run the graph optimiser. false: disable it, for the model already optimised
+void CORTInferer::InitSessionOptions(Ort::SessionOptions& sessionOptions, const std::string& sLogID, bool bOptimise)
+{
+	sessionOptions = Ort::SessionOptions();
+	sessionOptions.SetLogId(sLogID.c_str());
 
-	const float* pData = predictions.GetTensorMutableData<float>();
+	// Execution mode and thread pools of the session
+	ApplyThreadingPolicy(sessionOptions);
+	sessionOptions.EnableMemPattern();
+	sessionOptions.SetGraphOptimizationLevel(bOptimise ?
+		GraphOptimizationLevel::ORT_ENABLE_EXTENDED : GraphOptimizationLevel::ORT_DISABLE_ALL);
 
-	return (const void*)pData;
+	// Add cuda provider if GPU is used
+	if (m_NetDetailsConfig.nDeviceID >= 0)
+	{
+		OrtCUDAProviderOptions cudaProviderOptions;
+		cudaProviderOptions.device_id = m_NetDetailsConfig.nDeviceID;
+		sessionOptions.AppendExecutionProvider_CUDA(cudaProviderOptions);
+	}
 }
 
-// Validate the required parameters
-bool CORTInferer::Validate()
+// Apply the threading policy of the network to the session options
+// @param[in/out] sessionOptions: session options
+// [Note] - The execution mode is always applied. The pool settings are applied only if the session creates its own pools,
+//          that is the policy requests its own pools or the runtime does not use the global pools.
+//        - Any pool setting other than the default, such as the thread counts or the affinity, requests the own pools,
+//          as it would be lost on the global pools.
+//        - The affinity pins each intra-op pool thread to one CPU of the mask in round-robin order.
+void CORTInferer::ApplyThreadingPolicy(Ort::SessionOptions& sessionOptions)
 {
-	if (!m_pORTPars)
-		return false;
+	const ThreadingPolicy& stPolicy = m_NetDetailsConfig.stThreading;
 
+	sessionOptions.SetExecutionMode(stPolicy.bParallelExecution ? ExecutionMode::ORT_PARALLEL : ExecutionMode::ORT_SEQUENTIAL);
 
-	if (m_nNetInputW == 0 || m_nNetInputH == 0)
-		return false;
+	// Use the global thread pools of the environment instead of creating the pools of this session
+	bool bOwnThreadPools = stPolicy.bOwnThreadPools || stPolicy.nIntraOpThreads > 0 || stPolicy.nInterOpThreads > 0 ||
+		!stPolicy.bAllowSpinning || stPolicy.nCPUAffinityMask != 0;
+	if (!bOwnThreadPools && CORTRuntime::GetInstance().GetConfig().bGlobalThreadPools)
+	{
+		sessionOptions.DisablePerSessionThreads();
+		return;
+	}
 
-	// [Note] If the onnx model was exported without considering the batch size, the output node dims will be 2D
-	if (m_vNetOuputNodeDims[0].size() > 2 && m_nNetOutputs == 0)
-		return false;
+	// CPUs of the affinity mask
+	std::vector<int> vCPUs;
+	for (int i = 0; i < 64; i++)
+	{
+		if (stPolicy.nCPUAffinityMask & (1ULL << i))
+			vCPUs.push_back(i);
+	}
 
-	if (m_nNetProposals == 0)
-		return false;
+	int nIntraOpThreads = stPolicy.nIntraOpThreads;
+	if (nIntraOpThreads <= 0 && !vCPUs.empty())
+		nIntraOpThreads = (int)vCPUs.size();
 
-	return true;
-}
+	if (nIntraOpThreads > 0)
+		sessionOptions.SetIntraOpNumThreads(nIntraOpThreads);
+	if (stPolicy.nInterOpThreads > 0)
+		sessionOptions.SetInterOpNumThreads(stPolicy.nInterOpThreads);
 
+	sessionOptions.AddConfigEntry("session.intra_op.allow_spinning", stPolicy.bAllowSpinning ? "1" : "0");
+	sessionOptions.AddConfigEntry("session.inter_op.allow_spinning", stPolicy.bAllowSpinning ? "1" : "0");
+
+	// The calling thread works as the first intra-op thread, so the pool has nIntraOpThreads - 1 threads.
+	// The affinity string lists the processors of each pool thread separated by ';', and the processor ids start from 1.
+	if (!vCPUs.empty() && nIntraOpThreads > 1)
+	{
+		std::string sAffinities;
+		for (int i = 1; i < nIntraOpThreads; i++)
+		{
+			if (!sAffinities.empty())
+				sAffinities += ";";
+			sAffinities += std::to_string(vCPUs[i % vCPUs.size()] + 1);
+		}
+		sessionOptions.AddConfigEntry("session.intra_op_thread_affinities", sAffinities.c_str());
+	}
+}
@@ -0,0 +1,487 @@
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include "CORTInitializers.h"
+#include "type_define.h"
+
+// Field numbers of the onnx protobuf messages
+#define ONNX_MODEL_GRAPH			7		// ModelProto.graph
+#define ONNX_GRAPH_INITIALIZER		5		// GraphProto.initializer
+#define ONNX_TENSOR_DIMS			1		// TensorProto.dims
+#define ONNX_TENSOR_DATA_TYPE		2		// TensorProto.data_type
+#define ONNX_TENSOR_NAME			8		// TensorProto.name
+#define ONNX_TENSOR_RAW_DATA		9		// TensorProto.raw_data
+#define ONNX_TENSOR_DATA_LOCATION	14		// TensorProto.data_location
+
+// Field indices of the ORT format flatbuffer tables
+#define ORT_SESSION_MODEL			1		// InferenceSession.model
+#define ORT_MODEL_GRAPH				7		// Model.graph
+#define ORT_GRAPH_INITIALIZERS		0		// Graph.initializers
+#define ORT_TENSOR_NAME				0		// Tensor.name
+#define ORT_TENSOR_DIMS				2		// Tensor.dims
+#define ORT_TENSOR_DATA_TYPE		3		// Tensor.data_type
+#define ORT_TENSOR_RAW_DATA			4		// Tensor.raw_data
+#define ORT_TENSOR_EXTERNAL_OFFSET	6		// Tensor.external_data_offset
+
+// Get the size of an element of the onnx data type
+// @param[in] nDataType: onnx data type
+// @return: size in bytes. 0 if the type is not shared, such as the strings
+static size_t GetElementSize(int nDataType)
+{
+	switch (nDataType)
+	{
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_BOOL:
+		return 1;
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT16:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16:
+		return 2;
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT32:
+		return 4;
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT64:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+// Read a varint of the protobuf
+// @param[in/out] p: position of the varint. Moved past it
+// @param[in] pEnd: end of the message
+// @param[out] nValue: value of the varint
+// @return: true if success, otherwise false
+static bool ReadVarint(const uint8_t*& p, const uint8_t* pEnd, uint64_t& nValue)
+{
+	nValue = 0;
+	for (int nShift = 0; nShift < 64 && p < pEnd; nShift += 7)
+	{
+		uint8_t nByte = *p++;
+		nValue |= (uint64_t)(nByte & 0x7F) << nShift;
+		if (!(nByte & 0x80))
+			return true;
+	}
+
+	return false;
+}
+
+// Read the key of a protobuf field, and the payload of the length-delimited field
+// @param[in/out] p: position of the field. Moved past it
+// @param[in] pEnd: end of the message
+// @param[out] nField: field number
+// @param[out] nWireType: wire type
+// @param[out] nValue: value of the varint field
+// @param[out] pPayload: payload of the length-delimited field
+// @param[out] nPayload: size of the payload
+// @return: true if success, otherwise false
+static bool ReadField(const uint8_t*& p, const uint8_t* pEnd, uint32_t& nField, uint32_t& nWireType, uint64_t& nValue,
+	const uint8_t*& pPayload, size_t& nPayload)
+{
+	uint64_t nKey = 0;
+	if (!ReadVarint(p, pEnd, nKey))
+		return false;
+
+	nField = (uint32_t)(nKey >> 3);
+	nWireType = (uint32_t)(nKey & 7);
+	nValue = 0;
+	pPayload = nullptr;
+	nPayload = 0;
+
+	switch (nWireType)
+	{
+	case 0:		// varint
+		return ReadVarint(p, pEnd, nValue);
+	case 1:		// 64-bit
+		if (pEnd - p < 8)
+			return false;
+		p += 8;
+		return true;
+	case 2:		// length-delimited
+		if (!ReadVarint(p, pEnd, nValue) || nValue > (uint64_t)(pEnd - p))
+			return false;
+		pPayload = p;
+		nPayload = (size_t)nValue;
+		p += nPayload;
+		return true;
+	case 5:		// 32-bit
+		if (pEnd - p < 4)
+			return false;
+		p += 4;
+		return true;
+	default:	// The groups are not used by onnx
+		return false;
+	}
+}
+
+// Table of the ORT format flatbuffer
+typedef struct _FlatTable
+{
+	const uint8_t*	pBase;		// start of the buffer
+	size_t			nSize;		// size of the buffer
+	size_t			nTable;		// position of the table
+	const uint8_t*	pVTable;	// vtable of the table
+	uint16_t		nVTable;	// size of the vtable
+
+	// Get the position of a field
+	// @param[in] nIndex: field index
+	// @return: position of the field. 0 if the field is not set
+	size_t Field(int nIndex) const
+	{
+		size_t nEntry = 4 + (size_t)nIndex * 2;
+		if (nEntry + 2 > nVTable)
+			return 0;
+
+		uint16_t nOffset = 0;
+		memcpy(&nOffset, pVTable + nEntry, 2);
+		return nOffset ? nTable + nOffset : 0;
+	}
+}FlatTable;
+
+// Read a 32-bit unsigned integer of the flatbuffer
+// @param[in] pBase: start of the buffer
+// @param[in] nSize: size of the buffer
+// @param[in] nPos: position of the integer
+// @param[out] nValue: value
+// @return: true if success, otherwise false
+static bool ReadU32(const uint8_t* pBase, size_t nSize, size_t nPos, uint32_t& nValue)
+{
+	if (nPos > nSize || nSize - nPos < 4)
+		return false;
+
+	memcpy(&nValue, pBase + nPos, 4);
+	return true;
+}
+
+// Open the flatbuffer table at the given position
+// @param[in] pBase: start of the buffer
+// @param[in] nSize: size of the buffer
+// @param[in] nTable: position of the table
+// @param[out] stTable: table
+// @return: true if success, otherwise false
+static bool OpenTable(const uint8_t* pBase, size_t nSize, size_t nTable, FlatTable& stTable)
+{
+	int32_t nVTableOffset = 0;
+	if (nTable > nSize || nSize - nTable < 4)
+		return false;
+	memcpy(&nVTableOffset, pBase + nTable, 4);
+
+	int64_t nVTable = (int64_t)nTable - nVTableOffset;
+	if (nVTable < 0 || (uint64_t)nVTable + 4 > nSize)
+		return false;
+
+	stTable.pBase = pBase;
+	stTable.nSize = nSize;
+	stTable.nTable = nTable;
+	stTable.pVTable = pBase + nVTable;
+	memcpy(&stTable.nVTable, stTable.pVTable, 2);
+
+	return (uint64_t)nVTable + stTable.nVTable <= nSize;
+}
+
+// Follow the offset field of the table to the referenced table, vector or string
+// @param[in] stTable: table
+// @param[in] nIndex: field index
+// @param[out] nTarget: position of the referenced object
+// @return: true if the field is set and valid, otherwise false
+static bool FollowField(const FlatTable& stTable, int nIndex, size_t& nTarget)
+{
+	size_t nField = stTable.Field(nIndex);
+	uint32_t nOffset = 0;
+	if (!nField || !ReadU32(stTable.pBase, stTable.nSize, nField, nOffset))
+		return false;
+
+	nTarget = nField + nOffset;
+	return nTarget < stTable.nSize;
+}
+
+// Get the elements of the flatbuffer vector
+// @param[in] pBase: start of the buffer
+// @param[in] nSize: size of the buffer
+// @param[in] nVector: position of the vector
+// @param[in] nElementSize: size of an element
+// @param[out] nCount: number of the elements
+// @return: true if the vector fits in the buffer, otherwise false
+static bool ReadVector(const uint8_t* pBase, size_t nSize, size_t nVector, size_t nElementSize, uint32_t& nCount)
+{
+	if (!ReadU32(pBase, nSize, nVector, nCount))
+		return false;
+
+	return (uint64_t)nCount * nElementSize <= nSize - nVector - 4;
+}
+
+CORTInitializers::CORTInitializers()
+	: m_nBytes(0)
+{
+}
+
+CORTInitializers::~CORTInitializers()
+{
+	Clear();
+}
+
+// Read the initializers of the model
+// @param[in] vModelBytes: bytes of the model
+// @param[in] bORTFormat: whether the model is in ORT format or not
+// @return: true if the model is parsed successfully, otherwise false
+bool CORTInitializers::Read(const std::vector<char>& vModelBytes, bool bORTFormat)
+{
+	Clear();
+
+	try {
+		m_memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+
+		const uint8_t* pData = (const uint8_t*)vModelBytes.data();
+		bool bRead = bORTFormat ? ReadOrt(pData, vModelBytes.size()) : ReadOnnx(pData, vModelBytes.size());
+		if (!bRead)
+			Clear();
+
+		return bRead;
+	}
+	catch (Ort::Exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+		Clear();
+		return false;
+	}
+}
+
+// Add the initializers to the session options
+// @param[in/out] sessionOptions: session options of the sessions sharing the initializers
+// [Note] The initializers must outlive the sessions created with the options.
+void CORTInitializers::AddTo(Ort::SessionOptions& sessionOptions) const
+{
+	for (size_t i = 0; i < m_vValues.size(); i++)
+		sessionOptions.AddInitializer(m_vNames[i].c_str(), m_vValues[i]);
+}
+
+// Release the initializers
+void CORTInitializers::Clear()
+{
+	m_vValues.clear();
+	m_vNames.clear();
+	m_vBuffers.clear();
+	m_nBytes = 0;
+}
+
+// Read the initializers of the onnx model from the protobuf
+// @param[in] pData: bytes of the model
+// @param[in] nSize: number of bytes
+// @return: true if the model is parsed successfully, otherwise false
+bool CORTInitializers::ReadOnnx(const uint8_t* pData, size_t nSize)
+{
+	uint32_t nField = 0, nWireType = 0;
+	uint64_t nValue = 0;
+	const uint8_t* pPayload = nullptr;
+	size_t nPayload = 0;
+
+	// Find the graph of the model
+	const uint8_t* pGraph = nullptr;
+	size_t nGraph = 0;
+	for (const uint8_t* p = pData; p < pData + nSize;)
+	{
+		if (!ReadField(p, pData + nSize, nField, nWireType, nValue, pPayload, nPayload))
+			return false;
+
+		if (nField == ONNX_MODEL_GRAPH && nWireType == 2)
+		{
+			pGraph = pPayload;
+			nGraph = nPayload;
+		}
+	}
+
+	if (!pGraph)
+		return false;
+
+	for (const uint8_t* p = pGraph; p < pGraph + nGraph;)
+	{
+		if (!ReadField(p, pGraph + nGraph, nField, nWireType, nValue, pPayload, nPayload))
+			return false;
+
+		if (nField != ONNX_GRAPH_INITIALIZER || nWireType != 2)
+			continue;
+
+		// Read the tensor of the initializer
+		std::string sName;
+		std::vector<int64_t> vDims;
+		int nDataType = 0;
+		bool bExternal = false;
+		const uint8_t* pRawData = nullptr;
+		size_t nRawData = 0;
+
+		const uint8_t* pTensorEnd = pPayload + nPayload;
+		for (const uint8_t* q = pPayload; q < pTensorEnd;)
+		{
+			const uint8_t* pField = nullptr;
+			size_t nFieldSize = 0;
+			if (!ReadField(q, pTensorEnd, nField, nWireType, nValue, pField, nFieldSize))
+				return false;
+
+			if (nField == ONNX_TENSOR_DIMS && nWireType == 0)
+			{
+				vDims.push_back((int64_t)nValue);
+			}
+			else if (nField == ONNX_TENSOR_DIMS && nWireType == 2)
+			{
+				// Packed dims
+				for (const uint8_t* r = pField; r < pField + nFieldSize;)
+				{
+					uint64_t nDim = 0;
+					if (!ReadVarint(r, pField + nFieldSize, nDim))
+						return false;
+					vDims.push_back((int64_t)nDim);
+				}
+			}
+			else if (nField == ONNX_TENSOR_DATA_TYPE && nWireType == 0)
+			{
+				nDataType = (int)nValue;
+			}
+			else if (nField == ONNX_TENSOR_NAME && nWireType == 2)
+			{
+				sName.assign((const char*)pField, nFieldSize);
+			}
+			else if (nField == ONNX_TENSOR_RAW_DATA && nWireType == 2)
+			{
+				pRawData = pField;
+				nRawData = nFieldSize;
+			}
+			else if (nField == ONNX_TENSOR_DATA_LOCATION && nWireType == 0)
+			{
+				bExternal = (nValue != 0);
+			}
+		}
+
+		// The raw data in the protobuf is not aligned, so it is copied
+		if (!bExternal && pRawData)
+			AddTensor(sName, nDataType, vDims, pRawData, nRawData, true);
+	}
+
+	return true;
+}
+
+// Read the initializers of the ORT format model from the flatbuffer
+// @param[in] pData: bytes of the model
+// @param[in] nSize: number of bytes
+// @return: true if the model is parsed successfully, otherwise false
+bool CORTInitializers::ReadOrt(const uint8_t* pData, size_t nSize)
+{
+	// The root table offset is followed by the file identifier
+	uint32_t nRoot = 0;
+	if (!ReadU32(pData, nSize, 0, nRoot) || nSize < 8 || memcmp(pData + 4, "ORTM", 4) != 0)
+		return false;
+
+	FlatTable stSession, stModel, stGraph;
+	size_t nModel = 0, nGraph = 0, nInitializers = 0;
+	if (!OpenTable(pData, nSize, nRoot, stSession) ||
+		!FollowField(stSession, ORT_SESSION_MODEL, nModel) || !OpenTable(pData, nSize, nModel, stModel) ||
+		!FollowField(stModel, ORT_MODEL_GRAPH, nGraph) || !OpenTable(pData, nSize, nGraph, stGraph))
+		return false;
+
+	// The model without initializers
+	if (!FollowField(stGraph, ORT_GRAPH_INITIALIZERS, nInitializers))
+		return true;
+
+	uint32_t nCount = 0;
+	if (!ReadVector(pData, nSize, nInitializers, 4, nCount))
+		return false;
+
+	for (uint32_t i = 0; i < nCount; i++)
+	{
+		size_t nElement = nInitializers + 4 + (size_t)i * 4;
+		uint32_t nOffset = 0;
+		FlatTable stTensor;
+		if (!ReadU32(pData, nSize, nElement, nOffset) || !OpenTable(pData, nSize, nElement + nOffset, stTensor))
+			return false;
+
+		// The data kept out of the model bytes is not shared
+		size_t nExternal = stTensor.Field(ORT_TENSOR_EXTERNAL_OFFSET);
+		int64_t nExternalOffset = -1;
+		if (nExternal)
+		{
+			if (nExternal + 8 > nSize)
+				return false;
+			memcpy(&nExternalOffset, pData + nExternal, 8);
+		}
+
+		size_t nName = 0, nDims = 0, nRawData = 0;
+		if (nExternalOffset >= 0 || !FollowField(stTensor, ORT_TENSOR_NAME, nName) ||
+			!FollowField(stTensor, ORT_TENSOR_RAW_DATA, nRawData))
+			continue;
+
+		uint32_t nNameLen = 0, nDimCount = 0, nRawLen = 0;
+		if (!ReadVector(pData, nSize, nName, 1, nNameLen) || !ReadVector(pData, nSize, nRawData, 1, nRawLen))
+			return false;
+
+		std::vector<int64_t> vDims;
+		if (FollowField(stTensor, ORT_TENSOR_DIMS, nDims))
+		{
+			if (!ReadVector(pData, nSize, nDims, 8, nDimCount))
+				return false;
+
+			vDims.resize(nDimCount);
+			memcpy(vDims.data(), pData + nDims + 4, (size_t)nDimCount * 8);
+		}
+
+		int32_t nDataType = 0;
+		size_t nType = stTensor.Field(ORT_TENSOR_DATA_TYPE);
+		if (nType)
+		{
+			if (nType + 4 > nSize)
+				return false;
+			memcpy(&nDataType, pData + nType, 4);
+		}
+
+		// The data is used from the model bytes directly as the sessions do, unless it is not aligned to the element
+		const uint8_t* pRawData = pData + nRawData + 4;
+		size_t nElementSize = _MAX((size_t)1, GetElementSize(nDataType));
+		bool bCopy = ((uintptr_t)pRawData % nElementSize) != 0;
+		AddTensor(std::string((const char*)pData + nName + 4, nNameLen), nDataType, vDims, pRawData, nRawLen, bCopy);
+	}
+
+	return true;
+}
+
+// Add an initializer. It is skipped if the data does not match the shape and the type
+// @param[in] sName: name of the initializer
+// @param[in] nDataType: onnx data type of the elements
+// @param[in] vDims: shape of the initializer
+// @param[in] pData: raw data of the elements
+// @param[in] nBytes: size of the raw data in bytes
+// @param[in] bCopy: true: copy the data. false: use the data directly
+void CORTInitializers::AddTensor(const std::string& sName, int nDataType, const std::vector<int64_t>& vDims, const uint8_t* pData,
+	size_t nBytes, bool bCopy)
+{
+	size_t nElementSize = GetElementSize(nDataType);
+	if (sName.empty() || nElementSize == 0 || nBytes == 0)
+		return;
+
+	size_t nElements = 1;
+	for (int64_t nDim : vDims)
+	{
+		if (nDim < 0)
+			return;
+		nElements *= (size_t)nDim;
+	}
+
+	if (nElements * nElementSize != nBytes)
+		return;
+
+	void* pTensorData = (void*)pData;
+	if (bCopy)
+	{
+		m_vBuffers.emplace_back((nBytes + 7) / 8);
+		memcpy(m_vBuffers.back().data(), pData, nBytes);
+		pTensorData = m_vBuffers.back().data();
+	}
+
+	m_vValues.push_back(Ort::Value::CreateTensor(m_memoryInfo, pTensorData, nBytes, vDims.data(), vDims.size(),
+		(ONNXTensorElementDataType)nDataType));
+	m_vNames.push_back(sName);
+	m_nBytes += nBytes;
+}
@@ -0,0 +1,209 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <cstring>
+#include <onnxruntime_cxx_api.h>
+#include <opencv2/opencv.hpp>
+#include "CORTModelCache.h"
+
+namespace fs = std::filesystem;
+
+// FNV-1a 64-bit constants
+#define FNV_OFFSET_BASIS	0xCBF29CE484222325ULL
+#define FNV_PRIME			0x00000100000001B3ULL
+
+// Size of the chunk read from the model file at once
+#define HASH_CHUNK_SIZE		(1 << 20)
+
+// Version of the cache layout. Increase it if the way of building the cached model changes
+#define MODEL_CACHE_VERSION	1
+
+// Constructor
+// @param[in] sModelPath: path to the original onnx model
+// @param[in] sCacheDir: directory of the cache. If empty, ORT_MODEL_CACHE_DIR_NAME next to the model is used
+// @param[in] nOptLevel: graph optimisation level used to optimise the model
+// @param[in] nDeviceID: device id of the execution provider. -1 means CPU
+CORTModelCache::CORTModelCache(const std::string& sModelPath, const std::string& sCacheDir, int nOptLevel, int nDeviceID)
+	: m_bValid(false)
+{
+	try {
+		fs::path modelPath(sModelPath);
+		m_sModelStem = modelPath.stem().string();
+		m_sCacheDir = sCacheDir.empty() ? (modelPath.parent_path() / ORT_MODEL_CACHE_DIR_NAME).string() : sCacheDir;
+
+		uint64_t nHash = 0;
+		if (!HashFile(sModelPath, nHash))
+			return;
+
+		int nCacheVersion = MODEL_CACHE_VERSION;
+		std::string sORTVersion = Ort::GetVersionString();
+		uint64_t nCPUFeatures = GetCPUFeatures();
+
+		HashBytes(nHash, &nCacheVersion, sizeof(nCacheVersion));
+		HashBytes(nHash, sORTVersion.data(), sORTVersion.size());
+		HashBytes(nHash, &nOptLevel, sizeof(nOptLevel));
+		HashBytes(nHash, &nDeviceID, sizeof(nDeviceID));
+		HashBytes(nHash, &nCPUFeatures, sizeof(nCPUFeatures));
+
+		char szKey[17];
+		snprintf(szKey, sizeof(szKey), "%016llx", (unsigned long long)nHash);
+
+		m_sCachePath = (fs::path(m_sCacheDir) / (m_sModelStem + "_" + szKey + ".ort")).string();
+
+		// The temporary file is unique for each writer, so the concurrent starts do not write the same file
+		std::random_device rd;
+		char szTag[9];
+		snprintf(szTag, sizeof(szTag), "%08x", (unsigned int)rd());
+		m_sTempPath = m_sCachePath + "." + szTag + ".tmp";
+
+		std::error_code ec;
+		fs::create_directories(m_sCacheDir, ec);
+		if (ec)
+			return;
+
+		m_bValid = true;
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "Model cache error: " << e.what() << std::endl;
+		m_bValid = false;
+	}
+}
+
+CORTModelCache::~CORTModelCache()
+{
+
+}
+
+// Check whether the optimised model of the entry exists in the cache
+// @return: true if exists, otherwise false
+bool CORTModelCache::Exists() const
+{
+	if (!m_bValid)
+		return false;
+
+	std::error_code ec;
+	return fs::is_regular_file(m_sCachePath, ec) && fs::file_size(m_sCachePath, ec) > 0;
+}
+
+// Move the temporary model written by the session to the cache path, and remove the stale entries of the same model
+// @return: true if success, otherwise false
+// [Note] The rename is atomic, so the other processes never read the partially written model.
+bool CORTModelCache::Commit()
+{
+	if (!m_bValid)
+		return false;
+
+	std::error_code ec;
+	if (!fs::is_regular_file(m_sTempPath, ec))
+		return false;
+
+	fs::rename(m_sTempPath, m_sCachePath, ec);
+	if (ec)
+	{
+		// Another process may have committed the same entry in the meantime
+		fs::remove(m_sTempPath, ec);
+		return Exists();
+	}
+
+	// Remove the entries of the same model built with the old model bytes, runtime or CPU
+	std::string sPrefix = m_sModelStem + "_";
+	std::string sCacheName = fs::path(m_sCachePath).filename().string();
+	for (const auto& entry : fs::directory_iterator(m_sCacheDir, ec))
+	{
+		std::string sName = entry.path().filename().string();
+		if (sName == sCacheName || sName.rfind(sPrefix, 0) != 0)
+			continue;
+
+		// The key has 16 hex digits, so the other models whose name starts with this model name are not matched
+		if (sName.size() != sPrefix.size() + 16 + 4 || entry.path().extension() != ".ort")
+			continue;
+
+		std::error_code ecRemove;
+		fs::remove(entry.path(), ecRemove);
+	}
+
+	return true;
+}
+
+// Remove the cached and temporary models of the entry. It is used when the cached model fails to be loaded.
+void CORTModelCache::Discard()
+{
+	if (!m_bValid)
+		return;
+
+	std::error_code ec;
+	fs::remove(m_sCachePath, ec);
+	fs::remove(m_sTempPath, ec);
+}
+
+// Hash the bytes of the file
+// @param[in] sPath: path to the file
+// @param[out] nHash: 64-bit FNV-1a style hash of the file
+// @return: true if success, otherwise false
+bool CORTModelCache::HashFile(const std::string& sPath, uint64_t& nHash)
+{
+	std::ifstream file(sPath, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	nHash = FNV_OFFSET_BASIS;
+
+	std::vector<char> vChunk(HASH_CHUNK_SIZE);
+	while (file)
+	{
+		file.read(vChunk.data(), vChunk.size());
+		std::streamsize nRead = file.gcount();
+		if (nRead <= 0)
+			break;
+
+		HashBytes(nHash, vChunk.data(), (size_t)nRead);
+	}
+
+	return !file.bad();
+}
+
+// Combine the value into the hash
+// @param[in/out] nHash: 64-bit FNV-1a style hash
+// @param[in] pData: data to be combined
+// @param[in] nSize: size of the data in bytes
+// [Note] The data is combined in 64-bit words rather than bytes, which is 8 times faster for the large models.
+void CORTModelCache::HashBytes(uint64_t& nHash, const void* pData, size_t nSize)
+{
+	const unsigned char* pBytes = (const unsigned char*)pData;
+
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= nSize; i += sizeof(uint64_t))
+	{
+		uint64_t nWord;
+		memcpy(&nWord, pBytes + i, sizeof(nWord));
+		nHash ^= nWord;
+		nHash *= FNV_PRIME;
+	}
+
+	for (; i < nSize; i++)
+	{
+		nHash ^= pBytes[i];
+		nHash *= FNV_PRIME;
+	}
+}
+
+// Get the bitmask of the CPU features that affect the kernels selected by the optimiser
+// @return: bitmask of the CPU features
+uint64_t CORTModelCache::GetCPUFeatures()
+{
+	static const int s_vFeatures[] = {
+		CV_CPU_SSE4_1, CV_CPU_SSE4_2, CV_CPU_AVX, CV_CPU_FP16, CV_CPU_AVX2, CV_CPU_FMA3,
+		CV_CPU_AVX_512F, CV_CPU_AVX512_SKX, CV_CPU_AVX_512VNNI, CV_CPU_NEON, CV_CPU_NEON_DOTPROD
+	};
+
+	uint64_t nFeatures = 0;
+	for (int i = 0; i < (int)(sizeof(s_vFeatures) / sizeof(s_vFeatures[0])); i++)
+	{
+		if (cv::checkHardwareSupport(s_vFeatures[i]))
+			nFeatures |= (1ULL << i);
+	}
+
+	return nFeatures;
+}
@@ -0,0 +1,77 @@
+#include <iostream>
+#include <onnxruntime_cxx_api.h>
+#include "CORTRuntime.h"
+
+CORTRuntime::CORTRuntime()
+	: m_pEnv(nullptr)
+{
+
+}
+
+CORTRuntime::~CORTRuntime()
+{
+	if (m_pEnv)
+	{
+		delete m_pEnv;	m_pEnv = nullptr;
+	}
+}
+
+// Get the singleton instance
+// @return: the process-wide runtime instance
+CORTRuntime& CORTRuntime::GetInstance()
+{
+	static CORTRuntime s_cRuntime;
+	return s_cRuntime;
+}
+
+// Configure the runtime
+// @param[in] stConfig: runtime configuration
+// @return: true if success, otherwise false
+// [Note] The configuration can only be changed before the environment is created, that is, before the first model is read.
+bool CORTRuntime::Configure(const ORTRuntimeConfig& stConfig)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_pEnv)
+	{
+		std::cout << "The onnxruntime environment has been created already. The runtime configuration is ignored." << std::endl;
+		return false;
+	}
+
+	m_stConfig = stConfig;
+	return true;
+}
+
+// Get the runtime configuration
+// @return: the runtime configuration
+const ORTRuntimeConfig& CORTRuntime::GetConfig() const
+{
+	return m_stConfig;
+}
+
+// Get the shared onnxruntime environment. It is created with the current configuration at the first call.
+// @return: the onnxruntime environment
+Ort::Env& CORTRuntime::GetEnv()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_pEnv)
+		return *m_pEnv;
+
+	if (m_stConfig.bGlobalThreadPools)
+	{
+		// Create the global thread pools shared by all the sessions
+		Ort::ThreadingOptions threadingOptions;
+		threadingOptions.SetGlobalIntraOpNumThreads(_MAX(0, m_stConfig.nIntraOpThreads));
+		threadingOptions.SetGlobalInterOpNumThreads(_MAX(0, m_stConfig.nInterOpThreads));
+		threadingOptions.SetGlobalSpinControl(m_stConfig.bAllowSpinning ? 1 : 0);
+
+		m_pEnv = new Ort::Env(threadingOptions, OrtLoggingLevel::ORT_LOGGING_LEVEL_WARNING, "iAICommonLib");
+	}
+	else
+	{
+		m_pEnv = new Ort::Env(OrtLoggingLevel::ORT_LOGGING_LEVEL_WARNING, "iAICommonLib");
+	}
+
+	return *m_pEnv;
+}
@@ -0,0 +1,270 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include "CORTSessionPool.h"
+#include "CORTRuntime.h"
+
+namespace fs = std::filesystem;
+
+std::mutex CORTSessionPool::s_registryMutex;
+std::map<std::string, std::weak_ptr<CORTSessionPool>> CORTSessionPool::s_mapRegistry;
+
+CORTSessionPool::CORTSessionPool()
+	: m_bInitialised(false)
+	, m_nCapacity(0)
+	, m_nCreating(0)
+	, m_bORTFormat(false)
+	, m_pPrepackedWeights(nullptr)
+{
+}
+
+CORTSessionPool::~CORTSessionPool()
+{
+	// The sessions must be released before the model bytes, the initializers and the prepacked weights they use
+	m_vAvailable.clear();
+	m_vSessions.clear();
+
+	if (m_pPrepackedWeights) Ort::GetApi().ReleasePrepackedWeightsContainer(m_pPrepackedWeights);
+	m_pPrepackedWeights = nullptr;
+	m_initializers.Clear();
+}
+
+// Get the pool shared by the networks of the given key. It is created at the first call of the key.
+// @param[in] sKey: key of the model and configuration of the networks
+// @return: the shared pool
+// [Note] The pool is released when the last network of the key releases it.
+std::shared_ptr<CORTSessionPool> CORTSessionPool::GetShared(const std::string& sKey)
+{
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+
+	std::shared_ptr<CORTSessionPool> pPool = s_mapRegistry[sKey].lock();
+	if (!pPool)
+	{
+		pPool = std::make_shared<CORTSessionPool>();
+		s_mapRegistry[sKey] = pPool;
+	}
+
+	// Remove the entries of the released pools
+	for (auto it = s_mapRegistry.begin(); it != s_mapRegistry.end();)
+	{
+		if (it->second.expired())
+			it = s_mapRegistry.erase(it);
+		else
+			++it;
+	}
+
+	return pPool;
+}
+
+// Add the sessions of one network to the capacity of the pool
+// @param[in] nSessions: number of sessions. It is at least 1
+void CORTSessionPool::AddCapacity(int nSessions)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_nCapacity += _MAX(1, nSessions);
+	m_cvAvailable.notify_all();
+}
+
+// Remove the sessions of one network from the capacity of the pool
+// @param[in] nSessions: number of sessions given to AddCapacity()
+void CORTSessionPool::RemoveCapacity(int nSessions)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_nCapacity = _MAX(0, m_nCapacity - _MAX(1, nSessions));
+
+	// Release the idle sessions over the capacity
+	while ((int)m_vSessions.size() > _MAX(1, m_nCapacity) && !m_vAvailable.empty())
+	{
+		CORTPars* pPars = m_vAvailable.back();
+		m_vAvailable.pop_back();
+
+		for (auto it = m_vSessions.begin(); it != m_vSessions.end(); ++it)
+		{
+			if (it->get() == pPars)
+			{
+				m_vSessions.erase(it);
+				break;
+			}
+		}
+	}
+}
+
+// Initialise the pool and create the first session
+// @param[in] pFirstPars: first session created by the caller. If nullptr, the first session is created by the pool
+//                        It is released and created again if the pool shares the initializers, as it holds its own weights
+// @param[in] sModelPath: path to the model that the sessions of the pool are created from
+// @param[in] bORTFormat: whether the model is in ORT format or not
+// @param[in] sessionOptions: session options of the sessions of the pool
+// @return: true if success, otherwise false
+bool CORTSessionPool::Init(std::unique_ptr<CORTPars> pFirstPars, const std::wstring& sModelPath, bool bORTFormat,
+	Ort::SessionOptions&& sessionOptions)
+{
+	try {
+		m_sModelPath = sModelPath;
+		m_bORTFormat = bORTFormat;
+		m_sessionOptions = std::move(sessionOptions);
+		m_vModelBytes.clear();
+
+		// Load the model bytes once. The ORT format sessions are created from them, and the initializers are read from them
+		std::ifstream file(fs::path(m_sModelPath), std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+			return false;
+
+		std::streamsize nSize = file.tellg();
+		file.seekg(0, std::ios::beg);
+		m_vModelBytes.resize((size_t)nSize);
+		if (!file.read(m_vModelBytes.data(), nSize))
+			return false;
+
+		if (m_bORTFormat)
+		{
+			// Let all the sessions use the initializers in the bytes without copying them
+			m_sessionOptions.AddConfigEntry("session.load_model_format", "ORT");
+			m_sessionOptions.AddConfigEntry("session.use_ort_model_bytes_directly", "1");
+			m_sessionOptions.AddConfigEntry("session.use_ort_model_bytes_for_initializers", "1");
+		}
+
+		// onnxruntime shares the prepacked weights only for the shared initializers, so the initializers are shared first.
+		// The shared initializers of the onnx model are kept beside the prepacked weights, while a single session frees them
+		// after prepacking, so the onnx model is shared only by more than one session.
+		// The sessions still work with their own weights if the initializers cannot be read.
+		if (m_bORTFormat || m_nCapacity > 1)
+		{
+			if (m_initializers.Read(m_vModelBytes, m_bORTFormat) && m_initializers.GetCount() > 0)
+			{
+				m_initializers.AddTo(m_sessionOptions);
+				Ort::ThrowOnError(Ort::GetApi().CreatePrepackedWeightsContainer(&m_pPrepackedWeights));
+				pFirstPars.reset();
+			}
+			else
+			{
+				std::cout << "Failed to read the initializers, so the sessions do not share the weights" << std::endl;
+			}
+		}
+
+		// The onnx model is loaded by each session from the path, so its bytes are no longer needed
+		if (!m_bORTFormat)
+			std::vector<char>().swap(m_vModelBytes);
+
+		if (!pFirstPars)
+			pFirstPars = CreateSession();
+		else
+			ReadNames(pFirstPars.get());
+
+		if (!pFirstPars)
+			return false;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_vAvailable.push_back(pFirstPars.get());
+		m_vSessions.push_back(std::move(pFirstPars));
+		m_bInitialised = true;
+	}
+	catch (std::exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Check out a session. It waits until a session is available if all the sessions are in use and the pool is full.
+// @return: the session. nullptr if the pool is not initialised or the session fails to be created
+CORTPars* CORTSessionPool::Acquire()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (!m_bInitialised)
+		return nullptr;
+
+	while (true)
+	{
+		if (!m_vAvailable.empty())
+		{
+			CORTPars* pPars = m_vAvailable.back();
+			m_vAvailable.pop_back();
+			return pPars;
+		}
+
+		// Create a new session if the pool is not full. The creation runs without the lock, as it takes long
+		if ((int)m_vSessions.size() + m_nCreating < m_nCapacity)
+		{
+			m_nCreating++;
+			lock.unlock();
+			std::unique_ptr<CORTPars> pNewPars = CreateSession();
+			lock.lock();
+			m_nCreating--;
+
+			if (!pNewPars)
+				return nullptr;
+
+			CORTPars* pPars = pNewPars.get();
+			m_vSessions.push_back(std::move(pNewPars));
+			return pPars;
+		}
+
+		m_cvAvailable.wait(lock);
+	}
+}
+
+// Return the session checked out by Acquire()
+// @param[in] pPars: the session
+void CORTSessionPool::Release(CORTPars* pPars)
+{
+	if (!pPars)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_vAvailable.push_back(pPars);
+	}
+	m_cvAvailable.notify_one();
+}
+
+// Create a new session of the pool
+// @return: the session. nullptr if failed
+std::unique_ptr<CORTPars> CORTSessionPool::CreateSession()
+{
+	try {
+		std::unique_ptr<CORTPars> pPars = std::make_unique<CORTPars>();
+		Ort::Env& env = CORTRuntime::GetInstance().GetEnv();
+
+		if (m_bORTFormat)
+			pPars->session = Ort::Session(env, m_vModelBytes.data(), m_vModelBytes.size(), m_sessionOptions, m_pPrepackedWeights);
+		else
+			pPars->session = Ort::Session(env, m_sModelPath.c_str(), m_sessionOptions, m_pPrepackedWeights);
+
+		ReadNames(pPars.get());
+		return pPars;
+	}
+	catch (Ort::Exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+		return nullptr;
+	}
+}
+
+// Read the input and output names of the session
+// @param[in/out] pPars: the session
+void CORTSessionPool::ReadNames(CORTPars* pPars)
+{
+	pPars->m_vInputNamesPtr.clear();
+	pPars->m_vOutputNamesPtr.clear();
+	pPars->m_vInputNames.clear();
+	pPars->m_vOutputNames.clear();
+
+	size_t nNumInputNodes = pPars->session.GetInputCount();
+	for (size_t i = 0; i < nNumInputNodes; i++)
+	{
+		pPars->m_vInputNamesPtr.push_back(pPars->session.GetInputNameAllocated(i, pPars->allocator));
+		pPars->m_vInputNames.push_back(pPars->m_vInputNamesPtr.back().get());
+	}
+
+	size_t nNumOutputNodes = pPars->session.GetOutputCount();
+	for (size_t i = 0; i < nNumOutputNodes; i++)
+	{
+		pPars->m_vOutputNamesPtr.push_back(pPars->session.GetOutputNameAllocated(i, pPars->allocator));
+		pPars->m_vOutputNames.push_back(pPars->m_vOutputNamesPtr.back().get());
+	}
+}
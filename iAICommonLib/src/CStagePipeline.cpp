@@ -0,0 +1,141 @@
+#include "CStagePipeline.h"
+#include <iostream>
+#include <chrono>
+
+CStagePipeline::CStagePipeline(const std::vector<StageFunc>& vStages, int nQueueDepth)
+	: m_vStages(vStages)
+	, m_pProcessed(nullptr)
+	, m_pBusyUs(nullptr)
+	, m_nInFlight(0)
+{
+	int nStages = (int)m_vStages.size();
+	m_pProcessed = new std::atomic<uint64_t>[_MAX(1, nStages)];
+	m_pBusyUs = new std::atomic<uint64_t>[_MAX(1, nStages)];
+	for (int i = 0; i < nStages; i++)
+	{
+		m_pProcessed[i].store(0);
+		m_pBusyUs[i].store(0);
+		m_vQueues.push_back(new CSPSCQueue<void*>(_MAX(1, nQueueDepth)));
+	}
+
+	for (int i = 0; i < nStages; i++)
+		m_vWorkers.emplace_back(&CStagePipeline::StageLoop, this, i);
+}
+
+CStagePipeline::~CStagePipeline()
+{
+	// Closing the 1st queue lets each stage finish its items and close the queue of the next stage in turn
+	if (!m_vQueues.empty())
+		m_vQueues[0]->Close();
+
+	for (std::thread& worker : m_vWorkers)
+	{
+		if (worker.joinable())
+			worker.join();
+	}
+
+	for (CSPSCQueue<void*>*& pQueue : m_vQueues)
+	{
+		if (pQueue)
+			delete pQueue; pQueue = nullptr;
+	}
+
+	if (m_pProcessed)
+		delete[] m_pProcessed; m_pProcessed = nullptr;
+
+	if (m_pBusyUs)
+		delete[] m_pBusyUs; m_pBusyUs = nullptr;
+}
+
+// Submit an item to the 1st stage. It waits until the queue has room if the queue is full
+// @param[in] pItem: item to run
+// @return: true if the item is queued, false if the pipeline is stopping
+// [Note] It must be called from one thread at a time.
+bool CStagePipeline::Submit(void* pItem)
+{
+	if (m_vQueues.empty())
+		return false;
+
+	m_nInFlight.fetch_add(1);
+	if (!m_vQueues[0]->Push(pItem))
+	{
+		if (m_nInFlight.fetch_sub(1) == 1)
+			m_nInFlight.notify_all();
+		return false;
+	}
+
+	return true;
+}
+
+// Wait until all the submitted items leave the last stage
+void CStagePipeline::WaitIdle()
+{
+	int nInFlight = m_nInFlight.load();
+	while (nInFlight != 0)
+	{
+		m_nInFlight.wait(nInFlight);
+		nInFlight = m_nInFlight.load();
+	}
+}
+
+// Get the counters of the stages
+// @param[out] vStats: counters of each stage in the order of running
+void CStagePipeline::GetStats(std::vector<PipelineStageStats>& vStats) const
+{
+	vStats.clear();
+	for (int i = 0; i < (int)m_vStages.size(); i++)
+	{
+		vStats.push_back(PipelineStageStats(
+			m_vQueues[i]->GetSize(),
+			m_vQueues[i]->GetMaxSize(),
+			m_vQueues[i]->GetCapacity(),
+			m_pProcessed[i].load(),
+			(double)m_pBusyUs[i].load() / 1000.0));
+	}
+}
+
+// Main loop of the thread of a stage
+// @param[in] nStage: index of the stage
+void CStagePipeline::StageLoop(int nStage)
+{
+	CSPSCQueue<void*>* pInQueue = m_vQueues[nStage];
+	CSPSCQueue<void*>* pOutQueue = (nStage + 1 < (int)m_vQueues.size()) ? m_vQueues[nStage + 1] : nullptr;
+
+	void* pItem = nullptr;
+	while (pInQueue->Pop(pItem))
+	{
+		std::chrono::steady_clock::time_point tpStart = std::chrono::steady_clock::now();
+		try
+		{
+			m_vStages[nStage](pItem);
+		}
+		catch (std::exception& e)
+		{
+			const char* msg = e.what();
+			std::cout << msg << std::endl;
+		}
+		catch (...)
+		{
+			// The item still goes on, so the later stages and WaitIdle() do not wait for it forever
+			std::cout << "CStagePipeline: Unknown exception in stage " << nStage << std::endl;
+		}
+		std::chrono::steady_clock::time_point tpEnd = std::chrono::steady_clock::now();
+
+		m_pBusyUs[nStage].fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(tpEnd - tpStart).count());
+		m_pProcessed[nStage].fetch_add(1);
+
+		// The push waits while the next stage is behind, which holds back this stage and the ones in front of it
+		if (pOutQueue)
+		{
+			pOutQueue->Push(pItem);
+		}
+		else if (m_nInFlight.fetch_sub(1) == 1)
+		{
+			m_nInFlight.notify_all();
+		}
+	}
+
+	// The items are finished, so the next stage stops after finishing its own ones
+	if (pOutQueue)
+		pOutQueue->Close();
+}
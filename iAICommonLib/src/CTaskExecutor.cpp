@@ -0,0 +1,95 @@
+#include "CTaskExecutor.h"
+#include <iostream>
+
+CTaskExecutor::CTaskExecutor(int nWorkers, int nMaxPending/* = 0*/)
+	: m_nMaxPending(_MAX(0, nMaxPending))
+	, m_nRunning(0)
+	, m_bStop(false)
+{
+	for (int i = 0; i < _MAX(1, nWorkers); i++)
+		m_vWorkers.emplace_back(&CTaskExecutor::WorkerLoop, this);
+}
+
+CTaskExecutor::~CTaskExecutor()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStop = true;
+	}
+	m_cvTask.notify_all();
+	m_cvSpace.notify_all();
+
+	for (std::thread& worker : m_vWorkers)
+	{
+		if (worker.joinable())
+			worker.join();
+	}
+}
+
+// Submit a task. It waits until the queue has room if the queue is full.
+// @param[in] fnTask: task to run on a worker thread
+// @return: true if the task is queued, false if the executor is stopping
+// [Note] The tasks are started in the submission order, but they may finish in any order if there are several workers.
+bool CTaskExecutor::Submit(std::function<void()> fnTask)
+{
+	if (!fnTask)
+		return false;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cvSpace.wait(lock, [this]() { return m_bStop || m_nMaxPending == 0 || (int)m_dqTasks.size() < m_nMaxPending; });
+		if (m_bStop)
+			return false;
+
+		m_dqTasks.push_back(std::move(fnTask));
+	}
+	m_cvTask.notify_one();
+
+	return true;
+}
+
+// Wait until all the submitted tasks are finished
+void CTaskExecutor::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cvIdle.wait(lock, [this]() { return m_dqTasks.empty() && m_nRunning == 0; });
+}
+
+// Main loop of the worker threads
+void CTaskExecutor::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> fnTask;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cvTask.wait(lock, [this]() { return m_bStop || !m_dqTasks.empty(); });
+
+			// Finish the pending tasks before stopping
+			if (m_dqTasks.empty())
+				return;
+
+			fnTask = std::move(m_dqTasks.front());
+			m_dqTasks.pop_front();
+			m_nRunning++;
+		}
+		m_cvSpace.notify_one();
+
+		try
+		{
+			fnTask();
+		}
+		catch (std::exception& e)
+		{
+			const char* msg = e.what();
+			std::cout << msg << std::endl;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_nRunning--;
+			if (m_dqTasks.empty() && m_nRunning == 0)
+				m_cvIdle.notify_all();
+		}
+	}
+}
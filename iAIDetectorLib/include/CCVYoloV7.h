@@ -0,0 +1,21 @@
+#pragma once
+#include "type_define.h"
+#include <opencv2/opencv.hpp>
+#include "CCVInferer.h"
+#include "CYoloV7.h"
+
+// Class for YOLOv7 object detection using OpenCV DNN inference engine
+class IAIDETECTORLIB_API CCVYoloV7 : public CYoloV7, public CCVInferer
+{
+public:
+	
+	CCVYoloV7(const ObjDetNetConfig& stObjDetNetConfig, const NetDetailsConfig& stNetDetailsConfig);
+	~CCVYoloV7();
+
+	// Read the onnx model from the given path
+	// @param[in] sModelPath: path to the onnx model
+	// @param[in] sPairedFilePath: path to the paired file. For this case, it is the path to the class names file
+	// @param[in] sLogTitle: title of the log
+	// @return: true if successfully read the model, false otherwise
+	virtual bool ReadModel(const std::string& sModelPath, const std::string& sPairedFilePath = "", const std::string& sLogTitle = "opencv-dnn");
+};
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+#include "type_define.h"
+#include <opencv2/opencv.hpp>
+#include <mutex>
+
+// Class of the cheap motion pre-stage run before the object detection
+// The downscaled grey frame is compared with a running average background. If nothing moved, the detection is skipped
+// and the previous result is reused. If something moved, the detection is restricted to the bounding region of the motion.
+// [Note] - The frames should be checked in the capture order of one camera. Create one gate per camera.
+//        - The first frame, and the frame after Reset() or a size change, is always detected on the whole frame.
+class IAIDETECTORLIB_API CMotionGate
+{
+public:
+	CMotionGate(const MotionGateConfig& stConfig);
+	~CMotionGate();
+
+	// Check the motion of the frame and decide how to run the detection on it
+	// @param[in] cvFrame: input frame in BGR format
+	// @param[out] cvRegion: motion region in the frame coordinates if eMgRegion is returned, otherwise the whole frame
+	// @return: decision of the gate
+	E_MotionGateResult Check(const cv::Mat& cvFrame, cv::Rect& cvRegion);
+
+	// Forget the background, so the next frame is detected on the whole frame
+	void Reset();
+
+	// Get the counters of the decisions
+	// @return: counters of the decisions
+	MotionGateStats GetStats() const;
+
+	// Reset the counters of the decisions
+	void ResetStats();
+
+	// Get the configuration of the gate
+	// @return: configuration
+	const MotionGateConfig& GetConfig() const;
+
+private:
+	// Count the decision and return it
+	// @param[in] eResult: decision of the gate
+	// @return: the given decision
+	E_MotionGateResult Count(E_MotionGateResult eResult);
+
+private:
+	MotionGateConfig	m_stConfig;			// configuration of the gate
+	cv::Mat				m_cvBackground;		// running average background of the downscaled grey frames. CV_32F
+	cv::Size			m_cvFrameSize;		// size of the original frames of the background
+	int					m_nSinceFullFrame;	// number of frames since the last whole frame detection
+	MotionGateStats		m_stStats;			// counters of the decisions
+	mutable std::mutex	m_mutex;			// mutex to protect the background and the counters
+};
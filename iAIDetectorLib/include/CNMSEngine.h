@@ -0,0 +1,50 @@
+#pragma once
+#include "type_define.h"
+
+// Class of the non-maximum suppression engine shared by the object detectors
+// The boxes are sorted once by (group, score) and stored as structure of arrays, so the overlaps of one box
+// against the following boxes of its group are computed by SIMD and the suppressed boxes are marked in a bitmask.
+// A group is the image in the batched mode and additionally the class in the class-aware mode.
+// [Note] - The engine does not hold any per-run state, so one engine can be run from several threads at the same time.
+//        - eNmLegacy gives the same result as the original CObjDetector::NMSBoxes for the parity check.
+class IAIDETECTORLIB_API CNMSEngine
+{
+public:
+	CNMSEngine(const NMSConfig& stNMSConfig = NMSConfig());
+	~CNMSEngine();
+
+	// Run non-maximum suppression on the boxes of one image
+	// @param[in/out] vBoxes: bounding boxes before and after non-maximum suppression, sorted by score in descending order
+	void Run(ObjBoxArr& vBoxes) const;
+
+	// Run non-maximum suppression on the boxes of several images at once
+	// @param[in/out] pvBoxes: bounding boxes of each image before and after non-maximum suppression
+	// @param[in] nCount: number of images
+	// [Note] The boxes of different images never suppress each other.
+	void Run(ObjBoxArr* pvBoxes, int nCount) const;
+
+	// Set the configuration of non-maximum suppression
+	// @param[in] stNMSConfig: configuration
+	void SetConfig(const NMSConfig& stNMSConfig);
+
+	// Get the configuration of non-maximum suppression
+	// @return: configuration
+	const NMSConfig& GetConfig() const;
+
+private:
+	// Run the greedy non-maximum suppression on one group of the sorted boxes
+	// @param[in] nBegin: index of the 1st box of the group in the sorted boxes
+	// @param[in] nEnd: index after the last box of the group in the sorted boxes
+	// @param[out] pKeep: whether each box of the group is kept
+	void RunGreedy(int nBegin, int nEnd, uint8_t* pKeep) const;
+
+	// Run Soft-NMS on one group of the sorted boxes
+	// @param[in] nBegin: index of the 1st box of the group in the sorted boxes
+	// @param[in] nEnd: index after the last box of the group in the sorted boxes
+	// @param[out] pKeep: whether each box of the group is kept
+	// [Note] The decayed scores are left in the score array of the sorted boxes.
+	void RunSoft(int nBegin, int nEnd, uint8_t* pKeep) const;
+
+private:
+	NMSConfig	m_stNMSConfig;		// configuration of non-maximum suppression
+};
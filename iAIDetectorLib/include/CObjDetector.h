@@ -1,6 +1,7 @@
 #pragma once
 #include "type_define.h"
 #include <opencv2/opencv.hpp>
+#include "CNMSEngine.h"
 
 // Abstract base class for object detection
 // All the object detection classes should inherit from this class
@@ -16,6 +17,44 @@ public:
 	// [Note]: The bounding boxes of detected objects can be obtained by calling GetObjBoxes().
 	virtual bool Detect(const cv::Mat& cvFrame) = 0;
 
+	// Detect objects in the input frame into the given result
+	// @param[in] cvFrame: input frame in BGR format
+	// @param[out] vObjBoxes: bounding boxes of detected objects
+	// @return: true if detection is successful, false otherwise. 
+	// [Note]: It does not touch the state of the detector, so it can be called from several threads at the same time.
+	virtual bool Detect(const cv::Mat& cvFrame, ObjBoxArr& vObjBoxes) = 0;
+
+	// Detect objects in several frames at once
+	// @param[in] vFrames: input frames in BGR format
+	// @param[out] vObjBoxes: bounding boxes of detected objects in each frame
+	// @return: true if detection is successful, false otherwise. 
+	// [Note]: The frames are packed into as few network runs as possible. It can be called from several threads at the same time.
+	virtual bool DetectBatch(const std::vector<cv::Mat>& vFrames, std::vector<ObjBoxArr>& vObjBoxes) = 0;
+
+	// Detect objects in the overlapping tiles of the input frame at the full resolution
+	// @param[in] cvFrame: input frame in BGR format
+	// @param[out] vObjBoxes: bounding boxes of detected objects in the frame coordinates
+	// @return: true if detection is successful, false otherwise. 
+	// [Note]: - The active tiles are run by DetectBatch() as one batch or as TileConfig::nParallelRuns concurrent runs,
+	//           and the boxes of all the tiles are merged by the cross-tile non-maximum suppression.
+	//         - It can be called from several threads at the same time.
+	virtual bool DetectTiled(const cv::Mat& cvFrame, ObjBoxArr& vObjBoxes);
+
+	// Set the configuration of the tiled detection
+	// @param[in] stTileConfig: tile configuration
+	// [Note]: If enabled, Detect() runs DetectTiled() instead of detecting on the whole frame.
+	void SetTileConfig(const TileConfig& stTileConfig);
+
+	// Get the configuration of the tiled detection
+	// @return: tile configuration
+	const TileConfig& GetTileConfig() const;
+
+	// Get the tiles of the frame of the given size
+	// @param[in] cvFrameSize: frame size
+	// @param[out] vTileRects: tile rectangles in row-major order. The index is the one of TileConfig::vActiveTiles
+	// [Note]: The tiles are spread evenly so that they cover the frame with at least TileConfig::nOverlap pixels of overlap.
+	void GetTileRects(const cv::Size& cvFrameSize, std::vector<cv::Rect>& vTileRects) const;
+
 	// Set the class names of objects which will be detected by the network
 	// @param[in] vClsNames2Detect: class names
 	virtual void SetClsNames2Detect(const ObjClsArr& vClsNames2Detect);
@@ -52,9 +91,17 @@ protected:
 	// @return: true if the class ID is in the list, false otherwise
 	inline bool IsClsID2Detect(const int nClsID) const;
 
+	// Build the class ID bitmask and the list of class IDs to detect from the class names to detect
+	// [Note] It should be called whenever m_vClsNames or m_vClsNames2Detect is changed.
+	void UpdateClsMask2Detect();
+
 protected:
 	ObjDetNetConfig		m_stObjDetConfig;		// object detection network configuration
+	CNMSEngine			m_NMSEngine;			// non-maximum suppression engine configured by m_stObjDetConfig
+	TileConfig			m_stTileConfig;			// tiled detection configuration
 	ObjBoxArr			m_vObjBoxes;			// bounding boxes of detected objects
 	ObjClsArr			m_vClsNames;			// class names of objects which can be detected by the network
 	ObjClsArr			m_vClsNames2Detect;		// class names of objects which will be detected. If empty, all the objects will be detected
+	std::vector<uint64_t>	m_vClsMask2Detect;	// bitmask of the class IDs to detect. Bit k of m_vClsMask2Detect[k / 64] is for class ID k
+	std::vector<int>		m_vClsIDs2Detect;	// class IDs to detect in ascending order. All the class IDs if m_vClsNames2Detect is empty
 };
\ No newline at end of file
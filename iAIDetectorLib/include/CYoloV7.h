@@ -0,0 +1,53 @@
+#pragma once
+#include "type_define.h"
+#include <opencv2/opencv.hpp>
+#include "CInferer.h"
+#include "CObjDetector.h"
+
+// Class for YOLOv7 object detection, independent of the inference runtime
+// The runtime is bound by the derived classes, e.g., CORTYoloV7 for onnxruntime and CCVYoloV7 for OpenCV DNN.
+class IAIDETECTORLIB_API CYoloV7 : public CObjDetector, public virtual CInferer
+{
+public:
+	
+	CYoloV7(const ObjDetNetConfig& stObjDetNetConfig, const NetDetailsConfig& stNetDetailsConfig);
+	virtual ~CYoloV7();
+
+	// Detect objects in the input frame
+	// @param[in] cvFrame: input frame in BGR format
+	// @return: true if detection is successful, false otherwise. 
+	// [Note]: The bounding boxes of detected objects can be obtained by calling GetObjBoxes().
+	virtual bool Detect(const cv::Mat& cvFrame);
+
+	// Detect objects in the input frame into the given result
+	// @param[in] cvFrame: input frame in BGR format
+	// @param[out] vObjBoxes: bounding boxes of detected objects
+	// @return: true if detection is successful, false otherwise. 
+	// [Note]: It does not touch the state of the detector, so it can be called from several threads at the same time.
+	virtual bool Detect(const cv::Mat& cvFrame, ObjBoxArr& vObjBoxes);
+
+	// Detect objects in several frames at once
+	// @param[in] vFrames: input frames in BGR format
+	// @param[out] vObjBoxes: bounding boxes of detected objects in each frame
+	// @return: true if detection is successful, false otherwise. 
+	// [Note]: The frames are packed into as few network runs as possible. It can be called from several threads at the same time.
+	virtual bool DetectBatch(const std::vector<cv::Mat>& vFrames, std::vector<ObjBoxArr>& vObjBoxes);
+
+
+protected:
+	// Read the class names from the given file
+	// @param[in] sClassPath: path to the class names file. One class name per line
+	// @return: true if successfully read the class names, false otherwise
+	bool ReadClassNames(const std::string& sClassPath);
+
+	// Preprocess the input image
+	// @param[in] cvImg: input image to be preprocessed
+	// @param[out] cvProcImg: preprocessed image
+	virtual void PreProcess(const cv::Mat& cvImg, cv::Mat& cvProcImg);
+
+	// Postprocess the output tensor
+	// @param[in] cvOrgImgSize: size of the original image
+	// @param[in] pTensorData: pointer to the output tensor data of the inference engine
+	// @param[out] pPostProcessData: pointer to the postprocessed data
+	virtual void PostProcess(const cv::Size& cvOrgImgSize, const void* pTensorData, void* pPostProcessData);
+};
\ No newline at end of file
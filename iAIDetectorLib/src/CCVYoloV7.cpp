@@ -0,0 +1,32 @@
+#include "CCVYoloV7.h"
+
+
+
+
+CCVYoloV7::CCVYoloV7(const ObjDetNetConfig& stObjDetNetConfig, const NetDetailsConfig& stNetDetailsConfig)
+	: CInferer(stNetDetailsConfig)
+	, CYoloV7(stObjDetNetConfig, stNetDetailsConfig)
+	, CCVInferer(stNetDetailsConfig)
+{
+	m_bValid = (ReadModel(stObjDetNetConfig.sModelPath, 
+		stObjDetNetConfig.sClassPath, "yolo7-cvdnn") && Validate());
+}
+
+
+CCVYoloV7::~CCVYoloV7()
+{
+
+}
+
+// Read the onnx model from the given path
+// @param[in] sModelPath: path to the onnx model
+// @param[in] sPairedFilePath: path to the paired file. For this case, it is the path to the class names file
+// @param[in] sLogTitle: title of the log
+// @return: true if successfully read the model, false otherwise
+bool CCVYoloV7::ReadModel(const std::string& sModelPath, const std::string& sPairedFilePath /*= ""*/, const std::string& sLogTitle /*= "opencv-dnn"*/)
+{
+	if (!CCVInferer::ReadModel(sModelPath, sPairedFilePath, sLogTitle))
+		return false;
+	
+	return ReadClassNames(sPairedFilePath);
+}
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "CMotionGate.h"
+#include <iostream>
+
+CMotionGate::CMotionGate(const MotionGateConfig& stConfig)
+	: m_stConfig(stConfig)
+	, m_nSinceFullFrame(0)
+{
+
+}
+
+CMotionGate::~CMotionGate()
+{
+
+}
+
+// Check the motion of the frame and decide how to run the detection on it
+// @param[in] cvFrame: input frame in BGR format
+// @param[out] cvRegion: motion region in the frame coordinates if eMgRegion is returned, otherwise the whole frame
+// @return: decision of the gate
+E_MotionGateResult CMotionGate::Check(const cv::Mat& cvFrame, cv::Rect& cvRegion)
+{
+	cvRegion = cv::Rect(0, 0, cvFrame.cols, cvFrame.rows);
+	if (cvFrame.empty())
+		return E_MotionGateResult::eMgUnknown;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	try
+	{
+		// Downscale the frame into grey. The blur suppresses the sensor noise
+		int nProcW = _MIN(_MAX(16, m_stConfig.nProcWidth), cvFrame.cols);
+		int nProcH = _MAX(1, (int)((int64_t)cvFrame.rows * nProcW / cvFrame.cols));
+
+		cv::Mat cvSmall, cvGrey;
+		cv::resize(cvFrame, cvSmall, cv::Size(nProcW, nProcH), 0, 0, cv::INTER_AREA);
+		if (cvSmall.channels() == 3)
+			cv::cvtColor(cvSmall, cvGrey, cv::COLOR_BGR2GRAY);
+		else
+			cvGrey = cvSmall;
+		cv::GaussianBlur(cvGrey, cvGrey, cv::Size(3, 3), 0);
+
+		// Start the background again if there is no background or the camera resolution is changed
+		if (m_cvBackground.empty() || m_cvFrameSize != cvFrame.size())
+		{
+			cvGrey.convertTo(m_cvBackground, CV_32F);
+			m_cvFrameSize = cvFrame.size();
+			return Count(E_MotionGateResult::eMgFullFrame);
+		}
+
+		// Find the moving pixels against the background, then let the background learn the frame
+		cv::Mat cvBackground8U, cvMask;
+		m_cvBackground.convertTo(cvBackground8U, CV_8U);
+		cv::absdiff(cvGrey, cvBackground8U, cvMask);
+		cv::threshold(cvMask, cvMask, m_stConfig.nDiffThresh, 255, cv::THRESH_BINARY);
+		cv::morphologyEx(cvMask, cvMask, cv::MORPH_OPEN, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3)));
+
+		cv::accumulateWeighted(cvGrey, m_cvBackground, m_stConfig.fLearningRate);
+
+		if (m_stConfig.nRefreshInterval > 0 && m_nSinceFullFrame + 1 >= m_stConfig.nRefreshInterval)
+			return Count(E_MotionGateResult::eMgFullFrame);
+
+		int nMoving = cv::countNonZero(cvMask);
+		if (nMoving == 0 || nMoving < m_stConfig.fMinMotionRatio * cvMask.total())
+			return Count(E_MotionGateResult::eMgSkip);
+
+		// Scale the bounding region of the motion back to the frame with the margin
+		cv::Rect cvMotion = cv::boundingRect(cvMask);
+		double dScaleX = (double)cvFrame.cols / nProcW;
+		double dScaleY = (double)cvFrame.rows / nProcH;
+		int nX1 = (int)(cvMotion.x * dScaleX) - m_stConfig.nRegionMargin;
+		int nY1 = (int)(cvMotion.y * dScaleY) - m_stConfig.nRegionMargin;
+		int nX2 = (int)std::ceil((cvMotion.x + cvMotion.width) * dScaleX) + m_stConfig.nRegionMargin;
+		int nY2 = (int)std::ceil((cvMotion.y + cvMotion.height) * dScaleY) + m_stConfig.nRegionMargin;
+
+		cv::Rect cvMotionRegion = cv::Rect(cv::Point(nX1, nY1), cv::Point(nX2, nY2)) & cvRegion;
+		if (cvMotionRegion.empty() || cvMotionRegion.area() > m_stConfig.fMaxRegionRatio * cvRegion.area())
+			return Count(E_MotionGateResult::eMgFullFrame);
+
+		cvRegion = cvMotionRegion;
+		return Count(E_MotionGateResult::eMgRegion);
+	}
+	catch (cv::Exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+	}
+
+	// Detect the whole frame if the gate fails
+	m_cvBackground.release();
+	return Count(E_MotionGateResult::eMgFullFrame);
+}
+
+// Forget the background, so the next frame is detected on the whole frame
+void CMotionGate::Reset()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_cvBackground.release();
+	m_cvFrameSize = cv::Size();
+	m_nSinceFullFrame = 0;
+}
+
+// Get the counters of the decisions
+// @return: counters of the decisions
+MotionGateStats CMotionGate::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return m_stStats;
+}
+
+// Reset the counters of the decisions
+void CMotionGate::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_stStats = MotionGateStats();
+}
+
+// Get the configuration of the gate
+// @return: configuration
+const MotionGateConfig& CMotionGate::GetConfig() const
+{
+	return m_stConfig;
+}
+
+// Count the decision and return it
+// @param[in] eResult: decision of the gate
+// @return: the given decision
+E_MotionGateResult CMotionGate::Count(E_MotionGateResult eResult)
+{
+	m_stStats.nFrames++;
+
+	if (eResult == E_MotionGateResult::eMgSkip)
+	{
+		m_stStats.nSkipped++;
+		m_nSinceFullFrame++;
+	}
+	else if (eResult == E_MotionGateResult::eMgRegion)
+	{
+		m_stStats.nRegion++;
+		m_nSinceFullFrame++;
+	}
+	else if (eResult == E_MotionGateResult::eMgFullFrame)
+	{
+		m_stStats.nFullFrame++;
+		m_nSinceFullFrame = 0;
+	}
+
+	return eResult;
+}
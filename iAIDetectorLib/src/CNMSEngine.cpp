@@ -0,0 +1,441 @@
+#include "CNMSEngine.h"
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cmath>
+
+#ifdef _SIMD_X86_
+#include <immintrin.h>
+#endif
+
+// Small value to avoid the division by zero of the degenerate boxes
+#define NMS_EPSILON		1e-12f
+
+
+// Structure of arrays of the boxes sorted by (group, score)
+// [Note] It is kept per thread and reused by the later runs, so the runs do not allocate memory in the steady state.
+typedef struct _NMSWorkspace
+{
+	std::vector<float>		vX1;		// top left x
+	std::vector<float>		vY1;		// top left y
+	std::vector<float>		vX2;		// bottom right x
+	std::vector<float>		vY2;		// bottom right y
+	std::vector<float>		vArea;		// area
+	std::vector<float>		vScore;		// score. Decayed by Soft-NMS
+	std::vector<float>		vOverlap;	// overlap of the current box against the following boxes
+	std::vector<int>		vImage;		// index of the source image
+	std::vector<int>		vBox;		// index of the box in the source image
+	std::vector<int64_t>	vGroup;		// group of the box. The boxes suppress the boxes of the same group only
+	std::vector<int>		vSrcImage;	// index of the source image before sorting
+	std::vector<int>		vSrcBox;	// index of the box in the source image before sorting
+	std::vector<int64_t>	vSrcGroup;	// group of the box before sorting
+	std::vector<float>		vSrcScore;	// score of the box before sorting
+	std::vector<int>		vOrder;		// sorting order
+	std::vector<uint8_t>	vKeep;		// whether the box is kept
+	std::vector<uint64_t>	vSupMask;	// bitmask of the suppressed boxes of the current group
+	ObjBoxArr				vTemp;		// kept boxes of one image
+}NMSWorkspace;
+
+static thread_local NMSWorkspace s_stWorkspace;
+
+
+#ifdef _SIMD_X86_
+// AVX2 version of OverlapRow
+_TARGET_AVX2_ static void OverlapRowAVX2(const NMSWorkspace& stWS, int i, int nBegin, int nEnd, float fOffset, bool bDIoU, float* pOverlap)
+{
+	const float* pX1 = stWS.vX1.data();
+	const float* pY1 = stWS.vY1.data();
+	const float* pX2 = stWS.vX2.data();
+	const float* pY2 = stWS.vY2.data();
+	const float* pArea = stWS.vArea.data();
+
+	__m256 vX1i = _mm256_set1_ps(pX1[i]), vY1i = _mm256_set1_ps(pY1[i]);
+	__m256 vX2i = _mm256_set1_ps(pX2[i]), vY2i = _mm256_set1_ps(pY2[i]);
+	__m256 vAreai = _mm256_set1_ps(pArea[i]);
+	__m256 vOffset = _mm256_set1_ps(fOffset);
+	__m256 vZero = _mm256_setzero_ps();
+	__m256 vEps = _mm256_set1_ps(NMS_EPSILON);
+	__m256 vHalf = _mm256_set1_ps(0.5f);
+
+	int j = nBegin;
+	for (; j <= nEnd - 8; j += 8)
+	{
+		__m256 vX1j = _mm256_loadu_ps(pX1 + j), vY1j = _mm256_loadu_ps(pY1 + j);
+		__m256 vX2j = _mm256_loadu_ps(pX2 + j), vY2j = _mm256_loadu_ps(pY2 + j);
+
+		__m256 vW = _mm256_max_ps(vZero, _mm256_add_ps(_mm256_sub_ps(_mm256_min_ps(vX2i, vX2j), _mm256_max_ps(vX1i, vX1j)), vOffset));
+		__m256 vH = _mm256_max_ps(vZero, _mm256_add_ps(_mm256_sub_ps(_mm256_min_ps(vY2i, vY2j), _mm256_max_ps(vY1i, vY1j)), vOffset));
+		__m256 vInter = _mm256_mul_ps(vW, vH);
+		__m256 vUnion = _mm256_sub_ps(_mm256_add_ps(vAreai, _mm256_loadu_ps(pArea + j)), vInter);
+		__m256 vValue = _mm256_div_ps(vInter, _mm256_max_ps(vUnion, vEps));
+
+		if (bDIoU)
+		{
+			// Squared distance of the centres normalised by the squared diagonal of the enclosing box
+			__m256 vDX = _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(vX1i, vX2i), _mm256_add_ps(vX1j, vX2j)), vHalf);
+			__m256 vDY = _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(vY1i, vY2i), _mm256_add_ps(vY1j, vY2j)), vHalf);
+			__m256 vCW = _mm256_sub_ps(_mm256_max_ps(vX2i, vX2j), _mm256_min_ps(vX1i, vX1j));
+			__m256 vCH = _mm256_sub_ps(_mm256_max_ps(vY2i, vY2j), _mm256_min_ps(vY1i, vY1j));
+			__m256 vRho2 = _mm256_fmadd_ps(vDX, vDX, _mm256_mul_ps(vDY, vDY));
+			__m256 vC2 = _mm256_fmadd_ps(vCW, vCW, _mm256_mul_ps(vCH, vCH));
+			vValue = _mm256_sub_ps(vValue, _mm256_div_ps(vRho2, _mm256_max_ps(vC2, vEps)));
+		}
+
+		_mm256_storeu_ps(pOverlap + j - nBegin, vValue);
+	}
+
+	for (; j < nEnd; j++)
+	{
+		float fW = _MAX(0.0f, _MIN(pX2[i], pX2[j]) - _MAX(pX1[i], pX1[j]) + fOffset);
+		float fH = _MAX(0.0f, _MIN(pY2[i], pY2[j]) - _MAX(pY1[i], pY1[j]) + fOffset);
+		float fInter = fW * fH;
+		float fValue = fInter / _MAX(pArea[i] + pArea[j] - fInter, NMS_EPSILON);
+
+		if (bDIoU)
+		{
+			float fDX = (pX1[i] + pX2[i] - pX1[j] - pX2[j]) * 0.5f;
+			float fDY = (pY1[i] + pY2[i] - pY1[j] - pY2[j]) * 0.5f;
+			float fCW = _MAX(pX2[i], pX2[j]) - _MIN(pX1[i], pX1[j]);
+			float fCH = _MAX(pY2[i], pY2[j]) - _MIN(pY1[i], pY1[j]);
+			fValue -= (fDX * fDX + fDY * fDY) / _MAX(fCW * fCW + fCH * fCH, NMS_EPSILON);
+		}
+
+		pOverlap[j - nBegin] = fValue;
+	}
+}
+
+// AVX2 version of MarkSuppressed
+_TARGET_AVX2_ static void MarkSuppressedAVX2(const float* pOverlap, int nLen, float fThresh, bool bInclusive, uint64_t* pSupMask, int nBitOfs)
+{
+	__m256 vThresh = _mm256_set1_ps(fThresh);
+
+	int j = 0;
+	for (; j <= nLen - 8; j += 8)
+	{
+		__m256 vOverlap = _mm256_loadu_ps(pOverlap + j);
+		__m256 vCmp = bInclusive ? _mm256_cmp_ps(vOverlap, vThresh, _CMP_GE_OQ) : _mm256_cmp_ps(vOverlap, vThresh, _CMP_GT_OQ);
+		uint64_t nMask = (uint64_t)_mm256_movemask_ps(vCmp);
+		if (!nMask)
+			continue;
+
+		// The 8 bits may straddle two words of the bitmask
+		int nBit = nBitOfs + j;
+		pSupMask[nBit >> 6] |= nMask << (nBit & 63);
+		if ((nBit & 63) > 56)
+			pSupMask[(nBit >> 6) + 1] |= nMask >> (64 - (nBit & 63));
+	}
+
+	for (; j < nLen; j++)
+	{
+		if (bInclusive ? (pOverlap[j] >= fThresh) : (pOverlap[j] > fThresh))
+			pSupMask[(nBitOfs + j) >> 6] |= (uint64_t)1 << ((nBitOfs + j) & 63);
+	}
+}
+#endif
+
+// Compute the overlap of box i against the boxes in [nBegin, nEnd)
+// @param[in] stWS: sorted boxes
+// @param[in] i: index of the box
+// @param[in] nBegin: index of the 1st box to compare
+// @param[in] nEnd: index after the last box to compare
+// @param[in] fOffset: 1 for the pixel-inclusive coordinates, otherwise 0
+// @param[in] bDIoU: true: DIoU. false: IoU
+// @param[out] pOverlap: overlap of each box in [nBegin, nEnd)
+static void OverlapRow(const NMSWorkspace& stWS, int i, int nBegin, int nEnd, float fOffset, bool bDIoU, float* pOverlap)
+{
+#ifdef _SIMD_X86_
+	static const bool s_bAVX2 = cv::checkHardwareSupport(CV_CPU_AVX2) && cv::checkHardwareSupport(CV_CPU_FMA3);
+
+	if (s_bAVX2)
+	{
+		OverlapRowAVX2(stWS, i, nBegin, nEnd, fOffset, bDIoU, pOverlap);
+		return;
+	}
+#endif
+
+	const float* pX1 = stWS.vX1.data();
+	const float* pY1 = stWS.vY1.data();
+	const float* pX2 = stWS.vX2.data();
+	const float* pY2 = stWS.vY2.data();
+	const float* pArea = stWS.vArea.data();
+
+	for (int j = nBegin; j < nEnd; j++)
+	{
+		float fW = _MAX(0.0f, _MIN(pX2[i], pX2[j]) - _MAX(pX1[i], pX1[j]) + fOffset);
+		float fH = _MAX(0.0f, _MIN(pY2[i], pY2[j]) - _MAX(pY1[i], pY1[j]) + fOffset);
+		float fInter = fW * fH;
+		float fValue = fInter / _MAX(pArea[i] + pArea[j] - fInter, NMS_EPSILON);
+
+		if (bDIoU)
+		{
+			float fDX = (pX1[i] + pX2[i] - pX1[j] - pX2[j]) * 0.5f;
+			float fDY = (pY1[i] + pY2[i] - pY1[j] - pY2[j]) * 0.5f;
+			float fCW = _MAX(pX2[i], pX2[j]) - _MIN(pX1[i], pX1[j]);
+			float fCH = _MAX(pY2[i], pY2[j]) - _MIN(pY1[i], pY1[j]);
+			fValue -= (fDX * fDX + fDY * fDY) / _MAX(fCW * fCW + fCH * fCH, NMS_EPSILON);
+		}
+
+		pOverlap[j - nBegin] = fValue;
+	}
+}
+
+// Mark the boxes whose overlap passes the threshold in the bitmask
+// @param[in] pOverlap: overlap of each box
+// @param[in] nLen: number of boxes
+// @param[in] fThresh: overlap threshold
+// @param[in] bInclusive: true: suppressed if overlap >= threshold. false: suppressed if overlap > threshold
+// @param[in/out] pSupMask: bitmask of the suppressed boxes
+// @param[in] nBitOfs: bit of the 1st box in the bitmask
+static void MarkSuppressed(const float* pOverlap, int nLen, float fThresh, bool bInclusive, uint64_t* pSupMask, int nBitOfs)
+{
+#ifdef _SIMD_X86_
+	static const bool s_bAVX2 = cv::checkHardwareSupport(CV_CPU_AVX2);
+
+	if (s_bAVX2)
+	{
+		MarkSuppressedAVX2(pOverlap, nLen, fThresh, bInclusive, pSupMask, nBitOfs);
+		return;
+	}
+#endif
+
+	for (int j = 0; j < nLen; j++)
+	{
+		if (bInclusive ? (pOverlap[j] >= fThresh) : (pOverlap[j] > fThresh))
+			pSupMask[(nBitOfs + j) >> 6] |= (uint64_t)1 << ((nBitOfs + j) & 63);
+	}
+}
+
+
+CNMSEngine::CNMSEngine(const NMSConfig& stNMSConfig/* = NMSConfig()*/)
+	: m_stNMSConfig(stNMSConfig)
+{
+
+}
+
+CNMSEngine::~CNMSEngine()
+{
+
+}
+
+// Set the configuration of non-maximum suppression
+// @param[in] stNMSConfig: configuration
+void CNMSEngine::SetConfig(const NMSConfig& stNMSConfig)
+{
+	m_stNMSConfig = stNMSConfig;
+}
+
+// Get the configuration of non-maximum suppression
+// @return: configuration
+const NMSConfig& CNMSEngine::GetConfig() const
+{
+	return m_stNMSConfig;
+}
+
+// Run non-maximum suppression on the boxes of one image
+// @param[in/out] vBoxes: bounding boxes before and after non-maximum suppression, sorted by score in descending order
+void CNMSEngine::Run(ObjBoxArr& vBoxes) const
+{
+	Run(&vBoxes, 1);
+}
+
+// Run non-maximum suppression on the boxes of several images at once
+// @param[in/out] pvBoxes: bounding boxes of each image before and after non-maximum suppression
+// @param[in] nCount: number of images
+// [Note] The boxes of different images never suppress each other.
+void CNMSEngine::Run(ObjBoxArr* pvBoxes, int nCount) const
+{
+	if (!pvBoxes || nCount <= 0)
+		return;
+
+	NMSWorkspace& stWS = s_stWorkspace;
+
+	int nTotal = 0;
+	int nMaxClassID = 0;
+	for (int n = 0; n < nCount; n++)
+	{
+		nTotal += int(pvBoxes[n].size());
+		for (const ObjBBox& stBox : pvBoxes[n])
+			nMaxClassID = _MAX(nMaxClassID, stBox.nClassID);
+	}
+
+	if (nTotal == 0)
+		return;
+
+	// Sort the boxes once by (group, score) so that each group is a contiguous range in descending score order
+	bool bClassAware = m_stNMSConfig.bClassAware && m_stNMSConfig.eMethod != E_NMSMethod::eNmLegacy;
+	int64_t nGroupStride = (int64_t)nMaxClassID + 2;
+
+	stWS.vSrcImage.resize(nTotal);
+	stWS.vSrcBox.resize(nTotal);
+	stWS.vSrcGroup.resize(nTotal);
+	stWS.vSrcScore.resize(nTotal);
+	stWS.vOrder.resize(nTotal);
+	for (int n = 0, k = 0; n < nCount; n++)
+	{
+		for (int b = 0; b < int(pvBoxes[n].size()); b++, k++)
+		{
+			stWS.vSrcImage[k] = n;
+			stWS.vSrcBox[k] = b;
+			stWS.vSrcGroup[k] = n * nGroupStride + (bClassAware ? pvBoxes[n][b].nClassID + 1 : 0);
+			stWS.vSrcScore[k] = pvBoxes[n][b].fScore;
+			stWS.vOrder[k] = k;
+		}
+	}
+
+	std::sort(stWS.vOrder.begin(), stWS.vOrder.end(), [&stWS](int a, int b) {
+		if (stWS.vSrcGroup[a] != stWS.vSrcGroup[b])
+			return stWS.vSrcGroup[a] < stWS.vSrcGroup[b];
+		if (stWS.vSrcScore[a] != stWS.vSrcScore[b])
+			return stWS.vSrcScore[a] > stWS.vSrcScore[b];
+		return a < b;
+	});
+
+	// Gather the sorted boxes into the structure of arrays
+	float fOffset = (m_stNMSConfig.eMethod == E_NMSMethod::eNmLegacy) ? 1.0f : 0.0f;
+
+	stWS.vX1.resize(nTotal);
+	stWS.vY1.resize(nTotal);
+	stWS.vX2.resize(nTotal);
+	stWS.vY2.resize(nTotal);
+	stWS.vArea.resize(nTotal);
+	stWS.vOverlap.resize(nTotal);
+	stWS.vScore.resize(nTotal);
+	stWS.vImage.resize(nTotal);
+	stWS.vBox.resize(nTotal);
+	stWS.vGroup.resize(nTotal);
+	stWS.vKeep.assign(nTotal, 0);
+
+	for (int k = 0; k < nTotal; k++)
+	{
+		int nSrc = stWS.vOrder[k];
+		const ObjBBox& stBox = pvBoxes[stWS.vSrcImage[nSrc]][stWS.vSrcBox[nSrc]];
+
+		stWS.vX1[k] = stBox.fX1;
+		stWS.vY1[k] = stBox.fY1;
+		stWS.vX2[k] = stBox.fX2;
+		stWS.vY2[k] = stBox.fY2;
+		stWS.vArea[k] = (stBox.fX2 - stBox.fX1 + fOffset) * (stBox.fY2 - stBox.fY1 + fOffset);
+		stWS.vScore[k] = stBox.fScore;
+		stWS.vImage[k] = stWS.vSrcImage[nSrc];
+		stWS.vBox[k] = stWS.vSrcBox[nSrc];
+		stWS.vGroup[k] = stWS.vSrcGroup[nSrc];
+	}
+
+	// Run the suppression on each group
+	bool bSoft = (m_stNMSConfig.eMethod == E_NMSMethod::eNmSoftLinear || m_stNMSConfig.eMethod == E_NMSMethod::eNmSoftGaussian);
+	for (int nBegin = 0, nEnd = 0; nBegin < nTotal; nBegin = nEnd)
+	{
+		for (nEnd = nBegin + 1; nEnd < nTotal && stWS.vGroup[nEnd] == stWS.vGroup[nBegin]; nEnd++);
+
+		if (bSoft)
+			RunSoft(nBegin, nEnd, stWS.vKeep.data() + nBegin);
+		else
+			RunGreedy(nBegin, nEnd, stWS.vKeep.data() + nBegin);
+	}
+
+	// Write the kept boxes back to each image in descending score order
+	for (int n = 0, k = 0; n < nCount; n++)
+	{
+		stWS.vTemp.clear();
+		for (; k < nTotal && stWS.vImage[k] == n; k++)
+		{
+			if (!stWS.vKeep[k])
+				continue;
+
+			ObjBBox stBox = pvBoxes[n][stWS.vBox[k]];
+			stBox.fScore = stWS.vScore[k];
+			stWS.vTemp.push_back(stBox);
+		}
+
+		if (bClassAware || bSoft)
+			std::stable_sort(stWS.vTemp.begin(), stWS.vTemp.end(), [](const ObjBBox& a, const ObjBBox& b) { return a.fScore > b.fScore; });
+
+		pvBoxes[n].assign(stWS.vTemp.begin(), stWS.vTemp.end());
+	}
+}
+
+// Run the greedy non-maximum suppression on one group of the sorted boxes
+// @param[in] nBegin: index of the 1st box of the group in the sorted boxes
+// @param[in] nEnd: index after the last box of the group in the sorted boxes
+// @param[out] pKeep: whether each box of the group is kept
+void CNMSEngine::RunGreedy(int nBegin, int nEnd, uint8_t* pKeep) const
+{
+	NMSWorkspace& stWS = s_stWorkspace;
+
+	int nLen = nEnd - nBegin;
+	stWS.vSupMask.assign((nLen + 63) / 64 + 1, 0);
+
+	bool bLegacy = (m_stNMSConfig.eMethod == E_NMSMethod::eNmLegacy);
+	bool bDIoU = (m_stNMSConfig.eMethod == E_NMSMethod::eNmDIoU);
+	float fOffset = bLegacy ? 1.0f : 0.0f;
+	uint64_t* pSupMask = stWS.vSupMask.data();
+
+	for (int i = 0; i < nLen; i++)
+	{
+		if ((pSupMask[i >> 6] >> (i & 63)) & 1)
+			continue;
+
+		pKeep[i] = 1;
+		if (i + 1 >= nLen)
+			break;
+
+		OverlapRow(stWS, nBegin + i, nBegin + i + 1, nEnd, fOffset, bDIoU, stWS.vOverlap.data());
+		MarkSuppressed(stWS.vOverlap.data(), nLen - i - 1, m_stNMSConfig.fIoUThresh, bLegacy, pSupMask, i + 1);
+	}
+}
+
+// Run Soft-NMS on one group of the sorted boxes
+// @param[in] nBegin: index of the 1st box of the group in the sorted boxes
+// @param[in] nEnd: index after the last box of the group in the sorted boxes
+// @param[out] pKeep: whether each box of the group is kept
+// [Note] The decayed scores are left in the score array of the sorted boxes.
+void CNMSEngine::RunSoft(int nBegin, int nEnd, uint8_t* pKeep) const
+{
+	NMSWorkspace& stWS = s_stWorkspace;
+
+	int nLen = nEnd - nBegin;
+	float* pScore = stWS.vScore.data() + nBegin;
+	const float* pOverlap = stWS.vOverlap.data();
+	bool bGaussian = (m_stNMSConfig.eMethod == E_NMSMethod::eNmSoftGaussian);
+	float fInvSigma = 1.0f / _MAX(m_stNMSConfig.fSoftSigma, NMS_EPSILON);
+
+	// pKeep is 0 for the alive boxes, 1 for the selected boxes and 2 for the removed boxes until the end
+	for (int nAlive = nLen; nAlive > 0;)
+	{
+		// Select the alive box with the highest score
+		int nMax = -1;
+		for (int j = 0; j < nLen; j++)
+		{
+			if (pKeep[j] == 0 && (nMax < 0 || pScore[j] > pScore[nMax]))
+				nMax = j;
+		}
+
+		if (pScore[nMax] <= m_stNMSConfig.fScoreThresh)
+			break;
+
+		pKeep[nMax] = 1;
+		nAlive--;
+
+		// Decay the scores of the other alive boxes by their overlap with the selected box
+		OverlapRow(stWS, nBegin + nMax, nBegin, nEnd, 0.0f, false, stWS.vOverlap.data());
+		for (int j = 0; j < nLen; j++)
+		{
+			if (pKeep[j] != 0)
+				continue;
+
+			float fIoU = pOverlap[j];
+			if (bGaussian)
+				pScore[j] *= std::exp(-fIoU * fIoU * fInvSigma);
+			else if (fIoU > m_stNMSConfig.fIoUThresh)
+				pScore[j] *= 1.0f - fIoU;
+
+			if (pScore[j] <= m_stNMSConfig.fScoreThresh)
+			{
+				pKeep[j] = 2;
+				nAlive--;
+			}
+		}
+	}
+
+	for (int j = 0; j < nLen; j++)
+		pKeep[j] = (pKeep[j] == 1) ? 1 : 0;
+}
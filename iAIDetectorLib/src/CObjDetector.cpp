@@ -1,7 +1,10 @@
 #include "CObjDetector.h"
+#include <atomic>
 
 CObjDetector::CObjDetector(const ObjDetNetConfig& stObjDetNetConfig)
 	: m_stObjDetConfig(stObjDetNetConfig)
+	, m_NMSEngine(NMSConfig(stObjDetNetConfig.eNMSMethod, stObjDetNetConfig.fNMSThresh, stObjDetNetConfig.bClassAwareNMS,
+		stObjDetNetConfig.fSoftNMSSigma, stObjDetNetConfig.fConfThresh))
 {
 
 }
@@ -12,11 +15,181 @@ CObjDetector::~CObjDetector()
 	m_vClsNames.clear();
 }
 
+// Get the start positions of the tiles along one axis
+// @param[in] nLength: length of the frame along the axis
+// @param[in] nTile: length of the tile along the axis
+// @param[in] nOverlap: minimum overlap between the adjacent tiles
+// @param[out] vStarts: start positions of the tiles
+static void GetTileStarts(int nLength, int nTile, int nOverlap, std::vector<int>& vStarts)
+{
+	vStarts.clear();
+	if (nLength <= nTile)
+	{
+		vStarts.push_back(0);
+		return;
+	}
+
+	int nStep = _MAX(1, nTile - nOverlap);
+	int nTiles = (nLength - nTile + nStep - 1) / nStep + 1;
+	for (int i = 0; i < nTiles; i++)
+		vStarts.push_back((int)((int64_t)i * (nLength - nTile) / (nTiles - 1)));
+}
+
+// Detect objects in the overlapping tiles of the input frame at the full resolution
+// @param[in] cvFrame: input frame in BGR format
+// @param[out] vObjBoxes: bounding boxes of detected objects in the frame coordinates
+// @return: true if detection is successful, false otherwise. 
+// [Note]: - The active tiles are run by DetectBatch() as one batch or as TileConfig::nParallelRuns concurrent runs,
+//           and the boxes of all the tiles are merged by the cross-tile non-maximum suppression.
+//         - It can be called from several threads at the same time.
+bool CObjDetector::DetectTiled(const cv::Mat& cvFrame, ObjBoxArr& vObjBoxes)
+{
+	vObjBoxes.clear();
+	if (cvFrame.empty())
+		return false;
+
+	std::vector<cv::Rect> vTileRects;
+	GetTileRects(cvFrame.size(), vTileRects);
+
+	// Schedule the active tiles only. The whole frame is added as the last image if required
+	const std::vector<bool>& vActiveTiles = m_stTileConfig.vActiveTiles;
+	std::vector<cv::Mat> vImages;
+	std::vector<cv::Point> vOffsets;
+	for (int i = 0; i < int(vTileRects.size()); i++)
+	{
+		if (!vActiveTiles.empty() && (i >= int(vActiveTiles.size()) || !vActiveTiles[i]))
+			continue;
+
+		vImages.push_back(cvFrame(vTileRects[i]));
+		vOffsets.push_back(vTileRects[i].tl());
+	}
+
+	bool bSingleTile = (vTileRects.size() == 1 && vTileRects[0].size() == cvFrame.size());
+	if (m_stTileConfig.bFullFrame && !bSingleTile)
+	{
+		vImages.push_back(cvFrame);
+		vOffsets.push_back(cv::Point(0, 0));
+	}
+
+	int nImages = int(vImages.size());
+	if (nImages == 0)
+		return true;
+
+	std::vector<ObjBoxArr> vImageBoxes(nImages);
+	int nRuns = _MAX(1, _MIN(m_stTileConfig.nParallelRuns, nImages));
+	if (nRuns == 1)
+	{
+		if (!DetectBatch(vImages, vImageBoxes))
+			return false;
+	}
+	else
+	{
+		// Split the images into nRuns contiguous parts and run them at the same time on the session pool
+		std::atomic<bool> bSuccess(true);
+		cv::parallel_for_(cv::Range(0, nRuns), [&](const cv::Range& range) {
+			for (int r = range.start; r < range.end; r++)
+			{
+				int nStart = (int)((int64_t)r * nImages / nRuns);
+				int nEnd = (int)((int64_t)(r + 1) * nImages / nRuns);
+
+				std::vector<cv::Mat> vRunImages(vImages.begin() + nStart, vImages.begin() + nEnd);
+				std::vector<ObjBoxArr> vRunBoxes;
+				if (!DetectBatch(vRunImages, vRunBoxes))
+				{
+					bSuccess = false;
+					continue;
+				}
+
+				std::move(vRunBoxes.begin(), vRunBoxes.end(), vImageBoxes.begin() + nStart);
+			}
+		}, nRuns);
+
+		if (!bSuccess)
+			return false;
+	}
+
+	// Move the boxes of each tile into the frame coordinates and merge them
+	for (int i = 0; i < nImages; i++)
+	{
+		for (ObjBBox& stBox : vImageBoxes[i])
+		{
+			stBox.fX1 += vOffsets[i].x;
+			stBox.fY1 += vOffsets[i].y;
+			stBox.fX2 = _MIN(stBox.fX2 + vOffsets[i].x, (float)(cvFrame.cols - 1));
+			stBox.fY2 = _MIN(stBox.fY2 + vOffsets[i].y, (float)(cvFrame.rows - 1));
+			vObjBoxes.push_back(stBox);
+		}
+	}
+
+	NMSBoxes(&vObjBoxes);
+
+	return true;
+}
+
+// Set the configuration of the tiled detection
+// @param[in] stTileConfig: tile configuration
+// [Note]: If enabled, Detect() runs DetectTiled() instead of detecting on the whole frame.
+void CObjDetector::SetTileConfig(const TileConfig& stTileConfig)
+{
+	m_stTileConfig = stTileConfig;
+}
+
+// Get the configuration of the tiled detection
+// @return: tile configuration
+const TileConfig& CObjDetector::GetTileConfig() const
+{
+	return m_stTileConfig;
+}
+
+// Get the tiles of the frame of the given size
+// @param[in] cvFrameSize: frame size
+// @param[out] vTileRects: tile rectangles in row-major order. The index is the one of TileConfig::vActiveTiles
+// [Note]: The tiles are spread evenly so that they cover the frame with at least TileConfig::nOverlap pixels of overlap.
+void CObjDetector::GetTileRects(const cv::Size& cvFrameSize, std::vector<cv::Rect>& vTileRects) const
+{
+	vTileRects.clear();
+	if (cvFrameSize.width <= 0 || cvFrameSize.height <= 0)
+		return;
+
+	int nTileW = (m_stTileConfig.nTileW > 0) ? _MIN(m_stTileConfig.nTileW, cvFrameSize.width) : cvFrameSize.width;
+	int nTileH = (m_stTileConfig.nTileH > 0) ? _MIN(m_stTileConfig.nTileH, cvFrameSize.height) : cvFrameSize.height;
+
+	std::vector<int> vXStarts, vYStarts;
+	GetTileStarts(cvFrameSize.width, nTileW, m_stTileConfig.nOverlap, vXStarts);
+	GetTileStarts(cvFrameSize.height, nTileH, m_stTileConfig.nOverlap, vYStarts);
+
+	for (int nY : vYStarts)
+	{
+		for (int nX : vXStarts)
+			vTileRects.push_back(cv::Rect(nX, nY, nTileW, nTileH));
+	}
+}
+
 // Set the class names of objects which will be detected by the network
 // @param[in] vClsNames2Detect: class names
 void CObjDetector::SetClsNames2Detect(const ObjClsArr& vClsNames2Detect)
 {
 	m_vClsNames2Detect = vClsNames2Detect;
+	UpdateClsMask2Detect();
+}
+
+// Build the class ID bitmask and the list of class IDs to detect from the class names to detect
+// [Note] It should be called whenever m_vClsNames or m_vClsNames2Detect is changed.
+void CObjDetector::UpdateClsMask2Detect()
+{
+	int nClassNum = int(m_vClsNames.size());
+
+	m_vClsMask2Detect.assign((nClassNum + 63) / 64, 0);
+	m_vClsIDs2Detect.clear();
+
+	for (int k = 0; k < nClassNum; k++)
+	{
+		if (!IsClsName2Detect(m_vClsNames[k]))
+			continue;
+
+		m_vClsMask2Detect[k / 64] |= (uint64_t)1 << (k % 64);
+		m_vClsIDs2Detect.push_back(k);
+	}
 }
 
 // Draw the bounding boxes on the input frame
@@ -62,8 +235,8 @@ void CObjDetector::DrawBBox(cv::Mat& cvFrame, const ObjBoxArr& vBoxes, bool bDra
 		
 		if(bDrawScore)
 		{
-			// Round the score to 2 decimal places
-			std::string sLabel = cv::format("%.2f", bbox.fScore);
+			// Round the score to 2 decimal places. The tracked object is prefixed with its track ID
+			std::string sLabel = (bbox.nTrackID >= 0) ? cv::format("#%d %.2f", bbox.nTrackID, bbox.fScore) : cv::format("%.2f", bbox.fScore);
 			// Get the size of the text
 			int nBaseLine = 0;
 			cv::Size cvLableSize = cv::getTextSize(sLabel, nFont, (double)nThickness / 3, nThickness, &nBaseLine);
@@ -101,43 +274,10 @@ const ObjBoxArr& CObjDetector::GetObjBoxes() const
 // @param[in/out] pvBoxes: bounding boxes of detected objects before and after non-maximum suppression
 void CObjDetector::NMSBoxes(ObjBoxArr* pvDetObj)
 {
-	// Sort the detected objects by score
-	sort(pvDetObj->begin(), pvDetObj->end(), [](ObjBBox a, ObjBBox b) { return a.fScore > b.fScore; });
+	if (!pvDetObj)
+		return;
 
-	// Calculate the area of each detected object
-	std::vector<float> vArea(pvDetObj->size());
-	for (int i = 0; i < int(pvDetObj->size()); ++i)
-	{
-		vArea[i] = (pvDetObj->at(i).fX2 - pvDetObj->at(i).fX1 + 1)
-			* (pvDetObj->at(i).fY2 - pvDetObj->at(i).fY1 + 1);
-	}
-
-	std::vector<bool> vIsSupressed(pvDetObj->size(), false);
-	for (int i = 0; i < int(pvDetObj->size()); ++i)
-	{
-		if (vIsSupressed[i]) { continue; }
-		for (int j = i + 1; j < int(pvDetObj->size()); ++j)
-		{
-			if (vIsSupressed[j]) { continue; }
-			float fX1 = _MAX(pvDetObj->at(i).fX1, pvDetObj->at(j).fX1);
-			float fY1 = _MAX(pvDetObj->at(i).fY1, pvDetObj->at(j).fY1);
-			float fX2 = _MIN(pvDetObj->at(i).fX2, pvDetObj->at(j).fX2);
-			float fY2 = _MIN(pvDetObj->at(i).fY2, pvDetObj->at(j).fY2);
-
-			float fW = _MAX(float(0), fX2 - fX1 + 1);
-			float fH = _MAX(float(0), fY2 - fY1 + 1);
-			float fInterArea = fW * fH;
-			float fIOU = fInterArea / (vArea[i] + vArea[j] - fInterArea);
-
-			if (fIOU >= m_stObjDetConfig.fNMSThresh)
-			{
-				vIsSupressed[j] = true;
-			}
-		}
-	}
-	// return post_nms;
-	int idx_t = 0;
-	pvDetObj->erase(remove_if(pvDetObj->begin(), pvDetObj->end(), [&idx_t, &vIsSupressed](const ObjBBox& f) { return vIsSupressed[idx_t++]; }), pvDetObj->end());
+	m_NMSEngine.Run(*pvDetObj);
 }
 
 // Check if the class name is in the list of class names of objects which can be detected by the network
@@ -158,8 +298,6 @@ bool CObjDetector::IsClsID2Detect(const int nClsID) const
 {
 	if(nClsID < 0 || nClsID >= int(m_vClsNames.size()))
 		return false;
-	
-	const std::string& strClsName = m_vClsNames.at(nClsID);
 
-	return IsClsName2Detect(strClsName);
+	return (m_vClsMask2Detect[nClsID / 64] >> (nClsID % 64)) & 1;
 }
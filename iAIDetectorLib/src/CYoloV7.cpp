@@ -0,0 +1,293 @@
+﻿#include "CYoloV7.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#ifdef _SIMD_X86_
+#include <immintrin.h>
+#endif
+
+// Number of proposals whose objectness is filtered at once
+#define OBJECTNESS_CHUNK	256
+
+
+#ifdef _SIMD_X86_
+// AVX-512 version of FilterObjectness
+_TARGET_AVX512_ static int FilterObjectnessAVX512(const float* pObj, int nStride, int nCount, float fThresh, int* pCandIdx)
+{
+	__m512i vOfs = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(nStride));
+	__m512 vThresh = _mm512_set1_ps(fThresh);
+
+	int nCand = 0;
+	int i = 0;
+	for (; i <= nCount - 16; i += 16)
+	{
+		__m512 vObj = _mm512_i32gather_ps(vOfs, pObj + (size_t)i * nStride, 4);
+		unsigned int nMask = _mm512_cmp_ps_mask(vObj, vThresh, _CMP_GT_OQ);
+		for (int k = 0; nMask; k++, nMask >>= 1)
+		{
+			if (nMask & 1)
+				pCandIdx[nCand++] = i + k;
+		}
+	}
+
+	for (; i < nCount; i++)
+	{
+		if (pObj[(size_t)i * nStride] > fThresh)
+			pCandIdx[nCand++] = i;
+	}
+
+	return nCand;
+}
+
+// AVX2 version of FilterObjectness
+_TARGET_AVX2_ static int FilterObjectnessAVX2(const float* pObj, int nStride, int nCount, float fThresh, int* pCandIdx)
+{
+	__m256i vOfs = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(nStride));
+	__m256 vThresh = _mm256_set1_ps(fThresh);
+
+	int nCand = 0;
+	int i = 0;
+	for (; i <= nCount - 8; i += 8)
+	{
+		__m256 vObj = _mm256_i32gather_ps(pObj + (size_t)i * nStride, vOfs, 4);
+		unsigned int nMask = _mm256_movemask_ps(_mm256_cmp_ps(vObj, vThresh, _CMP_GT_OQ));
+		for (int k = 0; nMask; k++, nMask >>= 1)
+		{
+			if (nMask & 1)
+				pCandIdx[nCand++] = i + k;
+		}
+	}
+
+	for (; i < nCount; i++)
+	{
+		if (pObj[(size_t)i * nStride] > fThresh)
+			pCandIdx[nCand++] = i;
+	}
+
+	return nCand;
+}
+#endif
+
+// Find the proposals whose objectness is greater than the threshold
+// @param[in] pObj: objectness of the 1st proposal
+// @param[in] nStride: number of floats between the objectness of two adjacent proposals
+// @param[in] nCount: number of proposals
+// @param[in] fThresh: objectness threshold
+// @param[out] pCandIdx: indices of the candidate proposals in ascending order. It should hold nCount indices
+// @return: number of the candidate proposals
+static int FilterObjectness(const float* pObj, int nStride, int nCount, float fThresh, int* pCandIdx)
+{
+#ifdef _SIMD_X86_
+	static const bool s_bAVX512 = cv::checkHardwareSupport(CV_CPU_AVX512_SKX);
+	static const bool s_bAVX2 = cv::checkHardwareSupport(CV_CPU_AVX2);
+
+	if (s_bAVX512)
+		return FilterObjectnessAVX512(pObj, nStride, nCount, fThresh, pCandIdx);
+
+	if (s_bAVX2)
+		return FilterObjectnessAVX2(pObj, nStride, nCount, fThresh, pCandIdx);
+#endif
+
+	int nCand = 0;
+	for (int i = 0; i < nCount; i++)
+	{
+		if (pObj[(size_t)i * nStride] > fThresh)
+			pCandIdx[nCand++] = i;
+	}
+
+	return nCand;
+}
+
+
+CYoloV7::CYoloV7(const ObjDetNetConfig& stObjDetNetConfig, const NetDetailsConfig& stNetDetailsConfig)
+	: CInferer(stNetDetailsConfig)
+	, CObjDetector(stObjDetNetConfig)
+{
+
+}
+
+
+CYoloV7::~CYoloV7()
+{
+
+}
+
+// Preprocess the input image
+// @param[in] cvImg: input image to be preprocessed
+// @param[out] cvProcImg: preprocessed image
+void CYoloV7::PreProcess(const cv::Mat& cvImg, cv::Mat& cvProcImg)
+{
+	CInferer::PreProcessCore(cvImg, true, cvProcImg);
+}
+
+// Postprocess the tensor output of the network
+// @param cvOrgImgSize: original image size
+// @param pOutputTensorData: tensor data returned by the network
+// @return vDetObj: detected objects
+void CYoloV7::PostProcess(const cv::Size& cvOrgImgSize, const void* pTensorData, void* pPostProcessData)
+{
+	if (!pPostProcessData)
+		return;
+
+	float fRH = (float)cvOrgImgSize.height / m_nNetInputH;
+	float fRW = (float)cvOrgImgSize.width / m_nNetInputW;
+
+	const float* pData = (const float*)CInferer::PostProcessCore(pTensorData);
+
+
+	ObjBoxArr* pvDetObj = (ObjBoxArr*)pPostProcessData;
+
+	int nClassNum = _MIN(int(m_vClsNames.size()), m_nNetOutputs - 5);
+	int nClsIDs2Detect = int(m_vClsIDs2Detect.size());
+	if (nClassNum <= 0 || nClsIDs2Detect == 0)
+		return;
+
+	// [Note] The class score is not greater than 1, so the proposal whose objectness is not greater than the threshold
+	//        can not pass the threshold either. The objectness is filtered first without touching the class scores,
+	//        and only the enabled classes of the remaining proposals are evaluated.
+	bool bAllClasses = (nClsIDs2Detect >= nClassNum);
+	const int* pClsIDs2Detect = m_vClsIDs2Detect.data();
+
+	int vCandIdx[OBJECTNESS_CHUNK];
+	for (int nChunk = 0; nChunk < m_nNetProposals; nChunk += OBJECTNESS_CHUNK)
+	{
+		const float* pChunk = pData + (size_t)nChunk * m_nNetOutputs;
+		int nCand = FilterObjectness(pChunk + 4, m_nNetOutputs, _MIN(OBJECTNESS_CHUNK, m_nNetProposals - nChunk),
+			m_stObjDetConfig.fConfThresh, vCandIdx);
+
+		for (int c = 0; c < nCand; c++)
+		{
+			const float* pProposal = pChunk + (size_t)vCandIdx[c] * m_nNetOutputs;
+			const float* pClsScores = pProposal + 5;
+			float fScore = pProposal[4];
+
+			int nMaxClassID = 0;
+			float fMaxClassScore = 0;
+			if (bAllClasses)
+			{
+				for (int k = 0; k < nClassNum; k++)
+				{
+					if (pClsScores[k] > fMaxClassScore)
+					{
+						fMaxClassScore = pClsScores[k];
+						nMaxClassID = k;
+					}
+				}
+			}
+			else
+			{
+				for (int k = 0; k < nClsIDs2Detect; k++)
+				{
+					int nClsID = pClsIDs2Detect[k];
+					if (nClsID < nClassNum && pClsScores[nClsID] > fMaxClassScore)
+					{
+						fMaxClassScore = pClsScores[nClsID];
+						nMaxClassID = nClsID;
+					}
+				}
+			}
+
+			fMaxClassScore *= fScore;
+			if (fMaxClassScore > m_stObjDetConfig.fConfThresh)
+			{
+				float cx = pProposal[0] * fRW;
+				float cy = pProposal[1] * fRH;
+				float w = pProposal[2] * fRW; 
+				float h = pProposal[3] * fRH;
+
+				float xmin = cx - 0.5 * w; xmin = _MAX(0, xmin);
+				float ymin = cy - 0.5 * h; ymin = _MAX(0, ymin);
+				float xmax = cx + 0.5 * w; xmax = _MIN(cvOrgImgSize.width - 1, xmax); 
+				float ymax = cy + 0.5 * h; ymax = _MIN(cvOrgImgSize.height - 1, ymax);
+
+				pvDetObj->push_back(ObjBBox{ xmin, ymin, xmax, ymax, fMaxClassScore, nMaxClassID });
+			}
+		}
+	}
+
+
+	NMSBoxes(pvDetObj);
+}
+
+
+// Detect objects in the input frame
+// @param[in] cvFrame: input frame in BGR format
+// @return: true if detection is successful, false otherwise. 
+// [Note]: The bounding boxes of detected objects can be obtained by calling GetObjBoxes().
+bool CYoloV7::Detect(const cv::Mat& cvFrame)
+{
+	return Detect(cvFrame, m_vObjBoxes);
+}
+
+// Detect objects in the input frame into the given result
+// @param[in] cvFrame: input frame in BGR format
+// @param[out] vObjBoxes: bounding boxes of detected objects
+// @return: true if detection is successful, false otherwise. 
+// [Note]: It does not touch the state of the detector, so it can be called from several threads at the same time.
+bool CYoloV7::Detect(const cv::Mat& cvFrame, ObjBoxArr& vObjBoxes)
+{
+	if (m_stTileConfig.bEnable)
+		return DetectTiled(cvFrame, vObjBoxes);
+
+	vObjBoxes.clear();
+
+	if (!CInferer::Inference(cvFrame, (void*)&vObjBoxes))
+	{
+		vObjBoxes.clear();
+		return false;
+	}
+
+	return true;
+}
+
+// Detect objects in several frames at once
+// @param[in] vFrames: input frames in BGR format
+// @param[out] vObjBoxes: bounding boxes of detected objects in each frame
+// @return: true if detection is successful, false otherwise. 
+// [Note]: The frames are packed into as few network runs as possible. It can be called from several threads at the same time.
+bool CYoloV7::DetectBatch(const std::vector<cv::Mat>& vFrames, std::vector<ObjBoxArr>& vObjBoxes)
+{
+	vObjBoxes.assign(vFrames.size(), ObjBoxArr());
+
+	std::vector<void*> vResultData(vFrames.size());
+	for (size_t i = 0; i < vFrames.size(); i++)
+		vResultData[i] = (void*)&vObjBoxes[i];
+
+	if (!CInferer::BatchInference(vFrames, vResultData))
+	{
+		vObjBoxes.assign(vFrames.size(), ObjBoxArr());
+		return false;
+	}
+
+	return true;
+}
+
+// Read the class names from the given file
+// @param[in] sClassPath: path to the class names file. One class name per line
+// @return: true if successfully read the class names, false otherwise
+bool CYoloV7::ReadClassNames(const std::string& sClassPath)
+{
+	m_vClsNames.clear();
+	try
+	{
+		std::ifstream ifs(sClassPath.c_str());
+		std::string line;
+		while (std::getline(ifs, line)) m_vClsNames.push_back(line);
+
+		UpdateClsMask2Detect();
+	}
+	catch (std::exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+		return false;
+	}
+	catch (...)
+	{
+		std::cout << "Unknown exception occurred when reading class names." << std::endl;
+		return false;
+	}
+
+	return true;
+}
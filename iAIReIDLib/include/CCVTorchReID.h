@@ -0,0 +1,21 @@
+#pragma once
+#include "type_define.h"
+#include <opencv2/opencv.hpp>
+#include "CTorchReID.h"
+#include "CCVInferer.h"
+
+// Class for TorchReID deep network using OpenCV DNN inference engine
+class IAIREIDLIB_API CCVTorchReID : public CTorchReID, public CCVInferer
+{
+public:
+	CCVTorchReID(const ReIDNetConfig& stReIDNetConfig, const NetDetailsConfig& stNetDetailsConfig);
+	~CCVTorchReID();
+
+	// Read the onnx model from the given path
+	// @param[in] sModelPath: path to the onnx model
+	// @param[in] sPairedFilePath: path to the paired file. Not used for this case
+	// @param[in] sLogTitle: title of the log
+	// @return: true if successfully read the model, false otherwise
+	virtual bool ReadModel(const std::string& sModelPath, const std::string& sPairedFilePath = "", const std::string& sLogTitle = "opencv-dnn");
+
+};
@@ -0,0 +1,116 @@
+#pragma once
+#include "type_define.h"
+#include <opencv2/opencv.hpp>
+#include <map>
+#include <mutex>
+
+class CReID;
+
+// Structure to hold the cached features of one track
+typedef struct _EmbeddingEntry
+{
+	std::vector<float>	vFeature;		// normalised running aggregate of the extracted features
+	cv::Mat				cvThumb;		// thumbnail of the crop of the latest extraction
+	float				fHeight;		// box height of the latest extraction
+	uint64_t			nExtractFrame;	// frame of the latest extraction
+	uint64_t			nSeenFrame;		// frame where the track is seen lastly
+	int					nSamples;		// number of the extracted features in the aggregate
+
+	_EmbeddingEntry()
+	{
+		fHeight = 0.0f;
+		nExtractFrame = 0;
+		nSeenFrame = 0;
+		nSamples = 0;
+	}
+}EmbeddingEntry;
+
+// Structure to hold the lookup of the objects of one frame between CEmbeddingCache::Lookup() and CEmbeddingCache::Complete()
+typedef struct _EmbeddingLookup
+{
+	uint64_t							nFrame;			// frame counter of the lookup
+	std::vector<cv::Mat>				vThumbs;		// thumbnail of the crop of each object
+	std::vector<std::vector<float>>		vCached;		// cached feature of each reused object. Empty for the objects to extract
+	std::vector<int>					vExtractIdx;	// indices of the objects to extract
+
+	_EmbeddingLookup()
+	{
+		nFrame = 0;
+	}
+}EmbeddingLookup;
+
+// Class of the re-id embedding cache keyed by the track ID
+// The features of a tracked object are extracted again only on a new track, on a large scale or appearance change against
+// the latest extraction, or every nRefreshInterval frames. Otherwise the running aggregate of the extracted features is reused,
+// so the cost of the re-id scales with the number of the new objects instead of the objects times the frames.
+// [Note] - The objects without track ID (nTrackID < 0) are extracted on every frame and are not cached.
+//        - The frames are counted by the calls of GetFeatures(). Create one cache per camera.
+class IAIREIDLIB_API CEmbeddingCache
+{
+public:
+	CEmbeddingCache(const EmbeddingCacheConfig& stConfig);
+	~CEmbeddingCache();
+
+	// Get the features of the objects of the next frame
+	// @param[in] pReID: ReID network extracting the features of the new and changed objects in one batch
+	// @param[in] vObjBoxes: objects of the frame carrying the track IDs
+	// @param[in] vCrops: crops of the objects from the frame. Same order as vObjBoxes
+	// @param[out] cvFeatures: feature matrix of CV_32F. Each row is the normalised feature vector of the relevant object
+	// @return: true if the features are successfully obtained, false otherwise
+	// [Note] It can be called from several threads at the same time. The network runs out of the lock.
+	bool GetFeatures(CReID* pReID, const ObjBoxArr& vObjBoxes, const std::vector<cv::Mat>& vCrops, cv::Mat& cvFeatures);
+
+	// Look up the objects of the next frame, deciding the objects to extract
+	// @param[in] vObjBoxes: objects of the frame carrying the track IDs
+	// @param[in] vCrops: crops of the objects from the frame. Same order as vObjBoxes
+	// @param[out] stLookup: lookup of the frame. The crops of stLookup.vExtractIdx should be extracted for Complete()
+	// @return: true if the objects are successfully looked up, false otherwise
+	// [Note] The extraction is left to the caller, so the crops of several caches can be extracted in one batch run.
+	bool Lookup(const ObjBoxArr& vObjBoxes, const std::vector<cv::Mat>& vCrops, EmbeddingLookup& stLookup);
+
+	// Complete the features of the objects looked up by Lookup()
+	// @param[in] stLookup: lookup of the frame
+	// @param[in] vObjBoxes: objects of the frame given to Lookup()
+	// @param[in] cvExtracted: features of the crops of stLookup.vExtractIdx. Each row is the normalised feature vector
+	// @param[out] cvFeatures: feature matrix of CV_32F. Each row is the normalised feature vector of the relevant object
+	// @return: true if the features are successfully obtained, false otherwise
+	bool Complete(const EmbeddingLookup& stLookup, const ObjBoxArr& vObjBoxes, const cv::Mat& cvExtracted, cv::Mat& cvFeatures);
+
+	// Remove all the tracks
+	void Reset();
+
+	// Get the counters of the cache
+	// @return: counters of the cache
+	EmbeddingCacheStats GetStats() const;
+
+	// Get the configuration of the cache
+	// @return: configuration
+	const EmbeddingCacheConfig& GetConfig() const;
+
+private:
+	// Make the thumbnail of the crop to detect the appearance change
+	// @param[in] cvCrop: crop of the object
+	// @param[out] cvThumb: thumbnail of the crop
+	void MakeThumb(const cv::Mat& cvCrop, cv::Mat& cvThumb) const;
+
+	// Check whether the features of the track should be extracted again
+	// @param[in] stEntry: cached features of the track
+	// @param[in] stBox: box of the track on the frame
+	// @param[in] cvThumb: thumbnail of the crop on the frame
+	// @param[in] nFrame: frame counter
+	// @return: true if the features should be extracted again, false if the cached ones can be reused
+	bool IsStale(const EmbeddingEntry& stEntry, const ObjBBox& stBox, const cv::Mat& cvThumb, uint64_t nFrame) const;
+
+	// Add the extracted feature into the aggregate of the track
+	// @param[in/out] stEntry: cached features of the track
+	// @param[in] pFeature: normalised extracted feature
+	// @param[in] nDim: dimension of the feature
+	void Aggregate(EmbeddingEntry& stEntry, const float* pFeature, int nDim) const;
+
+private:
+	EmbeddingCacheConfig			m_stConfig;		// configuration of the cache
+	std::map<int, EmbeddingEntry>	m_mapEntries;	// cached features indexed by the track ID
+	uint64_t						m_nFrame;		// number of the frames given to GetFeatures()
+	EmbeddingCacheStats				m_stStats;		// counters of the cache
+	mutable std::mutex				m_mutex;		// mutex to protect the entries and the counters
+};
@@ -0,0 +1,107 @@
+#pragma once
+#include "type_define.h"
+#include <cstddef>
+
+// Structure to hold the query prepared for the similarity to the compressed embeddings
+typedef struct _FeatureCodecQuery
+{
+	std::vector<float>		vQuery;			// query feature vector. eFcFloat32 and eFcFloat16
+	std::vector<int8_t>		vInt8Query;		// query quantised by the scales of the codec. eFcInt8
+	float					fInt8Scale;		// scale of the integer inner product to the float one. eFcInt8
+	std::vector<float>		vTable;			// similarity of each subspace of the query to each centroid. eFcPQ
+	float					fNorm2;			// squared norm of the query
+
+	_FeatureCodecQuery()
+	{
+		fInt8Scale = 0.0f;
+		fNorm2 = 0.0f;
+	}
+}FeatureCodecQuery;
+
+// Class of the compressed form of the embeddings
+// The similarity between a query and a compressed embedding is computed on the compressed form without decoding it.
+// The query is prepared once per search: quantised by the same scales for eFcInt8, whose inner product is computed on the
+// 8-bit integers by the VNNI or AVX2 instructions, and turned into the table of its similarity to every centroid of every
+// subspace for eFcPQ, so the similarity to an embedding is the sum of one table entry per subspace.
+// [Note] eFcInt8 and eFcPQ are trained on the sample embeddings before the encoding.
+class IAIREIDLIB_API CFeatureCodec
+{
+public:
+	CFeatureCodec(const FeatureCodecConfig& stConfig, int nDim, E_FeatureMetric eMetric);
+	~CFeatureCodec();
+
+	// Train the codec on the sample embeddings
+	// @param[in] pFeatures: 1st sample embedding
+	// @param[in] nRows: number of the sample embeddings
+	// @param[in] nStride: distance between the sample embeddings in floats
+	// @return: true if the codec is trained successfully, false otherwise
+	// [Note] - eFcInt8 takes the range of each dimension, and eFcPQ runs k-means of 256 centroids per subspace.
+	//        - It fails for fewer sample embeddings than GetMinTrainRows().
+	bool Train(const float* pFeatures, int nRows, size_t nStride);
+
+	// Check whether the codec is ready to encode
+	// @return: true if the codec is trained or needs no training, false otherwise
+	bool IsTrained() const;
+
+	// Get the minimum number of the sample embeddings to train the codec on
+	// @return: number of the sample embeddings. 0 if the codec needs no training
+	int GetMinTrainRows() const;
+
+	// Get the size of one compressed embedding
+	// @return: size in bytes
+	size_t GetCodeSize() const;
+
+	// Compress the embedding
+	// @param[in] pFeature: embedding of nDim floats
+	// @param[out] pCode: compressed embedding of GetCodeSize() bytes
+	void Encode(const float* pFeature, uint8_t* pCode) const;
+
+	// Restore the embedding from the compressed form
+	// @param[in] pCode: compressed embedding
+	// @param[out] pFeature: approximate embedding of nDim floats
+	void Decode(const uint8_t* pCode, float* pFeature) const;
+
+	// Prepare the query for the similarity to the compressed embeddings
+	// @param[in] pQuery: query feature vector of nDim floats
+	// @param[out] stQuery: prepared query
+	void PrepareQuery(const float* pQuery, FeatureCodecQuery& stQuery) const;
+
+	// Compute the similarity between the prepared query and the compressed embedding
+	// @param[in] stQuery: query prepared by PrepareQuery()
+	// @param[in] pCode: compressed embedding
+	// @return: similarity of the metric of the codec
+	float Similarity(const FeatureCodecQuery& stQuery, const uint8_t* pCode) const;
+
+	// Compute the similarity between the prepared query and each of the compressed embeddings
+	// @param[in] stQuery: query prepared by PrepareQuery()
+	// @param[in] pCodes: 1st compressed embedding
+	// @param[in] nRows: number of the compressed embeddings
+	// @param[in] nCodeStride: distance between the compressed embeddings in bytes
+	// @param[out] pSim: similarity of each compressed embedding
+	void Similarities(const FeatureCodecQuery& stQuery, const uint8_t* pCodes, int nRows, size_t nCodeStride, float* pSim) const;
+
+	// Get the configuration of the codec
+	// @return: configuration
+	const FeatureCodecConfig& GetConfig() const;
+
+private:
+	// Turn the inner product and the squared norms into the similarity of the metric
+	// @param[in] fDot: inner product
+	// @param[in] fNorm2A: squared norm of one vector
+	// @param[in] fNorm2B: squared norm of the other vector
+	// @return: similarity
+	float DotToSimilarity(float fDot, float fNorm2A, float fNorm2B) const;
+
+private:
+	FeatureCodecConfig	m_stConfig;			// codec configuration
+	int					m_nDim;				// dimension of the embeddings
+	E_FeatureMetric		m_eMetric;			// similarity metric
+	size_t				m_nCodeSize;		// size of one compressed embedding in bytes
+	bool				m_bTrained;			// true if the codec is ready to encode
+
+	std::vector<float>	m_vInt8Scales;		// eFcInt8: value of the integer 1 of each dimension
+	int					m_nSubspaces;		// eFcPQ: number of subspaces
+	int					m_nSubDim;			// eFcPQ: dimension of each subspace. The last one is padded by zeros
+	int					m_nCentroids;		// eFcPQ: number of centroids per subspace
+	std::vector<float>	m_vPQCentroids;		// eFcPQ: centroids of each subspace. m_nSubspaces x 256 x m_nSubDim floats
+};
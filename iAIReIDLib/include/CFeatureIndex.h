@@ -0,0 +1,181 @@
+#pragma once
+#include "CFeatureCodec.h"
+#include <shared_mutex>
+
+class CGalleryStore;
+
+// Abstract base class of the nearest-neighbour index of the gallery
+// The index either owns a copy of the rows given by Add(), or is attached to a CGalleryStore and reads the rows from the
+// mapped file, so a disk-resident gallery is indexed without loading it. The rows are identified by the order they are added,
+// which is the row index of the store for the attached index. The derived classes implement the approximate search, and
+// SearchExact() is the linear scan of all the rows to validate them.
+// With a codec other than eFcFloat32, the index keeps only the compressed rows in memory and searches them in the compressed
+// form. The index attached to a store then reranks the top nRerank candidates by the uncompressed rows of the store.
+// Without Train(), the rows are kept uncompressed and scanned exactly until the codec can be trained on them, and they are
+// compressed once enough rows are added.
+// [Note] - The adds and the searches can be called from several threads at the same time. The adds are serialised.
+//        - The rows of the cosine metric should be normalised in advance, as CFeatureMatcher.
+class IAIREIDLIB_API CFeatureIndex
+{
+public:
+	CFeatureIndex(const FeatureIndexConfig& stConfig, int nDim);
+	virtual ~CFeatureIndex();
+
+	// Train the index on the sample rows
+	// @param[in] pFeatures: 1st sample row
+	// @param[in] nRows: number of the sample rows
+	// @param[in] nStride: distance between the sample rows in floats
+	// @return: true if the index is trained successfully, false otherwise
+	// [Note] - The IVF index and the eFcInt8 and eFcPQ codecs need it. Otherwise they are trained once enough rows are added.
+	//        - The codecs fail for fewer rows than CFeatureCodec::GetMinTrainRows().
+	//        - It fails after the rows are added.
+	bool Train(const float* pFeatures, int nRows, size_t nStride);
+
+	// Add the rows to the index
+	// @param[in] pFeatures: 1st row
+	// @param[in] nRows: number of the rows
+	// @param[in] nStride: distance between the rows in floats
+	// @return: true if the rows are added successfully, false otherwise
+	// [Note] The rows are copied or compressed into the index. It fails for the index attached to a store.
+	bool Add(const float* pFeatures, int nRows, size_t nStride);
+
+	// Add the rows of the store appended since the last call
+	// @param[in] cStore: opened gallery store of the same dimension and metric
+	// @return: true if the rows are added successfully, false otherwise
+	// [Note] - The index is attached to the store on the first call, and reads the rows from it since then.
+	//          The store should be kept opened while the index is used. It fails for another store or the index owning rows.
+	//        - The appends of the store wait until the rows are added.
+	bool Add(const CGalleryStore& cStore);
+
+	// Search the top K rows for the query
+	// @param[in] pQuery: normalised query feature vector
+	// @param[in] nTopK: maximum number of rows to return
+	// @param[in] fSimThresh: minimum similarity to return
+	// @param[out] vReIDRes: top K rows in the descending order of the similarity. nImgID is the row ID
+	// @return: true if the search is performed successfully, false otherwise
+	bool Search(const float* pQuery, int nTopK, float fSimThresh, ReIDResArr& vReIDRes) const;
+
+	// Search the top K rows for the query by the linear scan of all the rows
+	// @param[in] pQuery: normalised query feature vector
+	// @param[in] nTopK: maximum number of rows to return
+	// @param[in] fSimThresh: minimum similarity to return
+	// @param[out] vReIDRes: top K rows in the descending order of the similarity. nImgID is the row ID
+	// @return: true if the search is performed successfully, false otherwise
+	// [Note] The compressed rows are scanned for the compressed index not attached to a store.
+	bool SearchExact(const float* pQuery, int nTopK, float fSimThresh, ReIDResArr& vReIDRes) const;
+
+	// Measure the recall of Search() against SearchExact()
+	// @param[in] pQueries: 1st row of the query feature matrix
+	// @param[in] nQueries: number of queries
+	// @param[in] nQueryStride: distance between the rows of the queries in floats
+	// @param[in] nTopK: number of rows to compare
+	// @return: average ratio of the exact top K rows found by Search(). -1 if it fails
+	float MeasureRecall(const float* pQueries, int nQueries, size_t nQueryStride, int nTopK) const;
+
+	// Get the number of the rows in the index
+	// @return: number of the rows
+	int64_t GetCount() const;
+
+	// Get the dimension of the rows
+	// @return: dimension
+	int GetDim() const;
+
+	// Get the configuration of the index
+	// @return: configuration
+	const FeatureIndexConfig& GetConfig() const;
+
+	// Get the memory of the rows kept by the index
+	// @return: size of the uncompressed or the compressed rows in bytes. 0 for the uncompressed rows of the attached store
+	size_t GetRowMemory() const;
+
+protected:
+	// Train the index on the sample rows. The index is locked
+	// @param[in] pFeatures: 1st sample row
+	// @param[in] nRows: number of the sample rows
+	// @param[in] nStride: distance between the sample rows in floats
+	// @return: true if the index is trained successfully, false otherwise
+	// [Note] The default implementation does nothing.
+	virtual bool TrainCore(const float* pFeatures, int nRows, size_t nStride);
+
+	// Index the rows which are already readable by GetRow(). The index is locked
+	// @param[in] nFirst: ID of the first row
+	// @param[in] nRows: number of the rows
+	// @return: true if the rows are indexed successfully, false otherwise
+	virtual bool AddCore(int nFirst, int nRows) = 0;
+
+	// Search the top K rows for the query. The index is locked and holds the rows
+	// @param[in] pQuery: normalised query feature vector
+	// @param[in] nTopK: maximum number of rows to return. Greater than 0
+	// @param[in] fSimThresh: minimum similarity to return
+	// @param[out] vReIDRes: top K rows in the descending order of the similarity. nImgID is the row ID
+	virtual void SearchCore(const float* pQuery, int nTopK, float fSimThresh, ReIDResArr& vReIDRes) const = 0;
+
+	// Search the top K rows for the query by the linear scan. The index is locked and holds the rows
+	// @param[in] pQuery: normalised query feature vector
+	// @param[in] nTopK: maximum number of rows to return. Greater than 0
+	// @param[in] fSimThresh: minimum similarity to return
+	// @param[out] vReIDRes: top K rows in the descending order of the similarity. nImgID is the row ID
+	void SearchExactCore(const float* pQuery, int nTopK, float fSimThresh, ReIDResArr& vReIDRes) const;
+
+	// Get the uncompressed row
+	// @param[in] nID: row ID
+	// @return: address of the row. nullptr if only the compressed row is kept
+	// [Note] The rows being added are always uncompressed during AddCore().
+	const float* GetRow(int nID) const;
+
+	// Get the uncompressed row, or decode the compressed one
+	// @param[in] nID: row ID
+	// @param[in] vBuffer: buffer of the decoded row
+	// @return: address of the row
+	const float* GetRow(int nID, std::vector<float>& vBuffer) const;
+
+	// Prepare the query for Similarity()
+	// @param[in] pQuery: query feature vector
+	// @param[out] stQuery: prepared query
+	void PrepareQuery(const float* pQuery, FeatureCodecQuery& stQuery) const;
+
+	// Compute the similarity between the prepared query and the row, in the compressed form for the compressed index
+	// @param[in] stQuery: query prepared by PrepareQuery()
+	// @param[in] nID: row ID
+	// @return: similarity of the metric of the index
+	float Similarity(const FeatureCodecQuery& stQuery, int nID) const;
+
+	// Compute the similarity between the feature vector and the row, decoded for the compressed index
+	// @param[in] pFeature: feature vector
+	// @param[in] nID: row ID
+	// @param[in] vBuffer: buffer of the decoded row
+	// @return: similarity of the metric of the index
+	float RowSimilarity(const float* pFeature, int nID, std::vector<float>& vBuffer) const;
+
+	// Prefetch the row or the compressed row into the cache, so the scattered rows are loaded in parallel
+	// @param[in] nID: row ID
+	void PrefetchRow(int nID) const;
+
+private:
+	// Compress the rows which are already readable by GetRow(), training the codec on all the rows once there are enough
+	// @param[in] nFirst: ID of the first row
+	// @param[in] nRows: number of the rows
+	// @return: true if the rows are compressed successfully, kept uncompressed until the training or the index is not
+	//          compressed, false otherwise
+	// [Note] All the rows added before the training are compressed with the rows.
+	bool CompressRows(int nFirst, int nRows);
+
+	// Check whether the rows are kept in the compressed form
+	// @return: true if the index has a trained codec, false otherwise
+	bool IsCompressed() const;
+
+protected:
+	FeatureIndexConfig			m_stConfig;		// index configuration
+	int							m_nDim;			// dimension of the rows
+	size_t						m_nStride;		// distance between the rows in floats
+	int							m_nCount;		// number of the rows in the index
+
+	std::vector<float>			m_vFeatures;	// rows owned by the index. Only the rows being added once the rows are compressed
+	int							m_nFeatureFirst;	// ID of the first row of m_vFeatures
+	const CGalleryStore*		m_pStore;		// store the index is attached to. nullptr if the index owns the rows
+
+	CFeatureCodec*				m_pCodec;		// codec of the compressed rows. nullptr for eFcFloat32
+	std::vector<uint8_t>		m_vCodes;		// compressed rows
+
+	mutable std::shared_mutex	m_mutex;		// mutex between the searches and the adds
+};
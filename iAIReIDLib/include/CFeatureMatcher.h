@@ -0,0 +1,71 @@
+#pragma once
+#include "type_define.h"
+#include <cstddef>
+
+// Class of the similarity kernels between the query feature and the gallery feature matrix
+// The gallery is one row-major matrix given by its pointer, rows and row stride, so the cv::Mat features and the other
+// gallery stores share the same kernels. The similarities are computed by one matrix product blocked over several queries
+// and rows with the SIMD instructions selected at runtime.
+class IAIREIDLIB_API CFeatureMatcher
+{
+public:
+	// Compute the similarity between two feature vectors
+	// @param[in] pFeatureA: 1st feature vector
+	// @param[in] pFeatureB: 2nd feature vector
+	// @param[in] nDim: dimension of the feature vectors
+	// @param[in] eMetric: similarity metric
+	// @return: similarity
+	// [Note] It is for the scattered rows, such as the graph search. Use Similarities() for the rows of a matrix.
+	static float Similarity(const float* pFeatureA, const float* pFeatureB, int nDim, E_FeatureMetric eMetric);
+
+	// Compute the similarity between the query feature and each row of the gallery
+	// @param[in] pQuery: query feature vector
+	// @param[in] pGallery: 1st row of the gallery feature matrix
+	// @param[in] nRows: number of rows of the gallery
+	// @param[in] nDim: dimension of the feature vectors
+	// @param[in] nStride: distance between the rows of the gallery in floats. It is nDim for the continuous matrix
+	// @param[in] eMetric: similarity metric
+	// @param[out] pSim: similarity of each row
+	// [Note] eFmCosine is the inner product, so the feature vectors should be normalised in advance.
+	static void Similarities(const float* pQuery, const float* pGallery, int nRows, int nDim, size_t nStride,
+		E_FeatureMetric eMetric, float* pSim);
+
+	// Compute the similarity between each query and each row of the gallery by one matrix-matrix product
+	// @param[in] pQueries: 1st row of the query feature matrix
+	// @param[in] nQueries: number of queries
+	// @param[in] nQueryStride: distance between the rows of the queries in floats
+	// @param[in] pGallery: 1st row of the gallery feature matrix
+	// @param[in] nRows: number of rows of the gallery
+	// @param[in] nDim: dimension of the feature vectors
+	// @param[in] nStride: distance between the rows of the gallery in floats. It is nDim for the continuous matrix
+	// @param[in] eMetric: similarity metric
+	// @param[out] pSim: similarity matrix of nQueries x nRows. Row q holds the similarities of query q
+	// [Note] eFmCosine is the inner product, so the feature vectors should be normalised in advance.
+	static void SimilarityMatrix(const float* pQueries, int nQueries, size_t nQueryStride, const float* pGallery, int nRows, int nDim,
+		size_t nStride, E_FeatureMetric eMetric, float* pSim);
+
+	// Select the top K rows in the descending order of the similarity
+	// @param[in] pSim: similarity of each row
+	// @param[in] nRows: number of rows
+	// @param[in] nTopK: maximum number of rows to select
+	// @param[in] fSimThresh: minimum similarity to select
+	// @param[out] vReIDRes: selected rows. nImgID is the row index
+	// [Note] The rows of the same similarity are ordered by the row index.
+	static void SelectTopK(const float* pSim, int nRows, int nTopK, float fSimThresh, ReIDResArr& vReIDRes);
+
+	// Merge the top K rows of a chunk of the gallery into the running top K rows
+	// @param[in] vChunkRes: top K rows of the chunk. nImgID is the row index in the chunk
+	// @param[in] nOffset: row index of the first row of the chunk
+	// @param[in] nTopK: maximum number of rows to keep
+	// @param[in/out] vReIDRes: running top K rows. nImgID is the row index in the gallery
+	// [Note] The rows of the same similarity are ordered by the row index.
+	static void MergeTopK(const ReIDResArr& vChunkRes, int64_t nOffset, int nTopK, ReIDResArr& vReIDRes);
+
+	// Normalise the feature vector by L2 norm
+	// @param[in] pOrgFeature: original feature vector
+	// @param[in] nDim: dimension of the feature vector
+	// @param[out] pNorFeature: normalised feature vector. It can be the same buffer as pOrgFeature
+	// [Note] The AVX2 version sums in another order, so the features normalised on the CPUs with and without AVX2 match within
+	//        the rounding error of the sum, not bitwise.
+	static void L2Normalise(const float* pOrgFeature, int nDim, float* pNorFeature);
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include "CFeatureIndex.h"
+
+// Class of the exact index scanning all the rows
+// It is the reference of the approximate indexes, and the fastest for the galleries up to about a hundred thousand rows.
+class IAIREIDLIB_API CFlatIndex : public CFeatureIndex
+{
+public:
+	CFlatIndex(const FeatureIndexConfig& stConfig, int nDim);
+	~CFlatIndex();
+
+protected:
+	// Index the rows which are already readable by GetRow(). The index is locked
+	// @param[in] nFirst: ID of the first row
+	// @param[in] nRows: number of the rows
+	// @return: true if the rows are indexed successfully, false otherwise
+	virtual bool AddCore(int nFirst, int nRows);
+
+	// Search the top K rows for the query. The index is locked and holds the rows
+	// @param[in] pQuery: normalised query feature vector
+	// @param[in] nTopK: maximum number of rows to return. Greater than 0
+	// @param[in] fSimThresh: minimum similarity to return
+	// @param[out] vReIDRes: top K rows in the descending order of the similarity. nImgID is the row ID
+	virtual void SearchCore(const float* pQuery, int nTopK, float fSimThresh, ReIDResArr& vReIDRes) const;
+};
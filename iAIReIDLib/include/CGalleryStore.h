@@ -0,0 +1,134 @@
+#pragma once
+#include "type_define.h"
+#include <opencv2/opencv.hpp>
+#include <shared_mutex>
+
+// Structure to hold one memory-mapped file
+typedef struct _MappedFile
+{
+	intptr_t	hFile;		// handle (Windows) or descriptor (POSIX) of the file. -1 if not opened
+	intptr_t	hMapping;	// handle of the file mapping object. Windows only
+	uint8_t*	pData;		// address of the mapped view. nullptr if not mapped
+	uint64_t	nSize;		// size of the mapped view in bytes
+
+	_MappedFile()
+	{
+		hFile = -1;
+		hMapping = 0;
+		pData = nullptr;
+		nSize = 0;
+	}
+}MappedFile;
+
+// Class of the persistent embedding store of the ReID gallery
+// The embeddings are kept in a memory-mapped binary file of fixed-stride rows, so millions of them are loaded at once
+// without the re-inference of the images, and CReID searches them in place without copying.
+// - <path>      : page-sized header (model ID, dimension, metric, count) followed by the rows. Each row is padded to
+//                 a multiple of 64 bytes, so every row starts on a cache line.
+// - <path>.meta : side table of GalleryMeta (camera, timestamp, track ID and label) in the same order as the rows.
+// [Note] - The files grow by doubling, and the count in the header is updated after the row is written,
+//          so a store closed abruptly keeps all the rows appended before the last count.
+//        - One process appends to a store at a time. The searches take LockRead() while the appends remap the files.
+class IAIREIDLIB_API CGalleryStore
+{
+public:
+	CGalleryStore();
+	~CGalleryStore();
+
+	// Open the store, or create it if the file does not exist
+	// @param[in] sPath: path of the store file. The side table is <sPath>.meta
+	// @param[in] sModelID: ID of the model extracting the embeddings. Empty to accept the ID of the existing store
+	// @param[in] nDim: dimension of the embeddings. 0 or less to accept the dimension of the existing store
+	// @param[in] eMetric: similarity metric of the embeddings. eFmUnknown to accept the metric of the existing store
+	// @param[in] bReadOnly: true to open the existing store for the search only
+	// @return: true if the store is opened successfully, false otherwise
+	// [Note] The existing store is rejected if its model ID, dimension or metric differs from the given one.
+	bool Open(const std::string& sPath, const std::string& sModelID, int nDim, E_FeatureMetric eMetric, bool bReadOnly = false);
+
+	// Write the header and close the store
+	void Close();
+
+	// Check whether the store is opened
+	// @return: true if the store is opened, false otherwise
+	bool IsOpen() const;
+
+	// Append one embedding to the store
+	// @param[in] pFeature: normalised embedding of GetDim() floats
+	// @param[in] stMeta: metadata of the embedding
+	// @return: true if the embedding is appended successfully, false otherwise
+	bool Append(const float* pFeature, const GalleryMeta& stMeta);
+
+	// Append the embeddings to the store
+	// @param[in] cvFeatures: embedding matrix of CV_32F. Each row is a normalised embedding of GetDim() floats
+	// @param[in] vMetas: metadata of each row
+	// @return: true if the embeddings are appended successfully, false otherwise
+	bool Append(const cv::Mat& cvFeatures, const std::vector<GalleryMeta>& vMetas);
+
+	// Reserve the rows in the files, so the appends do not remap them
+	// @param[in] nRows: number of rows to reserve
+	// @return: true if the rows are reserved successfully, false otherwise
+	bool Reserve(int64_t nRows);
+
+	// Write the mapped rows and the header to the disk
+	// @return: true if they are written successfully, false otherwise
+	bool Flush();
+
+	// Lock the store against the appends while the rows are read
+	// @return: lock shared by the readers
+	std::shared_lock<std::shared_mutex> LockRead() const;
+
+	// Get the number of embeddings
+	// @return: number of embeddings
+	int64_t GetCount() const;
+
+	// Get the dimension of the embeddings
+	// @return: dimension of the embeddings
+	int GetDim() const;
+
+	// Get the distance between the rows
+	// @return: distance between the rows in floats
+	size_t GetStride() const;
+
+	// Get the similarity metric of the embeddings
+	// @return: similarity metric
+	E_FeatureMetric GetMetric() const;
+
+	// Get the ID of the model extracting the embeddings
+	// @return: model ID
+	const std::string& GetModelID() const;
+
+	// Get the first row of the embeddings
+	// @return: address of the first row. nullptr if the store is not opened
+	// [Note] The address is valid while LockRead() is held.
+	const float* GetFeatures() const;
+
+	// Get the metadata of the embedding
+	// @param[in] nIdx: index of the embedding
+	// @return: metadata. nullptr if the index is out of range
+	// [Note] The address is valid while LockRead() is held.
+	const GalleryMeta* GetMeta(int64_t nIdx) const;
+
+private:
+	// Grow the files to hold the given number of rows and map them again
+	// @param[in] nCapacity: number of rows
+	// @return: true if the files are grown successfully, false otherwise
+	bool Grow(int64_t nCapacity);
+
+	// Write the count and the capacity to the header
+	void WriteHeader();
+
+private:
+	std::string			m_sPath;		// path of the store file
+	std::string			m_sModelID;		// ID of the model extracting the embeddings
+	int					m_nDim;			// dimension of the embeddings
+	size_t				m_nStride;		// distance between the rows in floats
+	E_FeatureMetric		m_eMetric;		// similarity metric of the embeddings
+	bool				m_bReadOnly;	// true if the store is opened for the search only
+	int64_t				m_nCount;		// number of embeddings
+	int64_t				m_nCapacity;	// number of rows the files can hold
+
+	MappedFile			m_stData;		// mapped store file
+	MappedFile			m_stMeta;		// mapped side table
+
+	mutable std::shared_mutex	m_mutex;	// mutex between the readers and the appends remapping the files
+};
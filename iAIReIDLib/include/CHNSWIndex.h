@@ -0,0 +1,105 @@
+#pragma once
+#include "CFeatureIndex.h"
+#include <mutex>
+#include <random>
+
+// Structure to hold the visit marks of one graph search
+typedef struct _VisitedList
+{
+	std::vector<uint32_t>	vMarks;		// mark of each node. The node is visited if its mark is nMark
+	uint32_t				nMark;		// mark of the current search
+
+	_VisitedList()
+	{
+		nMark = 0;
+	}
+}VisitedList;
+
+// Class of the hierarchical navigable small world graph index
+// Each row is a node linked to its nearest rows on the bottom layer and on a random number of the sparser upper layers.
+// The search descends greedily from the entry node through the upper layers, then explores nEfSearch candidates on the
+// bottom layer, so it visits a few thousand rows of a gallery of millions. The links are chosen by the heuristic keeping
+// the diverse directions, and the rows are added one by one without rebuilding the graph.
+// [Note] The graph and the rows are kept in memory. Use CIVFIndex for the galleries larger than the memory.
+class IAIREIDLIB_API CHNSWIndex : public CFeatureIndex
+{
+public:
+	CHNSWIndex(const FeatureIndexConfig& stConfig, int nDim);
+	~CHNSWIndex();
+
+	// Set the number of candidates searched for a query
+	// @param[in] nEfSearch: number of candidates. Larger is more accurate but slower
+	void SetEfSearch(int nEfSearch);
+
+protected:
+	// Index the rows which are already readable by GetRow(). The index is locked
+	// @param[in] nFirst: ID of the first row
+	// @param[in] nRows: number of the rows
+	// @return: true if the rows are indexed successfully, false otherwise
+	virtual bool AddCore(int nFirst, int nRows);
+
+	// Search the top K rows for the query. The index is locked and holds the rows
+	// @param[in] pQuery: normalised query feature vector
+	// @param[in] nTopK: maximum number of rows to return. Greater than 0
+	// @param[in] fSimThresh: minimum similarity to return
+	// @param[out] vReIDRes: top K rows in the descending order of the similarity. nImgID is the row ID
+	virtual void SearchCore(const float* pQuery, int nTopK, float fSimThresh, ReIDResArr& vReIDRes) const;
+
+private:
+	typedef std::pair<float, int>	SimNode;	// similarity to the query and node ID
+
+	// Link the new node into the graph
+	// @param[in] nID: node ID
+	void Insert(int nID);
+
+	// Descend greedily to the node most similar to the query on the layer
+	// @param[in] stQuery: query prepared by PrepareQuery()
+	// @param[in/out] stCur: start node, and the most similar node found
+	// @param[in] nLevel: layer
+	void GreedySearch(const FeatureCodecQuery& stQuery, SimNode& stCur, int nLevel) const;
+
+	// Search the candidates most similar to the query on the layer
+	// @param[in] stQuery: query prepared by PrepareQuery()
+	// @param[in] stEntry: entry node
+	// @param[in] nEf: number of candidates
+	// @param[in] nLevel: layer
+	// @param[out] vResult: candidates in the descending order of the similarity
+	void SearchLayer(const FeatureCodecQuery& stQuery, const SimNode& stEntry, int nEf, int nLevel, std::vector<SimNode>& vResult) const;
+
+	// Select the links among the candidates, keeping only the candidates closer to the node than to the selected links
+	// @param[in/out] vCands: candidates in the descending order of the similarity to the node, and the selected links
+	// @param[in] nMaxLinks: maximum number of links
+	void SelectLinks(std::vector<SimNode>& vCands, int nMaxLinks) const;
+
+	// Get the links of the node on the layer
+	// @param[in] nID: node ID
+	// @param[in] nLevel: layer
+	// @return: number of links followed by the linked node IDs
+	int* GetLinks(int nID, int nLevel);
+	const int* GetLinks(int nID, int nLevel) const;
+
+	// Take a visited list of the pool for a search
+	// @return: visited list cleared for the search
+	VisitedList AcquireVisited() const;
+
+	// Return the visited list to the pool
+	// @param[in] stVisited: visited list taken by AcquireVisited()
+	void ReleaseVisited(VisitedList& stVisited) const;
+
+private:
+	int							m_nM;				// number of links of each node on the upper layers
+	int							m_nMaxM0;			// number of links of each node on the bottom layer
+	int							m_nEfConstruction;	// number of candidates searched to link a new node
+	int							m_nEfSearch;		// number of candidates searched for a query
+	double						m_dLevelMult;		// normalisation of the random layer of the new node
+
+	std::vector<int>			m_vLinks0;			// links on the bottom layer. (1 + m_nMaxM0) ints per node
+	std::vector<std::vector<int>>	m_vUpperLinks;	// links on the upper layers. (1 + m_nM) ints per node per layer
+	std::vector<int>			m_vLevels;			// top layer of each node
+	int							m_nEntry;			// entry node of the search. -1 if the graph is empty
+	int							m_nMaxLevel;		// top layer of the entry node
+	std::mt19937				m_rng;				// random generator of the layers
+
+	mutable std::mutex			m_visitedMutex;		// mutex of the visited list pool
+	mutable std::vector<VisitedList>	m_vVisitedPool;	// visited lists reused by the searches
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include "CFeatureIndex.h"
+#include <opencv2/opencv.hpp>
+
+// Class of the inverted file index of k-means lists
+// The rows are clustered by k-means into nLists lists, and a query scans only the nProbes lists of the nearest centroids.
+// The index itself holds only the centroids and the row IDs of each list, so the index attached to a CGalleryStore keeps
+// the rows on the disk and reads the probed ones from the mapped file.
+// [Note] The centroids are trained by Train(), or on the rows added once there are 39 rows per list. The rows added before it
+//        are scanned linearly. Train on a sample of the whole gallery in advance when the first rows do not represent it.
+class IAIREIDLIB_API CIVFIndex : public CFeatureIndex
+{
+public:
+	CIVFIndex(const FeatureIndexConfig& stConfig, int nDim);
+	~CIVFIndex();
+
+	// Set the number of lists searched for a query
+	// @param[in] nProbes: number of lists. Larger is more accurate but slower
+	void SetProbes(int nProbes);
+
+protected:
+	// Train the centroids of the lists by k-means on the sample rows. The index is locked
+	// @param[in] pFeatures: 1st sample row
+	// @param[in] nRows: number of the sample rows
+	// @param[in] nStride: distance between the sample rows in floats
+	// @return: true if the index is trained successfully, false otherwise
+	// [Note] It fails once the lists are trained, because the rows are assigned to the old centroids.
+	virtual bool TrainCore(const float* pFeatures, int nRows, size_t nStride);
+
+	// Index the rows which are already readable by GetRow(). The index is locked
+	// @param[in] nFirst: ID of the first row
+	// @param[in] nRows: number of the rows
+	// @return: true if the rows are indexed successfully, false otherwise
+	// [Note] Without Train(), the rows are kept out of the lists and scanned linearly until there are enough rows to train on.
+	virtual bool AddCore(int nFirst, int nRows);
+
+	// Search the top K rows for the query. The index is locked and holds the rows
+	// @param[in] pQuery: normalised query feature vector
+	// @param[in] nTopK: maximum number of rows to return. Greater than 0
+	// @param[in] fSimThresh: minimum similarity to return
+	// @param[out] vReIDRes: top K rows in the descending order of the similarity. nImgID is the row ID
+	virtual void SearchCore(const float* pQuery, int nTopK, float fSimThresh, ReIDResArr& vReIDRes) const;
+
+private:
+	// Assign the rows to the list of the most similar centroid
+	// @param[in] nFirst: ID of the first row
+	// @param[in] nRows: number of the rows
+	// @return: true if the rows are assigned successfully, false otherwise
+	// [Note] The compressed rows added before the training are decoded.
+	bool AssignRows(int nFirst, int nRows);
+
+private:
+	int								m_nProbes;		// number of lists searched for a query
+	cv::Mat							m_cvCentroids;	// centroid matrix of CV_32F. Each row is the centroid of the relevant list
+	std::vector<std::vector<int>>	m_vLists;		// row IDs of each list
+};
@@ -2,6 +2,9 @@
 #include "type_define.h"
 #include <opencv2/opencv.hpp>
 
+class CGalleryStore;
+class CFeatureIndex;
+
 // Abstract base class for ReID(Re-identification)
 // All the ReID classes should inherit from this class
 class IAIREIDLIB_API CReID
@@ -37,12 +40,105 @@ public:
 	//         - The query embedding feature should be registered in advance by calling RegisterQuery()
 	virtual bool ReID(const std::vector<cv::Mat>& cvGalleryImgs);
 
+	// Perform ReID between the query embedding feature and the gallery images into the given result
+	// @param[in] vQueryFeature: query embedding feature
+	// @param[in] cvGalleryImgs: multiple gallery images
+	// @param[out] vReIDRes: ReID results
+	// @return: true if the ReID is successfully performed, false otherwise
+	// [Note]: It does not touch the state of the ReID, so it can be called from several threads at the same time.
+	virtual bool ReID(const std::vector<float>& vQueryFeature, const std::vector<cv::Mat>& cvGalleryImgs, ReIDResArr& vReIDRes);
+
+	// Perform ReID between the preregistered query embedding feature and the gallery features extracted in advance
+	// @param[in] cvGalleryFeatures: gallery feature matrix of CV_32F. Each row is the normalised feature vector of a gallery image
+	// @return: true if the ReID is successfully performed, false otherwise
+	// [Note]: - The ReID results can be obtained by calling GetReIDRes()
+	//         - The gallery features can be cached ones, such as the aggregate features of the tracked objects.
+	virtual bool MatchFeatures(const cv::Mat& cvGalleryFeatures);
+
+	// Perform ReID between the query embedding feature and the gallery features extracted in advance into the given result
+	// @param[in] vQueryFeature: query embedding feature
+	// @param[in] cvGalleryFeatures: gallery feature matrix of CV_32F. Each row is the normalised feature vector of a gallery image
+	// @param[out] vReIDRes: ReID results
+	// @return: true if the ReID is successfully performed, false otherwise
+	// [Note]: It does not touch the state of the ReID, so it can be called from several threads at the same time.
+	virtual bool MatchFeatures(const std::vector<float>& vQueryFeature, const cv::Mat& cvGalleryFeatures, ReIDResArr& vReIDRes);
+
+	// Perform ReID between the query set and the gallery images
+	// @param[in] cvGalleryImgs: multiple gallery images
+	// @return: true if the ReID is successfully performed, false otherwise
+	// [Note]: - The ReID results of each query can be obtained by calling GetQueryReIDRes()
+	//         - The gallery features are extracted once and matched with all the queries by one matrix product.
+	virtual bool ReIDQueries(const std::vector<cv::Mat>& cvGalleryImgs);
+
+	// Perform ReID between the query set and the gallery features extracted in advance
+	// @param[in] cvGalleryFeatures: gallery feature matrix of CV_32F. Each row is the normalised feature vector of a gallery image
+	// @return: true if the ReID is successfully performed, false otherwise
+	// [Note]: The ReID results of each query can be obtained by calling GetQueryReIDRes()
+	virtual bool MatchQueries(const cv::Mat& cvGalleryFeatures);
+
+	// Perform ReID between the given query set and the gallery features extracted in advance into the given result
+	// @param[in] vQueries: queries of the query set
+	// @param[in] cvQueryFeatures: query feature matrix of CV_32F. Each row is the normalised feature vector of the relevant query
+	// @param[in] cvGalleryFeatures: gallery feature matrix of CV_32F. Each row is the normalised feature vector of a gallery image
+	// @param[out] vQueryReIDRes: ReID results of each query. Same order as vQueries
+	// @return: true if the ReID is successfully performed, false otherwise
+	// [Note]: It does not touch the state of the ReID, so it can be called from several threads at the same time.
+	virtual bool MatchQueries(const ReIDQueryArr& vQueries, const cv::Mat& cvQueryFeatures, const cv::Mat& cvGalleryFeatures,
+		QueryReIDResArr& vQueryReIDRes);
+
+	// Perform ReID between the query feature and the persistent gallery store into the given result
+	// @param[in] vQueryFeature: normalised query feature vector
+	// @param[in] cStore: opened gallery store of the same model
+	// @param[out] vReIDRes: top K results. nImgID is the row index of the store, whose metadata is cStore.GetMeta(nImgID)
+	// @return: true if the ReID is successfully performed, false otherwise
+	// [Note]: - The rows are searched in place on the mapped file by chunks, so the store is never copied into memory.
+	//         - It does not touch the state of the ReID, so it can be called from several threads at the same time.
+	virtual bool MatchStore(const std::vector<float>& vQueryFeature, const CGalleryStore& cStore, ReIDResArr& vReIDRes);
+
+	// Perform ReID between the given query set and the persistent gallery store into the given result
+	// @param[in] vQueries: queries of the query set
+	// @param[in] cvQueryFeatures: query feature matrix of CV_32F. Each row is the normalised feature vector of the relevant query
+	// @param[in] cStore: opened gallery store of the same model
+	// @param[out] vQueryReIDRes: ReID results of each query. Same order as vQueries. nImgID is the row index of the store
+	// @return: true if the ReID is successfully performed, false otherwise
+	// [Note]: - Each chunk of the rows is loaded once for all the queries by one matrix product.
+	//         - It does not touch the state of the ReID, so it can be called from several threads at the same time.
+	virtual bool MatchStore(const ReIDQueryArr& vQueries, const cv::Mat& cvQueryFeatures, const CGalleryStore& cStore,
+		QueryReIDResArr& vQueryReIDRes);
+
+	// Perform ReID between the query feature and the gallery of the nearest-neighbour index into the given result
+	// @param[in] vQueryFeature: normalised query feature vector
+	// @param[in] cIndex: index of the gallery of the same model
+	// @param[out] vReIDRes: top K results. nImgID is the row ID of the index, which is the row index of the attached store
+	// @return: true if the ReID is successfully performed, false otherwise
+	// [Note]: - The results are approximate for CHNSWIndex and CIVFIndex. Use CFeatureIndex::SearchExact() to validate them.
+	//         - It does not touch the state of the ReID, so it can be called from several threads at the same time.
+	virtual bool MatchIndex(const std::vector<float>& vQueryFeature, const CFeatureIndex& cIndex, ReIDResArr& vReIDRes);
+
+	// Perform ReID between the given query set and the gallery of the nearest-neighbour index into the given result
+	// @param[in] vQueries: queries of the query set
+	// @param[in] cvQueryFeatures: query feature matrix of CV_32F. Each row is the normalised feature vector of the relevant query
+	// @param[in] cIndex: index of the gallery of the same model
+	// @param[out] vQueryReIDRes: ReID results of each query. Same order as vQueries. nImgID is the row ID of the index
+	// @return: true if the ReID is successfully performed, false otherwise
+	// [Note]: It does not touch the state of the ReID, so it can be called from several threads at the same time.
+	virtual bool MatchIndex(const ReIDQueryArr& vQueries, const cv::Mat& cvQueryFeatures, const CFeatureIndex& cIndex,
+		QueryReIDResArr& vQueryReIDRes);
+
 	// Extract the feature vector from the input image
 	// @param[in] cvImg: input image
 	// @param[out] vFeature: extracted feature vector
 	// @return: true if the feature is successfully extracted, false otherwise
 	virtual const bool ExtractFeature(const cv::Mat& cvImg, std::vector<float>& vFeature) = 0;
 
+	// Extract the feature vectors from the multiple input images
+	// @param[in] vImgs: input images
+	// @param[out] cvFeatures: extracted feature matrix of CV_32F. Each row is the feature vector of the relevant image
+	// @return: true if the features are successfully extracted, false otherwise
+	// [Note] - The default implementation extracts the features one by one by calling ExtractFeature().
+	//        - The derived classes should override this function to extract the features in batch.
+	virtual const bool ExtractFeatures(const std::vector<cv::Mat>& vImgs, cv::Mat& cvFeatures);
+
 	// Register the query image for further ReID in advance
 	// @param[in] cvQueryImg: query image
 	// @return: true if the query image is successfully registered, false otherwise
@@ -55,6 +151,41 @@ public:
 	// [Note]: The query feature vector is stored in m_vQueryFeature
 	virtual bool RegisterQuery(const std::vector<float>& vQueryFeature);
 
+	// Add the query image to the query set
+	// @param[in] stQuery: query ID, top K and similarity threshold of the query
+	// @param[in] cvQueryImg: query image
+	// @return: true if the query is successfully added, false otherwise
+	// [Note]: The query of the same ID is replaced.
+	virtual bool AddQuery(const ReIDQuery& stQuery, const cv::Mat& cvQueryImg);
+
+	// Add the query feature vector to the query set
+	// @param[in] stQuery: query ID, top K and similarity threshold of the query
+	// @param[in] vQueryFeature: normalised query feature vector
+	// @return: true if the query is successfully added, false otherwise
+	// [Note]: The query of the same ID is replaced.
+	virtual bool AddQuery(const ReIDQuery& stQuery, const std::vector<float>& vQueryFeature);
+
+	// Remove the query from the query set
+	// @param[in] nQueryID: query ID
+	// @return: true if the query is removed, false if it is not found
+	bool RemoveQuery(int nQueryID);
+
+	// Remove all the queries from the query set
+	void ClearQueries();
+
+	// Clear the ReID results of the registered query and of the query set
+	// [Note]: The results are kept until the next ReID, so clear them before a ReID that may not run.
+	void ClearResults();
+
+	// Get the queries of the query set
+	// @return: queries. Same order as the rows of GetQueryFeatures()
+	const ReIDQueryArr& GetQueries() const;
+
+	// Get the feature matrix of the query set
+	// @return: query feature matrix of CV_32F. Each row is the feature vector of the relevant query
+	// [Note]: The matrix is allocated again whenever the query set changes, so a copy of it stays valid as a snapshot.
+	const cv::Mat& GetQueryFeatures() const;
+
 	// Visualise the ReID results
 	// @param[in] cvQueryImg: query image
 	// @param[in] cvGalleryImgs: gallery images
@@ -68,40 +199,43 @@ public:
 	// Get the ReID results
 	// @return: ReID results
 	virtual const ReIDResArr& GetReIDRes() const;
+
+	// Get the query feature vector registered by RegisterQuery()
+	// @return: query feature vector. Empty if not registered
+	const std::vector<float>& GetQueryFeature() const;
+
+	// Get the ReID results of each query of the query set
+	// @return: ReID results of each query. Same order as GetQueries()
+	const QueryReIDResArr& GetQueryReIDRes() const;
 protected:
 
 	// Normalise the feature vector
-	// @param[in] vOrgFeature: original feature vector
-	// @param[out] vNorFeature: normalised feature vector
+	// @param[in] pOrgFeature: original feature vector
+	// @param[in] nDim: dimension of the feature vector
+	// @param[out] pNorFeature: normalised feature vector. It can be the same buffer as pOrgFeature
 	// [Note] - The default implementation is L2 normalisation. 
 	//        - If you want to use other normalisation methods, this function should be overridden.
-	virtual void Normalisation(const std::vector<float>& vOrgFeature, std::vector<float>& vNorFeature);
+	virtual void Normalisation(const float* pOrgFeature, int nDim, float* pNorFeature);
 
-	// Calculate the similarity between the query feature and the gallery features and store the top K results in m_vReIDRes
+	// Calculate the similarity between the query feature and the gallery features and store the top K results
 	// @param[in] vQueryFeature: query feature vector
-	// @param[in] vGalleryFeatures: gallery feature vectors
+	// @param[in] cvGalleryFeatures: gallery feature matrix. Each row is a gallery feature vector
+	// @param[out] vReIDRes: top K results
 	// @param[in] eMode: similarity mode. COSINE: cosine similarity; EUCLIDEAN: Euclidean distance
 	virtual void CalculateTopK(const std::vector<float>& vQueryFeature, 
-		const std::vector<std::vector<float>>& vGalleryFeatures,
+		const cv::Mat& cvGalleryFeatures,
+		ReIDResArr& vReIDRes,
 		const E_SimilarityMetric& eMode = E_SimilarityMetric::COSINE);
 
 
-private:
-	// Calculate the cosine similarity between two vectors
-	// @param[in] vFeature1: normalised feature vector 1
-	// @param[in] vFeature2: normalised feature vector 2
-	// @return: cosine similarity
-	inline float CosineSimilarity(const std::vector<float>& vFeature1, const std::vector<float>& vFeature2);
-
-	// Calculate the Euclidean distance between two vectors
-	// @param[in] vFeature1: normalised feature vector 1
-	// @param[in] vFeature2: normalised feature vector 2
-	// @return: Euclidean distance
-	inline float EuclideanDistance(const std::vector<float>& vFeature1, const std::vector<float>& vFeature2);
-
 protected:
 	ReIDNetConfig		m_stReIDNetConfig;		// ReID network configuration
 	ReIDResArr			m_vReIDRes;				// ReID results
 
 	std::vector<float>	m_vQueryFeature;		// query feature vector
+	cv::Mat				m_cvGalleryFeatures;	// gallery feature matrix of the last ReID. Each row is a gallery feature vector
+
+	ReIDQueryArr		m_vQueries;				// queries of the query set
+	cv::Mat				m_cvQueryFeatures;		// feature matrix of the query set. Each row is the feature vector of the relevant query
+	QueryReIDResArr		m_vQueryReIDRes;		// ReID results of each query of the query set
 };
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+#include "type_define.h"
+#include <opencv2/opencv.hpp>
+#include "CReID.h"
+#include "CInferer.h"
+
+// Class for TorchReID deep network, independent of the inference runtime
+// The runtime is bound by the derived classes, e.g., CORTTorchReID for onnxruntime and CCVTorchReID for OpenCV DNN.
+class IAIREIDLIB_API CTorchReID : public CReID, public virtual CInferer
+{
+public:
+	CTorchReID(const ReIDNetConfig& stReIDNetConfig, const NetDetailsConfig& stNetDetailsConfig);
+	~CTorchReID();
+
+	// Extract the feature vector from the input image
+	// @param[in] cvImg: input image
+	// @param[out] vFeature: extracted feature vector
+	// @return: true if the feature is successfully extracted, false otherwise
+	virtual const bool ExtractFeature(const cv::Mat& cvImg, std::vector<float>& vFeature);
+
+	// Extract the feature vectors from the multiple input images in batch
+	// @param[in] vImgs: input images
+	// @param[out] cvFeatures: extracted feature matrix of CV_32F. Each row is the feature vector of the relevant image
+	// @return: true if the features are successfully extracted, false otherwise
+	virtual const bool ExtractFeatures(const std::vector<cv::Mat>& vImgs, cv::Mat& cvFeatures);
+protected:
+	// Preprocess the input image
+	// @param[in] cvImg: input image to be preprocessed
+	// @param[out] cvProcImg: preprocessed image
+	virtual void PreProcess(const cv::Mat& cvImg, cv::Mat& cvProcImg);
+
+	// Preprocess the input images into the batch tensor buffer
+	// @param[in] pFrames: input images
+	// @param[in] nCount: number of input images
+	// @param[out] pTensor: tensor buffer of nCount x 3 x H x W floats
+	// @return: true if success, otherwise false
+	// [Note] The crops of the detected persons in the same frame are sampled from the frame in one parallel pass.
+	virtual bool PreProcessBatch(const cv::Mat* pFrames, int nCount, float* pTensor);
+
+	// Postprocess the output tensor
+	// @param[in] cvOrgImgSize: original image size
+	// @param[in] pTensorData: output tensor data to be postprocessed
+	// @param[out] pPostProcessData: postprocessed data
+	// [Note] - The normalised feature vector is stored in pPostProcessData, which points to a float buffer of the feature dimension
+	virtual void PostProcess(const cv::Size& cvOrgImgSize, const void* pTensorData, void* pPostProcessData);
+
+};
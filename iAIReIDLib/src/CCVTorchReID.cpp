@@ -0,0 +1,25 @@
+#include "CCVTorchReID.h"
+
+CCVTorchReID::CCVTorchReID(const ReIDNetConfig& stReIDNetConfig, const NetDetailsConfig& stNetDetailsConfig)
+	: CInferer(stNetDetailsConfig)
+	, CTorchReID(stReIDNetConfig, stNetDetailsConfig)
+	, CCVInferer(stNetDetailsConfig)
+{
+	m_bValid = (ReadModel(stReIDNetConfig.sModelPath,
+		"", "torchreid-cvdnn") && Validate());
+}
+
+CCVTorchReID::~CCVTorchReID()
+{
+
+}
+
+// Read the onnx model from the given path
+// @param[in] sModelPath: path to the onnx model
+// @param[in] sPairedFilePath: path to the paired file. Not used for this case
+// @param[in] sLogTitle: title of the log
+// @return: true if successfully read the model, false otherwise
+bool CCVTorchReID::ReadModel(const std::string& sModelPath, const std::string& sPairedFilePath /*= ""*/, const std::string& sLogTitle /*= "opencv-dnn"*/)
+{
+	return CCVInferer::ReadModel(sModelPath, sPairedFilePath, sLogTitle);
+}
@@ -0,0 +1,25 @@
+#include "CCVYouReID.h"
+
+CCVYouReID::CCVYouReID(const ReIDNetConfig& stReIDNetConfig, const NetDetailsConfig& stNetDetailsConfig)
+	: CInferer(stNetDetailsConfig)
+	, CYouReID(stReIDNetConfig, stNetDetailsConfig)
+	, CCVInferer(stNetDetailsConfig)
+{
+	m_bValid = (ReadModel(stReIDNetConfig.sModelPath,
+		"", "youreid-cvdnn") && Validate());
+}
+
+CCVYouReID::~CCVYouReID()
+{
+
+}
+
+// Read the onnx model from the given path
+// @param[in] sModelPath: path to the onnx model
+// @param[in] sPairedFilePath: path to the paired file. Not used for this case
+// @param[in] sLogTitle: title of the log
+// @return: true if successfully read the model, false otherwise
+bool CCVYouReID::ReadModel(const std::string& sModelPath, const std::string& sPairedFilePath /*= ""*/, const std::string& sLogTitle /*= "opencv-dnn"*/)
+{
+	return CCVInferer::ReadModel(sModelPath, sPairedFilePath, sLogTitle);
+}
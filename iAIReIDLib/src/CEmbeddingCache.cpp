@@ -0,0 +1,305 @@
+#include "CEmbeddingCache.h"
+#include "CReID.h"
+#include <iostream>
+
+#define THUMB_W		8		// width of the thumbnail to detect the appearance change
+#define THUMB_H		16		// height of the thumbnail to detect the appearance change
+
+CEmbeddingCache::CEmbeddingCache(const EmbeddingCacheConfig& stConfig)
+	: m_stConfig(stConfig)
+	, m_nFrame(0)
+{
+
+}
+
+CEmbeddingCache::~CEmbeddingCache()
+{
+	m_mapEntries.clear();
+}
+
+// Get the features of the objects of the next frame
+// @param[in] pReID: ReID network extracting the features of the new and changed objects in one batch
+// @param[in] vObjBoxes: objects of the frame carrying the track IDs
+// @param[in] vCrops: crops of the objects from the frame. Same order as vObjBoxes
+// @param[out] cvFeatures: feature matrix of CV_32F. Each row is the normalised feature vector of the relevant object
+// @return: true if the features are successfully obtained, false otherwise
+// [Note] It can be called from several threads at the same time. The network runs out of the lock.
+bool CEmbeddingCache::GetFeatures(CReID* pReID, const ObjBoxArr& vObjBoxes, const std::vector<cv::Mat>& vCrops, cv::Mat& cvFeatures)
+{
+	cvFeatures.release();
+	if (!pReID)
+		return false;
+
+	EmbeddingLookup stLookup;
+	if (!Lookup(vObjBoxes, vCrops, stLookup))
+		return false;
+
+	// Extract the new and changed objects in one batch run
+	cv::Mat cvExtracted;
+	try
+	{
+		std::vector<cv::Mat> vExtractCrops;
+		vExtractCrops.reserve(stLookup.vExtractIdx.size());
+		for (int nIdx : stLookup.vExtractIdx)
+			vExtractCrops.push_back(vCrops[nIdx]);
+
+		if (!vExtractCrops.empty() && !pReID->ExtractFeatures(vExtractCrops, cvExtracted))
+			return false;
+	}
+	catch (cv::Exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+		return false;
+	}
+
+	return Complete(stLookup, vObjBoxes, cvExtracted, cvFeatures);
+}
+
+// Look up the objects of the next frame, deciding the objects to extract
+// @param[in] vObjBoxes: objects of the frame carrying the track IDs
+// @param[in] vCrops: crops of the objects from the frame. Same order as vObjBoxes
+// @param[out] stLookup: lookup of the frame. The crops of stLookup.vExtractIdx should be extracted for Complete()
+// @return: true if the objects are successfully looked up, false otherwise
+// [Note] The extraction is left to the caller, so the crops of several caches can be extracted in one batch run.
+bool CEmbeddingCache::Lookup(const ObjBoxArr& vObjBoxes, const std::vector<cv::Mat>& vCrops, EmbeddingLookup& stLookup)
+{
+	stLookup = EmbeddingLookup();
+	if (vObjBoxes.size() != vCrops.size())
+		return false;
+
+	int nObjs = (int)vObjBoxes.size();
+	if (nObjs == 0)
+		return true;
+
+	stLookup.vThumbs.resize(nObjs);
+	stLookup.vCached.resize(nObjs);
+
+	try
+	{
+		for (int i = 0; i < nObjs; i++)
+			MakeThumb(vCrops[i], stLookup.vThumbs[i]);
+
+		// Decide the objects to extract, and take the cached features of the others
+		std::lock_guard<std::mutex> lock(m_mutex);
+		uint64_t nFrame = ++m_nFrame;
+		stLookup.nFrame = nFrame;
+
+		for (int i = 0; i < nObjs; i++)
+		{
+			const ObjBBox& stBox = vObjBoxes[i];
+
+			std::map<int, EmbeddingEntry>::iterator it = m_mapEntries.end();
+			if (stBox.nTrackID >= 0)
+				it = m_mapEntries.find(stBox.nTrackID);
+
+			if (it != m_mapEntries.end())
+			{
+				it->second.nSeenFrame = nFrame;
+				if (!IsStale(it->second, stBox, stLookup.vThumbs[i], nFrame))
+				{
+					stLookup.vCached[i] = it->second.vFeature;
+					continue;
+				}
+			}
+
+			stLookup.vExtractIdx.push_back(i);
+		}
+
+		// Forget the tracks which have left the scene
+		for (std::map<int, EmbeddingEntry>::iterator it = m_mapEntries.begin(); it != m_mapEntries.end();)
+		{
+			if (nFrame - it->second.nSeenFrame > (uint64_t)_MAX(0, m_stConfig.nMaxIdleFrames))
+				it = m_mapEntries.erase(it);
+			else
+				++it;
+		}
+
+		m_stStats.nLookups += nObjs;
+		m_stStats.nExtracted += stLookup.vExtractIdx.size();
+	}
+	catch (cv::Exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Complete the features of the objects looked up by Lookup()
+// @param[in] stLookup: lookup of the frame
+// @param[in] vObjBoxes: objects of the frame given to Lookup()
+// @param[in] cvExtracted: features of the crops of stLookup.vExtractIdx. Each row is the normalised feature vector
+// @param[out] cvFeatures: feature matrix of CV_32F. Each row is the normalised feature vector of the relevant object
+// @return: true if the features are successfully obtained, false otherwise
+bool CEmbeddingCache::Complete(const EmbeddingLookup& stLookup, const ObjBoxArr& vObjBoxes, const cv::Mat& cvExtracted, cv::Mat& cvFeatures)
+{
+	cvFeatures.release();
+
+	int nObjs = (int)vObjBoxes.size();
+	if (nObjs == 0)
+		return true;
+
+	if ((int)stLookup.vCached.size() != nObjs || (int)stLookup.vExtractIdx.size() != (cvExtracted.empty() ? 0 : cvExtracted.rows))
+		return false;
+
+	try
+	{
+		int nDim = !cvExtracted.empty() ? cvExtracted.cols : (int)stLookup.vCached[0].size();
+		if (nDim <= 0)
+			return false;
+
+		cvFeatures.create(nObjs, nDim, CV_32F);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (int i = 0; i < (int)stLookup.vExtractIdx.size(); i++)
+		{
+			int nIdx = stLookup.vExtractIdx[i];
+			const ObjBBox& stBox = vObjBoxes[nIdx];
+			const float* pFeature = cvExtracted.ptr<float>(i);
+
+			if (stBox.nTrackID < 0)
+			{
+				memcpy(cvFeatures.ptr<float>(nIdx), pFeature, nDim * sizeof(float));
+				continue;
+			}
+
+			// Add the feature into the aggregate of the track, which is matched instead of the single feature
+			EmbeddingEntry& stEntry = m_mapEntries[stBox.nTrackID];
+			Aggregate(stEntry, pFeature, nDim);
+			stEntry.cvThumb = stLookup.vThumbs[nIdx];
+			stEntry.fHeight = stBox.fY2 - stBox.fY1;
+			stEntry.nExtractFrame = stLookup.nFrame;
+			stEntry.nSeenFrame = _MAX(stEntry.nSeenFrame, stLookup.nFrame);
+
+			memcpy(cvFeatures.ptr<float>(nIdx), stEntry.vFeature.data(), nDim * sizeof(float));
+		}
+
+		for (int i = 0; i < nObjs; i++)
+		{
+			if (stLookup.vCached[i].empty())
+				continue;
+
+			if ((int)stLookup.vCached[i].size() != nDim)
+			{
+				cvFeatures.release();
+				return false;
+			}
+
+			memcpy(cvFeatures.ptr<float>(i), stLookup.vCached[i].data(), nDim * sizeof(float));
+		}
+
+		m_stStats.nTracks = m_mapEntries.size();
+	}
+	catch (cv::Exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+		cvFeatures.release();
+		return false;
+	}
+
+	return true;
+}
+
+// Remove all the tracks
+void CEmbeddingCache::Reset()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_mapEntries.clear();
+	m_stStats.nTracks = 0;
+}
+
+// Get the counters of the cache
+// @return: counters of the cache
+EmbeddingCacheStats CEmbeddingCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return m_stStats;
+}
+
+// Get the configuration of the cache
+// @return: configuration
+const EmbeddingCacheConfig& CEmbeddingCache::GetConfig() const
+{
+	return m_stConfig;
+}
+
+// Make the thumbnail of the crop to detect the appearance change
+// @param[in] cvCrop: crop of the object
+// @param[out] cvThumb: thumbnail of the crop
+void CEmbeddingCache::MakeThumb(const cv::Mat& cvCrop, cv::Mat& cvThumb) const
+{
+	cvThumb.release();
+	if (cvCrop.empty())
+		return;
+
+	cv::resize(cvCrop, cvThumb, cv::Size(THUMB_W, THUMB_H), 0, 0, cv::INTER_AREA);
+}
+
+// Check whether the features of the track should be extracted again
+// @param[in] stEntry: cached features of the track
+// @param[in] stBox: box of the track on the frame
+// @param[in] cvThumb: thumbnail of the crop on the frame
+// @param[in] nFrame: frame counter
+// @return: true if the features should be extracted again, false if the cached ones can be reused
+bool CEmbeddingCache::IsStale(const EmbeddingEntry& stEntry, const ObjBBox& stBox, const cv::Mat& cvThumb, uint64_t nFrame) const
+{
+	if (stEntry.nSamples == 0 || stEntry.vFeature.empty())
+		return true;
+
+	if (nFrame >= stEntry.nExtractFrame + (uint64_t)_MAX(1, m_stConfig.nRefreshInterval))
+		return true;
+
+	// The person walked towards or away from the camera, so the details in the crop changed
+	float fHeight = stBox.fY2 - stBox.fY1;
+	if (stEntry.fHeight <= 0.0f || std::abs(fHeight / stEntry.fHeight - 1.0f) > m_stConfig.fScaleChangeRatio)
+		return true;
+
+	// The person turned around or got occluded
+	if (cvThumb.empty() || stEntry.cvThumb.size() != cvThumb.size() || stEntry.cvThumb.type() != cvThumb.type())
+		return true;
+
+	double dDiff = cv::norm(cvThumb, stEntry.cvThumb, cv::NORM_L1) / ((double)cvThumb.total() * cvThumb.channels() * 255.0);
+	if (dDiff > m_stConfig.fAppearanceThresh)
+		return true;
+
+	return false;
+}
+
+// Add the extracted feature into the aggregate of the track
+// @param[in/out] stEntry: cached features of the track
+// @param[in] pFeature: normalised extracted feature
+// @param[in] nDim: dimension of the feature
+void CEmbeddingCache::Aggregate(EmbeddingEntry& stEntry, const float* pFeature, int nDim) const
+{
+	if (stEntry.nSamples == 0 || (int)stEntry.vFeature.size() != nDim)
+	{
+		stEntry.vFeature.assign(pFeature, pFeature + nDim);
+		stEntry.nSamples = 1;
+		return;
+	}
+
+	// Exponential moving average, normalised again so the cosine similarity stays the inner product
+	float fMomentum = _MIN(_MAX(0.0f, m_stConfig.fMomentum), 1.0f);
+	float fSum = 0.0f;
+	for (int i = 0; i < nDim; i++)
+	{
+		stEntry.vFeature[i] = fMomentum * stEntry.vFeature[i] + (1.0f - fMomentum) * pFeature[i];
+		fSum += stEntry.vFeature[i] * stEntry.vFeature[i];
+	}
+
+	fSum = sqrt(fSum);
+	if (fSum > 0.0f)
+	{
+		for (int i = 0; i < nDim; i++)
+			stEntry.vFeature[i] /= fSum;
+	}
+
+	stEntry.nSamples++;
+}
@@ -0,0 +1,572 @@
+#include "CFeatureCodec.h"
+#include "CFeatureMatcher.h"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <cfloat>
+#include <cmath>
+
+#ifdef _SIMD_X86_
+#include <immintrin.h>
+#endif
+
+// Number of centroids per PQ subspace, so each subspace is coded by 1 byte
+#define PQ_CENTROIDS		256
+// Maximum number of the sample embeddings of the PQ training. The larger samples barely move the centroids
+#define PQ_TRAIN_ROWS		16384
+// Minimum number of the sample embeddings of the training. Fewer leave the PQ centroids and the int8 ranges on a few embeddings
+#define CODEC_MIN_TRAIN_ROWS	PQ_CENTROIDS
+// The int8 codes are padded to a multiple of 4 bytes, followed by the float squared norm of the decoded embedding
+#define INT8_ALIGN			4
+
+
+#ifdef _SIMD_X86_
+// Horizontal sum of the 8 integer lanes
+_TARGET_AVX2_ static inline int32_t HorizontalSumEpi32AVX2(__m256i vSum)
+{
+	__m128i vLow = _mm_add_epi32(_mm256_castsi256_si128(vSum), _mm256_extracti128_si256(vSum, 1));
+	vLow = _mm_add_epi32(vLow, _mm_shuffle_epi32(vLow, _MM_SHUFFLE(1, 0, 3, 2)));
+	vLow = _mm_add_epi32(vLow, _mm_shuffle_epi32(vLow, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(vLow);
+}
+
+// Horizontal sum of the 8 float lanes
+_TARGET_AVX2_ static inline float HorizontalSumPsAVX2(__m256 vSum)
+{
+	__m128 vLow = _mm_add_ps(_mm256_castps256_ps128(vSum), _mm256_extractf128_ps(vSum, 1));
+	vLow = _mm_add_ps(vLow, _mm_movehl_ps(vLow, vLow));
+	vLow = _mm_add_ss(vLow, _mm_movehdup_ps(vLow));
+	return _mm_cvtss_f32(vLow);
+}
+
+// AVX512-VNNI version of DotInt8
+// The unsigned by signed byte product takes |a| and b with the sign of a, which is the same product.
+_TARGET_AVX512VNNI_ static int32_t DotInt8VNNI(const int8_t* pA, const int8_t* pB, int nDim)
+{
+	__m256i vAcc = _mm256_setzero_si256();
+
+	int k = 0;
+	for (; k <= nDim - 32; k += 32)
+	{
+		__m256i vA = _mm256_loadu_si256((const __m256i*)(pA + k));
+		__m256i vB = _mm256_loadu_si256((const __m256i*)(pB + k));
+		vAcc = _mm256_dpbusd_epi32(vAcc, _mm256_sign_epi8(vA, vA), _mm256_sign_epi8(vB, vA));
+	}
+
+	int32_t nSum = HorizontalSumEpi32AVX2(vAcc);
+	for (; k < nDim; k++)
+		nSum += (int32_t)pA[k] * pB[k];
+
+	return nSum;
+}
+
+// AVX2 version of DotInt8
+// The pairs of the byte products are summed into 16 bits, which does not saturate for the values within [-127, 127].
+_TARGET_AVX2_ static int32_t DotInt8AVX2(const int8_t* pA, const int8_t* pB, int nDim)
+{
+	__m256i vAcc = _mm256_setzero_si256();
+	__m256i vOnes = _mm256_set1_epi16(1);
+
+	int k = 0;
+	for (; k <= nDim - 32; k += 32)
+	{
+		__m256i vA = _mm256_loadu_si256((const __m256i*)(pA + k));
+		__m256i vB = _mm256_loadu_si256((const __m256i*)(pB + k));
+		__m256i vProd = _mm256_maddubs_epi16(_mm256_sign_epi8(vA, vA), _mm256_sign_epi8(vB, vA));
+		vAcc = _mm256_add_epi32(vAcc, _mm256_madd_epi16(vProd, vOnes));
+	}
+
+	int32_t nSum = HorizontalSumEpi32AVX2(vAcc);
+	for (; k < nDim; k++)
+		nSum += (int32_t)pA[k] * pB[k];
+
+	return nSum;
+}
+
+// F16C version of SimilarityFloat16
+_TARGET_F16C_ static float SimilarityFloat16F16C(const float* pQuery, const uint16_t* pCode, int nDim, bool bEuclidean)
+{
+	__m256 vAcc = _mm256_setzero_ps();
+
+	int k = 0;
+	for (; k <= nDim - 8; k += 8)
+	{
+		__m256 vQ = _mm256_loadu_ps(pQuery + k);
+		__m256 vC = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(pCode + k)));
+		if (bEuclidean)
+		{
+			__m256 vDiff = _mm256_sub_ps(vQ, vC);
+			vAcc = _mm256_fmadd_ps(vDiff, vDiff, vAcc);
+		}
+		else
+		{
+			vAcc = _mm256_fmadd_ps(vQ, vC, vAcc);
+		}
+	}
+
+	float fSum = HorizontalSumPsAVX2(vAcc);
+	for (; k < nDim; k++)
+	{
+		float fValue = (float)cv::float16_t::fromBits(pCode[k]);
+		fSum += bEuclidean ? (pQuery[k] - fValue) * (pQuery[k] - fValue) : pQuery[k] * fValue;
+	}
+
+	return bEuclidean ? 1 - sqrt(fSum) : fSum;
+}
+#endif
+
+// Inner product of two int8 vectors
+// @param[in] pA: 1st vector. Its values are within [-127, 127]
+// @param[in] pB: 2nd vector. Its values are within [-127, 127]
+// @param[in] nDim: dimension of the vectors
+// @return: inner product
+static int32_t DotInt8(const int8_t* pA, const int8_t* pB, int nDim)
+{
+#ifdef _SIMD_X86_
+	static const bool s_bVNNI = cv::checkHardwareSupport(CV_CPU_AVX512_CLX);
+	static const bool s_bAVX2 = cv::checkHardwareSupport(CV_CPU_AVX2);
+
+	if (s_bVNNI)
+		return DotInt8VNNI(pA, pB, nDim);
+	if (s_bAVX2)
+		return DotInt8AVX2(pA, pB, nDim);
+#endif
+
+	int32_t nSum = 0;
+	for (int k = 0; k < nDim; k++)
+		nSum += (int32_t)pA[k] * pB[k];
+
+	return nSum;
+}
+
+// Similarity between the float query and the fp16 embedding
+// @param[in] pQuery: query feature vector
+// @param[in] pCode: bits of the fp16 values of the embedding
+// @param[in] nDim: dimension of the vectors
+// @param[in] bEuclidean: true for eFmEuclidean, false for eFmCosine
+// @return: similarity
+static float SimilarityFloat16(const float* pQuery, const uint16_t* pCode, int nDim, bool bEuclidean)
+{
+#ifdef _SIMD_X86_
+	static const bool s_bF16C = cv::checkHardwareSupport(CV_CPU_AVX2) && cv::checkHardwareSupport(CV_CPU_FMA3) &&
+		cv::checkHardwareSupport(CV_CPU_FP16);
+
+	if (s_bF16C)
+		return SimilarityFloat16F16C(pQuery, pCode, nDim, bEuclidean);
+#endif
+
+	float fSum = 0.0f;
+	for (int k = 0; k < nDim; k++)
+	{
+		float fValue = (float)cv::float16_t::fromBits(pCode[k]);
+		fSum += bEuclidean ? (pQuery[k] - fValue) * (pQuery[k] - fValue) : pQuery[k] * fValue;
+	}
+
+	return bEuclidean ? 1 - sqrt(fSum) : fSum;
+}
+
+
+CFeatureCodec::CFeatureCodec(const FeatureCodecConfig& stConfig, int nDim, E_FeatureMetric eMetric)
+	: m_stConfig(stConfig)
+	, m_nDim(nDim)
+	, m_eMetric(eMetric)
+	, m_nCodeSize(0)
+	, m_bTrained(false)
+	, m_nSubspaces(0)
+	, m_nSubDim(0)
+	, m_nCentroids(0)
+{
+	switch (m_stConfig.eCodec)
+	{
+	case E_FeatureCodec::eFcFloat32:
+		m_nCodeSize = (size_t)nDim * sizeof(float);
+		m_bTrained = true;
+		break;
+	case E_FeatureCodec::eFcFloat16:
+		m_nCodeSize = (size_t)nDim * sizeof(uint16_t);
+		m_bTrained = true;
+		break;
+	case E_FeatureCodec::eFcInt8:
+		m_nCodeSize = (size_t)(nDim + INT8_ALIGN - 1) / INT8_ALIGN * INT8_ALIGN + sizeof(float);
+		break;
+	case E_FeatureCodec::eFcPQ:
+		m_nSubspaces = _MIN(_MAX(1, m_stConfig.nPQSubspaces), nDim);
+		m_nSubDim = (nDim + m_nSubspaces - 1) / m_nSubspaces;
+		m_nCodeSize = (size_t)m_nSubspaces;
+		break;
+	default:
+		break;
+	}
+}
+
+CFeatureCodec::~CFeatureCodec()
+{
+	m_vInt8Scales.clear();
+	m_vPQCentroids.clear();
+}
+
+// Train the codec on the sample embeddings
+// @param[in] pFeatures: 1st sample embedding
+// @param[in] nRows: number of the sample embeddings
+// @param[in] nStride: distance between the sample embeddings in floats
+// @return: true if the codec is trained successfully, false otherwise
+// [Note] - eFcInt8 takes the range of each dimension, and eFcPQ runs k-means of 256 centroids per subspace.
+//        - It fails for fewer sample embeddings than GetMinTrainRows().
+bool CFeatureCodec::Train(const float* pFeatures, int nRows, size_t nStride)
+{
+	if (!pFeatures || nRows <= 0 || nRows < GetMinTrainRows() || nStride < (size_t)m_nDim)
+		return false;
+
+	if (m_stConfig.eCodec == E_FeatureCodec::eFcInt8)
+	{
+		// The largest value of each dimension is mapped to 127
+		std::vector<float> vMaxAbs(m_nDim, 0.0f);
+		for (int i = 0; i < nRows; i++)
+		{
+			const float* pRow = pFeatures + (size_t)i * nStride;
+			for (int k = 0; k < m_nDim; k++)
+				vMaxAbs[k] = _MAX(vMaxAbs[k], _ABS(pRow[k]));
+		}
+
+		m_vInt8Scales.resize(m_nDim);
+		for (int k = 0; k < m_nDim; k++)
+			m_vInt8Scales[k] = _MAX(vMaxAbs[k], FLT_MIN) / 127.0f;
+
+		m_bTrained = true;
+		return true;
+	}
+
+	if (m_stConfig.eCodec == E_FeatureCodec::eFcPQ)
+	{
+		try
+		{
+			int nSamples = _MIN(nRows, PQ_TRAIN_ROWS);
+			int nCentroids = PQ_CENTROIDS;
+			std::vector<float> vCentroids((size_t)m_nSubspaces * PQ_CENTROIDS * m_nSubDim, 0.0f);
+
+			cv::Mat cvSamples(nSamples, m_nSubDim, CV_32F);
+			for (int m = 0; m < m_nSubspaces; m++)
+			{
+				// The samples are taken evenly over the whole input, and the last subspace is padded by zeros
+				int nBegin = m * m_nSubDim;
+				int nLen = _MIN(m_nSubDim, m_nDim - nBegin);
+				cvSamples.setTo(0.0f);
+				for (int i = 0; i < nSamples; i++)
+				{
+					const float* pRow = pFeatures + (size_t)((int64_t)i * nRows / nSamples) * nStride;
+					memcpy(cvSamples.ptr<float>(i), pRow + nBegin, nLen * sizeof(float));
+				}
+
+				cv::Mat cvLabels, cvSubCentroids;
+				cv::kmeans(cvSamples, nCentroids, cvLabels, cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS,
+					_MAX(1, m_stConfig.nTrainIters), 1e-4), 1, cv::KMEANS_PP_CENTERS, cvSubCentroids);
+
+				for (int c = 0; c < nCentroids; c++)
+					memcpy(vCentroids.data() + ((size_t)m * PQ_CENTROIDS + c) * m_nSubDim, cvSubCentroids.ptr<float>(c), m_nSubDim * sizeof(float));
+			}
+
+			m_vPQCentroids.swap(vCentroids);
+			m_nCentroids = nCentroids;
+		}
+		catch (cv::Exception& e)
+		{
+			const char* msg = e.what();
+			std::cout << msg << std::endl;
+			return false;
+		}
+
+		m_bTrained = true;
+		return true;
+	}
+
+	return m_bTrained;
+}
+
+// Check whether the codec is ready to encode
+// @return: true if the codec is trained or needs no training, false otherwise
+bool CFeatureCodec::IsTrained() const
+{
+	return m_bTrained;
+}
+
+// Get the minimum number of the sample embeddings to train the codec on
+// @return: number of the sample embeddings. 0 if the codec needs no training
+int CFeatureCodec::GetMinTrainRows() const
+{
+	if (m_stConfig.eCodec == E_FeatureCodec::eFcInt8 || m_stConfig.eCodec == E_FeatureCodec::eFcPQ)
+		return CODEC_MIN_TRAIN_ROWS;
+
+	return 0;
+}
+
+// Get the size of one compressed embedding
+// @return: size in bytes
+size_t CFeatureCodec::GetCodeSize() const
+{
+	return m_nCodeSize;
+}
+
+// Compress the embedding
+// @param[in] pFeature: embedding of nDim floats
+// @param[out] pCode: compressed embedding of GetCodeSize() bytes
+void CFeatureCodec::Encode(const float* pFeature, uint8_t* pCode) const
+{
+	switch (m_stConfig.eCodec)
+	{
+	case E_FeatureCodec::eFcFloat32:
+		memcpy(pCode, pFeature, m_nDim * sizeof(float));
+		break;
+
+	case E_FeatureCodec::eFcFloat16:
+	{
+		uint16_t* pHalf = (uint16_t*)pCode;
+		for (int k = 0; k < m_nDim; k++)
+			pHalf[k] = cv::float16_t(pFeature[k]).bits();
+		break;
+	}
+
+	case E_FeatureCodec::eFcInt8:
+	{
+		int8_t* pInt8 = (int8_t*)pCode;
+		size_t nPadded = m_nCodeSize - sizeof(float);
+		float fNorm2 = 0.0f;
+		for (int k = 0; k < m_nDim; k++)
+		{
+			int nValue = (int)lrintf(pFeature[k] / m_vInt8Scales[k]);
+			pInt8[k] = (int8_t)_MIN(_MAX(nValue, -127), 127);
+			fNorm2 += (pInt8[k] * m_vInt8Scales[k]) * (pInt8[k] * m_vInt8Scales[k]);
+		}
+		memset(pInt8 + m_nDim, 0, nPadded - m_nDim);
+		memcpy(pCode + nPadded, &fNorm2, sizeof(float));
+		break;
+	}
+
+	case E_FeatureCodec::eFcPQ:
+	{
+		// Nearest centroid of each subspace
+		for (int m = 0; m < m_nSubspaces; m++)
+		{
+			int nBegin = m * m_nSubDim;
+			int nLen = _MIN(m_nSubDim, m_nDim - nBegin);
+			const float* pCentroids = m_vPQCentroids.data() + (size_t)m * PQ_CENTROIDS * m_nSubDim;
+
+			int nBest = 0;
+			float fBest = FLT_MAX;
+			for (int c = 0; c < m_nCentroids; c++)
+			{
+				const float* pCentroid = pCentroids + (size_t)c * m_nSubDim;
+				float fDist = 0.0f;
+				for (int k = 0; k < m_nSubDim; k++)
+				{
+					float fDiff = (k < nLen ? pFeature[nBegin + k] : 0.0f) - pCentroid[k];
+					fDist += fDiff * fDiff;
+				}
+
+				if (fDist < fBest)
+				{
+					fBest = fDist;
+					nBest = c;
+				}
+			}
+
+			pCode[m] = (uint8_t)nBest;
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+// Restore the embedding from the compressed form
+// @param[in] pCode: compressed embedding
+// @param[out] pFeature: approximate embedding of nDim floats
+void CFeatureCodec::Decode(const uint8_t* pCode, float* pFeature) const
+{
+	switch (m_stConfig.eCodec)
+	{
+	case E_FeatureCodec::eFcFloat32:
+		memcpy(pFeature, pCode, m_nDim * sizeof(float));
+		break;
+
+	case E_FeatureCodec::eFcFloat16:
+	{
+		const uint16_t* pHalf = (const uint16_t*)pCode;
+		for (int k = 0; k < m_nDim; k++)
+			pFeature[k] = (float)cv::float16_t::fromBits(pHalf[k]);
+		break;
+	}
+
+	case E_FeatureCodec::eFcInt8:
+	{
+		const int8_t* pInt8 = (const int8_t*)pCode;
+		for (int k = 0; k < m_nDim; k++)
+			pFeature[k] = pInt8[k] * m_vInt8Scales[k];
+		break;
+	}
+
+	case E_FeatureCodec::eFcPQ:
+	{
+		for (int m = 0; m < m_nSubspaces; m++)
+		{
+			int nBegin = m * m_nSubDim;
+			int nLen = _MIN(m_nSubDim, m_nDim - nBegin);
+			const float* pCentroid = m_vPQCentroids.data() + ((size_t)m * PQ_CENTROIDS + pCode[m]) * m_nSubDim;
+			memcpy(pFeature + nBegin, pCentroid, nLen * sizeof(float));
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+// Prepare the query for the similarity to the compressed embeddings
+// @param[in] pQuery: query feature vector of nDim floats
+// @param[out] stQuery: prepared query
+void CFeatureCodec::PrepareQuery(const float* pQuery, FeatureCodecQuery& stQuery) const
+{
+	stQuery.fNorm2 = 0.0f;
+	for (int k = 0; k < m_nDim; k++)
+		stQuery.fNorm2 += pQuery[k] * pQuery[k];
+
+	switch (m_stConfig.eCodec)
+	{
+	case E_FeatureCodec::eFcFloat32:
+	case E_FeatureCodec::eFcFloat16:
+		stQuery.vQuery.assign(pQuery, pQuery + m_nDim);
+		break;
+
+	case E_FeatureCodec::eFcInt8:
+	{
+		// The query is multiplied by the scales of the codec, so the product of the integers is the product of the values
+		std::vector<float> vScaled(m_nDim);
+		float fMaxAbs = 0.0f;
+		for (int k = 0; k < m_nDim; k++)
+		{
+			vScaled[k] = pQuery[k] * m_vInt8Scales[k];
+			fMaxAbs = _MAX(fMaxAbs, _ABS(vScaled[k]));
+		}
+
+		stQuery.fInt8Scale = fMaxAbs > 0.0f ? fMaxAbs / 127.0f : 1.0f;
+		stQuery.vInt8Query.assign(m_nCodeSize - sizeof(float), 0);
+		for (int k = 0; k < m_nDim; k++)
+		{
+			int nValue = (int)lrintf(vScaled[k] / stQuery.fInt8Scale);
+			stQuery.vInt8Query[k] = (int8_t)_MIN(_MAX(nValue, -127), 127);
+		}
+		break;
+	}
+
+	case E_FeatureCodec::eFcPQ:
+	{
+		// Similarity of each subspace of the query to each centroid. The squared distances are summed for eFmEuclidean
+		bool bEuclidean = (m_eMetric == E_FeatureMetric::eFmEuclidean);
+		std::vector<float> vSub(m_nSubDim);
+		stQuery.vTable.assign((size_t)m_nSubspaces * PQ_CENTROIDS, 0.0f);
+		for (int m = 0; m < m_nSubspaces; m++)
+		{
+			int nBegin = m * m_nSubDim;
+			int nLen = _MIN(m_nSubDim, m_nDim - nBegin);
+			std::fill(vSub.begin(), vSub.end(), 0.0f);
+			memcpy(vSub.data(), pQuery + nBegin, nLen * sizeof(float));
+
+			const float* pCentroids = m_vPQCentroids.data() + (size_t)m * PQ_CENTROIDS * m_nSubDim;
+			float* pTable = stQuery.vTable.data() + (size_t)m * PQ_CENTROIDS;
+			for (int c = 0; c < m_nCentroids; c++)
+			{
+				const float* pCentroid = pCentroids + (size_t)c * m_nSubDim;
+				float fSum = 0.0f;
+				for (int k = 0; k < m_nSubDim; k++)
+					fSum += bEuclidean ? (vSub[k] - pCentroid[k]) * (vSub[k] - pCentroid[k]) : vSub[k] * pCentroid[k];
+				pTable[c] = fSum;
+			}
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+// Compute the similarity between the prepared query and the compressed embedding
+// @param[in] stQuery: query prepared by PrepareQuery()
+// @param[in] pCode: compressed embedding
+// @return: similarity of the metric of the codec
+float CFeatureCodec::Similarity(const FeatureCodecQuery& stQuery, const uint8_t* pCode) const
+{
+	bool bEuclidean = (m_eMetric == E_FeatureMetric::eFmEuclidean);
+
+	switch (m_stConfig.eCodec)
+	{
+	case E_FeatureCodec::eFcFloat32:
+		return CFeatureMatcher::Similarity(stQuery.vQuery.data(), (const float*)pCode, m_nDim, m_eMetric);
+
+	case E_FeatureCodec::eFcFloat16:
+		return SimilarityFloat16(stQuery.vQuery.data(), (const uint16_t*)pCode, m_nDim, bEuclidean);
+
+	case E_FeatureCodec::eFcInt8:
+	{
+		size_t nPadded = m_nCodeSize - sizeof(float);
+		float fNorm2 = 0.0f;
+		memcpy(&fNorm2, pCode + nPadded, sizeof(float));
+
+		float fDot = DotInt8(stQuery.vInt8Query.data(), (const int8_t*)pCode, (int)nPadded) * stQuery.fInt8Scale;
+		return DotToSimilarity(fDot, stQuery.fNorm2, fNorm2);
+	}
+
+	case E_FeatureCodec::eFcPQ:
+	{
+		const float* pTable = stQuery.vTable.data();
+		float fSum = 0.0f;
+		for (int m = 0; m < m_nSubspaces; m++, pTable += PQ_CENTROIDS)
+			fSum += pTable[pCode[m]];
+
+		return bEuclidean ? 1 - sqrt(_MAX(fSum, 0.0f)) : fSum;
+	}
+
+	default:
+		return -FLT_MAX;
+	}
+}
+
+// Compute the similarity between the prepared query and each of the compressed embeddings
+// @param[in] stQuery: query prepared by PrepareQuery()
+// @param[in] pCodes: 1st compressed embedding
+// @param[in] nRows: number of the compressed embeddings
+// @param[in] nCodeStride: distance between the compressed embeddings in bytes
+// @param[out] pSim: similarity of each compressed embedding
+void CFeatureCodec::Similarities(const FeatureCodecQuery& stQuery, const uint8_t* pCodes, int nRows, size_t nCodeStride, float* pSim) const
+{
+	if (m_stConfig.eCodec == E_FeatureCodec::eFcFloat32 && nCodeStride % sizeof(float) == 0)
+	{
+		// The uncompressed rows are a float matrix for the blocked kernel
+		CFeatureMatcher::Similarities(stQuery.vQuery.data(), (const float*)pCodes, nRows, m_nDim, nCodeStride / sizeof(float), m_eMetric, pSim);
+		return;
+	}
+
+	for (int i = 0; i < nRows; i++)
+		pSim[i] = Similarity(stQuery, pCodes + (size_t)i * nCodeStride);
+}
+
+// Get the configuration of the codec
+// @return: configuration
+const FeatureCodecConfig& CFeatureCodec::GetConfig() const
+{
+	return m_stConfig;
+}
+
+// Turn the inner product and the squared norms into the similarity of the metric
+// @param[in] fDot: inner product
+// @param[in] fNorm2A: squared norm of one vector
+// @param[in] fNorm2B: squared norm of the other vector
+// @return: similarity
+float CFeatureCodec::DotToSimilarity(float fDot, float fNorm2A, float fNorm2B) const
+{
+	if (m_eMetric == E_FeatureMetric::eFmEuclidean)
+		return 1 - sqrt(_MAX(fNorm2A + fNorm2B - 2 * fDot, 0.0f));
+
+	return fDot;
+}
@@ -0,0 +1,465 @@
+#include "CFeatureIndex.h"
+#include "CFeatureMatcher.h"
+#include "CGalleryStore.h"
+#include <iostream>
+#include <climits>
+#include <cfloat>
+#include <cstring>
+
+#ifdef _SIMD_X86_
+#include <immintrin.h>
+#endif
+
+// Number of the rows whose similarities are computed at a time by the linear scan
+#define EXACT_CHUNK_ROWS	65536
+// Rows owned by the index are padded to a multiple of 16 floats, as the gallery store
+#define INDEX_ROW_ALIGN		16
+
+CFeatureIndex::CFeatureIndex(const FeatureIndexConfig& stConfig, int nDim)
+	: m_stConfig(stConfig)
+	, m_nDim(nDim)
+	, m_nStride((size_t)(nDim + INDEX_ROW_ALIGN - 1) / INDEX_ROW_ALIGN * INDEX_ROW_ALIGN)
+	, m_nCount(0)
+	, m_nFeatureFirst(0)
+	, m_pStore(nullptr)
+	, m_pCodec(nullptr)
+{
+	if (stConfig.stCodec.eCodec > E_FeatureCodec::eFcFloat32 && stConfig.stCodec.eCodec < E_FeatureCodec::eFcCount)
+		m_pCodec = new CFeatureCodec(stConfig.stCodec, nDim, stConfig.eMetric);
+}
+
+CFeatureIndex::~CFeatureIndex()
+{
+	m_vFeatures.clear();
+	m_vCodes.clear();
+	m_pStore = nullptr;
+
+	if (m_pCodec)
+		delete m_pCodec;
+	m_pCodec = nullptr;
+}
+
+// Train the index on the sample rows
+// @param[in] pFeatures: 1st sample row
+// @param[in] nRows: number of the sample rows
+// @param[in] nStride: distance between the sample rows in floats
+// @return: true if the index is trained successfully, false otherwise
+// [Note] - The IVF index and the eFcInt8 and eFcPQ codecs need it. Otherwise they are trained once enough rows are added.
+//        - The codecs fail for fewer rows than CFeatureCodec::GetMinTrainRows().
+//        - It fails after the rows are added.
+bool CFeatureIndex::Train(const float* pFeatures, int nRows, size_t nStride)
+{
+	std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+	if (!pFeatures || nRows <= 0 || nStride < (size_t)m_nDim || m_nCount > 0)
+		return false;
+
+	if (m_pCodec && !m_pCodec->Train(pFeatures, nRows, nStride))
+		return false;
+
+	return TrainCore(pFeatures, nRows, nStride);
+}
+
+// Add the rows to the index
+// @param[in] pFeatures: 1st row
+// @param[in] nRows: number of the rows
+// @param[in] nStride: distance between the rows in floats
+// @return: true if the rows are added successfully, false otherwise
+// [Note] The rows are copied or compressed into the index. It fails for the index attached to a store.
+bool CFeatureIndex::Add(const float* pFeatures, int nRows, size_t nStride)
+{
+	std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+	if (m_pStore || !pFeatures || nRows < 0 || nStride < (size_t)m_nDim || nRows > INT_MAX - m_nCount)
+		return false;
+
+	if (nRows == 0)
+		return true;
+
+	// The compressed index keeps the uncompressed rows only while they are added
+	if (IsCompressed())
+	{
+		m_nFeatureFirst = m_nCount;
+		m_vFeatures.assign((size_t)nRows * m_nStride, 0.0f);
+	}
+	else
+	{
+		m_vFeatures.resize((size_t)(m_nCount + nRows) * m_nStride, 0.0f);
+	}
+
+	float* pRows = m_vFeatures.data() + (size_t)(m_nCount - m_nFeatureFirst) * m_nStride;
+	for (int i = 0; i < nRows; i++)
+		memcpy(pRows + (size_t)i * m_nStride, pFeatures + (size_t)i * nStride, m_nDim * sizeof(float));
+
+	bool bAdded = CompressRows(m_nCount, nRows) && AddCore(m_nCount, nRows);
+	if (bAdded)
+		m_nCount += nRows;
+
+	if (IsCompressed())
+	{
+		std::vector<float>().swap(m_vFeatures);
+		m_vCodes.resize((size_t)m_nCount * m_pCodec->GetCodeSize());
+		m_nFeatureFirst = m_nCount;
+	}
+	else
+	{
+		m_vFeatures.resize((size_t)m_nCount * m_nStride);
+	}
+
+	return bAdded;
+}
+
+// Add the rows of the store appended since the last call
+// @param[in] cStore: opened gallery store of the same dimension and metric
+// @return: true if the rows are added successfully, false otherwise
+// [Note] - The index is attached to the store on the first call, and reads the rows from it since then.
+//          The store should be kept opened while the index is used. It fails for another store or the index owning rows.
+//        - The appends of the store wait until the rows are added.
+bool CFeatureIndex::Add(const CGalleryStore& cStore)
+{
+	std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+	if ((m_pStore && m_pStore != &cStore) || (!m_pStore && m_nCount > 0))
+		return false;
+
+	std::shared_lock<std::shared_mutex> storeLock = cStore.LockRead();
+	if (!cStore.IsOpen() || cStore.GetDim() != m_nDim || cStore.GetMetric() != m_stConfig.eMetric)
+	{
+		std::cout << "The gallery store does not match the index" << std::endl;
+		return false;
+	}
+
+	int64_t nRows = cStore.GetCount() - m_nCount;
+	if (nRows > INT_MAX - m_nCount)
+		return false;
+
+	m_pStore = &cStore;
+	m_nStride = cStore.GetStride();
+	if (nRows <= 0)
+		return true;
+
+	if (!CompressRows(m_nCount, (int)nRows) || !AddCore(m_nCount, (int)nRows))
+	{
+		if (IsCompressed())
+			m_vCodes.resize((size_t)m_nCount * m_pCodec->GetCodeSize());
+		return false;
+	}
+
+	m_nCount += (int)nRows;
+	return true;
+}
+
+// Search the top K rows for the query
+// @param[in] pQuery: normalised query feature vector
+// @param[in] nTopK: maximum number of rows to return
+// @param[in] fSimThresh: minimum similarity to return
+// @param[out] vReIDRes: top K rows in the descending order of the similarity. nImgID is the row ID
+// @return: true if the search is performed successfully, false otherwise
+bool CFeatureIndex::Search(const float* pQuery, int nTopK, float fSimThresh, ReIDResArr& vReIDRes) const
+{
+	vReIDRes.clear();
+	if (!pQuery)
+		return false;
+
+	std::shared_lock<std::shared_mutex> lock(m_mutex);
+	std::shared_lock<std::shared_mutex> storeLock;
+	if (m_pStore)
+	{
+		storeLock = m_pStore->LockRead();
+		if (!m_pStore->IsOpen())
+			return false;
+	}
+
+	if (m_nCount == 0 || nTopK <= 0)
+		return true;
+
+	if (!IsCompressed() || !m_pStore || m_stConfig.nRerank <= 0)
+	{
+		SearchCore(pQuery, nTopK, fSimThresh, vReIDRes);
+		return true;
+	}
+
+	// The candidates of the compressed rows are reranked by the uncompressed rows of the store
+	ReIDResArr vCands;
+	SearchCore(pQuery, _MAX(nTopK, m_stConfig.nRerank), -FLT_MAX, vCands);
+
+	std::vector<float> vSimilarities(vCands.size());
+	for (int i = 0; i < (int)vCands.size(); i++)
+		vSimilarities[i] = CFeatureMatcher::Similarity(pQuery, GetRow(vCands[i].nImgID), m_nDim, m_stConfig.eMetric);
+
+	CFeatureMatcher::SelectTopK(vSimilarities.data(), (int)vCands.size(), nTopK, fSimThresh, vReIDRes);
+	for (ReIDRes& stRes : vReIDRes)
+		stRes.nImgID = vCands[stRes.nImgID].nImgID;
+
+	return true;
+}
+
+// Search the top K rows for the query by the linear scan of all the rows
+// @param[in] pQuery: normalised query feature vector
+// @param[in] nTopK: maximum number of rows to return
+// @param[in] fSimThresh: minimum similarity to return
+// @param[out] vReIDRes: top K rows in the descending order of the similarity. nImgID is the row ID
+// @return: true if the search is performed successfully, false otherwise
+bool CFeatureIndex::SearchExact(const float* pQuery, int nTopK, float fSimThresh, ReIDResArr& vReIDRes) const
+{
+	vReIDRes.clear();
+	if (!pQuery)
+		return false;
+
+	std::shared_lock<std::shared_mutex> lock(m_mutex);
+	std::shared_lock<std::shared_mutex> storeLock;
+	if (m_pStore)
+	{
+		storeLock = m_pStore->LockRead();
+		if (!m_pStore->IsOpen())
+			return false;
+	}
+
+	if (m_nCount == 0 || nTopK <= 0)
+		return true;
+
+	SearchExactCore(pQuery, nTopK, fSimThresh, vReIDRes);
+	return true;
+}
+
+// Measure the recall of Search() against SearchExact()
+// @param[in] pQueries: 1st row of the query feature matrix
+// @param[in] nQueries: number of queries
+// @param[in] nQueryStride: distance between the rows of the queries in floats
+// @param[in] nTopK: number of rows to compare
+// @return: average ratio of the exact top K rows found by Search(). -1 if it fails
+float CFeatureIndex::MeasureRecall(const float* pQueries, int nQueries, size_t nQueryStride, int nTopK) const
+{
+	if (!pQueries || nQueries <= 0 || nTopK <= 0)
+		return -1.0f;
+
+	ReIDResArr vApprox, vExact;
+	int64_t nFound = 0, nTotal = 0;
+	for (int q = 0; q < nQueries; q++)
+	{
+		const float* pQuery = pQueries + (size_t)q * nQueryStride;
+		if (!Search(pQuery, nTopK, -FLT_MAX, vApprox) || !SearchExact(pQuery, nTopK, -FLT_MAX, vExact))
+			return -1.0f;
+
+		for (const ReIDRes& stExact : vExact)
+		{
+			for (const ReIDRes& stApprox : vApprox)
+			{
+				if (stApprox.nImgID == stExact.nImgID)
+				{
+					nFound++;
+					break;
+				}
+			}
+		}
+		nTotal += vExact.size();
+	}
+
+	return nTotal > 0 ? (float)nFound / nTotal : 1.0f;
+}
+
+// Get the number of the rows in the index
+// @return: number of the rows
+int64_t CFeatureIndex::GetCount() const
+{
+	std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+	return m_nCount;
+}
+
+// Get the dimension of the rows
+// @return: dimension
+int CFeatureIndex::GetDim() const
+{
+	return m_nDim;
+}
+
+// Get the configuration of the index
+// @return: configuration
+const FeatureIndexConfig& CFeatureIndex::GetConfig() const
+{
+	return m_stConfig;
+}
+
+// Get the memory of the rows kept by the index
+// @return: size of the uncompressed or the compressed rows in bytes. 0 for the uncompressed rows of the attached store
+size_t CFeatureIndex::GetRowMemory() const
+{
+	std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+	// The compressed index keeps the uncompressed rows until the codec is trained
+	return m_vCodes.size() + m_vFeatures.size() * sizeof(float);
+}
+
+// Train the index on the sample rows. The index is locked
+// @param[in] pFeatures: 1st sample row
+// @param[in] nRows: number of the sample rows
+// @param[in] nStride: distance between the sample rows in floats
+// @return: true if the index is trained successfully, false otherwise
+// [Note] The default implementation does nothing.
+bool CFeatureIndex::TrainCore(const float* /*pFeatures*/, int /*nRows*/, size_t /*nStride*/)
+{
+	return true;
+}
+
+// Search the top K rows for the query by the linear scan. The index is locked and holds the rows
+// @param[in] pQuery: normalised query feature vector
+// @param[in] nTopK: maximum number of rows to return. Greater than 0
+// @param[in] fSimThresh: minimum similarity to return
+// @param[out] vReIDRes: top K rows in the descending order of the similarity. nImgID is the row ID
+void CFeatureIndex::SearchExactCore(const float* pQuery, int nTopK, float fSimThresh, ReIDResArr& vReIDRes) const
+{
+	vReIDRes.clear();
+
+	// Only the compressed rows are kept if the compressed index is not attached to a store
+	bool bCompressed = (IsCompressed() && !m_pStore);
+	FeatureCodecQuery stQuery;
+	if (bCompressed)
+		m_pCodec->PrepareQuery(pQuery, stQuery);
+
+	std::vector<float> vSimilarities(_MIN(m_nCount, EXACT_CHUNK_ROWS));
+	ReIDResArr vChunkRes;
+	for (int nOffset = 0; nOffset < m_nCount; nOffset += EXACT_CHUNK_ROWS)
+	{
+		int nRows = _MIN(m_nCount - nOffset, EXACT_CHUNK_ROWS);
+		if (bCompressed)
+		{
+			size_t nCodeSize = m_pCodec->GetCodeSize();
+			m_pCodec->Similarities(stQuery, m_vCodes.data() + (size_t)nOffset * nCodeSize, nRows, nCodeSize, vSimilarities.data());
+		}
+		else
+		{
+			CFeatureMatcher::Similarities(pQuery, GetRow(nOffset), nRows, m_nDim, m_nStride, m_stConfig.eMetric, vSimilarities.data());
+		}
+
+		CFeatureMatcher::SelectTopK(vSimilarities.data(), nRows, nTopK, fSimThresh, vChunkRes);
+		CFeatureMatcher::MergeTopK(vChunkRes, nOffset, nTopK, vReIDRes);
+	}
+}
+
+// Get the uncompressed row
+// @param[in] nID: row ID
+// @return: address of the row. nullptr if only the compressed row is kept
+// [Note] The rows being added are always uncompressed during AddCore().
+const float* CFeatureIndex::GetRow(int nID) const
+{
+	if (m_pStore)
+		return m_pStore->GetFeatures() + (size_t)nID * m_nStride;
+
+	if (nID < m_nFeatureFirst || (size_t)(nID - m_nFeatureFirst) * m_nStride >= m_vFeatures.size())
+		return nullptr;
+
+	return m_vFeatures.data() + (size_t)(nID - m_nFeatureFirst) * m_nStride;
+}
+
+// Get the uncompressed row, or decode the compressed one
+// @param[in] nID: row ID
+// @param[in] vBuffer: buffer of the decoded row
+// @return: address of the row
+const float* CFeatureIndex::GetRow(int nID, std::vector<float>& vBuffer) const
+{
+	const float* pRow = GetRow(nID);
+	if (pRow)
+		return pRow;
+
+	vBuffer.resize(m_nDim);
+	m_pCodec->Decode(m_vCodes.data() + (size_t)nID * m_pCodec->GetCodeSize(), vBuffer.data());
+	return vBuffer.data();
+}
+
+// Prepare the query for Similarity()
+// @param[in] pQuery: query feature vector
+// @param[out] stQuery: prepared query
+void CFeatureIndex::PrepareQuery(const float* pQuery, FeatureCodecQuery& stQuery) const
+{
+	if (IsCompressed())
+		m_pCodec->PrepareQuery(pQuery, stQuery);
+	else
+		stQuery.vQuery.assign(pQuery, pQuery + m_nDim);
+}
+
+// Compute the similarity between the prepared query and the row, in the compressed form for the compressed index
+// @param[in] stQuery: query prepared by PrepareQuery()
+// @param[in] nID: row ID
+// @return: similarity of the metric of the index
+float CFeatureIndex::Similarity(const FeatureCodecQuery& stQuery, int nID) const
+{
+	if (IsCompressed())
+		return m_pCodec->Similarity(stQuery, m_vCodes.data() + (size_t)nID * m_pCodec->GetCodeSize());
+
+	return CFeatureMatcher::Similarity(stQuery.vQuery.data(), GetRow(nID), m_nDim, m_stConfig.eMetric);
+}
+
+// Compute the similarity between the feature vector and the row, decoded for the compressed index
+// @param[in] pFeature: feature vector
+// @param[in] nID: row ID
+// @param[in] vBuffer: buffer of the decoded row
+// @return: similarity of the metric of the index
+float CFeatureIndex::RowSimilarity(const float* pFeature, int nID, std::vector<float>& vBuffer) const
+{
+	return CFeatureMatcher::Similarity(pFeature, GetRow(nID, vBuffer), m_nDim, m_stConfig.eMetric);
+}
+
+// Prefetch the row or the compressed row into the cache, so the scattered rows are loaded in parallel
+// @param[in] nID: row ID
+void CFeatureIndex::PrefetchRow(int nID) const
+{
+#ifdef _SIMD_X86_
+	const char* pBytes = nullptr;
+	size_t nBytes = 0;
+	if (IsCompressed())
+	{
+		nBytes = m_pCodec->GetCodeSize();
+		pBytes = (const char*)(m_vCodes.data() + (size_t)nID * nBytes);
+	}
+	else
+	{
+		nBytes = m_nDim * sizeof(float);
+		pBytes = (const char*)GetRow(nID);
+	}
+
+	for (size_t i = 0; i < nBytes; i += 64)
+		_mm_prefetch(pBytes + i, _MM_HINT_T0);
+#endif
+}
+
+// Compress the rows which are already readable by GetRow(), training the codec on all the rows once there are enough
+// @param[in] nFirst: ID of the first row
+// @param[in] nRows: number of the rows
+// @return: true if the rows are compressed successfully, kept uncompressed until the training or the index is not
+//          compressed, false otherwise
+// [Note] All the rows added before the training are compressed with the rows.
+bool CFeatureIndex::CompressRows(int nFirst, int nRows)
+{
+	if (!m_pCodec)
+		return true;
+
+	if (!m_pCodec->IsTrained())
+	{
+		// A few rows leave the codec on them, so the rows are kept uncompressed and scanned exactly until there are enough
+		int nTotal = nFirst + nRows;
+		if (nTotal < m_pCodec->GetMinTrainRows())
+			return true;
+
+		// The rows added so far are contiguous from the first one, owned by the index or in the store
+		if (!m_pCodec->Train(GetRow(0), nTotal, m_nStride))
+			return false;
+
+		nFirst = 0;
+		nRows = nTotal;
+	}
+
+	size_t nCodeSize = m_pCodec->GetCodeSize();
+	m_vCodes.resize((size_t)(nFirst + nRows) * nCodeSize);
+	for (int i = 0; i < nRows; i++)
+		m_pCodec->Encode(GetRow(nFirst + i), m_vCodes.data() + (size_t)(nFirst + i) * nCodeSize);
+
+	return true;
+}
+
+// Check whether the rows are kept in the compressed form
+// @return: true if the index has a trained codec, false otherwise
+bool CFeatureIndex::IsCompressed() const
+{
+	return m_pCodec && m_pCodec->IsTrained();
+}
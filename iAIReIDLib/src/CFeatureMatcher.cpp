@@ -0,0 +1,391 @@
+#include "CFeatureMatcher.h"
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cmath>
+
+#ifdef _SIMD_X86_
+#include <immintrin.h>
+#endif
+
+// Number of gallery rows computed together, so each block of a query is loaded once for several rows
+#define ROW_BLOCK	4
+// Number of queries computed together, so each block of a gallery row is loaded once for several queries
+#define QUERY_BLOCK	2
+
+
+#ifdef _SIMD_X86_
+// Horizontal sum of the 8 lanes
+_TARGET_AVX2_ static inline float HorizontalSumAVX2(__m256 vSum)
+{
+	__m128 vLow = _mm_add_ps(_mm256_castps256_ps128(vSum), _mm256_extractf128_ps(vSum, 1));
+	vLow = _mm_add_ps(vLow, _mm_movehl_ps(vLow, vLow));
+	vLow = _mm_add_ss(vLow, _mm_movehdup_ps(vLow));
+	return _mm_cvtss_f32(vLow);
+}
+
+// Similarities of a block of NQ queries against a block of NR gallery rows
+// Each block of a gallery row is loaded once for all the queries, and each block of a query once for all the rows.
+template <int NQ, int NR>
+_TARGET_AVX2_ static void SimilarityBlockAVX2(const float* const* ppQuery, const float* const* ppRow, int nDim, bool bEuclidean,
+	float* pSim, size_t nSimStride)
+{
+	__m256 vAcc[NQ][NR];
+	for (int q = 0; q < NQ; q++)
+		for (int r = 0; r < NR; r++)
+			vAcc[q][r] = _mm256_setzero_ps();
+
+	int k = 0;
+	for (; k <= nDim - 8; k += 8)
+	{
+		__m256 vG[NR];
+		for (int r = 0; r < NR; r++)
+			vG[r] = _mm256_loadu_ps(ppRow[r] + k);
+
+		for (int q = 0; q < NQ; q++)
+		{
+			__m256 vQ = _mm256_loadu_ps(ppQuery[q] + k);
+			for (int r = 0; r < NR; r++)
+			{
+				if (bEuclidean)
+				{
+					__m256 vDiff = _mm256_sub_ps(vQ, vG[r]);
+					vAcc[q][r] = _mm256_fmadd_ps(vDiff, vDiff, vAcc[q][r]);
+				}
+				else
+				{
+					vAcc[q][r] = _mm256_fmadd_ps(vQ, vG[r], vAcc[q][r]);
+				}
+			}
+		}
+	}
+
+	for (int q = 0; q < NQ; q++)
+	{
+		const float* pQuery = ppQuery[q];
+		for (int r = 0; r < NR; r++)
+		{
+			const float* pRow = ppRow[r];
+			float fSum = HorizontalSumAVX2(vAcc[q][r]);
+			for (int j = k; j < nDim; j++)
+			{
+				if (bEuclidean)
+					fSum += (pQuery[j] - pRow[j]) * (pQuery[j] - pRow[j]);
+				else
+					fSum += pQuery[j] * pRow[j];
+			}
+
+			pSim[q * nSimStride + r] = bEuclidean ? 1 - sqrt(fSum) : fSum;
+		}
+	}
+}
+
+// Similarities of NQ queries against all the gallery rows
+template <int NQ>
+_TARGET_AVX2_ static void SimilarityRowsAVX2(const float* const* ppQuery, const float* pGallery, int nRows, int nDim, size_t nStride,
+	bool bEuclidean, float* pSim, size_t nSimStride)
+{
+	const float* ppRow[ROW_BLOCK];
+
+	int i = 0;
+	for (; i <= nRows - ROW_BLOCK; i += ROW_BLOCK)
+	{
+		for (int r = 0; r < ROW_BLOCK; r++)
+			ppRow[r] = pGallery + (size_t)(i + r) * nStride;
+
+		SimilarityBlockAVX2<NQ, ROW_BLOCK>(ppQuery, ppRow, nDim, bEuclidean, pSim + i, nSimStride);
+	}
+
+	for (; i < nRows; i++)
+	{
+		ppRow[0] = pGallery + (size_t)i * nStride;
+		SimilarityBlockAVX2<NQ, 1>(ppQuery, ppRow, nDim, bEuclidean, pSim + i, nSimStride);
+	}
+}
+
+// AVX2 version of SimilarityMatrix
+_TARGET_AVX2_ static void SimilarityMatrixAVX2(const float* pQueries, int nQueries, size_t nQueryStride, const float* pGallery,
+	int nRows, int nDim, size_t nStride, bool bEuclidean, float* pSim)
+{
+	const float* ppQuery[QUERY_BLOCK];
+
+	int q = 0;
+	for (; q <= nQueries - QUERY_BLOCK; q += QUERY_BLOCK)
+	{
+		for (int j = 0; j < QUERY_BLOCK; j++)
+			ppQuery[j] = pQueries + (size_t)(q + j) * nQueryStride;
+
+		SimilarityRowsAVX2<QUERY_BLOCK>(ppQuery, pGallery, nRows, nDim, nStride, bEuclidean, pSim + (size_t)q * nRows, nRows);
+	}
+
+	for (; q < nQueries; q++)
+	{
+		ppQuery[0] = pQueries + (size_t)q * nQueryStride;
+		SimilarityRowsAVX2<1>(ppQuery, pGallery, nRows, nDim, nStride, bEuclidean, pSim + (size_t)q * nRows, nRows);
+	}
+}
+
+// AVX2 version of Similarity
+// Four independent accumulators hide the latency of FMA, since one pair of vectors has no other work to interleave.
+// [Note] The lanes sum in another order than the scalar version, so the similarity differs from it in the last bits.
+_TARGET_AVX2_ static float SimilarityAVX2(const float* pFeatureA, const float* pFeatureB, int nDim, bool bEuclidean)
+{
+	__m256 vAcc[4] = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+
+	int k = 0;
+	for (; k <= nDim - 32; k += 32)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			__m256 vA = _mm256_loadu_ps(pFeatureA + k + 8 * j);
+			__m256 vB = _mm256_loadu_ps(pFeatureB + k + 8 * j);
+			if (bEuclidean)
+			{
+				__m256 vDiff = _mm256_sub_ps(vA, vB);
+				vAcc[j] = _mm256_fmadd_ps(vDiff, vDiff, vAcc[j]);
+			}
+			else
+			{
+				vAcc[j] = _mm256_fmadd_ps(vA, vB, vAcc[j]);
+			}
+		}
+	}
+	for (; k <= nDim - 8; k += 8)
+	{
+		__m256 vA = _mm256_loadu_ps(pFeatureA + k);
+		__m256 vB = _mm256_loadu_ps(pFeatureB + k);
+		if (bEuclidean)
+		{
+			__m256 vDiff = _mm256_sub_ps(vA, vB);
+			vAcc[0] = _mm256_fmadd_ps(vDiff, vDiff, vAcc[0]);
+		}
+		else
+		{
+			vAcc[0] = _mm256_fmadd_ps(vA, vB, vAcc[0]);
+		}
+	}
+
+	float fSum = HorizontalSumAVX2(_mm256_add_ps(_mm256_add_ps(vAcc[0], vAcc[1]), _mm256_add_ps(vAcc[2], vAcc[3])));
+	for (; k < nDim; k++)
+	{
+		if (bEuclidean)
+			fSum += (pFeatureA[k] - pFeatureB[k]) * (pFeatureA[k] - pFeatureB[k]);
+		else
+			fSum += pFeatureA[k] * pFeatureB[k];
+	}
+
+	return bEuclidean ? 1 - sqrt(fSum) : fSum;
+}
+
+// AVX2 version of L2Normalise
+// [Note] The squares are summed by 8 lanes and FMA, so the norm, and with it the normalised feature, differs from the scalar
+//        version in the last bits. The features are compared by the similarity, so they are not required to be bitwise equal.
+_TARGET_AVX2_ static void L2NormaliseAVX2(const float* pOrgFeature, int nDim, float* pNorFeature)
+{
+	__m256 vAcc = _mm256_setzero_ps();
+	int i = 0;
+	for (; i <= nDim - 8; i += 8)
+	{
+		__m256 vValue = _mm256_loadu_ps(pOrgFeature + i);
+		vAcc = _mm256_fmadd_ps(vValue, vValue, vAcc);
+	}
+
+	float fSum = HorizontalSumAVX2(vAcc);
+	for (int j = i; j < nDim; j++)
+		fSum += pOrgFeature[j] * pOrgFeature[j];
+	fSum = sqrt(fSum);
+
+	// Divided by the norm instead of multiplied by its reciprocal, which would add another rounding
+	__m256 vNorm = _mm256_set1_ps(fSum);
+	for (i = 0; i <= nDim - 8; i += 8)
+		_mm256_storeu_ps(pNorFeature + i, _mm256_div_ps(_mm256_loadu_ps(pOrgFeature + i), vNorm));
+	for (; i < nDim; i++)
+		pNorFeature[i] = pOrgFeature[i] / fSum;
+}
+#endif
+
+// Compute the similarity between two feature vectors
+// @param[in] pFeatureA: 1st feature vector
+// @param[in] pFeatureB: 2nd feature vector
+// @param[in] nDim: dimension of the feature vectors
+// @param[in] eMetric: similarity metric
+// @return: similarity
+// [Note] It is for the scattered rows, such as the graph search. Use Similarities() for the rows of a matrix.
+float CFeatureMatcher::Similarity(const float* pFeatureA, const float* pFeatureB, int nDim, E_FeatureMetric eMetric)
+{
+	bool bEuclidean = (eMetric == E_FeatureMetric::eFmEuclidean);
+
+#ifdef _SIMD_X86_
+	static const bool s_bAVX2 = cv::checkHardwareSupport(CV_CPU_AVX2) && cv::checkHardwareSupport(CV_CPU_FMA3);
+
+	if (s_bAVX2)
+		return SimilarityAVX2(pFeatureA, pFeatureB, nDim, bEuclidean);
+#endif
+
+	float fSum = 0.0f;
+	for (int k = 0; k < nDim; k++)
+	{
+		if (bEuclidean)
+			fSum += (pFeatureA[k] - pFeatureB[k]) * (pFeatureA[k] - pFeatureB[k]);
+		else
+			fSum += pFeatureA[k] * pFeatureB[k];
+	}
+
+	return bEuclidean ? 1 - sqrt(fSum) : fSum;
+}
+
+// Compute the similarity between the query feature and each row of the gallery
+// @param[in] pQuery: query feature vector
+// @param[in] pGallery: 1st row of the gallery feature matrix
+// @param[in] nRows: number of rows of the gallery
+// @param[in] nDim: dimension of the feature vectors
+// @param[in] nStride: distance between the rows of the gallery in floats. It is nDim for the continuous matrix
+// @param[in] eMetric: similarity metric
+// @param[out] pSim: similarity of each row
+// [Note] eFmCosine is the inner product, so the feature vectors should be normalised in advance.
+void CFeatureMatcher::Similarities(const float* pQuery, const float* pGallery, int nRows, int nDim, size_t nStride,
+	E_FeatureMetric eMetric, float* pSim)
+{
+	SimilarityMatrix(pQuery, 1, nDim, pGallery, nRows, nDim, nStride, eMetric, pSim);
+}
+
+// Compute the similarity between each query and each row of the gallery by one matrix-matrix product
+// @param[in] pQueries: 1st row of the query feature matrix
+// @param[in] nQueries: number of queries
+// @param[in] nQueryStride: distance between the rows of the queries in floats
+// @param[in] pGallery: 1st row of the gallery feature matrix
+// @param[in] nRows: number of rows of the gallery
+// @param[in] nDim: dimension of the feature vectors
+// @param[in] nStride: distance between the rows of the gallery in floats. It is nDim for the continuous matrix
+// @param[in] eMetric: similarity metric
+// @param[out] pSim: similarity matrix of nQueries x nRows. Row q holds the similarities of query q
+// [Note] eFmCosine is the inner product, so the feature vectors should be normalised in advance.
+void CFeatureMatcher::SimilarityMatrix(const float* pQueries, int nQueries, size_t nQueryStride, const float* pGallery, int nRows, int nDim,
+	size_t nStride, E_FeatureMetric eMetric, float* pSim)
+{
+	if (nQueries <= 0 || nRows <= 0 || nDim <= 0)
+		return;
+
+	bool bEuclidean = (eMetric == E_FeatureMetric::eFmEuclidean);
+
+#ifdef _SIMD_X86_
+	static const bool s_bAVX2 = cv::checkHardwareSupport(CV_CPU_AVX2) && cv::checkHardwareSupport(CV_CPU_FMA3);
+
+	if (s_bAVX2)
+	{
+		SimilarityMatrixAVX2(pQueries, nQueries, nQueryStride, pGallery, nRows, nDim, nStride, bEuclidean, pSim);
+		return;
+	}
+#endif
+
+	for (int q = 0; q < nQueries; q++)
+	{
+		const float* pQuery = pQueries + (size_t)q * nQueryStride;
+		float* pQuerySim = pSim + (size_t)q * nRows;
+
+		for (int i = 0; i < nRows; i++)
+		{
+			const float* pRow = pGallery + (size_t)i * nStride;
+
+			float fSum = 0.0f;
+			if (bEuclidean)
+			{
+				for (int k = 0; k < nDim; k++)
+					fSum += (pQuery[k] - pRow[k]) * (pQuery[k] - pRow[k]);
+
+				pQuerySim[i] = 1 - sqrt(fSum);
+			}
+			else
+			{
+				for (int k = 0; k < nDim; k++)
+					fSum += pQuery[k] * pRow[k];
+
+				pQuerySim[i] = fSum;
+			}
+		}
+	}
+}
+
+// Select the top K rows in the descending order of the similarity
+// @param[in] pSim: similarity of each row
+// @param[in] nRows: number of rows
+// @param[in] nTopK: maximum number of rows to select
+// @param[in] fSimThresh: minimum similarity to select
+// @param[out] vReIDRes: selected rows. nImgID is the row index
+// [Note] The rows of the same similarity are ordered by the row index.
+void CFeatureMatcher::SelectTopK(const float* pSim, int nRows, int nTopK, float fSimThresh, ReIDResArr& vReIDRes)
+{
+	vReIDRes.clear();
+	if (nRows <= 0 || nTopK <= 0)
+		return;
+
+	// Only the rows over the threshold can be selected, so the others are not sorted at all
+	std::vector<int> vCandIdx;
+	vCandIdx.reserve(nRows);
+	for (int i = 0; i < nRows; i++)
+	{
+		if (pSim[i] >= fSimThresh)
+			vCandIdx.push_back(i);
+	}
+
+	int nLen = _MIN(nTopK, (int)vCandIdx.size());
+	std::partial_sort(vCandIdx.begin(), vCandIdx.begin() + nLen, vCandIdx.end(), [pSim](int x, int y)
+	{
+		return pSim[x] > pSim[y] || (pSim[x] == pSim[y] && x < y);
+	});
+
+	vReIDRes.reserve(nLen);
+	for (int i = 0; i < nLen; i++)
+		vReIDRes.push_back(ReIDRes(i, vCandIdx[i], pSim[vCandIdx[i]]));
+}
+
+// Merge the top K rows of a chunk of the gallery into the running top K rows
+// @param[in] vChunkRes: top K rows of the chunk. nImgID is the row index in the chunk
+// @param[in] nOffset: row index of the first row of the chunk
+// @param[in] nTopK: maximum number of rows to keep
+// @param[in/out] vReIDRes: running top K rows. nImgID is the row index in the gallery
+// [Note] The rows of the same similarity are ordered by the row index.
+void CFeatureMatcher::MergeTopK(const ReIDResArr& vChunkRes, int64_t nOffset, int nTopK, ReIDResArr& vReIDRes)
+{
+	for (const ReIDRes& stRes : vChunkRes)
+		vReIDRes.push_back(ReIDRes(0, (int)(stRes.nImgID + nOffset), stRes.fSimilarity));
+
+	int nLen = _MAX(0, _MIN(nTopK, (int)vReIDRes.size()));
+	std::partial_sort(vReIDRes.begin(), vReIDRes.begin() + nLen, vReIDRes.end(), [](const ReIDRes& x, const ReIDRes& y)
+	{
+		return x.fSimilarity > y.fSimilarity || (x.fSimilarity == y.fSimilarity && x.nImgID < y.nImgID);
+	});
+	vReIDRes.resize(nLen);
+
+	for (int i = 0; i < nLen; i++)
+		vReIDRes[i].nRank = i;
+}
+
+// Normalise the feature vector by L2 norm
+// @param[in] pOrgFeature: original feature vector
+// @param[in] nDim: dimension of the feature vector
+// @param[out] pNorFeature: normalised feature vector. It can be the same buffer as pOrgFeature
+// [Note] The AVX2 version sums in another order, so the features normalised on the CPUs with and without AVX2 match within
+//        the rounding error of the sum, not bitwise.
+void CFeatureMatcher::L2Normalise(const float* pOrgFeature, int nDim, float* pNorFeature)
+{
+#ifdef _SIMD_X86_
+	static const bool s_bAVX2 = cv::checkHardwareSupport(CV_CPU_AVX2) && cv::checkHardwareSupport(CV_CPU_FMA3);
+
+	if (s_bAVX2)
+	{
+		L2NormaliseAVX2(pOrgFeature, nDim, pNorFeature);
+		return;
+	}
+#endif
+
+	float fSum = 0.0f;
+	for (int i = 0; i < nDim; i++)
+	{
+		fSum += pOrgFeature[i] * pOrgFeature[i];
+	}
+	fSum = sqrt(fSum);
+	for (int i = 0; i < nDim; i++)
+	{
+		pNorFeature[i] = pOrgFeature[i] / fSum;
+	}
+}
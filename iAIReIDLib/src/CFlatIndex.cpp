@@ -0,0 +1,32 @@
+#include "CFlatIndex.h"
+
+CFlatIndex::CFlatIndex(const FeatureIndexConfig& stConfig, int nDim)
+	: CFeatureIndex(stConfig, nDim)
+{
+
+}
+
+CFlatIndex::~CFlatIndex()
+{
+
+}
+
+// Index the rows which are already readable by GetRow(). The index is locked
+// @param[in] nFirst: ID of the first row
+// @param[in] nRows: number of the rows
+// @return: true if the rows are indexed successfully, false otherwise
+bool CFlatIndex::AddCore(int /*nFirst*/, int /*nRows*/)
+{
+	// The rows are scanned as they are
+	return true;
+}
+
+// Search the top K rows for the query. The index is locked and holds the rows
+// @param[in] pQuery: normalised query feature vector
+// @param[in] nTopK: maximum number of rows to return. Greater than 0
+// @param[in] fSimThresh: minimum similarity to return
+// @param[out] vReIDRes: top K rows in the descending order of the similarity. nImgID is the row ID
+void CFlatIndex::SearchCore(const float* pQuery, int nTopK, float fSimThresh, ReIDResArr& vReIDRes) const
+{
+	SearchExactCore(pQuery, nTopK, fSimThresh, vReIDRes);
+}
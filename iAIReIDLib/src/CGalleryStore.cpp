@@ -0,0 +1,535 @@
+#include "CGalleryStore.h"
+#include <iostream>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define STORE_MAGIC			"IAIGSTOR"	// magic of the store file
+#define META_MAGIC			"IAIGMETA"	// magic of the side table
+#define STORE_VERSION		1			// version of the file format
+#define STORE_HEADER_SIZE	4096		// size of the header of the store file. The rows start on a page boundary
+#define META_HEADER_SIZE	64			// size of the header of the side table
+#define STORE_ROW_ALIGN		16			// rows are padded to a multiple of 16 floats, that is 64 bytes
+#define STORE_MIN_CAPACITY	1024		// number of rows of a new store
+
+// Header of the store file
+typedef struct _GalleryStoreHeader
+{
+	char		szMagic[8];			// STORE_MAGIC
+	uint32_t	nVersion;			// STORE_VERSION
+	uint32_t	nHeaderSize;		// STORE_HEADER_SIZE
+	uint32_t	nDim;				// dimension of the embeddings
+	uint32_t	nStride;			// distance between the rows in floats
+	int32_t		eMetric;			// E_FeatureMetric of the embeddings
+	uint32_t	nMetaSize;			// size of GalleryMeta
+	uint64_t	nCount;				// number of embeddings
+	uint64_t	nCapacity;			// number of rows the file can hold
+	char		szModelID[64];		// ID of the model extracting the embeddings. Null terminated
+}GalleryStoreHeader;
+
+// Header of the side table
+typedef struct _GalleryMetaHeader
+{
+	char		szMagic[8];			// META_MAGIC
+	uint32_t	nVersion;			// STORE_VERSION
+	uint32_t	nMetaSize;			// size of GalleryMeta
+}GalleryMetaHeader;
+
+static_assert(sizeof(GalleryStoreHeader) <= STORE_HEADER_SIZE, "Header of the gallery store is too large");
+static_assert(sizeof(GalleryMetaHeader) <= META_HEADER_SIZE, "Header of the gallery side table is too large");
+static_assert(sizeof(GalleryMeta) == 24, "GalleryMeta is written to the file as it is");
+
+
+// Open the file
+// @param[in] sPath: path of the file
+// @param[in] bReadOnly: true to open for reading only
+// @param[out] stFile: opened file
+// @return: true if the file is opened successfully, false otherwise
+static bool OpenFile(const std::string& sPath, bool bReadOnly, MappedFile& stFile)
+{
+#ifdef _WIN32
+	HANDLE hFile = CreateFileA(sPath.c_str(), GENERIC_READ | (bReadOnly ? 0 : GENERIC_WRITE), FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+		bReadOnly ? OPEN_EXISTING : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	stFile.hFile = (intptr_t)hFile;
+#else
+	int nFd = open(sPath.c_str(), bReadOnly ? O_RDONLY : (O_RDWR | O_CREAT), 0644);
+	if (nFd < 0)
+		return false;
+	stFile.hFile = nFd;
+#endif
+
+	return true;
+}
+
+// Get the size of the file
+// @param[in] stFile: opened file
+// @return: size of the file in bytes. -1 if it fails
+static int64_t GetFileSize(const MappedFile& stFile)
+{
+#ifdef _WIN32
+	LARGE_INTEGER liSize;
+	if (!GetFileSizeEx((HANDLE)stFile.hFile, &liSize))
+		return -1;
+	return liSize.QuadPart;
+#else
+	struct stat stStat;
+	if (fstat((int)stFile.hFile, &stStat) != 0)
+		return -1;
+	return stStat.st_size;
+#endif
+}
+
+// Resize the file
+// @param[in] stFile: opened file which is not mapped
+// @param[in] nSize: new size of the file in bytes
+// @return: true if the file is resized successfully, false otherwise
+static bool ResizeFile(const MappedFile& stFile, uint64_t nSize)
+{
+#ifdef _WIN32
+	LARGE_INTEGER liSize;
+	liSize.QuadPart = (LONGLONG)nSize;
+	return SetFilePointerEx((HANDLE)stFile.hFile, liSize, NULL, FILE_BEGIN) && SetEndOfFile((HANDLE)stFile.hFile);
+#else
+	return ftruncate((int)stFile.hFile, (off_t)nSize) == 0;
+#endif
+}
+
+// Map the whole file
+// @param[in/out] stFile: opened file
+// @param[in] nSize: size of the file in bytes
+// @param[in] bReadOnly: true to map for reading only
+// @return: true if the file is mapped successfully, false otherwise
+static bool MapFile(MappedFile& stFile, uint64_t nSize, bool bReadOnly)
+{
+#ifdef _WIN32
+	HANDLE hMapping = CreateFileMappingA((HANDLE)stFile.hFile, NULL, bReadOnly ? PAGE_READONLY : PAGE_READWRITE,
+		(DWORD)(nSize >> 32), (DWORD)(nSize & 0xFFFFFFFF), NULL);
+	if (!hMapping)
+		return false;
+
+	void* pData = MapViewOfFile(hMapping, bReadOnly ? FILE_MAP_READ : FILE_MAP_WRITE, 0, 0, (SIZE_T)nSize);
+	if (!pData)
+	{
+		CloseHandle(hMapping);
+		return false;
+	}
+	stFile.hMapping = (intptr_t)hMapping;
+#else
+	void* pData = mmap(nullptr, (size_t)nSize, PROT_READ | (bReadOnly ? 0 : PROT_WRITE), MAP_SHARED, (int)stFile.hFile, 0);
+	if (pData == MAP_FAILED)
+		return false;
+#endif
+
+	stFile.pData = (uint8_t*)pData;
+	stFile.nSize = nSize;
+	return true;
+}
+
+// Unmap the file
+// @param[in/out] stFile: mapped file
+static void UnmapFile(MappedFile& stFile)
+{
+	if (!stFile.pData)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(stFile.pData);
+	CloseHandle((HANDLE)stFile.hMapping);
+	stFile.hMapping = 0;
+#else
+	munmap(stFile.pData, (size_t)stFile.nSize);
+#endif
+
+	stFile.pData = nullptr;
+	stFile.nSize = 0;
+}
+
+// Write the mapped view to the disk
+// @param[in] stFile: mapped file
+// @return: true if the view is written successfully, false otherwise
+static bool FlushFile(const MappedFile& stFile)
+{
+	if (!stFile.pData)
+		return true;
+
+#ifdef _WIN32
+	return FlushViewOfFile(stFile.pData, 0) && FlushFileBuffers((HANDLE)stFile.hFile);
+#else
+	return msync(stFile.pData, (size_t)stFile.nSize, MS_SYNC) == 0;
+#endif
+}
+
+// Unmap and close the file
+// @param[in/out] stFile: opened file
+static void CloseFile(MappedFile& stFile)
+{
+	UnmapFile(stFile);
+
+	if (stFile.hFile == -1)
+		return;
+
+#ifdef _WIN32
+	CloseHandle((HANDLE)stFile.hFile);
+#else
+	close((int)stFile.hFile);
+#endif
+
+	stFile.hFile = -1;
+}
+
+
+CGalleryStore::CGalleryStore()
+	: m_nDim(0)
+	, m_nStride(0)
+	, m_eMetric(E_FeatureMetric::eFmUnknown)
+	, m_bReadOnly(true)
+	, m_nCount(0)
+	, m_nCapacity(0)
+{
+
+}
+
+CGalleryStore::~CGalleryStore()
+{
+	Close();
+}
+
+// Open the store, or create it if the file does not exist
+// @param[in] sPath: path of the store file. The side table is <sPath>.meta
+// @param[in] sModelID: ID of the model extracting the embeddings. Empty to accept the ID of the existing store
+// @param[in] nDim: dimension of the embeddings. 0 or less to accept the dimension of the existing store
+// @param[in] eMetric: similarity metric of the embeddings. eFmUnknown to accept the metric of the existing store
+// @param[in] bReadOnly: true to open the existing store for the search only
+// @return: true if the store is opened successfully, false otherwise
+// [Note] The existing store is rejected if its model ID, dimension or metric differs from the given one.
+bool CGalleryStore::Open(const std::string& sPath, const std::string& sModelID, int nDim, E_FeatureMetric eMetric, bool bReadOnly/* = false*/)
+{
+	Close();
+
+	std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+	if (sModelID.size() >= sizeof(GalleryStoreHeader::szModelID))
+		return false;
+
+	if (!OpenFile(sPath, bReadOnly, m_stData) || !OpenFile(sPath + ".meta", bReadOnly, m_stMeta))
+	{
+		std::cout << "Failed to open the gallery store: " << sPath << std::endl;
+		CloseFile(m_stData);
+		CloseFile(m_stMeta);
+		return false;
+	}
+
+	m_sPath = sPath;
+	m_bReadOnly = bReadOnly;
+
+	int64_t nDataSize = GetFileSize(m_stData);
+	int64_t nMetaSize = GetFileSize(m_stMeta);
+	bool bValid = (nDataSize >= 0 && nMetaSize >= 0);
+
+	if (bValid && nDataSize == 0 && !bReadOnly)
+	{
+		// Create the new store
+		if (nDim <= 0 || eMetric <= E_FeatureMetric::eFmUnknown || eMetric >= E_FeatureMetric::eFmCount)
+		{
+			bValid = false;
+		}
+		else
+		{
+			m_sModelID = sModelID;
+			m_nDim = nDim;
+			m_nStride = (size_t)(nDim + STORE_ROW_ALIGN - 1) / STORE_ROW_ALIGN * STORE_ROW_ALIGN;
+			m_eMetric = eMetric;
+			m_nCount = 0;
+			m_nCapacity = 0;
+
+			bValid = Grow(STORE_MIN_CAPACITY);
+			if (bValid)
+			{
+				GalleryStoreHeader* pHeader = (GalleryStoreHeader*)m_stData.pData;
+				memset(pHeader, 0, sizeof(GalleryStoreHeader));
+				memcpy(pHeader->szMagic, STORE_MAGIC, sizeof(pHeader->szMagic));
+				pHeader->nVersion = STORE_VERSION;
+				pHeader->nHeaderSize = STORE_HEADER_SIZE;
+				pHeader->nDim = (uint32_t)m_nDim;
+				pHeader->nStride = (uint32_t)m_nStride;
+				pHeader->eMetric = (int32_t)m_eMetric;
+				pHeader->nMetaSize = sizeof(GalleryMeta);
+				strncpy(pHeader->szModelID, m_sModelID.c_str(), sizeof(pHeader->szModelID) - 1);
+
+				GalleryMetaHeader* pMetaHeader = (GalleryMetaHeader*)m_stMeta.pData;
+				memset(pMetaHeader, 0, sizeof(GalleryMetaHeader));
+				memcpy(pMetaHeader->szMagic, META_MAGIC, sizeof(pMetaHeader->szMagic));
+				pMetaHeader->nVersion = STORE_VERSION;
+				pMetaHeader->nMetaSize = sizeof(GalleryMeta);
+
+				WriteHeader();
+			}
+		}
+	}
+	else if (bValid && nDataSize >= STORE_HEADER_SIZE && nMetaSize >= META_HEADER_SIZE)
+	{
+		// Open the existing store, and check it is written by the same model in the same format
+		bValid = MapFile(m_stData, (uint64_t)nDataSize, bReadOnly) && MapFile(m_stMeta, (uint64_t)nMetaSize, bReadOnly);
+		if (bValid)
+		{
+			const GalleryStoreHeader* pHeader = (const GalleryStoreHeader*)m_stData.pData;
+			const GalleryMetaHeader* pMetaHeader = (const GalleryMetaHeader*)m_stMeta.pData;
+
+			bValid = memcmp(pHeader->szMagic, STORE_MAGIC, sizeof(pHeader->szMagic)) == 0 &&
+				memcmp(pMetaHeader->szMagic, META_MAGIC, sizeof(pMetaHeader->szMagic)) == 0 &&
+				pHeader->nVersion == STORE_VERSION && pHeader->nHeaderSize == STORE_HEADER_SIZE &&
+				pHeader->nMetaSize == sizeof(GalleryMeta) && pMetaHeader->nMetaSize == sizeof(GalleryMeta) &&
+				pHeader->nDim > 0 && pHeader->nStride >= pHeader->nDim;
+		}
+
+		if (bValid)
+		{
+			const GalleryStoreHeader* pHeader = (const GalleryStoreHeader*)m_stData.pData;
+			m_sModelID = std::string(pHeader->szModelID, strnlen(pHeader->szModelID, sizeof(pHeader->szModelID)));
+			m_nDim = (int)pHeader->nDim;
+			m_nStride = pHeader->nStride;
+			m_eMetric = (E_FeatureMetric)pHeader->eMetric;
+
+			// The rows beyond the file sizes are not trusted even if the header says so
+			int64_t nDataRows = (nDataSize - STORE_HEADER_SIZE) / (int64_t)(m_nStride * sizeof(float));
+			int64_t nMetaRows = (nMetaSize - META_HEADER_SIZE) / (int64_t)sizeof(GalleryMeta);
+			m_nCapacity = _MIN(nDataRows, nMetaRows);
+			m_nCount = _MIN((int64_t)pHeader->nCount, m_nCapacity);
+
+			if ((!sModelID.empty() && sModelID != m_sModelID) || (nDim > 0 && nDim != m_nDim) ||
+				(eMetric != E_FeatureMetric::eFmUnknown && eMetric != m_eMetric))
+			{
+				std::cout << "The gallery store is written by another model: " << sPath << " (" << m_sModelID << ")" << std::endl;
+				bValid = false;
+			}
+		}
+	}
+	else
+	{
+		bValid = false;
+	}
+
+	if (!bValid)
+	{
+		CloseFile(m_stData);
+		CloseFile(m_stMeta);
+		m_nCount = m_nCapacity = 0;
+		return false;
+	}
+
+	return true;
+}
+
+// Write the header and close the store
+void CGalleryStore::Close()
+{
+	std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+	if (m_stData.pData && !m_bReadOnly)
+	{
+		WriteHeader();
+		FlushFile(m_stData);
+		FlushFile(m_stMeta);
+	}
+
+	CloseFile(m_stData);
+	CloseFile(m_stMeta);
+	m_nCount = 0;
+	m_nCapacity = 0;
+}
+
+// Check whether the store is opened
+// @return: true if the store is opened, false otherwise
+bool CGalleryStore::IsOpen() const
+{
+	return m_stData.pData != nullptr;
+}
+
+// Append one embedding to the store
+// @param[in] pFeature: normalised embedding of GetDim() floats
+// @param[in] stMeta: metadata of the embedding
+// @return: true if the embedding is appended successfully, false otherwise
+bool CGalleryStore::Append(const float* pFeature, const GalleryMeta& stMeta)
+{
+	cv::Mat cvFeature(1, m_nDim, CV_32F, (void*)pFeature);
+	return Append(cvFeature, std::vector<GalleryMeta>(1, stMeta));
+}
+
+// Append the embeddings to the store
+// @param[in] cvFeatures: embedding matrix of CV_32F. Each row is a normalised embedding of GetDim() floats
+// @param[in] vMetas: metadata of each row
+// @return: true if the embeddings are appended successfully, false otherwise
+bool CGalleryStore::Append(const cv::Mat& cvFeatures, const std::vector<GalleryMeta>& vMetas)
+{
+	std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+	if (!m_stData.pData || m_bReadOnly)
+		return false;
+
+	if (cvFeatures.type() != CV_32F || cvFeatures.cols != m_nDim || cvFeatures.rows != (int)vMetas.size())
+		return false;
+
+	int64_t nRows = cvFeatures.rows;
+	if (m_nCount + nRows > m_nCapacity && !Grow(_MAX(m_nCapacity * 2, m_nCount + nRows)))
+		return false;
+
+	float* pRow = (float*)(m_stData.pData + STORE_HEADER_SIZE) + (size_t)m_nCount * m_nStride;
+	GalleryMeta* pMeta = (GalleryMeta*)(m_stMeta.pData + META_HEADER_SIZE) + m_nCount;
+	for (int i = 0; i < (int)nRows; i++, pRow += m_nStride)
+	{
+		memcpy(pRow, cvFeatures.ptr<float>(i), m_nDim * sizeof(float));
+		memset(pRow + m_nDim, 0, (m_nStride - m_nDim) * sizeof(float));
+		pMeta[i] = vMetas[i];
+	}
+
+	// The count is the commit point, so it is updated after the rows
+	m_nCount += nRows;
+	WriteHeader();
+
+	return true;
+}
+
+// Reserve the rows in the files, so the appends do not remap them
+// @param[in] nRows: number of rows to reserve
+// @return: true if the rows are reserved successfully, false otherwise
+bool CGalleryStore::Reserve(int64_t nRows)
+{
+	std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+	if (!m_stData.pData || m_bReadOnly)
+		return false;
+
+	if (nRows <= m_nCapacity)
+		return true;
+
+	return Grow(nRows);
+}
+
+// Write the mapped rows and the header to the disk
+// @return: true if they are written successfully, false otherwise
+bool CGalleryStore::Flush()
+{
+	std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+	if (!m_stData.pData || m_bReadOnly)
+		return true;
+
+	WriteHeader();
+	return FlushFile(m_stData) && FlushFile(m_stMeta);
+}
+
+// Lock the store against the appends while the rows are read
+// @return: lock shared by the readers
+std::shared_lock<std::shared_mutex> CGalleryStore::LockRead() const
+{
+	return std::shared_lock<std::shared_mutex>(m_mutex);
+}
+
+// Get the number of embeddings
+// @return: number of embeddings
+int64_t CGalleryStore::GetCount() const
+{
+	return m_nCount;
+}
+
+// Get the dimension of the embeddings
+// @return: dimension of the embeddings
+int CGalleryStore::GetDim() const
+{
+	return m_nDim;
+}
+
+// Get the distance between the rows
+// @return: distance between the rows in floats
+size_t CGalleryStore::GetStride() const
+{
+	return m_nStride;
+}
+
+// Get the similarity metric of the embeddings
+// @return: similarity metric
+E_FeatureMetric CGalleryStore::GetMetric() const
+{
+	return m_eMetric;
+}
+
+// Get the ID of the model extracting the embeddings
+// @return: model ID
+const std::string& CGalleryStore::GetModelID() const
+{
+	return m_sModelID;
+}
+
+// Get the first row of the embeddings
+// @return: address of the first row. nullptr if the store is not opened
+// [Note] The address is valid while LockRead() is held.
+const float* CGalleryStore::GetFeatures() const
+{
+	if (!m_stData.pData)
+		return nullptr;
+
+	return (const float*)(m_stData.pData + STORE_HEADER_SIZE);
+}
+
+// Get the metadata of the embedding
+// @param[in] nIdx: index of the embedding
+// @return: metadata. nullptr if the index is out of range
+// [Note] The address is valid while LockRead() is held.
+const GalleryMeta* CGalleryStore::GetMeta(int64_t nIdx) const
+{
+	if (!m_stMeta.pData || nIdx < 0 || nIdx >= m_nCount)
+		return nullptr;
+
+	return (const GalleryMeta*)(m_stMeta.pData + META_HEADER_SIZE) + nIdx;
+}
+
+// Grow the files to hold the given number of rows and map them again
+// @param[in] nCapacity: number of rows
+// @return: true if the files are grown successfully, false otherwise
+bool CGalleryStore::Grow(int64_t nCapacity)
+{
+	if (m_stData.pData)
+		WriteHeader();
+
+	UnmapFile(m_stData);
+	UnmapFile(m_stMeta);
+
+	uint64_t nDataSize = STORE_HEADER_SIZE + (uint64_t)nCapacity * m_nStride * sizeof(float);
+	uint64_t nMetaSize = META_HEADER_SIZE + (uint64_t)nCapacity * sizeof(GalleryMeta);
+
+	if (!ResizeFile(m_stData, nDataSize) || !ResizeFile(m_stMeta, nMetaSize) ||
+		!MapFile(m_stData, nDataSize, false) || !MapFile(m_stMeta, nMetaSize, false))
+	{
+		std::cout << "Failed to grow the gallery store: " << m_sPath << std::endl;
+		CloseFile(m_stData);
+		CloseFile(m_stMeta);
+		m_nCount = m_nCapacity = 0;
+		return false;
+	}
+
+	m_nCapacity = nCapacity;
+	return true;
+}
+
+// Write the count and the capacity to the header
+void CGalleryStore::WriteHeader()
+{
+	GalleryStoreHeader* pHeader = (GalleryStoreHeader*)m_stData.pData;
+	pHeader->nCount = (uint64_t)m_nCount;
+	pHeader->nCapacity = (uint64_t)m_nCapacity;
+}
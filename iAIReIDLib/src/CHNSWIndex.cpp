@@ -0,0 +1,340 @@
+#include "CHNSWIndex.h"
+#include <algorithm>
+#include <queue>
+#include <cmath>
+
+CHNSWIndex::CHNSWIndex(const FeatureIndexConfig& stConfig, int nDim)
+	: CFeatureIndex(stConfig, nDim)
+	, m_nM(_MAX(2, stConfig.nM))
+	, m_nMaxM0(2 * _MAX(2, stConfig.nM))
+	, m_nEfConstruction(_MAX(_MAX(2, stConfig.nM), stConfig.nEfConstruction))
+	, m_nEfSearch(_MAX(1, stConfig.nEfSearch))
+	, m_dLevelMult(1.0 / log((double)_MAX(2, stConfig.nM)))
+	, m_nEntry(-1)
+	, m_nMaxLevel(-1)
+	, m_rng(100)
+{
+
+}
+
+CHNSWIndex::~CHNSWIndex()
+{
+	m_vLinks0.clear();
+	m_vUpperLinks.clear();
+	m_vLevels.clear();
+	m_vVisitedPool.clear();
+}
+
+// Set the number of candidates searched for a query
+// @param[in] nEfSearch: number of candidates. Larger is more accurate but slower
+void CHNSWIndex::SetEfSearch(int nEfSearch)
+{
+	std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+	m_nEfSearch = _MAX(1, nEfSearch);
+}
+
+// Index the rows which are already readable by GetRow(). The index is locked
+// @param[in] nFirst: ID of the first row
+// @param[in] nRows: number of the rows
+// @return: true if the rows are indexed successfully, false otherwise
+bool CHNSWIndex::AddCore(int nFirst, int nRows)
+{
+	size_t nNodes = (size_t)nFirst + nRows;
+	m_vLinks0.resize(nNodes * (1 + m_nMaxM0), 0);
+	m_vUpperLinks.resize(nNodes);
+	m_vLevels.resize(nNodes, 0);
+
+	std::uniform_real_distribution<double> cUniform(0.0, 1.0);
+	for (int i = nFirst; i < nFirst + nRows; i++)
+	{
+		// The layer of the node follows the exponential distribution, so each upper layer has 1/M nodes of the lower one
+		int nLevel = (int)(-log(1.0 - cUniform(m_rng)) * m_dLevelMult);
+		m_vLevels[i] = nLevel;
+		if (nLevel > 0)
+			m_vUpperLinks[i].assign((size_t)nLevel * (1 + m_nM), 0);
+
+		Insert(i);
+	}
+
+	return true;
+}
+
+// Search the top K rows for the query. The index is locked and holds the rows
+// @param[in] pQuery: normalised query feature vector
+// @param[in] nTopK: maximum number of rows to return. Greater than 0
+// @param[in] fSimThresh: minimum similarity to return
+// @param[out] vReIDRes: top K rows in the descending order of the similarity. nImgID is the row ID
+void CHNSWIndex::SearchCore(const float* pQuery, int nTopK, float fSimThresh, ReIDResArr& vReIDRes) const
+{
+	vReIDRes.clear();
+	if (m_nEntry < 0)
+		return;
+
+	FeatureCodecQuery stQuery;
+	PrepareQuery(pQuery, stQuery);
+
+	SimNode stCur(Similarity(stQuery, m_nEntry), m_nEntry);
+	for (int nLevel = m_nMaxLevel; nLevel > 0; nLevel--)
+		GreedySearch(stQuery, stCur, nLevel);
+
+	std::vector<SimNode> vCands;
+	SearchLayer(stQuery, stCur, _MAX(m_nEfSearch, nTopK), 0, vCands);
+
+	for (int i = 0; i < (int)vCands.size() && (int)vReIDRes.size() < nTopK; i++)
+	{
+		if (vCands[i].first < fSimThresh)
+			break;
+
+		vReIDRes.push_back(ReIDRes((int)vReIDRes.size(), vCands[i].second, vCands[i].first));
+	}
+}
+
+// Link the new node into the graph
+// @param[in] nID: node ID
+void CHNSWIndex::Insert(int nID)
+{
+	int nLevel = m_vLevels[nID];
+	if (m_nEntry < 0)
+	{
+		m_nEntry = nID;
+		m_nMaxLevel = nLevel;
+		return;
+	}
+
+	// The new row is searched as a query, compared with the compressed rows of the compressed index as the searches are
+	FeatureCodecQuery stQuery;
+	PrepareQuery(GetRow(nID), stQuery);
+
+	SimNode stCur(Similarity(stQuery, m_nEntry), m_nEntry);
+	for (int l = m_nMaxLevel; l > nLevel; l--)
+		GreedySearch(stQuery, stCur, l);
+
+	std::vector<SimNode> vCands, vNeighbourCands;
+	std::vector<float> vNeighbourBuffer, vBuffer;
+	for (int l = _MIN(nLevel, m_nMaxLevel); l >= 0; l--)
+	{
+		SearchLayer(stQuery, stCur, m_nEfConstruction, l, vCands);
+		stCur = vCands[0];
+
+		SelectLinks(vCands, m_nM);
+
+		int* pLinks = GetLinks(nID, l);
+		pLinks[0] = (int)vCands.size();
+		for (int i = 0; i < (int)vCands.size(); i++)
+			pLinks[1 + i] = vCands[i].second;
+
+		// Link the neighbours back, and reselect their links when they are full
+		int nMaxLinks = (l == 0) ? m_nMaxM0 : m_nM;
+		for (const SimNode& stNeighbour : vCands)
+		{
+			int* pNeighbourLinks = GetLinks(stNeighbour.second, l);
+			if (pNeighbourLinks[0] < nMaxLinks)
+			{
+				pNeighbourLinks[1 + pNeighbourLinks[0]++] = nID;
+				continue;
+			}
+
+			for (int i = 0; i < pNeighbourLinks[0]; i++)
+				PrefetchRow(pNeighbourLinks[1 + i]);
+
+			const float* pNeighbourRow = GetRow(stNeighbour.second, vNeighbourBuffer);
+			vNeighbourCands.clear();
+			vNeighbourCands.push_back(SimNode(stNeighbour.first, nID));
+			for (int i = 0; i < pNeighbourLinks[0]; i++)
+				vNeighbourCands.push_back(SimNode(RowSimilarity(pNeighbourRow, pNeighbourLinks[1 + i], vBuffer), pNeighbourLinks[1 + i]));
+			std::sort(vNeighbourCands.begin(), vNeighbourCands.end(), std::greater<SimNode>());
+
+			SelectLinks(vNeighbourCands, nMaxLinks);
+			pNeighbourLinks[0] = (int)vNeighbourCands.size();
+			for (int i = 0; i < (int)vNeighbourCands.size(); i++)
+				pNeighbourLinks[1 + i] = vNeighbourCands[i].second;
+		}
+	}
+
+	if (nLevel > m_nMaxLevel)
+	{
+		m_nEntry = nID;
+		m_nMaxLevel = nLevel;
+	}
+}
+
+// Descend greedily to the node most similar to the query on the layer
+// @param[in] stQuery: query prepared by PrepareQuery()
+// @param[in/out] stCur: start node, and the most similar node found
+// @param[in] nLevel: layer
+void CHNSWIndex::GreedySearch(const FeatureCodecQuery& stQuery, SimNode& stCur, int nLevel) const
+{
+	bool bChanged = true;
+	while (bChanged)
+	{
+		bChanged = false;
+
+		const int* pLinks = GetLinks(stCur.second, nLevel);
+		for (int i = 0; i < pLinks[0]; i++)
+		{
+			float fSim = Similarity(stQuery, pLinks[1 + i]);
+			if (fSim > stCur.first)
+			{
+				stCur = SimNode(fSim, pLinks[1 + i]);
+				bChanged = true;
+			}
+		}
+	}
+}
+
+// Search the candidates most similar to the query on the layer
+// @param[in] stQuery: query prepared by PrepareQuery()
+// @param[in] stEntry: entry node
+// @param[in] nEf: number of candidates
+// @param[in] nLevel: layer
+// @param[out] vResult: candidates in the descending order of the similarity
+void CHNSWIndex::SearchLayer(const FeatureCodecQuery& stQuery, const SimNode& stEntry, int nEf, int nLevel, std::vector<SimNode>& vResult) const
+{
+	VisitedList stVisited = AcquireVisited();
+
+	// The candidates to explore, most similar first, and the found nodes, least similar first to be replaced
+	std::priority_queue<SimNode> qCands;
+	std::priority_queue<SimNode, std::vector<SimNode>, std::greater<SimNode>> qFound;
+	std::vector<int> vNeighbours;
+	vNeighbours.reserve(m_nMaxM0);
+
+	stVisited.vMarks[stEntry.second] = stVisited.nMark;
+	qCands.push(stEntry);
+	qFound.push(stEntry);
+
+	while (!qCands.empty())
+	{
+		SimNode stCand = qCands.top();
+		if (stCand.first < qFound.top().first && (int)qFound.size() >= nEf)
+			break;
+		qCands.pop();
+
+		// The rows of the new neighbours are requested together before any of them is compared
+		const int* pLinks = GetLinks(stCand.second, nLevel);
+		vNeighbours.clear();
+		for (int i = 0; i < pLinks[0]; i++)
+		{
+			int nNeighbour = pLinks[1 + i];
+			if (stVisited.vMarks[nNeighbour] == stVisited.nMark)
+				continue;
+			stVisited.vMarks[nNeighbour] = stVisited.nMark;
+
+			PrefetchRow(nNeighbour);
+			vNeighbours.push_back(nNeighbour);
+		}
+
+		for (int nNeighbour : vNeighbours)
+		{
+			float fSim = Similarity(stQuery, nNeighbour);
+			if ((int)qFound.size() < nEf || fSim > qFound.top().first)
+			{
+				qCands.push(SimNode(fSim, nNeighbour));
+				qFound.push(SimNode(fSim, nNeighbour));
+				if ((int)qFound.size() > nEf)
+					qFound.pop();
+			}
+		}
+	}
+
+	ReleaseVisited(stVisited);
+
+	vResult.resize(qFound.size());
+	for (int i = (int)vResult.size() - 1; i >= 0; i--)
+	{
+		vResult[i] = qFound.top();
+		qFound.pop();
+	}
+}
+
+// Select the links among the candidates, keeping only the candidates closer to the node than to the selected links
+// @param[in/out] vCands: candidates in the descending order of the similarity to the node, and the selected links
+// @param[in] nMaxLinks: maximum number of links
+void CHNSWIndex::SelectLinks(std::vector<SimNode>& vCands, int nMaxLinks) const
+{
+	if ((int)vCands.size() <= nMaxLinks)
+		return;
+
+	// A candidate closer to a selected link than to the node is reached through that link, so it is not linked directly.
+	// It keeps the links spread in all the directions instead of crowding in the densest one.
+	std::vector<SimNode> vSelected;
+	vSelected.reserve(nMaxLinks);
+	std::vector<float> vCandBuffer, vBuffer;
+	for (const SimNode& stCand : vCands)
+	{
+		if ((int)vSelected.size() >= nMaxLinks)
+			break;
+
+		const float* pCandRow = GetRow(stCand.second, vCandBuffer);
+		bool bDiverse = true;
+		for (const SimNode& stSelected : vSelected)
+		{
+			if (RowSimilarity(pCandRow, stSelected.second, vBuffer) > stCand.first)
+			{
+				bDiverse = false;
+				break;
+			}
+		}
+
+		if (bDiverse)
+			vSelected.push_back(stCand);
+	}
+
+	vCands.swap(vSelected);
+}
+
+// Get the links of the node on the layer
+// @param[in] nID: node ID
+// @param[in] nLevel: layer
+// @return: number of links followed by the linked node IDs
+int* CHNSWIndex::GetLinks(int nID, int nLevel)
+{
+	if (nLevel == 0)
+		return m_vLinks0.data() + (size_t)nID * (1 + m_nMaxM0);
+
+	return m_vUpperLinks[nID].data() + (size_t)(nLevel - 1) * (1 + m_nM);
+}
+
+const int* CHNSWIndex::GetLinks(int nID, int nLevel) const
+{
+	if (nLevel == 0)
+		return m_vLinks0.data() + (size_t)nID * (1 + m_nMaxM0);
+
+	return m_vUpperLinks[nID].data() + (size_t)(nLevel - 1) * (1 + m_nM);
+}
+
+// Take a visited list of the pool for a search
+// @return: visited list cleared for the search
+VisitedList CHNSWIndex::AcquireVisited() const
+{
+	VisitedList stVisited;
+	{
+		std::lock_guard<std::mutex> lock(m_visitedMutex);
+		if (!m_vVisitedPool.empty())
+		{
+			stVisited = std::move(m_vVisitedPool.back());
+			m_vVisitedPool.pop_back();
+		}
+	}
+
+	// The marks are cleared by the new mark instead of writing all the nodes, except when the mark wraps around
+	if (++stVisited.nMark == 0)
+	{
+		std::fill(stVisited.vMarks.begin(), stVisited.vMarks.end(), 0);
+		stVisited.nMark = 1;
+	}
+
+	if (stVisited.vMarks.size() < m_vLevels.size())
+		stVisited.vMarks.resize(m_vLevels.size(), 0);
+
+	return stVisited;
+}
+
+// Return the visited list to the pool
+// @param[in] stVisited: visited list taken by AcquireVisited()
+void CHNSWIndex::ReleaseVisited(VisitedList& stVisited) const
+{
+	std::lock_guard<std::mutex> lock(m_visitedMutex);
+
+	m_vVisitedPool.push_back(std::move(stVisited));
+}
@@ -0,0 +1,224 @@
+#include "CIVFIndex.h"
+#include "CFeatureMatcher.h"
+#include <iostream>
+#include <cfloat>
+
+// Number of the sample rows of k-means per list. The larger samples barely move the centroids but slow down the training
+#define TRAIN_ROWS_PER_LIST		256
+// Minimum number of the added rows per list to train the lists on them. Fewer rows leave the centroids on the outliers
+#define MIN_TRAIN_ROWS_PER_LIST	39
+// Number of the rows assigned to the lists at a time, so the similarity buffer stays small
+#define ASSIGN_CHUNK_ROWS		4096
+
+CIVFIndex::CIVFIndex(const FeatureIndexConfig& stConfig, int nDim)
+	: CFeatureIndex(stConfig, nDim)
+	, m_nProbes(_MAX(1, stConfig.nProbes))
+{
+
+}
+
+CIVFIndex::~CIVFIndex()
+{
+	m_cvCentroids.release();
+	m_vLists.clear();
+}
+
+// Set the number of lists searched for a query
+// @param[in] nProbes: number of lists. Larger is more accurate but slower
+void CIVFIndex::SetProbes(int nProbes)
+{
+	std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+	m_nProbes = _MAX(1, nProbes);
+}
+
+// Train the centroids of the lists by k-means on the sample rows. The index is locked
+// @param[in] pFeatures: 1st sample row
+// @param[in] nRows: number of the sample rows
+// @param[in] nStride: distance between the sample rows in floats
+// @return: true if the index is trained successfully, false otherwise
+// [Note] It fails once the lists are trained, because the rows are assigned to the old centroids.
+bool CIVFIndex::TrainCore(const float* pFeatures, int nRows, size_t nStride)
+{
+	if (!m_cvCentroids.empty())
+		return false;
+
+	try
+	{
+		// Sample the rows evenly over the whole input
+		int nLists = _MAX(1, _MIN(m_stConfig.nLists, nRows));
+		int nSamples = (int)_MIN((int64_t)nRows, (int64_t)nLists * TRAIN_ROWS_PER_LIST);
+		cv::Mat cvSamples(nSamples, m_nDim, CV_32F);
+		for (int i = 0; i < nSamples; i++)
+		{
+			const float* pRow = pFeatures + (size_t)((int64_t)i * nRows / nSamples) * nStride;
+			memcpy(cvSamples.ptr<float>(i), pRow, m_nDim * sizeof(float));
+		}
+
+		cv::Mat cvLabels, cvCentroids;
+		cv::kmeans(cvSamples, nLists, cvLabels, cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS,
+			_MAX(1, m_stConfig.nTrainIters), 1e-4), 1, cv::KMEANS_PP_CENTERS, cvCentroids);
+
+		// The rows are compared by the inner product, so the centroids are projected back onto the unit sphere
+		if (m_stConfig.eMetric == E_FeatureMetric::eFmCosine)
+		{
+			for (int i = 0; i < cvCentroids.rows; i++)
+				CFeatureMatcher::L2Normalise(cvCentroids.ptr<float>(i), m_nDim, cvCentroids.ptr<float>(i));
+		}
+
+		m_cvCentroids = cvCentroids;
+		m_vLists.assign(nLists, std::vector<int>());
+	}
+	catch (cv::Exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Index the rows which are already readable by GetRow(). The index is locked
+// @param[in] nFirst: ID of the first row
+// @param[in] nRows: number of the rows
+// @return: true if the rows are indexed successfully, false otherwise
+// [Note] Without Train(), the rows are kept out of the lists and scanned linearly until there are enough rows to train on.
+bool CIVFIndex::AddCore(int nFirst, int nRows)
+{
+	if (!m_cvCentroids.empty())
+		return AssignRows(nFirst, nRows);
+
+	int nLists = _MAX(1, m_stConfig.nLists);
+	int nTotal = nFirst + nRows;
+	if ((int64_t)nTotal < (int64_t)nLists * MIN_TRAIN_ROWS_PER_LIST)
+		return true;
+
+	// Train on all the rows added so far, sampled evenly, and assign the waiting rows to the new lists
+	cv::Mat cvSamples;
+	try
+	{
+		int nSamples = (int)_MIN((int64_t)nTotal, (int64_t)nLists * TRAIN_ROWS_PER_LIST);
+		cvSamples.create(nSamples, m_nDim, CV_32F);
+		std::vector<float> vBuffer;
+		for (int i = 0; i < nSamples; i++)
+		{
+			const float* pRow = GetRow((int)((int64_t)i * nTotal / nSamples), vBuffer);
+			memcpy(cvSamples.ptr<float>(i), pRow, m_nDim * sizeof(float));
+		}
+	}
+	catch (cv::Exception& e)
+	{
+		const char* msg = e.what();
+		std::cout << msg << std::endl;
+		return false;
+	}
+
+	if (!TrainCore(cvSamples.ptr<float>(0), cvSamples.rows, cvSamples.step1()))
+		return false;
+
+	if (!AssignRows(0, nTotal))
+	{
+		m_cvCentroids.release();
+		m_vLists.clear();
+		return false;
+	}
+
+	return true;
+}
+
+// Search the top K rows for the query. The index is locked and holds the rows
+// @param[in] pQuery: normalised query feature vector
+// @param[in] nTopK: maximum number of rows to return. Greater than 0
+// @param[in] fSimThresh: minimum similarity to return
+// @param[out] vReIDRes: top K rows in the descending order of the similarity. nImgID is the row ID
+void CIVFIndex::SearchCore(const float* pQuery, int nTopK, float fSimThresh, ReIDResArr& vReIDRes) const
+{
+	vReIDRes.clear();
+
+	// The rows are not in the lists until the index is trained
+	if (m_cvCentroids.empty())
+	{
+		SearchExactCore(pQuery, nTopK, fSimThresh, vReIDRes);
+		return;
+	}
+
+	// The lists of the nearest centroids
+	int nLists = m_cvCentroids.rows;
+	std::vector<float> vCentroidSims(nLists);
+	CFeatureMatcher::Similarities(pQuery, m_cvCentroids.ptr<float>(0), nLists, m_nDim, m_cvCentroids.step1(), m_stConfig.eMetric,
+		vCentroidSims.data());
+
+	ReIDResArr vProbes;
+	CFeatureMatcher::SelectTopK(vCentroidSims.data(), nLists, m_nProbes, -FLT_MAX, vProbes);
+
+	// The rows of the probed lists
+	std::vector<int> vCandIDs;
+	for (const ReIDRes& stProbe : vProbes)
+	{
+		const std::vector<int>& vList = m_vLists[stProbe.nImgID];
+		vCandIDs.insert(vCandIDs.end(), vList.begin(), vList.end());
+	}
+
+	FeatureCodecQuery stQuery;
+	PrepareQuery(pQuery, stQuery);
+
+	std::vector<float> vSimilarities(vCandIDs.size());
+	for (int i = 0; i < (int)vCandIDs.size(); i++)
+	{
+		if (i + 4 < (int)vCandIDs.size())
+			PrefetchRow(vCandIDs[i + 4]);
+		vSimilarities[i] = Similarity(stQuery, vCandIDs[i]);
+	}
+
+	CFeatureMatcher::SelectTopK(vSimilarities.data(), (int)vCandIDs.size(), nTopK, fSimThresh, vReIDRes);
+	for (ReIDRes& stRes : vReIDRes)
+		stRes.nImgID = vCandIDs[stRes.nImgID];
+}
+
+// Assign the rows to the list of the most similar centroid
+// @param[in] nFirst: ID of the first row
+// @param[in] nRows: number of the rows
+// @return: true if the rows are assigned successfully, false otherwise
+// [Note] The compressed rows added before the training are decoded.
+bool CIVFIndex::AssignRows(int nFirst, int nRows)
+{
+	// One matrix product of the rows and the centroids per chunk
+	int nLists = m_cvCentroids.rows;
+	std::vector<float> vSimilarities((size_t)_MIN(nRows, ASSIGN_CHUNK_ROWS) * nLists);
+	std::vector<float> vChunk, vBuffer;
+	for (int nOffset = 0; nOffset < nRows; nOffset += ASSIGN_CHUNK_ROWS)
+	{
+		int nChunk = _MIN(nRows - nOffset, ASSIGN_CHUNK_ROWS);
+
+		// The uncompressed rows are the last ones, so the chunk is uncompressed if its first row is
+		const float* pRows = GetRow(nFirst + nOffset);
+		size_t nRowStride = m_nStride;
+		if (!pRows)
+		{
+			vChunk.resize((size_t)nChunk * m_nDim);
+			for (int i = 0; i < nChunk; i++)
+				memcpy(vChunk.data() + (size_t)i * m_nDim, GetRow(nFirst + nOffset + i, vBuffer), m_nDim * sizeof(float));
+			pRows = vChunk.data();
+			nRowStride = m_nDim;
+		}
+
+		CFeatureMatcher::SimilarityMatrix(pRows, nChunk, nRowStride, m_cvCentroids.ptr<float>(0), nLists, m_nDim,
+			m_cvCentroids.step1(), m_stConfig.eMetric, vSimilarities.data());
+
+		for (int i = 0; i < nChunk; i++)
+		{
+			const float* pSim = vSimilarities.data() + (size_t)i * nLists;
+			int nBest = 0;
+			for (int j = 1; j < nLists; j++)
+			{
+				if (pSim[j] > pSim[nBest])
+					nBest = j;
+			}
+
+			m_vLists[nBest].push_back(nFirst + nOffset + i);
+		}
+	}
+
+	return true;
+}
@@ -1,7 +1,8 @@
 #include "CORTYouReID.h"
 
 CORTYouReID::CORTYouReID(const ReIDNetConfig& stReIDNetConfig, const NetDetailsConfig& stNetDetailsConfig)
-	: CReID(stReIDNetConfig)
+	: CInferer(stNetDetailsConfig)
+	, CYouReID(stReIDNetConfig, stNetDetailsConfig)
 	, CORTInferer(stNetDetailsConfig)
 {
 	m_bValid = (ReadModel(stReIDNetConfig.sModelPath,
@@ -13,47 +14,12 @@ CORTYouReID::~CORTYouReID()
 
 }
 
-// Extract the feature vector from the input image
-// @param[in] cvImg: input image
-// @param[out] vFeature: extracted feature vector
-// @return: true if the feature is successfully extracted, false otherwise
-const bool CORTYouReID::ExtractFeature(const cv::Mat& cvImg, std::vector<float>& vFeature)
+// Read the onnx model from the given path
+// @param[in] sModelPath: path to the onnx model
+// @param[in] sPairedFilePath: path to the paired file. Not used for this case
+// @param[in] sLogTitle: title of the log
+// @return: true if successfully read the model, false otherwise
+bool CORTYouReID::ReadModel(const std::string& sModelPath, const std::string& sPairedFilePath /*= ""*/, const std::string& sLogTitle /*= "onnxruntime"*/)
 {
-	if (!CORTInferer::Inference(cvImg, &vFeature))
-	{
-		return false;
-	}
-
-	return true;
-}
-
-// Preprocess the input image
-// @param[in] cvImg: input image to be preprocessed
-// @param[out] cvProcImg: preprocessed image
-void CORTYouReID::PreProcess(const cv::Mat& cvImg, cv::Mat& cvProcImg)
-{
-	CORTInferer::PreProcessCore(cvImg, true, cvProcImg);
+	return CORTInferer::ReadModel(sModelPath, sPairedFilePath, sLogTitle);
 }
-
-// Postprocess the output tensor
-// @param[in] cvOrgImgSize: original image size
-// @param[in] pTensorData: output tensor data to be postprocessed
-// @param[out] pPostProcessData: postprocessed data
-// [Note] - The normalised feature vector is stored in pPostProcessData
-void CORTYouReID::PostProcess(const cv::Size& cvOrgImgSize, const void* pTensorData, void* pPostProcessData)
-{
-	if (!pPostProcessData)
-		return;
-
-	const float* pData = (const float*)CORTInferer::PostProcessCore(pTensorData);
-	if(!pData)
-		return;
-
-	// Initialise the original feature vector using the same buffer of pData
-	std::vector<float> vOrgFeature(pData, pData + m_nNetProposals);
-
-	// Normalise the feature vector
-	std::vector<float>* pvFeature = (std::vector<float>*)pPostProcessData;
-	Normalisation(vOrgFeature, *pvFeature);
-}
-
@@ -1,4 +1,10 @@
 ﻿#include "CReID.h"
+#include "CFeatureMatcher.h"
+#include "CGalleryStore.h"
+#include "CFeatureIndex.h"
+
+// Number of the store rows whose similarities are computed at a time, so the similarity buffer stays small
+#define STORE_CHUNK_ROWS	65536
 
 CReID::CReID(const ReIDNetConfig& stReIDNetConfig)
 	: m_stReIDNetConfig(stReIDNetConfig)
@@ -28,23 +34,7 @@ bool CReID::ReID(const cv::Mat& cvQueryImg, const std::vector<cv::Mat>& cvGaller
 		return false;
 	}
 
-	// Extract the embedding features of the gallery images
-	std::vector<std::vector<float>> vGalleryFeatures;
-	for (auto& cvGalleryImg : cvGalleryImgs)
-	{
-		std::vector<float> vGalleryFeature;
-		if (!ExtractFeature(cvGalleryImg, vGalleryFeature))
-		{
-			return false;
-		}
-		vGalleryFeatures.push_back(vGalleryFeature);
-	}
-
-	// Calculate Top K results
-	CalculateTopK(vQueryFeature, vGalleryFeatures, E_SimilarityMetric::COSINE);
-
-	// Return the ReID results
-	return true;
+	return ReID(vQueryFeature, cvGalleryImgs);
 }
 
 // Perform ReID between the query embedding feature and the gallery images
@@ -58,20 +48,14 @@ bool CReID::ReID(const std::vector<float>& vQueryFeature, const std::vector<cv::
 	if (vQueryFeature.size() == 0)
 		return false;
 
-	// Extract the embedding features of the gallery images
-	std::vector<std::vector<float>> vGalleryFeatures;
-	for (auto& cvGalleryImg : cvGalleryImgs)
+	// Extract the embedding features of the gallery images into one feature matrix
+	if (!ExtractFeatures(cvGalleryImgs, m_cvGalleryFeatures))
 	{
-		std::vector<float> vGalleryFeature;
-		if (!ExtractFeature(cvGalleryImg, vGalleryFeature))
-		{
-			return false;
-		}
-		vGalleryFeatures.push_back(vGalleryFeature);
+		return false;
 	}
 
 	// Calculate Top K results
-	CalculateTopK(vQueryFeature, vGalleryFeatures, E_SimilarityMetric::COSINE);
+	CalculateTopK(vQueryFeature, m_cvGalleryFeatures, m_vReIDRes, E_SimilarityMetric::COSINE);
 
 	// Return the ReID results
 	return true;
@@ -87,76 +71,315 @@ bool CReID::ReID(const std::vector<cv::Mat>& cvGalleryImgs)
 	return ReID(m_vQueryFeature, cvGalleryImgs);
 }
 
-// Normalise the feature vector
-// @param[in] vOrgFeature: original feature vector
-// @param[out] vNorFeature: normalised feature vector
-// [Note] - The default implementation is L2 normalisation. 
-//        - If you want to use other normalisation methods, this function should be overridden.
-void CReID::Normalisation(const std::vector<float>& vOrgFeature, std::vector<float>& vNorFeature)
+// Perform ReID between the query embedding feature and the gallery images into the given result
+// @param[in] vQueryFeature: query embedding feature
+// @param[in] cvGalleryImgs: multiple gallery images
+// @param[out] vReIDRes: ReID results
+// @return: true if the ReID is successfully performed, false otherwise
+// [Note]: It does not touch the state of the ReID, so it can be called from several threads at the same time.
+bool CReID::ReID(const std::vector<float>& vQueryFeature, const std::vector<cv::Mat>& cvGalleryImgs, ReIDResArr& vReIDRes)
 {
-	vNorFeature.clear();
+	vReIDRes.clear();
+	if (vQueryFeature.size() == 0)
+		return false;
 
-	float fSum = 0.0f;
-	for (int i = 0; i < vOrgFeature.size(); i++)
+	cv::Mat cvGalleryFeatures;
+	if (!ExtractFeatures(cvGalleryImgs, cvGalleryFeatures))
 	{
-		fSum += vOrgFeature[i] * vOrgFeature[i];
+		return false;
 	}
-	fSum = sqrt(fSum);
-	for (int i = 0; i < vOrgFeature.size(); i++)
+
+	CalculateTopK(vQueryFeature, cvGalleryFeatures, vReIDRes, E_SimilarityMetric::COSINE);
+
+	return true;
+}
+
+// Perform ReID between the preregistered query embedding feature and the gallery features extracted in advance
+// @param[in] cvGalleryFeatures: gallery feature matrix of CV_32F. Each row is the normalised feature vector of a gallery image
+// @return: true if the ReID is successfully performed, false otherwise
+// [Note]: - The ReID results can be obtained by calling GetReIDRes()
+//         - The gallery features can be cached ones, such as the aggregate features of the tracked objects.
+bool CReID::MatchFeatures(const cv::Mat& cvGalleryFeatures)
+{
+	m_vReIDRes.clear();
+	m_cvGalleryFeatures = cvGalleryFeatures;
+
+	return MatchFeatures(m_vQueryFeature, cvGalleryFeatures, m_vReIDRes);
+}
+
+// Perform ReID between the query embedding feature and the gallery features extracted in advance into the given result
+// @param[in] vQueryFeature: query embedding feature
+// @param[in] cvGalleryFeatures: gallery feature matrix of CV_32F. Each row is the normalised feature vector of a gallery image
+// @param[out] vReIDRes: ReID results
+// @return: true if the ReID is successfully performed, false otherwise
+// [Note]: It does not touch the state of the ReID, so it can be called from several threads at the same time.
+bool CReID::MatchFeatures(const std::vector<float>& vQueryFeature, const cv::Mat& cvGalleryFeatures, ReIDResArr& vReIDRes)
+{
+	vReIDRes.clear();
+	if (vQueryFeature.size() == 0)
+		return false;
+
+	if (!cvGalleryFeatures.empty() && (cvGalleryFeatures.type() != CV_32F || cvGalleryFeatures.cols != (int)vQueryFeature.size()))
+		return false;
+
+	CalculateTopK(vQueryFeature, cvGalleryFeatures, vReIDRes, E_SimilarityMetric::COSINE);
+
+	return true;
+}
+
+// Perform ReID between the query set and the gallery images
+// @param[in] cvGalleryImgs: multiple gallery images
+// @return: true if the ReID is successfully performed, false otherwise
+// [Note]: - The ReID results of each query can be obtained by calling GetQueryReIDRes()
+//         - The gallery features are extracted once and matched with all the queries by one matrix product.
+bool CReID::ReIDQueries(const std::vector<cv::Mat>& cvGalleryImgs)
+{
+	m_vQueryReIDRes.clear();
+	if (m_vQueries.empty())
+		return false;
+
+	if (!ExtractFeatures(cvGalleryImgs, m_cvGalleryFeatures))
 	{
-		vNorFeature.push_back(vOrgFeature[i] / fSum);
+		return false;
 	}
+
+	return MatchQueries(m_vQueries, m_cvQueryFeatures, m_cvGalleryFeatures, m_vQueryReIDRes);
 }
 
-// Calculate the similarity between the query feature and the gallery features and store the top K results in m_vReIDRes
-// @param[in] vQueryFeature: query feature vector
-// @param[in] vGalleryFeatures: gallery feature vectors
-// @param[in] eMode: similarity mode. COSINE: cosine similarity; EUCLIDEAN: Euclidean distance
-void CReID::CalculateTopK(const std::vector<float>& vQueryFeature, 
-	const std::vector<std::vector<float>>& vGalleryFeatures, 
-	const E_SimilarityMetric& eMode /*= E_SimilarityMetric::COSINE*/)
+// Perform ReID between the query set and the gallery features extracted in advance
+// @param[in] cvGalleryFeatures: gallery feature matrix of CV_32F. Each row is the normalised feature vector of a gallery image
+// @return: true if the ReID is successfully performed, false otherwise
+// [Note]: The ReID results of each query can be obtained by calling GetQueryReIDRes()
+bool CReID::MatchQueries(const cv::Mat& cvGalleryFeatures)
 {
-	m_vReIDRes.clear();
+	m_vQueryReIDRes.clear();
+	m_cvGalleryFeatures = cvGalleryFeatures;
 
-	std::vector<float>	vSimilarities;
-	std::vector<int>	vImgIDs;
+	return MatchQueries(m_vQueries, m_cvQueryFeatures, cvGalleryFeatures, m_vQueryReIDRes);
+}
 
-	for (int i = 0; i < vGalleryFeatures.size(); i++)
+// Perform ReID between the given query set and the gallery features extracted in advance into the given result
+// @param[in] vQueries: queries of the query set
+// @param[in] cvQueryFeatures: query feature matrix of CV_32F. Each row is the normalised feature vector of the relevant query
+// @param[in] cvGalleryFeatures: gallery feature matrix of CV_32F. Each row is the normalised feature vector of a gallery image
+// @param[out] vQueryReIDRes: ReID results of each query. Same order as vQueries
+// @return: true if the ReID is successfully performed, false otherwise
+// [Note]: It does not touch the state of the ReID, so it can be called from several threads at the same time.
+bool CReID::MatchQueries(const ReIDQueryArr& vQueries, const cv::Mat& cvQueryFeatures, const cv::Mat& cvGalleryFeatures,
+	QueryReIDResArr& vQueryReIDRes)
+{
+	vQueryReIDRes.clear();
+	if (vQueries.empty() || cvQueryFeatures.type() != CV_32F || cvQueryFeatures.rows != (int)vQueries.size())
+		return false;
+
+	if (!cvGalleryFeatures.empty() && (cvGalleryFeatures.type() != CV_32F || cvGalleryFeatures.cols != cvQueryFeatures.cols))
+		return false;
+
+	vQueryReIDRes.reserve(vQueries.size());
+	for (const ReIDQuery& stQuery : vQueries)
+		vQueryReIDRes.push_back(QueryReIDRes(stQuery.nQueryID));
+
+	if (cvGalleryFeatures.empty())
+		return true;
+
+	// The similarities of all the queries against all the gallery rows by one matrix product, then the top K of each query
+	int nQueries = cvQueryFeatures.rows;
+	int nRows = cvGalleryFeatures.rows;
+	std::vector<float> vSimilarities((size_t)nQueries * nRows);
+	CFeatureMatcher::SimilarityMatrix(cvQueryFeatures.ptr<float>(0), nQueries, cvQueryFeatures.step1(), cvGalleryFeatures.ptr<float>(0),
+		nRows, cvGalleryFeatures.cols, cvGalleryFeatures.step1(), E_FeatureMetric::eFmCosine, vSimilarities.data());
+
+	for (int q = 0; q < nQueries; q++)
 	{
-		float fSimilarity = 0.0f;
-		if (eMode == E_SimilarityMetric::COSINE)
-		{
-			fSimilarity = CosineSimilarity(vQueryFeature, vGalleryFeatures[i]);
-		}
-		else if (eMode == E_SimilarityMetric::EUCLIDEAN)
-		{
-			fSimilarity = 1 - EuclideanDistance(vQueryFeature, vGalleryFeatures[i]);
-		}
-		else
+		CFeatureMatcher::SelectTopK(vSimilarities.data() + (size_t)q * nRows, nRows, vQueries[q].nTopK, vQueries[q].fSimThresh,
+			vQueryReIDRes[q].vReIDRes);
+	}
+
+	return true;
+}
+
+// Perform ReID between the query feature and the persistent gallery store into the given result
+// @param[in] vQueryFeature: normalised query feature vector
+// @param[in] cStore: opened gallery store of the same model
+// @param[out] vReIDRes: top K results. nImgID is the row index of the store, whose metadata is cStore.GetMeta(nImgID)
+// @return: true if the ReID is successfully performed, false otherwise
+// [Note]: - The rows are searched in place on the mapped file by chunks, so the store is never copied into memory.
+//         - It does not touch the state of the ReID, so it can be called from several threads at the same time.
+bool CReID::MatchStore(const std::vector<float>& vQueryFeature, const CGalleryStore& cStore, ReIDResArr& vReIDRes)
+{
+	vReIDRes.clear();
+
+	ReIDQueryArr vQueries(1, ReIDQuery(-1, m_stReIDNetConfig.nTopK, m_stReIDNetConfig.fSimThresh));
+	cv::Mat cvQueryFeatures(1, (int)vQueryFeature.size(), CV_32F, (void*)vQueryFeature.data());
+	QueryReIDResArr vQueryReIDRes;
+	if (vQueryFeature.empty() || !MatchStore(vQueries, cvQueryFeatures, cStore, vQueryReIDRes))
+		return false;
+
+	vReIDRes.swap(vQueryReIDRes[0].vReIDRes);
+	return true;
+}
+
+// Perform ReID between the given query set and the persistent gallery store into the given result
+// @param[in] vQueries: queries of the query set
+// @param[in] cvQueryFeatures: query feature matrix of CV_32F. Each row is the normalised feature vector of the relevant query
+// @param[in] cStore: opened gallery store of the same model
+// @param[out] vQueryReIDRes: ReID results of each query. Same order as vQueries. nImgID is the row index of the store
+// @return: true if the ReID is successfully performed, false otherwise
+// [Note]: - Each chunk of the rows is loaded once for all the queries by one matrix product.
+//         - It does not touch the state of the ReID, so it can be called from several threads at the same time.
+bool CReID::MatchStore(const ReIDQueryArr& vQueries, const cv::Mat& cvQueryFeatures, const CGalleryStore& cStore,
+	QueryReIDResArr& vQueryReIDRes)
+{
+	vQueryReIDRes.clear();
+	if (vQueries.empty() || cvQueryFeatures.type() != CV_32F || cvQueryFeatures.rows != (int)vQueries.size())
+		return false;
+
+	// Hold the store against the appends remapping the file while its rows are read
+	std::shared_lock<std::shared_mutex> lock = cStore.LockRead();
+	if (!cStore.IsOpen() || cStore.GetDim() != cvQueryFeatures.cols)
+		return false;
+
+	vQueryReIDRes.reserve(vQueries.size());
+	for (const ReIDQuery& stQuery : vQueries)
+		vQueryReIDRes.push_back(QueryReIDRes(stQuery.nQueryID));
+
+	int nQueries = cvQueryFeatures.rows;
+	int64_t nCount = cStore.GetCount();
+	size_t nStride = cStore.GetStride();
+	const float* pFeatures = cStore.GetFeatures();
+
+	std::vector<float> vSimilarities((size_t)nQueries * (size_t)_MIN(nCount, (int64_t)STORE_CHUNK_ROWS));
+	ReIDResArr vChunkRes;
+	for (int64_t nOffset = 0; nOffset < nCount; nOffset += STORE_CHUNK_ROWS)
+	{
+		int nRows = (int)_MIN(nCount - nOffset, (int64_t)STORE_CHUNK_ROWS);
+		CFeatureMatcher::SimilarityMatrix(cvQueryFeatures.ptr<float>(0), nQueries, cvQueryFeatures.step1(), pFeatures + (size_t)nOffset * nStride,
+			nRows, cStore.GetDim(), nStride, cStore.GetMetric(), vSimilarities.data());
+
+		for (int q = 0; q < nQueries; q++)
 		{
-			assert(false);
+			CFeatureMatcher::SelectTopK(vSimilarities.data() + (size_t)q * nRows, nRows, vQueries[q].nTopK, vQueries[q].fSimThresh, vChunkRes);
+			CFeatureMatcher::MergeTopK(vChunkRes, nOffset, vQueries[q].nTopK, vQueryReIDRes[q].vReIDRes);
 		}
-		
-		vSimilarities.push_back(fSimilarity);
-		vImgIDs.push_back(i);
 	}
 
-	if(vSimilarities.size() == 0)
-		return;
+	return true;
+}
 
-	// Sort the similarities in descending order
-	std::sort(vImgIDs.begin(), vImgIDs.end(), [&](int x, int y) {return vSimilarities[x] > vSimilarities[y]; });
+// Perform ReID between the query feature and the gallery of the nearest-neighbour index into the given result
+// @param[in] vQueryFeature: normalised query feature vector
+// @param[in] cIndex: index of the gallery of the same model
+// @param[out] vReIDRes: top K results. nImgID is the row ID of the index, which is the row index of the attached store
+// @return: true if the ReID is successfully performed, false otherwise
+// [Note]: - The results are approximate for CHNSWIndex and CIVFIndex. Use CFeatureIndex::SearchExact() to validate them.
+//         - It does not touch the state of the ReID, so it can be called from several threads at the same time.
+bool CReID::MatchIndex(const std::vector<float>& vQueryFeature, const CFeatureIndex& cIndex, ReIDResArr& vReIDRes)
+{
+	vReIDRes.clear();
+	if ((int)vQueryFeature.size() != cIndex.GetDim())
+		return false;
 
-	// Store the top K results in m_vReIDRes
-	int nLen = _MIN(m_stReIDNetConfig.nTopK, vImgIDs.size());
-	for (int i = 0; i < nLen; i++)
+	return cIndex.Search(vQueryFeature.data(), m_stReIDNetConfig.nTopK, m_stReIDNetConfig.fSimThresh, vReIDRes);
+}
+
+// Perform ReID between the given query set and the gallery of the nearest-neighbour index into the given result
+// @param[in] vQueries: queries of the query set
+// @param[in] cvQueryFeatures: query feature matrix of CV_32F. Each row is the normalised feature vector of the relevant query
+// @param[in] cIndex: index of the gallery of the same model
+// @param[out] vQueryReIDRes: ReID results of each query. Same order as vQueries. nImgID is the row ID of the index
+// @return: true if the ReID is successfully performed, false otherwise
+// [Note]: It does not touch the state of the ReID, so it can be called from several threads at the same time.
+bool CReID::MatchIndex(const ReIDQueryArr& vQueries, const cv::Mat& cvQueryFeatures, const CFeatureIndex& cIndex,
+	QueryReIDResArr& vQueryReIDRes)
+{
+	vQueryReIDRes.clear();
+	if (vQueries.empty() || cvQueryFeatures.type() != CV_32F || cvQueryFeatures.rows != (int)vQueries.size() ||
+		cvQueryFeatures.cols != cIndex.GetDim())
+		return false;
+
+	vQueryReIDRes.reserve(vQueries.size());
+	for (int q = 0; q < (int)vQueries.size(); q++)
 	{
-		if(vSimilarities[vImgIDs[i]] < m_stReIDNetConfig.fSimThresh)
-			break;
+		vQueryReIDRes.push_back(QueryReIDRes(vQueries[q].nQueryID));
+		if (!cIndex.Search(cvQueryFeatures.ptr<float>(q), vQueries[q].nTopK, vQueries[q].fSimThresh, vQueryReIDRes[q].vReIDRes))
+			return false;
+	}
+
+	return true;
+}
+
+// Extract the feature vectors from the multiple input images
+// @param[in] vImgs: input images
+// @param[out] cvFeatures: extracted feature matrix of CV_32F. Each row is the feature vector of the relevant image
+// @return: true if the features are successfully extracted, false otherwise
+// [Note] - The default implementation extracts the features one by one by calling ExtractFeature().
+//        - The derived classes should override this function to extract the features in batch.
+const bool CReID::ExtractFeatures(const std::vector<cv::Mat>& vImgs, cv::Mat& cvFeatures)
+{
+	std::vector<float> vFeature;
+	for (int i = 0; i < (int)vImgs.size(); i++)
+	{
+		if (!ExtractFeature(vImgs[i], vFeature))
+			return false;
+
+		// Allocate the feature matrix once the feature dimension is known
+		if (i == 0)
+			cvFeatures.create((int)vImgs.size(), (int)vFeature.size(), CV_32F);
 
-		ReIDRes stReIDRes(i, vImgIDs[i], vSimilarities[vImgIDs[i]]);
-		m_vReIDRes.push_back(stReIDRes);
+		if (vFeature.size() != (size_t)cvFeatures.cols)
+			return false;
+
+		memcpy(cvFeatures.ptr<float>(i), vFeature.data(), vFeature.size() * sizeof(float));
 	}
+
+	if (vImgs.empty())
+		cvFeatures.release();
+
+	return true;
+}
+
+// Normalise the feature vector
+// @param[in] pOrgFeature: original feature vector
+// @param[in] nDim: dimension of the feature vector
+// @param[out] pNorFeature: normalised feature vector. It can be the same buffer as pOrgFeature
+// [Note] - The default implementation is L2 normalisation. 
+//        - If you want to use other normalisation methods, this function should be overridden.
+void CReID::Normalisation(const float* pOrgFeature, int nDim, float* pNorFeature)
+{
+	CFeatureMatcher::L2Normalise(pOrgFeature, nDim, pNorFeature);
+}
+
+// Calculate the similarity between the query feature and the gallery features and store the top K results
+// @param[in] vQueryFeature: query feature vector
+// @param[in] cvGalleryFeatures: gallery feature matrix. Each row is a gallery feature vector
+// @param[out] vReIDRes: top K results
+// @param[in] eMode: similarity mode. COSINE: cosine similarity; EUCLIDEAN: Euclidean distance
+void CReID::CalculateTopK(const std::vector<float>& vQueryFeature, 
+	const cv::Mat& cvGalleryFeatures, 
+	ReIDResArr& vReIDRes,
+	const E_SimilarityMetric& eMode /*= E_SimilarityMetric::COSINE*/)
+{
+	vReIDRes.clear();
+
+	if (cvGalleryFeatures.empty())
+		return;
+
+	assert(cvGalleryFeatures.type() == CV_32F && cvGalleryFeatures.cols == (int)vQueryFeature.size());
+
+	E_FeatureMetric eMetric = E_FeatureMetric::eFmUnknown;
+	if (eMode == E_SimilarityMetric::COSINE)
+		eMetric = E_FeatureMetric::eFmCosine;
+	else if (eMode == E_SimilarityMetric::EUCLIDEAN)
+		eMetric = E_FeatureMetric::eFmEuclidean;
+	else
+		assert(false);
+
+	// The similarities of all the gallery rows by one matrix-vector product, then the top K of them without sorting all
+	std::vector<float> vSimilarities(cvGalleryFeatures.rows);
+	CFeatureMatcher::Similarities(vQueryFeature.data(), cvGalleryFeatures.ptr<float>(0), cvGalleryFeatures.rows, cvGalleryFeatures.cols,
+		cvGalleryFeatures.step1(), eMetric, vSimilarities.data());
+
+	CFeatureMatcher::SelectTopK(vSimilarities.data(), cvGalleryFeatures.rows, m_stReIDNetConfig.nTopK, m_stReIDNetConfig.fSimThresh, vReIDRes);
 }
 
 // Register the query image for further ReID in advance
@@ -182,6 +405,118 @@ bool CReID::RegisterQuery(const std::vector<float>& vQueryFeature)
 	return true;
 }
 
+// Add the query image to the query set
+// @param[in] stQuery: query ID, top K and similarity threshold of the query
+// @param[in] cvQueryImg: query image
+// @return: true if the query is successfully added, false otherwise
+// [Note]: The query of the same ID is replaced.
+bool CReID::AddQuery(const ReIDQuery& stQuery, const cv::Mat& cvQueryImg)
+{
+	std::vector<float> vQueryFeature;
+	if (!ExtractFeature(cvQueryImg, vQueryFeature))
+		return false;
+
+	return AddQuery(stQuery, vQueryFeature);
+}
+
+// Add the query feature vector to the query set
+// @param[in] stQuery: query ID, top K and similarity threshold of the query
+// @param[in] vQueryFeature: normalised query feature vector
+// @return: true if the query is successfully added, false otherwise
+// [Note]: The query of the same ID is replaced.
+bool CReID::AddQuery(const ReIDQuery& stQuery, const std::vector<float>& vQueryFeature)
+{
+	if (vQueryFeature.empty())
+		return false;
+
+	if (!m_vQueries.empty() && m_cvQueryFeatures.cols != (int)vQueryFeature.size())
+		return false;
+
+	int nRow = (int)m_vQueries.size();
+	for (int i = 0; i < (int)m_vQueries.size(); i++)
+	{
+		if (m_vQueries[i].nQueryID == stQuery.nQueryID)
+		{
+			nRow = i;
+			break;
+		}
+	}
+
+	// The matrix is allocated again, so the snapshots taken by GetQueryFeatures() are not changed
+	int nQueries = _MAX(nRow + 1, (int)m_vQueries.size());
+	cv::Mat cvQueryFeatures(nQueries, (int)vQueryFeature.size(), CV_32F);
+	if (!m_vQueries.empty())
+		m_cvQueryFeatures.copyTo(cvQueryFeatures.rowRange(0, m_cvQueryFeatures.rows));
+	memcpy(cvQueryFeatures.ptr<float>(nRow), vQueryFeature.data(), vQueryFeature.size() * sizeof(float));
+
+	if (nRow == (int)m_vQueries.size())
+		m_vQueries.push_back(stQuery);
+	else
+		m_vQueries[nRow] = stQuery;
+	m_cvQueryFeatures = cvQueryFeatures;
+
+	return true;
+}
+
+// Remove the query from the query set
+// @param[in] nQueryID: query ID
+// @return: true if the query is removed, false if it is not found
+bool CReID::RemoveQuery(int nQueryID)
+{
+	for (int i = 0; i < (int)m_vQueries.size(); i++)
+	{
+		if (m_vQueries[i].nQueryID != nQueryID)
+			continue;
+
+		cv::Mat cvQueryFeatures;
+		for (int j = 0; j < m_cvQueryFeatures.rows; j++)
+		{
+			if (j != i)
+				cvQueryFeatures.push_back(m_cvQueryFeatures.row(j));
+		}
+
+		m_vQueries.erase(m_vQueries.begin() + i);
+		m_cvQueryFeatures = cvQueryFeatures;
+
+		// The results are in the order of the old query set, so they no longer match GetQueries()
+		m_vQueryReIDRes.clear();
+		return true;
+	}
+
+	return false;
+}
+
+// Remove all the queries from the query set
+void CReID::ClearQueries()
+{
+	m_vQueries.clear();
+	m_cvQueryFeatures = cv::Mat();
+	m_vQueryReIDRes.clear();
+}
+
+// Clear the ReID results of the registered query and of the query set
+// [Note]: The results are kept until the next ReID, so clear them before a ReID that may not run.
+void CReID::ClearResults()
+{
+	m_vReIDRes.clear();
+	m_vQueryReIDRes.clear();
+}
+
+// Get the queries of the query set
+// @return: queries. Same order as the rows of GetQueryFeatures()
+const ReIDQueryArr& CReID::GetQueries() const
+{
+	return m_vQueries;
+}
+
+// Get the feature matrix of the query set
+// @return: query feature matrix of CV_32F. Each row is the feature vector of the relevant query
+// [Note]: The matrix is allocated again whenever the query set changes, so a copy of it stays valid as a snapshot.
+const cv::Mat& CReID::GetQueryFeatures() const
+{
+	return m_cvQueryFeatures;
+}
+
 // Visualise the ReID results
 // @param[in] cvQueryImg: query image
 // @param[in] cvGalleryImgs: gallery images
@@ -220,37 +555,16 @@ const ReIDResArr& CReID::GetReIDRes() const
 	return m_vReIDRes;
 }
 
-// Calculate the cosine similarity between two vectors
-// @param[in] vFeature1: normalised feature vector 1
-// @param[in] vFeature2: normalised feature vector 2
-// @return: cosine similarity
-float CReID::CosineSimilarity(const std::vector<float>& vFeature1, const std::vector<float>& vFeature2)
+// Get the query feature vector registered by RegisterQuery()
+// @return: query feature vector. Empty if not registered
+const std::vector<float>& CReID::GetQueryFeature() const
 {
-	assert(vFeature1.size() == vFeature2.size());
-	float fSimilarity = 0.0f;
-	for (int i = 0; i < vFeature1.size(); i++)
-	{
-		fSimilarity += vFeature1[i] * vFeature2[i];
-	}
-
-	return fSimilarity;
+	return m_vQueryFeature;
 }
 
-
-// Calculate the Euclidean distance between two vectors
-// @param[in] vFeature1: normalised feature vector 1
-// @param[in] vFeature2: normalised feature vector 2
-// @return: Euclidean distance
-float CReID::EuclideanDistance(const std::vector<float>& vFeature1, const std::vector<float>& vFeature2)
+// Get the ReID results of each query of the query set
+// @return: ReID results of each query. Same order as GetQueries()
+const QueryReIDResArr& CReID::GetQueryReIDRes() const
 {
-	assert(vFeature1.size() == vFeature2.size());
-
-	float fDistance = 0.0f;
-	for (int i = 0; i < vFeature1.size(); i++)
-	{
-		fDistance += (vFeature1[i] - vFeature2[i]) * (vFeature1[i] - vFeature2[i]);
-	}
-
-	return sqrt(fDistance);
-
+	return m_vQueryReIDRes;
 }
@@ -0,0 +1,96 @@
+#include "CTorchReID.h"
+
+CTorchReID::CTorchReID(const ReIDNetConfig& stReIDNetConfig, const NetDetailsConfig& stNetDetailsConfig)
+	: CInferer(stNetDetailsConfig)
+	, CReID(stReIDNetConfig)
+{
+
+}
+
+CTorchReID::~CTorchReID()
+{
+
+}
+
+
+// Extract the feature vector from the input image
+// @param[in] cvImg: input image
+// @param[out] vFeature: extracted feature vector
+// @return: true if the feature is successfully extracted, false otherwise
+const bool CTorchReID::ExtractFeature(const cv::Mat& cvImg, std::vector<float>& vFeature)
+{
+	vFeature.resize(m_nNetProposals);
+	if (!CInferer::Inference(cvImg, vFeature.data()))
+	{
+		vFeature.clear();
+		return false;
+	}
+
+	return true;
+}
+
+// Extract the feature vectors from the multiple input images in batch
+// @param[in] vImgs: input images
+// @param[out] cvFeatures: extracted feature matrix of CV_32F. Each row is the feature vector of the relevant image
+// @return: true if the features are successfully extracted, false otherwise
+const bool CTorchReID::ExtractFeatures(const std::vector<cv::Mat>& vImgs, cv::Mat& cvFeatures)
+{
+	if (vImgs.empty())
+	{
+		cvFeatures.release();
+		return true;
+	}
+
+	// The feature of each image is written to the relevant row of the feature matrix directly
+	cvFeatures.create((int)vImgs.size(), m_nNetProposals, CV_32F);
+
+	std::vector<void*> vResultData(vImgs.size());
+	for (int i = 0; i < cvFeatures.rows; i++)
+		vResultData[i] = cvFeatures.ptr<float>(i);
+
+	if (!CInferer::BatchInference(vImgs, vResultData))
+	{
+		cvFeatures.release();
+		return false;
+	}
+
+	return true;
+}
+
+// Preprocess the input image
+// @param[in] cvImg: input image to be preprocessed
+// @param[out] cvProcImg: preprocessed image
+void CTorchReID::PreProcess(const cv::Mat& cvImg, cv::Mat& cvProcImg)
+{
+	CInferer::PreProcessCore(cvImg, true, cvProcImg);
+}
+
+// Preprocess the input images into the batch tensor buffer
+// @param[in] pFrames: input images
+// @param[in] nCount: number of input images
+// @param[out] pTensor: tensor buffer of nCount x 3 x H x W floats
+// @return: true if success, otherwise false
+// [Note] The crops of the detected persons in the same frame are sampled from the frame in one parallel pass.
+bool CTorchReID::PreProcessBatch(const cv::Mat* pFrames, int nCount, float* pTensor)
+{
+	return CInferer::PreProcessBatchCore(pFrames, nCount, true, pTensor);
+}
+
+// Postprocess the output tensor
+// @param[in] cvOrgImgSize: original image size
+// @param[in] pTensorData: output tensor data to be postprocessed
+// @param[out] pPostProcessData: postprocessed data
+// [Note] - The normalised feature vector is stored in pPostProcessData, which points to a float buffer of the feature dimension
+void CTorchReID::PostProcess(const cv::Size& cvOrgImgSize, const void* pTensorData, void* pPostProcessData)
+{
+	if (!pPostProcessData)
+		return;
+
+	const float* pData = (const float*)CInferer::PostProcessCore(pTensorData);
+	if(!pData)
+		return;
+
+	// Normalise the feature vector from the tensor buffer into the output buffer directly
+	Normalisation(pData, m_nNetProposals, (float*)pPostProcessData);
+}
+
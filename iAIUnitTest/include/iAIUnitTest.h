@@ -0,0 +1,37 @@
+// iAIUnitTest.h : Checks of the building blocks of the libraries which need no model or video.
+// Each check returns true if it passes, and prints the failed condition otherwise.
+
+#pragma once
+
+#include <iostream>
+
+// Fail the check with the location and the condition if the condition is false
+#define UNIT_CHECK(COND)																	\
+	do																						\
+	{																						\
+		if (!(COND))																		\
+		{																					\
+			std::cout << __FILE__ << "(" << __LINE__ << "): " << #COND << " failed" << std::endl;	\
+			return false;																	\
+		}																					\
+	} while (0)
+
+// CNMSEngine
+bool TestNMSLegacyParity();
+bool TestNMSBatchedParity();
+
+// CFeatureMatcher
+bool TestMatcherTopKParity();
+bool TestMatcherNormalise();
+
+// CFeatureIndex and CFeatureCodec
+bool TestIndexRecall();
+bool TestCodecRoundTrip();
+bool TestCodecRerank();
+bool TestCodecDeferredTraining();
+bool TestIVFWithoutLists();
+
+// CSPSCQueue and CStagePipeline
+bool TestQueueOrdering();
+bool TestQueueClose();
+bool TestPipelineExceptions();
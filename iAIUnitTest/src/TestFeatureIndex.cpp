@@ -0,0 +1,239 @@
+#include "iAIUnitTest.h"
+#include "CFeatureMatcher.h"
+#include "CFlatIndex.h"
+#include "CHNSWIndex.h"
+#include "CIVFIndex.h"
+#include "CGalleryStore.h"
+#include <cmath>
+#include <filesystem>
+#include <memory>
+#include <random>
+
+namespace fs = std::filesystem;
+
+// Dimension of the test embeddings
+#define TEST_DIM			64
+// Number of the clusters of the test embeddings, as the identities of a gallery
+#define TEST_CLUSTERS		100
+
+// Make the normalised embeddings scattered around the clusters
+// @param[in] nRows: number of the embeddings
+// @param[in] nSeed: seed of the random embeddings. The clusters are the same for all the seeds
+// @return: embeddings of nRows x TEST_DIM floats
+static std::vector<float> MakeClusteredFeatures(int nRows, unsigned int nSeed)
+{
+	std::mt19937 rngClusters(0);
+	std::normal_distribution<float> normal(0.0f, 1.0f);
+	std::vector<float> vClusters((size_t)TEST_CLUSTERS * TEST_DIM);
+	for (float& fValue : vClusters)
+		fValue = normal(rngClusters);
+
+	std::mt19937 rng(nSeed);
+	std::vector<float> vFeatures((size_t)nRows * TEST_DIM);
+	for (int i = 0; i < nRows; i++)
+	{
+		const float* pCluster = vClusters.data() + (size_t)(rng() % TEST_CLUSTERS) * TEST_DIM;
+		float* pRow = vFeatures.data() + (size_t)i * TEST_DIM;
+		for (int k = 0; k < TEST_DIM; k++)
+			pRow[k] = pCluster[k] + 0.7f * normal(rng);
+		CFeatureMatcher::L2Normalise(pRow, TEST_DIM, pRow);
+	}
+
+	return vFeatures;
+}
+
+// Create the index of the given type
+// @param[in] stConfig: index configuration
+// @return: index
+static std::unique_ptr<CFeatureIndex> CreateIndex(const FeatureIndexConfig& stConfig)
+{
+	if (stConfig.eType == E_IndexType::eItHNSW)
+		return std::unique_ptr<CFeatureIndex>(new CHNSWIndex(stConfig, TEST_DIM));
+	if (stConfig.eType == E_IndexType::eItIVF)
+		return std::unique_ptr<CFeatureIndex>(new CIVFIndex(stConfig, TEST_DIM));
+
+	return std::unique_ptr<CFeatureIndex>(new CFlatIndex(stConfig, TEST_DIM));
+}
+
+// The approximate indexes find most of the exact top 10, and the flat index all of them
+bool TestIndexRecall()
+{
+	std::vector<float> vGallery = MakeClusteredFeatures(10000, 1);
+	std::vector<float> vQueries = MakeClusteredFeatures(100, 2);
+
+	FeatureIndexConfig stFlat(E_IndexType::eItFlat);
+	FeatureIndexConfig stHNSW(E_IndexType::eItHNSW);
+	FeatureIndexConfig stIVF(E_IndexType::eItIVF);
+	stIVF.nLists = 32;
+	stIVF.nProbes = 8;
+
+	const FeatureIndexConfig vConfigs[] = { stFlat, stHNSW, stIVF };
+	const float vMinRecalls[] = { 1.0f, 0.95f, 0.9f };
+	for (int i = 0; i < 3; i++)
+	{
+		// The rows are added in batches without Train(), so the IVF lists are trained on the rows added
+		std::unique_ptr<CFeatureIndex> pIndex = CreateIndex(vConfigs[i]);
+		for (int nOffset = 0; nOffset < 10000; nOffset += 500)
+			UNIT_CHECK(pIndex->Add(vGallery.data() + (size_t)nOffset * TEST_DIM, 500, TEST_DIM));
+
+		UNIT_CHECK(pIndex->GetCount() == 10000);
+		UNIT_CHECK(pIndex->MeasureRecall(vQueries.data(), 100, TEST_DIM, 10) >= vMinRecalls[i]);
+	}
+
+	return true;
+}
+
+// The decoded embeddings are close to the original ones, and the similarity on the compressed form is the one of the decoded
+bool TestCodecRoundTrip()
+{
+	// The rows in the range of the training rows are encoded, as the int8 codes clip the values out of the range
+	std::vector<float> vTrain = MakeClusteredFeatures(2000, 3);
+	std::vector<float> vTest(vTrain.begin(), vTrain.begin() + (size_t)200 * TEST_DIM);
+
+	const E_FeatureCodec vCodecs[] = { E_FeatureCodec::eFcFloat16, E_FeatureCodec::eFcInt8, E_FeatureCodec::eFcPQ };
+	const float vMaxErrors[] = { 1e-3f, 1.0f / 127.0f, 1.0f };
+	const float vSimTolerances[] = { 1e-4f, 2e-2f, 1e-4f };
+	for (int c = 0; c < 3; c++)
+	{
+		CFeatureCodec cCodec(FeatureCodecConfig(vCodecs[c], 16), TEST_DIM, E_FeatureMetric::eFmCosine);
+		UNIT_CHECK(cCodec.Train(vTrain.data(), 2000, TEST_DIM));
+		UNIT_CHECK(cCodec.IsTrained());
+
+		std::vector<uint8_t> vCode(cCodec.GetCodeSize());
+		std::vector<float> vDecoded(TEST_DIM);
+		double dError = 0.0, dSquaredNorm = 0.0;
+		for (int i = 0; i < 200; i++)
+		{
+			const float* pRow = vTest.data() + (size_t)i * TEST_DIM;
+			cCodec.Encode(pRow, vCode.data());
+			cCodec.Decode(vCode.data(), vDecoded.data());
+
+			for (int k = 0; k < TEST_DIM; k++)
+			{
+				UNIT_CHECK(std::fabs(vDecoded[k] - pRow[k]) <= vMaxErrors[c]);
+				dError += (vDecoded[k] - pRow[k]) * (vDecoded[k] - pRow[k]);
+				dSquaredNorm += pRow[k] * pRow[k];
+			}
+
+			// The similarity of the next row as the query to this compressed row
+			const float* pQuery = vTest.data() + (size_t)((i + 1) % 200) * TEST_DIM;
+			FeatureCodecQuery stQuery;
+			cCodec.PrepareQuery(pQuery, stQuery);
+			float fDecodedSim = CFeatureMatcher::Similarity(pQuery, vDecoded.data(), TEST_DIM, E_FeatureMetric::eFmCosine);
+			UNIT_CHECK(std::fabs(cCodec.Similarity(stQuery, vCode.data()) - fDecodedSim) <= vSimTolerances[c]);
+		}
+
+		// PQ keeps the coarse shape of the embeddings only, so its error is checked on the whole set
+		UNIT_CHECK(dError / dSquaredNorm < 0.25);
+	}
+
+	return true;
+}
+
+// Reranking the candidates of the compressed rows by the rows of the store restores the recall of the compression
+bool TestCodecRerank()
+{
+	std::vector<float> vGallery = MakeClusteredFeatures(5000, 5);
+	std::vector<float> vQueries = MakeClusteredFeatures(50, 6);
+
+	std::string sPath = (fs::temp_directory_path() / "iAIUnitTest.gallery").string();
+	std::error_code ec;
+	fs::remove(sPath, ec);
+	fs::remove(sPath + ".meta", ec);
+
+	float vRecalls[2] = { 0.0f, 0.0f };
+	{
+		CGalleryStore cStore;
+		UNIT_CHECK(cStore.Open(sPath, "unit-test", TEST_DIM, E_FeatureMetric::eFmCosine));
+		for (int i = 0; i < 5000; i++)
+			UNIT_CHECK(cStore.Append(vGallery.data() + (size_t)i * TEST_DIM, GalleryMeta(i)));
+
+		for (int r = 0; r < 2; r++)
+		{
+			FeatureIndexConfig stConfig(E_IndexType::eItHNSW);
+			stConfig.stCodec = FeatureCodecConfig(E_FeatureCodec::eFcPQ, 8);
+			stConfig.nRerank = (r == 0) ? 0 : 100;
+
+			// The graph is searched on the compressed rows, while SearchExact() of the index attached to a store scans the
+			// uncompressed rows, so the recall includes the loss of the codec
+			CHNSWIndex cIndex(stConfig, TEST_DIM);
+			UNIT_CHECK(cIndex.Add(cStore));
+			vRecalls[r] = cIndex.MeasureRecall(vQueries.data(), 50, TEST_DIM, 10);
+		}
+
+		cStore.Close();
+	}
+
+	fs::remove(sPath, ec);
+	fs::remove(sPath + ".meta", ec);
+
+	UNIT_CHECK(vRecalls[0] >= 0.0f && vRecalls[1] > vRecalls[0]);
+	UNIT_CHECK(vRecalls[1] >= 0.9f);
+	return true;
+}
+
+// The codec is trained once enough rows are added, and the rows are scanned exactly until then
+bool TestCodecDeferredTraining()
+{
+	std::vector<float> vGallery = MakeClusteredFeatures(1000, 7);
+	std::vector<float> vQueries = MakeClusteredFeatures(20, 8);
+
+	const E_IndexType vTypes[] = { E_IndexType::eItFlat, E_IndexType::eItHNSW, E_IndexType::eItIVF };
+	for (E_IndexType eType : vTypes)
+	{
+		for (E_FeatureCodec eCodec : { E_FeatureCodec::eFcInt8, E_FeatureCodec::eFcPQ })
+		{
+			FeatureIndexConfig stConfig(eType);
+			stConfig.nLists = 4;
+			stConfig.stCodec = FeatureCodecConfig(eCodec, 16);
+
+			// A few sample rows cannot train the codec
+			CFeatureCodec cCodec(stConfig.stCodec, TEST_DIM, stConfig.eMetric);
+			UNIT_CHECK(!cCodec.Train(vGallery.data(), cCodec.GetMinTrainRows() - 1, TEST_DIM));
+			std::unique_ptr<CFeatureIndex> pTrained = CreateIndex(stConfig);
+			UNIT_CHECK(!pTrained->Train(vGallery.data(), 3, TEST_DIM));
+
+			std::unique_ptr<CFeatureIndex> pIndex = CreateIndex(stConfig);
+			int nMinRows = cCodec.GetMinTrainRows();
+			int nAdded = 0;
+			for (; nAdded + 3 < nMinRows; nAdded += 3)
+				UNIT_CHECK(pIndex->Add(vGallery.data() + (size_t)nAdded * TEST_DIM, 3, TEST_DIM));
+
+			// The rows are kept uncompressed and searched exactly
+			size_t nUncompressed = pIndex->GetRowMemory();
+			UNIT_CHECK(nUncompressed >= (size_t)nAdded * TEST_DIM * sizeof(float));
+			UNIT_CHECK(pIndex->MeasureRecall(vQueries.data(), 20, TEST_DIM, 10) == 1.0f);
+
+			for (; nAdded < 1000; nAdded += 8)
+				UNIT_CHECK(pIndex->Add(vGallery.data() + (size_t)nAdded * TEST_DIM, _MIN(8, 1000 - nAdded), TEST_DIM));
+
+			// All the rows are compressed once the codec is trained
+			UNIT_CHECK(pIndex->GetCount() == 1000);
+			UNIT_CHECK(pIndex->GetRowMemory() < (size_t)1000 * TEST_DIM * sizeof(float) / 2);
+			UNIT_CHECK(pIndex->MeasureRecall(vQueries.data(), 20, TEST_DIM, 10) >= 0.5f);
+		}
+	}
+
+	return true;
+}
+
+// The IVF index without a positive number of lists still trains one list and adds the rows
+bool TestIVFWithoutLists()
+{
+	std::vector<float> vGallery = MakeClusteredFeatures(500, 9);
+	std::vector<float> vQueries = MakeClusteredFeatures(10, 10);
+
+	for (int nLists : { 0, -3 })
+	{
+		FeatureIndexConfig stConfig(E_IndexType::eItIVF);
+		stConfig.nLists = nLists;
+		CIVFIndex cIndex(stConfig, TEST_DIM);
+		for (int nOffset = 0; nOffset < 500; nOffset += 50)
+			UNIT_CHECK(cIndex.Add(vGallery.data() + (size_t)nOffset * TEST_DIM, 50, TEST_DIM));
+
+		UNIT_CHECK(cIndex.GetCount() == 500);
+		UNIT_CHECK(cIndex.MeasureRecall(vQueries.data(), 10, TEST_DIM, 10) == 1.0f);
+	}
+
+	return true;
+}
@@ -0,0 +1,163 @@
+#include "iAIUnitTest.h"
+#include "CFeatureMatcher.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// Maximum difference of the similarities of the SIMD and the scalar sums of the normalised features
+#define SIM_TOLERANCE		1e-5f
+
+// Make the random normalised features
+// @param[in] nRows: number of the features
+// @param[in] nDim: dimension of the features
+// @param[in] nSeed: seed of the random features
+// @return: features of nRows x nDim floats
+static std::vector<float> MakeFeatures(int nRows, int nDim, unsigned int nSeed)
+{
+	std::mt19937 rng(nSeed);
+	std::normal_distribution<float> normal(0.0f, 1.0f);
+
+	std::vector<float> vFeatures((size_t)nRows * nDim);
+	for (float& fValue : vFeatures)
+		fValue = normal(rng);
+	for (int i = 0; i < nRows; i++)
+		CFeatureMatcher::L2Normalise(vFeatures.data() + (size_t)i * nDim, nDim, vFeatures.data() + (size_t)i * nDim);
+
+	return vFeatures;
+}
+
+// Original CReID::CalculateTopK of the cosine similarity, kept as the reference
+// @param[in] pQuery: normalised query feature vector
+// @param[in] pGallery: normalised gallery features
+// @param[in] nRows: number of rows of the gallery
+// @param[in] nDim: dimension of the features
+// @param[in] nTopK: maximum number of rows to return
+// @param[in] fSimThresh: minimum similarity to return
+// @param[out] vReIDRes: top K rows in the descending order of the similarity
+static void ReferenceCalculateTopK(const float* pQuery, const float* pGallery, int nRows, int nDim, int nTopK, float fSimThresh,
+	ReIDResArr& vReIDRes)
+{
+	vReIDRes.clear();
+
+	std::vector<float> vSimilarities;
+	std::vector<int> vImgIDs;
+	for (int i = 0; i < nRows; i++)
+	{
+		float fSimilarity = 0.0f;
+		for (int k = 0; k < nDim; k++)
+			fSimilarity += pQuery[k] * pGallery[(size_t)i * nDim + k];
+
+		vSimilarities.push_back(fSimilarity);
+		vImgIDs.push_back(i);
+	}
+
+	std::sort(vImgIDs.begin(), vImgIDs.end(), [&](int x, int y) { return vSimilarities[x] > vSimilarities[y]; });
+
+	int nLen = _MIN(nTopK, (int)vImgIDs.size());
+	for (int i = 0; i < nLen; i++)
+	{
+		if (vSimilarities[vImgIDs[i]] < fSimThresh)
+			break;
+
+		vReIDRes.push_back(ReIDRes(i, vImgIDs[i], vSimilarities[vImgIDs[i]]));
+	}
+}
+
+// Check whether the top K rows match the reference within the tolerance of the similarity
+// @param[in] vReIDRes: top K rows to check
+// @param[in] vReference: top K rows of the reference
+// @return: true if the similarities match at every rank, and so do the rows not tied with their neighbours
+static bool SameTopK(const ReIDResArr& vReIDRes, const ReIDResArr& vReference)
+{
+	// A row of a similarity close to the threshold may be on either side of it
+	if ((int)vReIDRes.size() < (int)vReference.size() - 1 || (int)vReIDRes.size() > (int)vReference.size() + 1)
+		return false;
+
+	for (int i = 0; i < (int)_MIN(vReIDRes.size(), vReference.size()); i++)
+	{
+		if (std::fabs(vReIDRes[i].fSimilarity - vReference[i].fSimilarity) > SIM_TOLERANCE || vReIDRes[i].nRank != i)
+			return false;
+
+		bool bTied = (i > 0 && vReference[i - 1].fSimilarity - vReference[i].fSimilarity < 2 * SIM_TOLERANCE) ||
+			(i + 1 < (int)vReference.size() && vReference[i].fSimilarity - vReference[i + 1].fSimilarity < 2 * SIM_TOLERANCE);
+		if (!bTied && vReIDRes[i].nImgID != vReference[i].nImgID)
+			return false;
+	}
+
+	return true;
+}
+
+// The top K of the matrix product and of the matrix-vector product match the original CalculateTopK
+bool TestMatcherTopKParity()
+{
+	const int vDims[] = { 7, 64, 128, 2048 };
+	const int vRows[] = { 1, 5, 333, 4096 };
+	const int nQueries = 5;
+	for (int nDim : vDims)
+	{
+		for (int nRows : vRows)
+		{
+			std::vector<float> vGallery = MakeFeatures(nRows, nDim, nDim * 7 + nRows);
+			std::vector<float> vQueries = MakeFeatures(nQueries, nDim, nDim * 11 + nRows);
+
+			std::vector<float> vMatrix((size_t)nQueries * nRows), vVector(nRows);
+			CFeatureMatcher::SimilarityMatrix(vQueries.data(), nQueries, nDim, vGallery.data(), nRows, nDim, nDim,
+				E_FeatureMetric::eFmCosine, vMatrix.data());
+
+			for (int q = 0; q < nQueries; q++)
+			{
+				const float* pQuery = vQueries.data() + (size_t)q * nDim;
+				CFeatureMatcher::Similarities(pQuery, vGallery.data(), nRows, nDim, nDim, E_FeatureMetric::eFmCosine, vVector.data());
+
+				for (int nTopK : { 1, 10, 100 })
+				{
+					for (float fThresh : { -1.0f, 0.05f })
+					{
+						ReIDResArr vReference, vFromMatrix, vFromVector;
+						ReferenceCalculateTopK(pQuery, vGallery.data(), nRows, nDim, nTopK, fThresh, vReference);
+						CFeatureMatcher::SelectTopK(vMatrix.data() + (size_t)q * nRows, nRows, nTopK, fThresh, vFromMatrix);
+						CFeatureMatcher::SelectTopK(vVector.data(), nRows, nTopK, fThresh, vFromVector);
+
+						UNIT_CHECK(SameTopK(vFromMatrix, vReference));
+						UNIT_CHECK(SameTopK(vFromVector, vReference));
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+// The SIMD normalisation matches the scalar one within the rounding error of the sum, not bitwise
+bool TestMatcherNormalise()
+{
+	const int vDims[] = { 1, 7, 8, 100, 512, 2048 };
+	for (int nDim : vDims)
+	{
+		std::mt19937 rng(nDim);
+		std::normal_distribution<float> normal(0.0f, 1.0f);
+
+		for (int t = 0; t < 100; t++)
+		{
+			std::vector<float> vFeature(nDim), vNormalised(nDim);
+			for (float& fValue : vFeature)
+				fValue = normal(rng);
+
+			double dSum = 0.0;
+			for (float fValue : vFeature)
+				dSum += (double)fValue * fValue;
+			double dNorm = std::sqrt(dSum);
+
+			CFeatureMatcher::L2Normalise(vFeature.data(), nDim, vNormalised.data());
+			for (int k = 0; k < nDim; k++)
+				UNIT_CHECK(std::fabs(vNormalised[k] - vFeature[k] / dNorm) <= 1e-6 * (std::fabs(vFeature[k] / dNorm) + 1e-6));
+
+			// The same buffer can be given as the input and the output
+			CFeatureMatcher::L2Normalise(vFeature.data(), nDim, vFeature.data());
+			UNIT_CHECK(vFeature == vNormalised);
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,140 @@
+#include "iAIUnitTest.h"
+#include "CNMSEngine.h"
+#include <algorithm>
+#include <random>
+
+// Original CObjDetector::NMSBoxes, kept as the reference of eNmLegacy
+// @param[in/out] vBoxes: bounding boxes before and after non-maximum suppression
+// @param[in] fNMSThresh: IoU threshold
+static void ReferenceNMSBoxes(ObjBoxArr& vBoxes, float fNMSThresh)
+{
+	std::sort(vBoxes.begin(), vBoxes.end(), [](const ObjBBox& a, const ObjBBox& b) { return a.fScore > b.fScore; });
+
+	std::vector<float> vArea(vBoxes.size());
+	for (int i = 0; i < (int)vBoxes.size(); i++)
+		vArea[i] = (vBoxes[i].fX2 - vBoxes[i].fX1 + 1) * (vBoxes[i].fY2 - vBoxes[i].fY1 + 1);
+
+	std::vector<bool> vIsSuppressed(vBoxes.size(), false);
+	for (int i = 0; i < (int)vBoxes.size(); i++)
+	{
+		if (vIsSuppressed[i])
+			continue;
+
+		for (int j = i + 1; j < (int)vBoxes.size(); j++)
+		{
+			if (vIsSuppressed[j])
+				continue;
+
+			float fW = _MAX(0.0f, _MIN(vBoxes[i].fX2, vBoxes[j].fX2) - _MAX(vBoxes[i].fX1, vBoxes[j].fX1) + 1);
+			float fH = _MAX(0.0f, _MIN(vBoxes[i].fY2, vBoxes[j].fY2) - _MAX(vBoxes[i].fY1, vBoxes[j].fY1) + 1);
+			float fInterArea = fW * fH;
+			if (fInterArea / (vArea[i] + vArea[j] - fInterArea) >= fNMSThresh)
+				vIsSuppressed[j] = true;
+		}
+	}
+
+	int nIdx = 0;
+	vBoxes.erase(std::remove_if(vBoxes.begin(), vBoxes.end(), [&](const ObjBBox&) { return vIsSuppressed[nIdx++]; }), vBoxes.end());
+}
+
+// Make the boxes clustered around a few objects, so many of them overlap
+// @param[in] nBoxes: number of boxes
+// @param[in] nSeed: seed of the random boxes
+// @return: boxes of distinct scores
+static ObjBoxArr MakeBoxes(int nBoxes, unsigned int nSeed)
+{
+	std::mt19937 rng(nSeed);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	std::normal_distribution<float> jitter(0.0f, 8.0f);
+
+	std::vector<ObjBBox> vObjects(8);
+	for (ObjBBox& stObj : vObjects)
+	{
+		stObj.fX1 = uniform(rng) * 1200.0f;
+		stObj.fY1 = uniform(rng) * 600.0f;
+		stObj.fX2 = stObj.fX1 + 40.0f + uniform(rng) * 200.0f;
+		stObj.fY2 = stObj.fY1 + 80.0f + uniform(rng) * 300.0f;
+	}
+
+	ObjBoxArr vBoxes;
+	for (int i = 0; i < nBoxes; i++)
+	{
+		const ObjBBox& stObj = vObjects[rng() % vObjects.size()];
+		float fX1 = stObj.fX1 + jitter(rng), fY1 = stObj.fY1 + jitter(rng);
+		float fX2 = _MAX(fX1 + 1.0f, stObj.fX2 + jitter(rng)), fY2 = _MAX(fY1 + 1.0f, stObj.fY2 + jitter(rng));
+		vBoxes.push_back(ObjBBox(fX1, fY1, fX2, fY2, 0.3f + 0.7f * (float)(nBoxes - i) / nBoxes, (int)(rng() % 3)));
+	}
+
+	std::shuffle(vBoxes.begin(), vBoxes.end(), rng);
+	return vBoxes;
+}
+
+// Check whether two arrays of boxes are the same
+// @param[in] vBoxesA: 1st boxes
+// @param[in] vBoxesB: 2nd boxes
+// @return: true if the boxes and their order are the same
+static bool SameBoxes(const ObjBoxArr& vBoxesA, const ObjBoxArr& vBoxesB)
+{
+	if (vBoxesA.size() != vBoxesB.size())
+		return false;
+
+	for (size_t i = 0; i < vBoxesA.size(); i++)
+	{
+		if (vBoxesA[i].fX1 != vBoxesB[i].fX1 || vBoxesA[i].fY1 != vBoxesB[i].fY1 || vBoxesA[i].fX2 != vBoxesB[i].fX2 ||
+			vBoxesA[i].fY2 != vBoxesB[i].fY2 || vBoxesA[i].fScore != vBoxesB[i].fScore || vBoxesA[i].nClassID != vBoxesB[i].nClassID)
+			return false;
+	}
+
+	return true;
+}
+
+// eNmLegacy of the engine keeps the same boxes in the same order as the original NMSBoxes
+bool TestNMSLegacyParity()
+{
+	const int vBoxCounts[] = { 0, 1, 2, 7, 8, 9, 64, 300, 1000 };
+	const float vThreshes[] = { 0.3f, 0.45f, 0.5f, 0.7f };
+	unsigned int nSeed = 1;
+	for (int nBoxes : vBoxCounts)
+	{
+		for (float fThresh : vThreshes)
+		{
+			ObjBoxArr vEngine = MakeBoxes(nBoxes, nSeed++);
+			ObjBoxArr vReference = vEngine;
+
+			CNMSEngine cEngine(NMSConfig(E_NMSMethod::eNmLegacy, fThresh));
+			cEngine.Run(vEngine);
+			ReferenceNMSBoxes(vReference, fThresh);
+
+			UNIT_CHECK(SameBoxes(vEngine, vReference));
+		}
+	}
+
+	return true;
+}
+
+// The batched run keeps the same boxes as the run of each image, for every method
+bool TestNMSBatchedParity()
+{
+	const int nImages = 5;
+	for (int nMethod = (int)E_NMSMethod::eNmLegacy; nMethod < (int)E_NMSMethod::eNmCount; nMethod++)
+	{
+		for (int nClassAware = 0; nClassAware < 2; nClassAware++)
+		{
+			CNMSEngine cEngine(NMSConfig((E_NMSMethod)nMethod, 0.5f, nClassAware != 0, 0.5f, 0.05f));
+
+			std::vector<ObjBoxArr> vBatched(nImages);
+			for (int i = 0; i < nImages; i++)
+				vBatched[i] = MakeBoxes(50 * i, 100 + i);
+
+			std::vector<ObjBoxArr> vSingle = vBatched;
+			cEngine.Run(vBatched.data(), nImages);
+			for (int i = 0; i < nImages; i++)
+			{
+				cEngine.Run(vSingle[i]);
+				UNIT_CHECK(SameBoxes(vBatched[i], vSingle[i]));
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,98 @@
+#include "iAIUnitTest.h"
+#include "CStagePipeline.h"
+#include <stdexcept>
+#include <thread>
+
+// The consumer pops every item once and in the push order, while the producer waits on the full queue
+bool TestQueueOrdering()
+{
+	const int nItems = 200000;
+	for (int nCapacity : { 1, 3, 64 })
+	{
+		CSPSCQueue<int> cQueue(nCapacity);
+		UNIT_CHECK(cQueue.GetCapacity() == nCapacity);
+
+		std::thread producer([&]()
+		{
+			for (int i = 0; i < nItems; i++)
+				cQueue.Push(i);
+			cQueue.Close();
+		});
+
+		int nExpected = 0, nItem = -1;
+		bool bOrdered = true;
+		while (cQueue.Pop(nItem))
+		{
+			if (nItem != nExpected)
+				bOrdered = false;
+			nExpected++;
+		}
+		producer.join();
+
+		UNIT_CHECK(bOrdered);
+		UNIT_CHECK(nExpected == nItems);
+		UNIT_CHECK(cQueue.GetMaxSize() <= nCapacity);
+	}
+
+	return true;
+}
+
+// The items pushed before Close() are still popped, and the pushes after it fail
+bool TestQueueClose()
+{
+	CSPSCQueue<int> cQueue(4);
+	UNIT_CHECK(cQueue.Push(1));
+	UNIT_CHECK(cQueue.Push(2));
+	cQueue.Close();
+	UNIT_CHECK(!cQueue.Push(3));
+
+	int nItem = 0;
+	UNIT_CHECK(cQueue.Pop(nItem) && nItem == 1);
+	UNIT_CHECK(cQueue.Pop(nItem) && nItem == 2);
+	UNIT_CHECK(!cQueue.Pop(nItem));
+	UNIT_CHECK(cQueue.GetSize() == 0);
+
+	// Close() wakes up the consumer waiting on the empty queue, and the last item pushed before it is not dropped
+	for (int t = 0; t < 1000; t++)
+	{
+		CSPSCQueue<int> cRace(1);
+		int nPopped = 0;
+		std::thread consumer([&]()
+		{
+			int nValue = 0;
+			while (cRace.Pop(nValue))
+				nPopped++;
+		});
+
+		cRace.Push(t);
+		cRace.Close();
+		consumer.join();
+		UNIT_CHECK(nPopped == 1);
+	}
+
+	return true;
+}
+
+// The items leave the pipeline in the submission order even if the stages throw, and WaitIdle() returns
+bool TestPipelineExceptions()
+{
+	std::vector<int> vFinished;
+	std::vector<CStagePipeline::StageFunc> vStages = {
+		[](void* pItem) { if (*(int*)pItem % 3 == 0) throw 42; },
+		[](void* pItem) { if (*(int*)pItem % 5 == 0) throw std::runtime_error("stage error"); },
+		[&](void* pItem) { vFinished.push_back(*(int*)pItem); delete (int*)pItem; },
+	};
+
+	{
+		CStagePipeline cPipeline(vStages, 2);
+		for (int i = 0; i < 100; i++)
+			UNIT_CHECK(cPipeline.Submit(new int(i)));
+		cPipeline.WaitIdle();
+
+		UNIT_CHECK(vFinished.size() == 100);
+		for (int i = 0; i < 100; i++)
+			UNIT_CHECK(vFinished[i] == i);
+	}
+
+	return true;
+}
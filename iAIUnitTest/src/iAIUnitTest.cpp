@@ -0,0 +1,41 @@
+// iAIUnitTest.cpp : Defines the entry point for the checks of the building blocks.
+//
+#include "iAIUnitTest.h"
+
+using namespace std;
+
+typedef struct _UnitTest
+{
+	const char*	szName;			// name of the check
+	bool		(*pfnTest)();	// function of the check
+}UnitTest;
+
+int main()
+{
+	const UnitTest vTests[] = {
+		{ "NMSLegacyParity",			TestNMSLegacyParity },
+		{ "NMSBatchedParity",			TestNMSBatchedParity },
+		{ "MatcherTopKParity",			TestMatcherTopKParity },
+		{ "MatcherNormalise",			TestMatcherNormalise },
+		{ "IndexRecall",				TestIndexRecall },
+		{ "CodecRoundTrip",				TestCodecRoundTrip },
+		{ "CodecRerank",				TestCodecRerank },
+		{ "CodecDeferredTraining",		TestCodecDeferredTraining },
+		{ "IVFWithoutLists",			TestIVFWithoutLists },
+		{ "QueueOrdering",				TestQueueOrdering },
+		{ "QueueClose",					TestQueueClose },
+		{ "PipelineExceptions",			TestPipelineExceptions },
+	};
+
+	int nFailed = 0;
+	for (const UnitTest& stTest : vTests)
+	{
+		bool bPassed = stTest.pfnTest();
+		cout << (bPassed ? "[PASS] " : "[FAIL] ") << stTest.szName << endl;
+		if (!bPassed)
+			nFailed++;
+	}
+
+	cout << nFailed << " of " << sizeof(vTests) / sizeof(vTests[0]) << " checks failed" << endl;
+	return nFailed;
+}
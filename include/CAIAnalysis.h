@@ -1,12 +1,24 @@
 #pragma once
 #include <analysis_type.h>
 #include <opencv2/opencv.hpp>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
 
 
 
 class CObjDetector;
 class CReID;
 class CVideoWriter;
+class CTaskExecutor;
+class CStagePipeline;
+class CMotionGate;
+class CTracker;
+class CEmbeddingCache;
+
+// Callback invoked on a worker thread when a frame run by CAIAnalysis::RunTaskAsync() is finished
+typedef std::function<void(const S_AnalysisResult&)> AnalysisCallback;
 
 // Class for AI-based analysis library
 // This class serves as the interface for the AI-based analysis library
@@ -17,12 +29,37 @@ public:
 	CAIAnalysis(const S_AnalysisParam& stParam);
 	~CAIAnalysis();
 
+	// Configure the process-wide inference runtime shared by all the CAIAnalysis instances
+	// @param[in] stRuntimeParam: the runtime parameters such as the sizes of the global thread pools
+	// @return true if the runtime is configured successfully, otherwise false
+	// [Note] This function must be called before the first CAIAnalysis instance is created.
+	static bool ConfigureRuntime(const S_RuntimeParam& stRuntimeParam);
+
 	// Run the given analysis task
 	// @param[in] eTaskType: the type of analysis task
 	// @param[in] cvBGRFrame: the input BGR format frame
 	// @return true if the task is run successfully, otherwise false
 	bool RunTask(const E_AnalysisTaskType& eTaskType, const cv::Mat& cvBGRFrame);
 
+	// Run the given analysis task asynchronously
+	// @param[in] eTaskType: the type of analysis task
+	// @param[in] cvBGRFrame: the input BGR format frame. It is copied, so the caller can reuse its buffer for the next frame
+	// @param[in] nFrameID: the frame id returned in the result
+	// @param[in] fnCallback: the callback invoked with the result when the task is finished. It can be nullptr
+	// @return the future of the result
+	// [Note] - Up to S_AnalysisParam::nAsyncWorkers frames run at the same time, and it blocks while as many frames are waiting.
+	//        - The results may finish out of order, so use nFrameID to match them. The result video is written in the call order.
+	//        - The results are returned only through the future and the callback. GetDetectionResult() and GetReIDResult() are not updated.
+	//        - The registration task runs synchronously, so the frames called after it use the new query.
+	//        - The callback runs on a worker thread. It must not call RunTaskAsync() or WaitAsyncTasks() of this instance.
+	//        - With S_AnalysisParam::stPipeline enabled, the frame goes through the stages of E_PipelineStage on their own threads
+	//          and the results finish in the call order.
+	std::future<S_AnalysisResult> RunTaskAsync(const E_AnalysisTaskType& eTaskType, const cv::Mat& cvBGRFrame, int64_t nFrameID,
+		const AnalysisCallback& fnCallback = nullptr);
+
+	// Wait until all the frames run by RunTaskAsync() are finished
+	void WaitAsyncTasks();
+
 	// Begin to write task results to video, given the result type
 	// @param[in] eWriteTaskType: the type of result to write to video
 	// @param[in] sVideoPath: the path of the video to write. The file extension should be "mp4" or "avi".
@@ -46,6 +83,46 @@ public:
 	// @return the re-identification result
 	const ReIDResArr*	GetReIDResult() const;
 
+	// Add the person of interest to the query set matched by the re-identification task
+	// @param[in] nQueryID: the query ID returned in the results. The query of the same ID is replaced
+	// @param[in] cvBGRImg: the input BGR format image of the person
+	// @param[in] nTopK: the top k of the query. 0 or less means S_AnalysisParam::nReIDTopK
+	// @param[in] fSimThresh: the similarity threshold of the query. Less than 0 means S_AnalysisParam::fReIDConfThresh
+	// @return true if the query is added successfully, otherwise false
+	// [Note] The frames called by RunTaskAsync() after it use the new query set.
+	bool AddQuery(int nQueryID, const cv::Mat& cvBGRImg, int nTopK = 0, float fSimThresh = -1.0f);
+
+	// Remove the person of interest from the query set
+	// @param[in] nQueryID: the query ID
+	// @return true if the query is removed, otherwise false
+	bool RemoveQuery(int nQueryID);
+
+	// Remove all the persons of interest from the query set
+	void ClearQueries();
+
+	// Get the query set
+	// @return the queries of the query set
+	const ReIDQueryArr*	GetQueries() const;
+
+	// Get the re-identification result of each query of the query set
+	// @return the re-identification result of each query
+	const QueryReIDResArr*	GetQueryReIDResult() const;
+
+	// Get the counters of the motion gate decisions
+	// @param[out] stStats: the counters of the skipped, region and whole frame detections
+	// @return true if the motion gate is enabled, otherwise false
+	bool GetMotionGateStats(MotionGateStats& stStats) const;
+
+	// Get the counters of the re-id embedding cache
+	// @param[out] stStats: the counters of the requested and extracted features
+	// @return true if the re-id embedding cache is enabled, otherwise false
+	bool GetReIDCacheStats(EmbeddingCacheStats& stStats) const;
+
+	// Get the counters of the stages of the pipelined RunTaskAsync()
+	// @param[out] vStats: the queue depth and the busy time of each stage. Indexed by E_PipelineStage
+	// @return true if the pipeline is enabled, otherwise false
+	bool GetPipelineStats(std::vector<PipelineStageStats>& vStats) const;
+
 	// Check if the analysis library is valid
 	// @return true if the analysis library is valid, otherwise false
 	const bool			IsValid() const;
@@ -57,11 +134,21 @@ public:
 	// @param[in/out] cvBGRFrame: the input BGR format frame
 	bool DrawResult(const E_AnalysisTaskType& eDrawTaskType, bool bCheckResultExistence, cv::Mat& cvBGRFrame);
 
+	// Draw the result of RunTaskAsync() on the given frame
+	// @param[in] stResult: the result returned by RunTaskAsync()
+	// @param[in] bCheckResultExistence: true if the result existence should be checked, otherwise false
+	// @param[in/out] cvBGRFrame: the input BGR format frame
+	bool DrawResult(const S_AnalysisResult& stResult, bool bCheckResultExistence, cv::Mat& cvBGRFrame);
+
 private:
 	bool Init();
 	bool InitObjDetector();
 	bool InitReID();
 	bool InitVideoWriter();
+	bool InitMotionGate();
+	bool InitTracker();
+	bool InitReIDCache();
+	bool InitPipeline();
 
 	void Release();
 
@@ -86,6 +173,99 @@ private:
 	// @param[in] cvBGRFrame: the input BGR format frame
 	// @return true if the task result is written to video successfully, otherwise false
 	inline bool WriteResultVideo(const cv::Mat& cvBGRFrame);
+
+	// Run the task on the given frame into the given result without touching the state of the networks
+	// @param[in] cvBGRFrame: the input BGR format frame
+	// @param[in] vQueryFeature: the query feature of the re-identification task
+	// @param[in] vQueries: the query set of the re-identification task
+	// @param[in] cvQueryFeatures: the feature matrix of the query set
+	// @param[in] eGate: the decision of the motion gate on the frame
+	// @param[in] cvRegion: the motion region of the frame
+	// @param[in] nGateSeq: the sequence number of the frame checked by the motion gate
+	// @param[in] nSeq: the call sequence number of the frame
+	// @param[in/out] stResult: the result of the task. The task type is given in it
+	// @return true if the task is run successfully, otherwise false
+	bool RunTaskCore(const cv::Mat& cvBGRFrame, const std::vector<float>& vQueryFeature, const ReIDQueryArr& vQueries, const cv::Mat& cvQueryFeatures,
+		E_MotionGateResult eGate, const cv::Rect& cvRegion, uint64_t nGateSeq, uint64_t nSeq, S_AnalysisResult& stResult);
+
+	// Run the detection and the tracking of the task into the given result
+	// @param[in] cvBGRFrame: the input BGR format frame
+	// @param[in] eGate: the decision of the motion gate on the frame
+	// @param[in] cvRegion: the motion region of the frame
+	// @param[in] nGateSeq: the sequence number of the frame checked by the motion gate
+	// @param[in] nSeq: the call sequence number of the frame
+	// @param[in/out] stResult: the result of the task. The detection result is set to it
+	// @return true if the objects are detected or tracked successfully, otherwise false
+	// [Note] It must be called once for every frame submitted to the workers, as the tracker waits for the turn of each frame.
+	bool RunDetectionCore(const cv::Mat& cvBGRFrame, E_MotionGateResult eGate, const cv::Rect& cvRegion, uint64_t nGateSeq, uint64_t nSeq,
+		S_AnalysisResult& stResult);
+
+	// Run the re-identification of the task on the detection result into the given result
+	// @param[in] cvBGRFrame: the input BGR format frame
+	// @param[in] vQueryFeature: the query feature of the re-identification task
+	// @param[in] vQueries: the query set of the re-identification task
+	// @param[in] cvQueryFeatures: the feature matrix of the query set
+	// @param[in/out] stResult: the result of the task holding the detection result. The re-identification result is set to it
+	// @return true if the task is run successfully, otherwise false
+	bool RunReIDCore(const cv::Mat& cvBGRFrame, const std::vector<float>& vQueryFeature, const ReIDQueryArr& vQueries, const cv::Mat& cvQueryFeatures,
+		S_AnalysisResult& stResult);
+
+	// Check the motion of the frame before the detection
+	// @param[in] cvBGRFrame: the input BGR format frame
+	// @param[out] cvRegion: the motion region of the frame
+	// @param[out] nGateSeq: the sequence number of the frame
+	// @return the decision of the motion gate. eMgFullFrame if the motion gate is disabled
+	// [Note] The frames must be checked in the capture order.
+	E_MotionGateResult CheckMotion(const cv::Mat& cvBGRFrame, cv::Rect& cvRegion, uint64_t& nGateSeq);
+
+	// Detect the objects in the frame as decided by the motion gate
+	// @param[in] cvBGRFrame: the input BGR format frame
+	// @param[in] eGate: the decision of the motion gate on the frame
+	// @param[in] cvRegion: the motion region of the frame
+	// @param[in] nGateSeq: the sequence number of the frame checked by the motion gate
+	// @param[out] vObjBoxes: the detection result
+	// @return true if the detection is successful, otherwise false
+	// [Note] - The skipped frame reuses the latest result, and the region result keeps the previous objects out of the region.
+	//        - The results are resolved in the gate order, so the skipped frame waits for the detection of the frames before it.
+	bool DetectGated(const cv::Mat& cvBGRFrame, E_MotionGateResult eGate, const cv::Rect& cvRegion, uint64_t nGateSeq,
+		ObjBoxArr& vObjBoxes);
+
+	// Pass the gate turn of the frame without detection to the next frame
+	// @param[in] nGateSeq: the sequence number of the frame checked by the motion gate
+	// [Note] It must be called once for every frame checked by the motion gate but not given to DetectGated().
+	void PassGateTurn(uint64_t nGateSeq);
+
+	// Draw the given result on the given frame
+	// @param[in] eDrawTaskType: the type of analysis task
+	// @param[in] bCheckResultExistence: true if the result existence should be checked, otherwise false
+	// @param[in] vObjBoxes: the detection result
+	// @param[in] vReIDRes: the re-identification result
+	// @param[in] vQueryReIDRes: the re-identification result of each query of the query set
+	// @param[in/out] cvBGRFrame: the input BGR format frame
+	bool DrawResultCore(const E_AnalysisTaskType& eDrawTaskType, bool bCheckResultExistence,
+		const ObjBoxArr& vObjBoxes, const ReIDResArr& vReIDRes, const QueryReIDResArr& vQueryReIDRes, cv::Mat& cvBGRFrame);
+
+	// Write the result of RunTaskAsync() to video in the call order
+	// @param[in] nSeq: the call sequence number of the frame
+	// @param[in] stResult: the result of the frame
+	// @param[in] cvBGRFrame: the input BGR format frame
+	void WriteResultVideoInOrder(uint64_t nSeq, const S_AnalysisResult& stResult, const cv::Mat& cvBGRFrame);
+
+	// Track the objects of the frame of RunTaskAsync() in the call order
+	// @param[in] nSeq: the call sequence number of the frame
+	// @param[in] bDetected: true if the objects are detected on the frame, false if the tracks are only predicted
+	// @param[in] cvFrameSize: the size of the frame
+	// @param[in/out] vObjBoxes: the detection result, replaced with the tracked objects
+	// [Note] It must be called once for every frame submitted to the workers, even if the detection fails.
+	void TrackInOrder(uint64_t nSeq, bool bDetected, const cv::Size& cvFrameSize, ObjBoxArr& vObjBoxes);
+
+	// Get the re-id features of the detected objects
+	// @param[in] cvBGRFrame: the input BGR format frame
+	// @param[in] vObjBoxes: the detection result
+	// @param[out] cvGalleryFeatures: the feature matrix. Each row is the feature vector of the relevant object
+	// @return true if the features are obtained successfully, otherwise false
+	// [Note] The cached features of the tracked objects are reused if the re-id embedding cache is enabled.
+	bool GetGalleryFeatures(const cv::Mat& cvBGRFrame, const ObjBoxArr& vObjBoxes, cv::Mat& cvGalleryFeatures);
 	
 private:
 	bool 				m_bValid;			// true if the analysis library is valid	
@@ -96,4 +276,27 @@ private:
 	S_AnalysisParam		m_stParam;			// Analysis parameters
 	
 	E_AnalysisTaskType	m_eWriteResultType;	// The type of result to write to video
+
+	CTaskExecutor		*m_pExecutor;		// Worker threads of RunTaskAsync(). nullptr if the pipeline is enabled
+	CStagePipeline		*m_pPipeline;		// Stage threads of the pipelined RunTaskAsync(). nullptr if disabled
+	std::mutex			m_submitMutex;		// Mutex to keep the call order of RunTaskAsync() same as the queue order
+	uint64_t			m_nSubmitSeq;		// Sequence number of the next frame of RunTaskAsync()
+	std::mutex			m_writeMutex;		// Mutex to protect the video writer shared by the workers
+	std::condition_variable	m_cvWriteTurn;	// Notified when a frame of RunTaskAsync() is written to video
+	uint64_t			m_nWriteSeq;		// Sequence number of the next frame to write to video
+
+	ObjBoxArr			m_vObjBoxes;		// Detection result of RunTask()
+	CMotionGate			*m_pMotionGate;		// Motion gate before the detection. nullptr if disabled
+	std::mutex			m_gateMutex;		// Mutex to protect the latest detection result of the motion gate
+	std::condition_variable	m_cvGateTurn;	// Notified when the gate result of a frame is resolved
+	ObjBoxArr			m_vGateBoxes;		// Latest detection result reused by the frames without motion
+	uint64_t			m_nGateSeq;			// Sequence number of the next frame checked by the motion gate
+	uint64_t			m_nGateTurnSeq;		// Sequence number of the next frame to resolve its gate result
+
+	CTracker			*m_pTracker;		// Multi-object tracker after the detection. nullptr if disabled
+	std::mutex			m_trackMutex;		// Mutex to protect the tracker shared by the workers
+	std::condition_variable	m_cvTrackTurn;	// Notified when a frame of RunTaskAsync() is tracked
+	uint64_t			m_nTrackSeq;		// Sequence number of the next frame to track
+
+	CEmbeddingCache		*m_pReIDCache;		// Re-id features of the tracked objects. nullptr if disabled
 };
\ No newline at end of file
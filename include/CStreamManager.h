@@ -0,0 +1,124 @@
+#pragma once
+#include <CAIAnalysis.h>
+#include <map>
+#include <deque>
+#include <thread>
+
+
+
+class CObjDetector;
+class CReID;
+
+// Class of the analysis engine running many camera streams on the shared networks
+// The frames submitted by the streams are collected by one scheduler thread. Each round takes the oldest frame of up to
+// S_StreamManagerParam::nMaxBatchFrames streams, detects all of them in one batch run, extracts the person crops of all of them
+// in one re-id batch run, and routes the results back to the callback of each stream.
+// Each stream keeps its own motion gate, tracker and re-id embedding cache, while the networks are loaded once for all the streams.
+class IAIANALYSISLIB_API CStreamManager
+{
+public:
+	CStreamManager(const S_AnalysisParam& stParam, const S_StreamManagerParam& stStreamParam = S_StreamManagerParam());
+	~CStreamManager();
+
+	// Add a stream
+	// @param[in] fnCallback: the callback invoked with the result of each frame of the stream. It can be nullptr
+	// @return the stream ID. -1 if it fails
+	// [Note] The callback runs on the scheduler thread, so it should return quickly. It must not call the functions of this instance.
+	int AddStream(const AnalysisCallback& fnCallback);
+
+	// Remove a stream
+	// @param[in] nStreamID: the stream ID
+	// @return true if the stream is removed, otherwise false
+	// [Note] It waits for the frame of the stream being run. The waiting frames are completed with bSuccess false.
+	bool RemoveStream(int nStreamID);
+
+	// Submit a frame of the stream
+	// @param[in] nStreamID: the stream ID
+	// @param[in] eTaskType: the type of analysis task. Only the detection and the re-identification tasks are supported
+	// @param[in] cvBGRFrame: the input BGR format frame. It is copied, so the caller can reuse its buffer for the next frame
+	// @param[in] nFrameID: the frame id returned in the result
+	// @return true if the frame is queued, otherwise false
+	// [Note] - The frames of a stream are run in the submission order, and the results are returned in the same order.
+	//        - If S_StreamManagerParam::nMaxPendingFrames frames are waiting, it blocks or drops the oldest one by bDropOldFrames.
+	bool SubmitFrame(int nStreamID, const E_AnalysisTaskType& eTaskType, const cv::Mat& cvBGRFrame, int64_t nFrameID);
+
+	// Wait until all the submitted frames are finished
+	void WaitIdle();
+
+	// Add the person of interest to the query set matched by the re-identification task of all the streams
+	// @param[in] nQueryID: the query ID returned in the results. The query of the same ID is replaced
+	// @param[in] cvBGRImg: the input BGR format image of the person
+	// @param[in] nTopK: the top k of the query. 0 or less means S_AnalysisParam::nReIDTopK
+	// @param[in] fSimThresh: the similarity threshold of the query. Less than 0 means S_AnalysisParam::fReIDConfThresh
+	// @return true if the query is added successfully, otherwise false
+	// [Note] The rounds started after it use the new query set.
+	bool AddQuery(int nQueryID, const cv::Mat& cvBGRImg, int nTopK = 0, float fSimThresh = -1.0f);
+
+	// Remove the person of interest from the query set
+	// @param[in] nQueryID: the query ID
+	// @return true if the query is removed, otherwise false
+	bool RemoveQuery(int nQueryID);
+
+	// Remove all the persons of interest from the query set
+	void ClearQueries();
+
+	// Get the counters of the batches
+	// @param[out] stStats: the counters of the frames and the batch runs
+	void GetStats(S_StreamManagerStats& stStats) const;
+
+	// Check if the stream manager is valid
+	// @return true if the stream manager is valid, otherwise false
+	const bool			IsValid() const;
+
+private:
+	struct StreamContext;
+	struct StreamFrame;
+
+	bool Init();
+	void Release();
+
+	// Main loop of the scheduler thread
+	void SchedulerLoop();
+
+	// Take the frames of the next round
+	// @param[out] vRound: the frames of the round. One frame per stream at most
+	// @return true if the frames are taken, false if the stream manager is stopping
+	// [Note] It waits up to S_StreamManagerParam::nBatchTimeoutMs for more streams to fill the batch.
+	bool TakeRound(std::vector<StreamFrame>& vRound);
+
+	// Run the frames of a round and invoke the callbacks of the streams
+	// @param[in/out] vRound: the frames of the round
+	void RunRound(std::vector<StreamFrame>& vRound);
+
+	// Detect the frames of a round in one batch run
+	// @param[in/out] vRound: the frames of the round. The detection result is set to the result of each frame
+	// @param[out] vDetected: true if the objects of the frame are detected, false if they are only predicted or the detection fails
+	void DetectRound(std::vector<StreamFrame>& vRound, std::vector<bool>& vDetected);
+
+	// Extract the re-id features of a round in one batch run and match them with the queries
+	// @param[in/out] vRound: the frames of the round. The re-id result is set to the result of each frame
+	void ReIDRound(std::vector<StreamFrame>& vRound);
+
+private:
+	bool					m_bValid;			// true if the stream manager is valid
+	S_AnalysisParam			m_stParam;			// Analysis parameters of all the streams
+	S_StreamManagerParam	m_stStreamParam;	// Batching parameters
+
+	CObjDetector			*m_pObjDetector;	// Object detector shared by all the streams
+	CReID					*m_pReID;			// Re-identification shared by all the streams
+	std::mutex				m_queryMutex;		// Mutex to protect the query set of the re-identification
+
+	mutable std::mutex		m_mutex;			// Mutex to protect the streams and the counters
+	std::condition_variable	m_cvFrame;			// Notified when a frame is submitted or the stream manager stops
+	std::condition_variable	m_cvSpace;			// Notified when a frame leaves the queue of a stream
+	std::condition_variable	m_cvIdle;			// Notified when a round is finished
+	std::map<int, StreamContext*>	m_mapStreams;	// Streams by the stream ID
+	int						m_nNextStreamID;	// ID of the next stream
+	int						m_nNextTurn;		// Stream ID the next round starts from, so all the streams get their turn
+	int						m_nPending;			// Number of frames waiting in all the streams
+	bool					m_bRunning;			// true while a round is being run
+	bool					m_bStop;			// true if the stream manager is stopping
+	S_StreamManagerStats	m_stStats;			// Counters of the batches
+
+	std::thread				m_scheduler;		// Scheduler thread running the rounds
+};
\ No newline at end of file
@@ -42,27 +42,242 @@ typedef enum _E_DEVICE_TYPE
 }E_DeviceType;
 
 // Enum type that defines the deep learning inference runtime type
-// Currently only onnx runtime is supported. More runtimes will be added in the future as project goes on.
+// Currently onnx runtime and OpenCV DNN are supported. More runtimes will be added in the future as project goes on.
 typedef enum _E_INFERENCE_RUNTIME_TYPE
 {
 	eIrtUnknown = -1,		// unknown runtime
 	eIrtOnnx,				// onnx runtime
+	eIrtOpenCVDNN,			// OpenCV DNN module with its own CPU kernels
 	eIrtCount				// total number of runtimes supported
 }E_InferenceRuntimeType;
 
+// Enum type that defines the numeric precision of the deep learning networks
+// The INT8 models are generated offline by the calibration tool under tools/quantization.
+typedef enum _E_PRECISION
+{
+	ePrUnknown = -1,		// unknown precision
+	ePrFP32,				// 32-bit floating point
+	ePrINT8,				// 8-bit integer quantized by static QDQ quantization
+	ePrCount				// total number of precisions supported
+}E_Precision;
+
+// Enum type that defines the stages of the pipelined CAIAnalysis::RunTaskAsync()
+// Decoding the frames is left to the caller, and the preprocessing of the detection network runs in its stage.
+typedef enum _E_PIPELINE_STAGE
+{
+	ePsUnknown = -1,		// unknown stage
+	ePsDetection,			// motion gate result, detection and tracking
+	ePsReID,				// cropping, re-id feature extraction and matching
+	ePsRender,				// drawing the result on the frame of the result video
+	ePsEncode,				// writing the result video and returning the result
+	ePsCount				// total number of stages
+}E_PipelineStage;
+
+
+// Structure that defines the threading policy of the deep learning networks of one CAIAnalysis instance
+// It is useful to give each stream a small fixed slice of CPU cores on a multi-stream host for the predictable latency.
+typedef struct _S_THREADING_PARAM
+{
+	bool bOwnThreadPools;					// true: the networks create their own thread pools with the settings below. false: use the global pools,
+											// unless a setting below other than bParallelExecution is not the default
+	int nIntraOpThreads;					// number of intra-op threads of each network. 0 means the default, or the number of CPUs in nCPUAffinityMask if set
+	int nInterOpThreads;					// number of inter-op threads of each network. 0 means the default
+	bool bParallelExecution;				// true: run the independent nodes in parallel. false: run the nodes sequentially
+	bool bAllowSpinning;					// true: the idle threads spin for a while before sleeping
+	uint64_t nCPUAffinityMask;				// bit i pins the intra-op threads to the logical processor i. 0 means no affinity
+
+	_S_THREADING_PARAM(
+		bool _bOwnThreadPools					= false,
+		int _nIntraOpThreads					= 0,
+		int _nInterOpThreads					= 0,
+		bool _bParallelExecution				= true,
+		bool _bAllowSpinning					= true,
+		uint64_t _nCPUAffinityMask				= 0)
+	{
+		bOwnThreadPools = _bOwnThreadPools;
+		nIntraOpThreads = _nIntraOpThreads;
+		nInterOpThreads = _nInterOpThreads;
+		bParallelExecution = _bParallelExecution;
+		bAllowSpinning = _bAllowSpinning;
+		nCPUAffinityMask = _nCPUAffinityMask;
+	}
+}S_ThreadingParam;
+
+
+// Structure that defines the tiled detection of the high-resolution frames
+// Each tile is detected at the full resolution, so the small objects far from the camera are not lost by the downscaling.
+// The cost scales with the number of the active tiles.
+typedef struct _S_TILE_PARAM
+{
+	bool bEnable;							// true: detect on the tiles. false: detect on the whole frame
+	int nTileW;								// tile width in pixels of the frame
+	int nTileH;								// tile height in pixels of the frame
+	int nOverlap;							// minimum overlap in pixels between the adjacent tiles
+	bool bFullFrame;						// true: also detect on the whole frame for the large objects cut by the tiles
+	int nParallelRuns;						// number of runs the tiles are split into and run at the same time. 1 means one batch
+	std::vector<bool> vActiveTiles;			// whether each tile in row-major order is detected. Empty means all the tiles
+
+	_S_TILE_PARAM(
+		bool _bEnable							= false,
+		int _nTileW								= 640,
+		int _nTileH								= 384,
+		int _nOverlap							= 64,
+		bool _bFullFrame						= true,
+		int _nParallelRuns						= 1,
+		const std::vector<bool>& _vActiveTiles	= std::vector<bool>())
+	{
+		bEnable = _bEnable;
+		nTileW = _nTileW;
+		nTileH = _nTileH;
+		nOverlap = _nOverlap;
+		bFullFrame = _bFullFrame;
+		nParallelRuns = _nParallelRuns;
+		vActiveTiles = _vActiveTiles;
+	}
+}S_TileParam;
+
+
+// Structure that defines the motion gate run before the detection of each frame
+// On the cameras looking at the quiet scenes, most of the detections are skipped or restricted to the moving region.
+// The sensitivity is set per camera by nDiffThresh and fMinMotionRatio.
+typedef struct _S_MOTION_GATE_PARAM
+{
+	bool bEnable;							// true: run the motion gate before the detection
+	int nProcWidth;							// width of the downscaled grey frame compared with the background
+	int nDiffThresh;						// minimum intensity difference [0, 255] of a moving pixel. Lower is more sensitive
+	float fMinMotionRatio;					// minimum ratio of the moving pixels to run the detector. Lower is more sensitive
+	float fLearningRate;					// learning rate of the background. The still objects fade into it
+	int nRegionMargin;						// margin in pixels added around the motion region
+	float fMaxRegionRatio;					// the whole frame is detected if the motion region is larger than this ratio of the frame
+	int nRefreshInterval;					// the whole frame is detected at least once every N frames. 0 means never
+
+	_S_MOTION_GATE_PARAM(
+		bool _bEnable							= false,
+		int _nProcWidth							= 160,
+		int _nDiffThresh						= 25,
+		float _fMinMotionRatio					= 0.002f,
+		float _fLearningRate					= 0.05f,
+		int _nRegionMargin						= 32,
+		float _fMaxRegionRatio					= 0.5f,
+		int _nRefreshInterval					= 100)
+	{
+		bEnable = _bEnable;
+		nProcWidth = _nProcWidth;
+		nDiffThresh = _nDiffThresh;
+		fMinMotionRatio = _fMinMotionRatio;
+		fLearningRate = _fLearningRate;
+		nRegionMargin = _nRegionMargin;
+		fMaxRegionRatio = _fMaxRegionRatio;
+		nRefreshInterval = _nRefreshInterval;
+	}
+}S_MotionGateParam;
+
+
+// Structure that defines the multi-object tracker run after the detection
+// The tracker predicts the motion of each person by a Kalman filter and associates the detections to the tracks
+// in two stages as ByteTrack: the confident detections first, then the low score ones to the remaining tracks.
+// Each result box carries the persistent track ID in ObjBBox::nTrackID.
+typedef struct _S_TRACKER_PARAM
+{
+	bool bEnable;							// true: track the detected persons across the frames
+	int nDetectInterval;					// the detector runs every N frames and the tracks are predicted in between. 1 means every frame
+	float fLowScoreThresh;					// minimum score of the low score detections of the 2nd association. fDetConfThresh is the high score threshold
+	float fMatchIoUThresh;					// minimum IoU between a track and a confident detection to associate them
+	int nMaxLostFrames;						// number of detection frames a track is kept without any detection
+	int nMinHits;							// number of associated detections to confirm a new track
+
+	_S_TRACKER_PARAM(
+		bool _bEnable							= false,
+		int _nDetectInterval					= 1,
+		float _fLowScoreThresh					= 0.1f,
+		float _fMatchIoUThresh					= 0.2f,
+		int _nMaxLostFrames						= 30,
+		int _nMinHits							= 2)
+	{
+		bEnable = _bEnable;
+		nDetectInterval = _nDetectInterval;
+		fLowScoreThresh = _fLowScoreThresh;
+		fMatchIoUThresh = _fMatchIoUThresh;
+		nMaxLostFrames = _nMaxLostFrames;
+		nMinHits = _nMinHits;
+	}
+}S_TrackerParam;
+
+
+// Structure that defines the re-id embedding cache keyed by the track ID
+// The features of a tracked person are extracted again only on a new track, on a large scale or appearance change, or every N frames,
+// and the running aggregate of them is matched with the query. It needs S_TrackerParam::bEnable.
+typedef struct _S_REID_CACHE_PARAM
+{
+	bool bEnable;							// true: cache the re-id features of the tracked persons
+	int nRefreshInterval;					// the features of a track are extracted at least once every N frames
+	float fScaleChangeRatio;				// relative change of the box height which makes the features extracted again
+	float fAppearanceThresh;				// mean absolute difference of the thumbnails [0, 1] which makes the features extracted again
+	float fMomentum;						// weight of the aggregate feature against the new feature. 0 keeps the latest feature only
+	int nMaxIdleFrames;						// the track not seen for N frames is removed from the cache
+
+	_S_REID_CACHE_PARAM(
+		bool _bEnable							= false,
+		int _nRefreshInterval					= 30,
+		float _fScaleChangeRatio				= 0.3f,
+		float _fAppearanceThresh				= 0.15f,
+		float _fMomentum						= 0.9f,
+		int _nMaxIdleFrames						= 90)
+	{
+		bEnable = _bEnable;
+		nRefreshInterval = _nRefreshInterval;
+		fScaleChangeRatio = _fScaleChangeRatio;
+		fAppearanceThresh = _fAppearanceThresh;
+		fMomentum = _fMomentum;
+		nMaxIdleFrames = _nMaxIdleFrames;
+	}
+}S_ReIDCacheParam;
+
+
+// Structure that defines the pipelined run of CAIAnalysis::RunTaskAsync()
+// Each stage of E_PipelineStage runs on its own thread and passes the frames to the next one through a bounded ring buffer,
+// so the stages work on the consecutive frames at the same time and the throughput is that of the slowest stage.
+typedef struct _S_PIPELINE_PARAM
+{
+	bool bEnable;							// true: run the stages as a pipeline. false: run each frame by one worker of nAsyncWorkers
+	int nQueueDepth;						// capacity of the queue in front of each stage. A full queue blocks the stage in front of it
+
+	_S_PIPELINE_PARAM(
+		bool _bEnable							= false,
+		int _nQueueDepth						= 2)
+	{
+		bEnable = _bEnable;
+		nQueueDepth = _nQueueDepth;
+	}
+}S_PipelineParam;
+
 
 // Structure that defines the parameters for CAIAnalysisLib
 typedef struct _S_ANALYSIS_PARAM
 {
 	E_DeviceType eDeviceType;				// device type
 	E_InferenceRuntimeType eRuntimeType;	// inference runtime type
+	E_InferenceRuntimeType eDetRuntimeType;	// inference runtime type of the detection network. eIrtUnknown means eRuntimeType
+	E_InferenceRuntimeType eReIDRuntimeType;	// inference runtime type of the re-id network. eIrtUnknown means eRuntimeType
+	E_Precision ePrecision;					// numeric precision of the detection and re-id networks
 
 	E_DetectionMode eDetectionMode;			// object detection mode
 	float fDetConfThresh;					// object detection confidence threshold
+	float fDetNMSThresh;					// object detection non-maximum suppression threshold
+	E_NMSMethod eDetNMSMethod;				// object detection non-maximum suppression method. eNmLegacy gives the original result
+	S_TileParam stDetTiling;				// tiled detection of the high-resolution frames
+	S_MotionGateParam stMotionGate;			// motion gate run before the detection
+	S_TrackerParam stTracker;				// multi-object tracker run after the detection
 
 	E_ReIDMode eReIDMode;					// re-id mode
 	float fReIDConfThresh;					// re-id confidence threshold
 	int nReIDTopK;							// re-id top k
+	int nReIDMaxBatchSize;					// maximum number of person crops extracted in one batch run by re-id
+	S_ReIDCacheParam stReIDCache;			// re-id embedding cache of the tracked persons
+
+	S_ThreadingParam stThreading;			// threading policy of the detection and re-id networks
+	int nAsyncWorkers;						// maximum number of frames run at the same time by CAIAnalysis::RunTaskAsync()
+	S_PipelineParam stPipeline;				// pipelined run of CAIAnalysis::RunTaskAsync()
 
 	_S_ANALYSIS_PARAM(
 		E_DeviceType _eDeviceType				= E_DeviceType::eDtCPU, 
@@ -71,7 +286,20 @@ typedef struct _S_ANALYSIS_PARAM
 		float _fDetConfThresh					= 0.5f,
 		E_ReIDMode _eReIDMode					= E_ReIDMode::eRmYouReID, 
 		float _fReIDConfThresh					= 0.5f,
-		int _nReIDTopK							= 5)
+		int _nReIDTopK							= 5,
+		int _nReIDMaxBatchSize					= 16,
+		const S_ThreadingParam& _stThreading	= S_ThreadingParam(),
+		E_Precision _ePrecision					= E_Precision::ePrFP32,
+		E_InferenceRuntimeType _eDetRuntimeType	= E_InferenceRuntimeType::eIrtUnknown,
+		E_InferenceRuntimeType _eReIDRuntimeType	= E_InferenceRuntimeType::eIrtUnknown,
+		int _nAsyncWorkers						= 2,
+		float _fDetNMSThresh					= 0.5f,
+		E_NMSMethod _eDetNMSMethod				= E_NMSMethod::eNmLegacy,
+		const S_TileParam& _stDetTiling			= S_TileParam(),
+		const S_MotionGateParam& _stMotionGate	= S_MotionGateParam(),
+		const S_TrackerParam& _stTracker		= S_TrackerParam(),
+		const S_ReIDCacheParam& _stReIDCache	= S_ReIDCacheParam(),
+		const S_PipelineParam& _stPipeline		= S_PipelineParam())
 	{
 		eDeviceType = _eDeviceType;
 		eRuntimeType = _eRuntimeType;
@@ -80,5 +308,114 @@ typedef struct _S_ANALYSIS_PARAM
 		eReIDMode = _eReIDMode;
 		fReIDConfThresh = _fReIDConfThresh;
 		nReIDTopK = _nReIDTopK;
+		nReIDMaxBatchSize = _nReIDMaxBatchSize;
+		stThreading = _stThreading;
+		ePrecision = _ePrecision;
+		eDetRuntimeType = _eDetRuntimeType;
+		eReIDRuntimeType = _eReIDRuntimeType;
+		nAsyncWorkers = _nAsyncWorkers;
+		fDetNMSThresh = _fDetNMSThresh;
+		eDetNMSMethod = _eDetNMSMethod;
+		stDetTiling = _stDetTiling;
+		stMotionGate = _stMotionGate;
+		stTracker = _stTracker;
+		stReIDCache = _stReIDCache;
+		stPipeline = _stPipeline;
 	}
 }S_AnalysisParam;
+
+
+// Structure that defines the result of one frame run by CAIAnalysis::RunTaskAsync()
+typedef struct _S_ANALYSIS_RESULT
+{
+	int64_t nFrameID;						// frame id given by the caller
+	E_AnalysisTaskType eTaskType;			// type of the analysis task
+	bool bSuccess;							// true if the task is run successfully, otherwise false
+	ObjBoxArr vObjBoxes;					// detection result of the frame
+	ReIDResArr vReIDRes;					// re-identification result of the frame. nImgID is the index in vObjBoxes
+	QueryReIDResArr vQueryReIDRes;			// re-identification result of each query of the query set. nImgID is the index in vObjBoxes
+
+	_S_ANALYSIS_RESULT(
+		int64_t _nFrameID						= -1,
+		E_AnalysisTaskType _eTaskType			= E_AnalysisTaskType::eAttUnknown,
+		bool _bSuccess							= false)
+	{
+		nFrameID = _nFrameID;
+		eTaskType = _eTaskType;
+		bSuccess = _bSuccess;
+	}
+}S_AnalysisResult;
+
+
+// Structure that defines the batching of the streams of CStreamManager
+// The frames of the streams are collected into one detection batch, and the person crops of all of them into one re-id batch,
+// so the shared networks run few large batches instead of one small run per camera.
+typedef struct _S_STREAM_MANAGER_PARAM
+{
+	int nMaxBatchFrames;					// maximum number of frames detected in one batch run. One frame per stream at most
+	int nBatchTimeoutMs;					// maximum time in milliseconds waiting for more streams to fill the batch. 0 runs the ready frames at once
+	int nMaxPendingFrames;					// maximum number of frames waiting per stream
+	bool bDropOldFrames;					// true: the oldest frame of a full stream is dropped. false: SubmitFrame() blocks
+
+	_S_STREAM_MANAGER_PARAM(
+		int _nMaxBatchFrames					= 8,
+		int _nBatchTimeoutMs					= 10,
+		int _nMaxPendingFrames					= 2,
+		bool _bDropOldFrames					= false)
+	{
+		nMaxBatchFrames = _nMaxBatchFrames;
+		nBatchTimeoutMs = _nBatchTimeoutMs;
+		nMaxPendingFrames = _nMaxPendingFrames;
+		bDropOldFrames = _bDropOldFrames;
+	}
+}S_StreamManagerParam;
+
+
+// Structure that defines the counters of the batches run by CStreamManager
+typedef struct _S_STREAM_MANAGER_STATS
+{
+	uint64_t nFrames;						// number of frames run
+	uint64_t nDropped;						// number of frames dropped from the full streams
+	uint64_t nDetBatches;					// number of detection batch runs
+	uint64_t nDetFrames;					// number of frames and motion regions detected in the batch runs
+	uint64_t nReIDBatches;					// number of re-id batch runs
+	uint64_t nReIDCrops;					// number of person crops extracted in the batch runs
+
+	_S_STREAM_MANAGER_STATS()
+	{
+		nFrames = 0;
+		nDropped = 0;
+		nDetBatches = 0;
+		nDetFrames = 0;
+		nReIDBatches = 0;
+		nReIDCrops = 0;
+	}
+}S_StreamManagerStats;
+
+
+// Structure that defines the process-wide inference runtime parameters shared by all the CAIAnalysis instances
+typedef struct _S_RUNTIME_PARAM
+{
+	bool bGlobalThreadPools;				// true: all the networks share the global thread pools. false: each network has its own pools
+	int nIntraOpThreads;					// number of threads of the global intra-op pool. 0 means the number of physical cores
+	int nInterOpThreads;					// number of threads of the global inter-op pool. 0 means the number of physical cores
+	bool bAllowSpinning;					// true: the idle threads spin for a while before sleeping. Set false when running many instances
+	bool bModelCache;						// true: cache the optimised models to skip the graph optimisation at the later starts
+	std::string sModelCacheDir;				// directory of the optimised model cache. Empty means the "ort_cache" directory next to each model
+
+	_S_RUNTIME_PARAM(
+		bool _bGlobalThreadPools				= true,
+		int _nIntraOpThreads					= 0,
+		int _nInterOpThreads					= 0,
+		bool _bAllowSpinning					= true,
+		bool _bModelCache						= true,
+		std::string _sModelCacheDir				= "")
+	{
+		bGlobalThreadPools = _bGlobalThreadPools;
+		nIntraOpThreads = _nIntraOpThreads;
+		nInterOpThreads = _nInterOpThreads;
+		bAllowSpinning = _bAllowSpinning;
+		bModelCache = _bModelCache;
+		sModelCacheDir = _sModelCacheDir;
+	}
+}S_RuntimeParam;
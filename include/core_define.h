@@ -12,3 +12,21 @@
 #define _MAX(A, B)						(((A) > (B)) ? (A):(B))
 #define _MIN(A, B)						(((A) < (B)) ? (A):(B))
 #define _ABS(A)							(((A) < 0) ?   (-(A)):(A))
+
+
+// SIMD code paths. The x86 SIMD functions are compiled for the given target and selected at runtime by CPU feature check.
+#if defined(_M_X64) || defined(__x86_64__)
+	#define _SIMD_X86_
+#endif
+
+#if defined(_MSC_VER)
+	#define _TARGET_AVX2_
+	#define _TARGET_F16C_
+	#define _TARGET_AVX512_
+	#define _TARGET_AVX512VNNI_
+#else
+	#define _TARGET_AVX2_					__attribute__((target("avx2,fma")))
+	#define _TARGET_F16C_					__attribute__((target("avx2,fma,f16c")))
+	#define _TARGET_AVX512_					__attribute__((target("avx512f,avx512bw,avx512vl")))
+	#define _TARGET_AVX512VNNI_				__attribute__((target("avx512f,avx512bw,avx512vl,avx512vnni")))
+#endif
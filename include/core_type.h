@@ -1,11 +1,33 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <cstdint>
 #include "core_define.h"
 //########################################################################
 // Common data structures
 //########################################################################
 
+// Structure to hold the threading policy of a deep learning network session
+typedef struct _ThreadingPolicy {
+	bool	bOwnThreadPools;	// true: the session creates its own thread pools with the settings below. false: use the global pools of the runtime,
+								// unless a setting below other than bParallelExecution is not the default
+	int		nIntraOpThreads;	// number of threads of the intra-op pool. 0 means the default, or the number of CPUs in nCPUAffinityMask if set
+	int		nInterOpThreads;	// number of threads of the inter-op pool. 0 means the default. Only used by the parallel execution
+	bool	bParallelExecution;	// true: run the independent nodes of the graph in parallel. false: run the nodes sequentially
+	bool	bAllowSpinning;		// true: the idle threads of the session pools spin for a while before sleeping
+	uint64_t nCPUAffinityMask;	// bit i pins the intra-op pool threads to the logical processor i. 0 means no affinity
+
+	_ThreadingPolicy(bool _bOTP = false, int _nIntra = 0, int _nInter = 0, bool _bPE = true, bool _bSpin = true, uint64_t _nMask = 0)
+	{
+		bOwnThreadPools = _bOTP;
+		nIntraOpThreads = _nIntra;
+		nInterOpThreads = _nInter;
+		bParallelExecution = _bPE;
+		bAllowSpinning = _bSpin;
+		nCPUAffinityMask = _nMask;
+	}
+}ThreadingPolicy;
+
 // Structure to hold the detailed configuration information of all types of deep learning networks
 // The new fields maybe added to this structure in future
 typedef struct _NetDetailsConfig {
@@ -16,10 +38,15 @@ typedef struct _NetDetailsConfig {
 	double	dNormStd0;		// normalisation std value for the 1st channel
 	double	dNormStd1;		// normalisation std value for the 2nd channel
 	double	dNormStd2;		// normalisation std value for the 3rd channel
+	int		nMaxBatchSize;	// maximum number of images in one batch run for the dynamic batch model. <= 0 means no limit
+	bool	bIoBinding;		// true: bind the persistent input/output tensors to the session once and reuse them for every run
+	ThreadingPolicy stThreading;	// threading policy of the session
+	int		nSessionPoolSize;	// number of sessions this network adds to the session pool shared by the networks of the same model
 
 	_NetDetailsConfig(int _nDeviceID = -1, 
 		double _dNM0 = 0.0f, double _dNM1 = 0.0f, double _dNM2 = 0.0f, 
-		double _dNS0 = 1.0f, double _dNS1 = 1.0f, double _dNS2 = 1.0f)
+		double _dNS0 = 1.0f, double _dNS1 = 1.0f, double _dNS2 = 1.0f,
+		int _nMBS = 8, bool _bIOB = false, const ThreadingPolicy& _stTP = ThreadingPolicy(), int _nSPS = 1)
 	{
 		nDeviceID = _nDeviceID;
 		dNormMean0 = _dNM0;
@@ -28,16 +55,172 @@ typedef struct _NetDetailsConfig {
 		dNormStd0 = _dNS0;
 		dNormStd1 = _dNS1;
 		dNormStd2 = _dNS2;
+		nMaxBatchSize = _nMBS;
+		bIoBinding = _bIOB;
+		stThreading = _stTP;
+		nSessionPoolSize = _nSPS;
 	}
 
 }NetDetailsConfig;
 
 
+// Structure to hold the process-wide configuration of the inference runtime
+// The configuration is shared by all the networks in the process
+typedef struct _ORTRuntimeConfig {
+	bool	bGlobalThreadPools;	// true: all the sessions share the global thread pools. false: each session creates its own pools
+	int		nIntraOpThreads;	// number of threads of the global intra-op pool. 0 means the default, i.e. the number of physical cores
+	int		nInterOpThreads;	// number of threads of the global inter-op pool. 0 means the default, i.e. the number of physical cores
+	bool	bAllowSpinning;		// true: the idle threads of the global pools spin for a while before sleeping
+	bool	bModelCache;		// true: cache the optimised models in ORT format and load them directly at the later starts
+	std::string sModelCacheDir;	// directory of the optimised model cache. Empty means the "ort_cache" directory next to each model
+
+	_ORTRuntimeConfig(bool _bGTP = true, int _nIntra = 0, int _nInter = 0, bool _bSpin = true, bool _bMC = true, std::string _sMCD = "")
+	{
+		bGlobalThreadPools = _bGTP;
+		nIntraOpThreads = _nIntra;
+		nInterOpThreads = _nInter;
+		bAllowSpinning = _bSpin;
+		bModelCache = _bMC;
+		sModelCacheDir = _sMCD;
+	}
+}ORTRuntimeConfig;
+
+// Structure to hold the counters of one stage of the stage pipeline
+// The stage with the largest busy time is the one limiting the throughput, and the queues in front of it fill up.
+typedef struct _PipelineStageStats
+{
+	int			nQueueDepth;	// number of items waiting in the queue of the stage
+	int			nMaxQueueDepth;	// maximum number of items seen waiting in the queue of the stage
+	int			nQueueCapacity;	// capacity of the queue of the stage
+	uint64_t	nProcessed;		// number of items run by the stage
+	double		dBusyMs;		// total time in milliseconds spent running the items
+
+	_PipelineStageStats(int _nQD = 0, int _nMQD = 0, int _nQC = 0, uint64_t _nP = 0, double _dB = 0.0)
+	{
+		nQueueDepth = _nQD;
+		nMaxQueueDepth = _nMQD;
+		nQueueCapacity = _nQC;
+		nProcessed = _nP;
+		dBusyMs = _dB;
+	}
+}PipelineStageStats;
+
+
 
 //########################################################################
 // Object detection related data structures and types
 //########################################################################
 
+// Enum type that defines the non-maximum suppression method
+typedef enum _E_NMS_METHOD
+{
+	eNmUnknown = -1,		// unknown method
+	eNmLegacy,				// greedy NMS of the original implementation. Pixel-inclusive IoU, suppressed if IoU >= threshold
+	eNmHard,				// greedy NMS. Suppressed if IoU > threshold
+	eNmSoftLinear,			// Soft-NMS. The score is multiplied by (1 - IoU) if IoU > threshold
+	eNmSoftGaussian,		// Soft-NMS. The score is multiplied by exp(-IoU^2 / sigma)
+	eNmDIoU,				// greedy NMS. Suppressed if DIoU, that is IoU minus the normalised centre distance, > threshold
+	eNmCount				// total number of methods supported
+}E_NMSMethod;
+
+// Structure to hold the configuration of non-maximum suppression
+typedef struct _NMSConfig
+{
+	E_NMSMethod	eMethod;		// NMS method
+	float		fIoUThresh;		// IoU (or DIoU) threshold
+	bool		bClassAware;	// true: the boxes suppress the boxes of the same class only. false: all the boxes suppress each other
+	float		fSoftSigma;		// sigma of eNmSoftGaussian
+	float		fScoreThresh;	// boxes whose score decays below this threshold are removed by Soft-NMS
+
+	_NMSConfig(E_NMSMethod _eM = E_NMSMethod::eNmLegacy, float _fIT = 0.5f, bool _bCA = false, float _fSS = 0.5f, float _fST = 0.0f)
+	{
+		eMethod = _eM;
+		fIoUThresh = _fIT;
+		bClassAware = _bCA;
+		fSoftSigma = _fSS;
+		fScoreThresh = _fST;
+	}
+}NMSConfig;
+
+// Structure to hold the configuration of the tiled detection
+// The frame is split into overlapping tiles of the given size and each tile is detected at the full resolution.
+typedef struct _TileConfig
+{
+	bool	bEnable;			// true: detect on the tiles. false: detect on the whole frame
+	int		nTileW;				// tile width in pixels of the original frame
+	int		nTileH;				// tile height in pixels of the original frame
+	int		nOverlap;			// minimum overlap in pixels between the adjacent tiles
+	bool	bFullFrame;			// true: also detect on the whole frame for the large objects cut by the tiles
+	int		nParallelRuns;		// number of runs the tiles are split into and run at the same time. 1 means one batch
+	std::vector<bool> vActiveTiles;	// whether each tile in row-major order is detected. Empty means all the tiles
+
+	_TileConfig(bool _bE = false, int _nTW = 640, int _nTH = 384, int _nOL = 64, bool _bFF = true, int _nPR = 1,
+		const std::vector<bool>& _vAT = std::vector<bool>())
+	{
+		bEnable = _bE;
+		nTileW = _nTW;
+		nTileH = _nTH;
+		nOverlap = _nOL;
+		bFullFrame = _bFF;
+		nParallelRuns = _nPR;
+		vActiveTiles = _vAT;
+	}
+}TileConfig;
+
+// Enum type that defines the decision of the motion gate before the detection
+typedef enum _E_MOTION_GATE_RESULT
+{
+	eMgUnknown = -1,		// unknown decision
+	eMgSkip,				// nothing moved. The previous detection result is reused without running the detector
+	eMgRegion,				// something moved in a part of the frame. The detector runs on the motion region only
+	eMgFullFrame,			// the detector runs on the whole frame
+	eMgCount				// total number of decisions supported
+}E_MotionGateResult;
+
+// Structure to hold the configuration of the motion gate
+// The sensitivity is set per camera by nDiffThresh and fMinMotionRatio.
+typedef struct _MotionGateConfig
+{
+	bool	bEnable;			// true: run the motion gate before the detection
+	int		nProcWidth;			// width of the downscaled grey frame compared with the background. The aspect ratio is kept
+	int		nDiffThresh;		// minimum intensity difference [0, 255] of a moving pixel against the background
+	float	fMinMotionRatio;	// minimum ratio of the moving pixels of the downscaled frame to run the detector
+	float	fLearningRate;		// learning rate of the running average background. The still objects fade into it
+	int		nRegionMargin;		// margin in pixels of the original frame added around the motion region
+	float	fMaxRegionRatio;	// the whole frame is detected if the motion region is larger than this ratio of the frame
+	int		nRefreshInterval;	// the whole frame is detected at least once every N frames. 0 means never
+
+	_MotionGateConfig(bool _bE = false, int _nPW = 160, int _nDT = 25, float _fMMR = 0.002f, float _fLR = 0.05f,
+		int _nRM = 32, float _fMRR = 0.5f, int _nRI = 100)
+	{
+		bEnable = _bE;
+		nProcWidth = _nPW;
+		nDiffThresh = _nDT;
+		fMinMotionRatio = _fMMR;
+		fLearningRate = _fLR;
+		nRegionMargin = _nRM;
+		fMaxRegionRatio = _fMRR;
+		nRefreshInterval = _nRI;
+	}
+}MotionGateConfig;
+
+// Structure to hold the counters of the motion gate decisions
+typedef struct _MotionGateStats
+{
+	uint64_t	nFrames;		// number of checked frames
+	uint64_t	nSkipped;		// number of frames whose detection is skipped
+	uint64_t	nRegion;		// number of frames detected on the motion region only
+	uint64_t	nFullFrame;		// number of frames detected on the whole frame
+
+	_MotionGateStats(uint64_t _nF = 0, uint64_t _nS = 0, uint64_t _nR = 0, uint64_t _nFF = 0)
+	{
+		nFrames = _nF;
+		nSkipped = _nS;
+		nRegion = _nR;
+		nFullFrame = _nFF;
+	}
+}MotionGateStats;
+
 // Structure to hold the common and high-level information across all the object detection networks
 // The new fields maybe added to this structure in future
 typedef struct _ObjDetNetConfig
@@ -46,14 +229,21 @@ typedef struct _ObjDetNetConfig
 	float fNMSThresh;		// non-maximum suppression threshold
 	std::string sModelPath;	// path to model weights
 	std::string sClassPath;	// path to class names
+	E_NMSMethod eNMSMethod;	// non-maximum suppression method
+	bool bClassAwareNMS;	// true: run non-maximum suppression per class. false: across all the classes
+	float fSoftNMSSigma;	// sigma of eNmSoftGaussian
 
 
-	_ObjDetNetConfig(float _fCT = 0.5f, float _fNT = 0.5f, std::string _sMP = "", std::string _sCP = "")
+	_ObjDetNetConfig(float _fCT = 0.5f, float _fNT = 0.5f, std::string _sMP = "", std::string _sCP = "",
+		E_NMSMethod _eNM = E_NMSMethod::eNmLegacy, bool _bCAN = false, float _fSNS = 0.5f)
 	{
 		fConfThresh = _fCT;
 		fNMSThresh = _fNT;
 		sModelPath = _sMP;
 		sClassPath = _sCP;
+		eNMSMethod = _eNM;
+		bClassAwareNMS = _bCAN;
+		fSoftNMSSigma = _fSNS;
 	}
 }ObjDetNetConfig;
 
@@ -66,9 +256,11 @@ typedef struct _ObjBBox
 	float	fY2;		// bottom right y
 	float	fScore;		// confidence/score
 	int		nClassID;	// predicted class ID. range [0, classes-1]. -1 means invalid
+	int		nTrackID;	// persistent ID of the object across the frames given by the tracker. -1 means not tracked
 
 
-	_ObjBBox(float _fX1 = 0.0f, float _fY1 = 0.0f, float _fX2 = 0.0f, float _fY2 = 0.0f, float _fScore = 0.0f, int _nClassID = -1)
+	_ObjBBox(float _fX1 = 0.0f, float _fY1 = 0.0f, float _fX2 = 0.0f, float _fY2 = 0.0f, float _fScore = 0.0f, int _nClassID = -1,
+		int _nTrackID = -1)
 	{
 		fX1 = _fX1;
 		fY1 = _fY1;
@@ -76,6 +268,7 @@ typedef struct _ObjBBox
 		fY2 = _fY2;
 		fScore = _fScore;
 		nClassID = _nClassID;
+		nTrackID = _nTrackID;
 	}
 } ObjBBox;
 
@@ -87,6 +280,15 @@ typedef std::vector<std::string>	ObjClsArr;	// array type of class names
 // ReID related data structures and types
 //########################################################################
 
+// Enum type that defines the similarity metric between two feature vectors
+typedef enum _E_FEATURE_METRIC
+{
+	eFmUnknown = -1,		// unknown metric
+	eFmCosine,				// cosine similarity, that is the inner product of the normalised feature vectors
+	eFmEuclidean,			// 1 - Euclidean distance between the feature vectors
+	eFmCount				// total number of metrics supported
+}E_FeatureMetric;
+
 // Structure to hold the common and high-level information across all the ReID networks
 typedef struct _ReIDNetConfig
 {
@@ -118,4 +320,158 @@ typedef struct _ReIDRes
 	}
 }ReIDRes;
 
-typedef std::vector<ReIDRes>	ReIDResArr;		// array type of ReID results
\ No newline at end of file
+typedef std::vector<ReIDRes>	ReIDResArr;		// array type of ReID results
+
+// Structure to hold one query of the query set, such as a person of the watchlist
+typedef struct _ReIDQuery
+{
+	int		nQueryID;		// query ID given at the registration
+	int		nTopK;			// top K similar gallery images to be returned for the query
+	float	fSimThresh;		// similarity threshold of the query
+
+	_ReIDQuery(int _nQueryID = -1, int _nTK = 10, float _fST = 0.5f)
+	{
+		nQueryID = _nQueryID;
+		nTopK = _nTK;
+		fSimThresh = _fST;
+	}
+}ReIDQuery;
+
+typedef std::vector<ReIDQuery>	ReIDQueryArr;	// array type of ReID queries
+
+// Structure to hold the ReID result of one query of the query set
+typedef struct _QueryReIDRes
+{
+	int			nQueryID;	// query ID
+	ReIDResArr	vReIDRes;	// ReID results of the query. nImgID is the index of the gallery image
+
+	_QueryReIDRes(int _nQueryID = -1)
+	{
+		nQueryID = _nQueryID;
+	}
+}QueryReIDRes;
+
+typedef std::vector<QueryReIDRes>	QueryReIDResArr;	// array type of ReID results of the query set
+
+// Structure to hold the configuration of the embedding cache keyed by the track ID
+// The features of a track are extracted again only on a new track, on a large scale or appearance change, or every N frames.
+typedef struct _EmbeddingCacheConfig
+{
+	bool	bEnable;			// true: cache the features of the tracked objects
+	int		nRefreshInterval;	// the features of a track are extracted at least once every N frames
+	float	fScaleChangeRatio;	// relative change of the box height which makes the features extracted again
+	float	fAppearanceThresh;	// mean absolute difference of the thumbnails [0, 1] which makes the features extracted again
+	float	fMomentum;			// weight of the aggregate feature against the new feature. 0 keeps the latest feature only
+	int		nMaxIdleFrames;		// the track not seen for N frames is removed from the cache
+
+	_EmbeddingCacheConfig(bool _bEnable = false, int _nRefreshInterval = 30, float _fScaleChangeRatio = 0.3f,
+		float _fAppearanceThresh = 0.15f, float _fMomentum = 0.9f, int _nMaxIdleFrames = 90)
+	{
+		bEnable = _bEnable;
+		nRefreshInterval = _nRefreshInterval;
+		fScaleChangeRatio = _fScaleChangeRatio;
+		fAppearanceThresh = _fAppearanceThresh;
+		fMomentum = _fMomentum;
+		nMaxIdleFrames = _nMaxIdleFrames;
+	}
+}EmbeddingCacheConfig;
+
+// Structure to hold the counters of the embedding cache
+typedef struct _EmbeddingCacheStats
+{
+	uint64_t	nLookups;		// number of the objects whose features are requested
+	uint64_t	nExtracted;		// number of the objects whose features are extracted by the network
+	uint64_t	nTracks;		// number of the tracks in the cache
+
+	_EmbeddingCacheStats(uint64_t _nL = 0, uint64_t _nE = 0, uint64_t _nT = 0)
+	{
+		nLookups = _nL;
+		nExtracted = _nE;
+		nTracks = _nT;
+	}
+}EmbeddingCacheStats;
+
+// Structure to hold the metadata of one embedding of the gallery store
+// [Note] It is written to the file as it is, so the fields must keep their size and order.
+typedef struct _GalleryMeta
+{
+	int64_t	nTimestamp;		// capture time of the image, in milliseconds since the epoch
+	int64_t	nLabel;			// label given by the caller, such as the person ID. -1 if unknown
+	int32_t	nCameraID;		// ID of the camera of the image. -1 if unknown
+	int32_t	nTrackID;		// track ID of the object in the camera. -1 if unknown
+
+	_GalleryMeta(int64_t _nTimestamp = 0, int64_t _nLabel = -1, int32_t _nCameraID = -1, int32_t _nTrackID = -1)
+	{
+		nTimestamp = _nTimestamp;
+		nLabel = _nLabel;
+		nCameraID = _nCameraID;
+		nTrackID = _nTrackID;
+	}
+}GalleryMeta;
+
+// Enumeration of the compressed forms of the embeddings
+typedef enum _E_FEATURE_CODEC
+{
+	eFcUnknown = -1,		// unknown codec
+	eFcFloat32,				// uncompressed 32-bit floats
+	eFcFloat16,				// 16-bit floats. 2x smaller
+	eFcInt8,				// 8-bit integers scaled per dimension. 4x smaller
+	eFcPQ,					// product quantization, 1 byte per subspace. nDim * 4 / nPQSubspaces times smaller
+	eFcCount				// total number of codecs supported
+}E_FeatureCodec;
+
+// Structure to hold the configuration of the embedding codec
+typedef struct _FeatureCodecConfig
+{
+	E_FeatureCodec	eCodec;				// codec
+	int				nPQSubspaces;		// PQ: number of subspaces, that is the bytes per embedding
+	int				nTrainIters;		// PQ: number of k-means iterations of the training
+
+	_FeatureCodecConfig(E_FeatureCodec _eCodec = E_FeatureCodec::eFcFloat32, int _nPQSubspaces = 64, int _nTrainIters = 10)
+	{
+		eCodec = _eCodec;
+		nPQSubspaces = _nPQSubspaces;
+		nTrainIters = _nTrainIters;
+	}
+}FeatureCodecConfig;
+
+// Enumeration of the nearest-neighbour index types of the gallery
+typedef enum _E_INDEX_TYPE
+{
+	eItUnknown = -1,		// unknown index type
+	eItFlat,				// exact linear scan of all the rows
+	eItHNSW,				// hierarchical navigable small world graph, for the galleries in memory
+	eItIVF,					// inverted file of k-means lists, for the galleries on the disk
+	eItCount				// total number of index types supported
+}E_IndexType;
+
+// Structure to hold the configuration of the nearest-neighbour index of the gallery
+typedef struct _FeatureIndexConfig
+{
+	E_IndexType		eType;				// index type
+	E_FeatureMetric	eMetric;			// similarity metric of the embeddings
+	int				nM;					// HNSW: number of links of each node on the upper layers. Twice on the bottom layer
+	int				nEfConstruction;	// HNSW: number of candidates searched to link a new node. Larger is more accurate but slower to add
+	int				nEfSearch;			// HNSW: number of candidates searched for a query. Larger is more accurate but slower
+	int				nLists;				// IVF: number of k-means lists
+	int				nProbes;			// IVF: number of lists searched for a query. Larger is more accurate but slower
+	int				nTrainIters;		// IVF: number of k-means iterations of the training
+	FeatureCodecConfig	stCodec;		// compressed form of the rows kept by the index
+	int				nRerank;			// number of the candidates reranked by the uncompressed rows of the attached store. 0 to disable
+
+	_FeatureIndexConfig(E_IndexType _eType = E_IndexType::eItHNSW, E_FeatureMetric _eMetric = E_FeatureMetric::eFmCosine,
+		int _nM = 16, int _nEfConstruction = 200, int _nEfSearch = 64, int _nLists = 1024, int _nProbes = 16, int _nTrainIters = 10,
+		FeatureCodecConfig _stCodec = FeatureCodecConfig(), int _nRerank = 0)
+	{
+		eType = _eType;
+		eMetric = _eMetric;
+		nM = _nM;
+		nEfConstruction = _nEfConstruction;
+		nEfSearch = _nEfSearch;
+		nLists = _nLists;
+		nProbes = _nProbes;
+		nTrainIters = _nTrainIters;
+		stCodec = _stCodec;
+		nRerank = _nRerank;
+	}
+}FeatureIndexConfig;
\ No newline at end of file
@@ -0,0 +1,140 @@
+"""Benchmark of the inference runtimes on each model to choose the faster runtime per model.
+
+Each model is run by onnxruntime (E_InferenceRuntimeType::eIrtOnnx) and by the OpenCV DNN module
+(E_InferenceRuntimeType::eIrtOpenCVDNN) on the same preprocessed images. The latency of both runtimes and the
+difference of their outputs are reported, with the runtime to set to S_AnalysisParam::eDetRuntimeType or
+S_AnalysisParam::eReIDRuntimeType on this machine.
+
+Usage:
+    python tools/benchmark/benchmark_runtimes.py                        # all the models in FP32
+    python tools/benchmark/benchmark_runtimes.py --int8 --threads 4     # the INT8 models with 4 threads
+"""
+import argparse
+import os
+import sys
+import time
+
+import cv2
+import numpy as np
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "quantization"))
+import common  # noqa: E402
+
+# Name of the runtimes in E_InferenceRuntimeType
+RUNTIME_ENUMS = {"onnxruntime": "eIrtOnnx", "opencv-dnn": "eIrtOpenCVDNN"}
+
+
+def load_images(name, args):
+    """Load the benchmark images of the model: full frames for detection, person crops for re-id."""
+    images = common.load_calibration_images(name, args.repo_root, args.video_stride, args.max_video_frames)
+    return images[: args.max_images] if args.max_images > 0 else images
+
+
+def measure(run, batches, repeats, warmups):
+    """Run all the batches repeatedly and return the outputs of the last round with the mean latency per image in ms."""
+    for data, _ in batches[:warmups]:
+        run(data)
+
+    outputs = []
+    elapsed = 0.0
+    images = 0
+    for _ in range(repeats):
+        outputs = []
+        for data, count in batches:
+            start = time.perf_counter()
+            result = run(data)
+            elapsed += time.perf_counter() - start
+            images += count
+            outputs.extend(result[:count])
+
+    return outputs, 1000.0 * elapsed / max(1, images)
+
+
+def benchmark_model(name, args, lines):
+    """Benchmark both runtimes on one model and return the recommended runtime."""
+    model_path = common.int8_model_path(name, args.repo_root) if args.int8 else common.fp32_model_path(name, args.repo_root)
+    if not os.path.isfile(model_path):
+        print("[%s] Model is not found: %s" % (name, model_path))
+        return None
+
+    spec = common.MODEL_SPECS[name]
+    session = common.create_session(model_path, args.threads)
+    input_name, batch, height, width = common.input_info(session)
+
+    # The fixed batch model runs its batch size, and the dynamic batch model runs the given batch size as the C++ libraries
+    run_batch = batch if batch > 0 else args.batch
+    images = load_images(name, args)
+    if not images:
+        print("[%s] No image is found under assets" % name)
+        return None
+
+    tensors = [common.preprocess(image, width, height, spec) for _, image in images]
+    batches = list(common.make_batches(tensors, run_batch))
+
+    # OpenCV DNN runs on the CPU with its own kernels, and its threads are set process-wide
+    if args.threads > 0:
+        cv2.setNumThreads(args.threads)
+    net = cv2.dnn.readNetFromONNX(model_path)
+    net.setPreferableBackend(cv2.dnn.DNN_BACKEND_OPENCV)
+    net.setPreferableTarget(cv2.dnn.DNN_TARGET_CPU)
+
+    def run_ort(data):
+        return session.run(None, {input_name: data})[0]
+
+    def run_cv(data):
+        net.setInput(data)
+        return net.forward()
+
+    results = {}
+    for runtime, run in (("onnxruntime", run_ort), ("opencv-dnn", run_cv)):
+        try:
+            results[runtime] = measure(run, batches, args.repeats, args.warmups)
+        except cv2.error as e:
+            print("[%s] %s failed to run the model: %s" % (name, runtime, str(e).strip().splitlines()[-1]))
+
+    lines += ["## %s%s" % (name, " (INT8)" if args.int8 else ""), "",
+              "| Runtime | Latency (ms/image) |", "| --- | --- |"]
+    for runtime, (_, latency) in results.items():
+        lines.append("| %s | %.2f |" % (runtime, latency))
+
+    if len(results) == 2:
+        ort_outputs = np.stack(results["onnxruntime"][0]).astype(np.float32)
+        cv_outputs = np.stack(results["opencv-dnn"][0]).astype(np.float32).reshape(ort_outputs.shape)
+        lines.append("| Max abs output difference | %.6f |" % float(np.max(np.abs(ort_outputs - cv_outputs), initial=0.0)))
+
+    best = min(results, key=lambda runtime: results[runtime][1]) if results else None
+    lines += ["", "Recommended runtime: **%s** (`%s`)" % (best, RUNTIME_ENUMS[best]) if best else "No runtime can run the model", ""]
+    return best
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark onnxruntime and OpenCV DNN on each model")
+    parser.add_argument("--models", nargs="+", choices=sorted(common.MODEL_SPECS), default=sorted(common.MODEL_SPECS),
+                        help="models to benchmark")
+    parser.add_argument("--repo-root", default=common.REPO_ROOT, help="root directory of the repository")
+    parser.add_argument("--report", default="", help="path to the markdown report. Printed only if empty")
+    parser.add_argument("--int8", action="store_true", help="benchmark the INT8 models generated by tools/quantization")
+    parser.add_argument("--threads", type=int, default=0, help="threads of both runtimes. 0 means the default")
+    parser.add_argument("--batch", type=int, default=1, help="batch size of the dynamic batch models")
+    parser.add_argument("--repeats", type=int, default=3, help="rounds over all the images")
+    parser.add_argument("--warmups", type=int, default=2, help="batches run before the measurement")
+    parser.add_argument("--max-images", type=int, default=32, help="maximum number of images per model. 0 means all")
+    parser.add_argument("--video-stride", type=int, default=30, help="sample one frame every N frames of the videos")
+    parser.add_argument("--max-video-frames", type=int, default=16, help="maximum number of frames sampled per video")
+    args = parser.parse_args()
+
+    lines = ["# Inference runtime benchmark", ""]
+    for name in args.models:
+        benchmark_model(name, args, lines)
+
+    report = "\n".join(lines) + "\n"
+    print(report)
+    if args.report:
+        with open(args.report, "w") as file:
+            file.write(report)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,153 @@
+"""Common model specifications, preprocessing and data loading of the quantization tools.
+
+The preprocessing mirrors CInferer::PreProcessCore() and the NetDetailsConfig values set in
+CAIAnalysis::InitObjDetector() / CAIAnalysis::InitReID(), so the calibration and the parity report
+see the same tensors as the C++ libraries.
+"""
+import glob
+import os
+
+import cv2
+import numpy as np
+import onnxruntime as ort
+
+# Root directory of the repository
+REPO_ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", ".."))
+
+# Suffix of the INT8 model file. It must match the *_INT8_ONNX_MODEL_PATH macros in iAIAnalysisLib/include/macro_define.h
+INT8_SUFFIX = "_int8.onnx"
+
+# Specifications of the models supported by the tools
+# mean/scale are in the order of the input BGR channels, as dNormMean0-2 / dNormStd0-2 of NetDetailsConfig
+MODEL_SPECS = {
+    "yolo7": {
+        "path": "models/yolo7/yolov7-tiny_384x640.onnx",
+        "task": "detection",
+        "mean": (0.0, 0.0, 0.0),
+        "scale": (1.0 / 255, 1.0 / 255, 1.0 / 255),
+        "swap_rb": True,
+    },
+    "youreid": {
+        "path": "models/youreid/youreid_s.onnx",
+        "task": "reid",
+        "mean": (0.406 * 255, 0.456 * 255, 0.485 * 255),
+        "scale": (1.0 / (0.225 * 255), 1.0 / (0.224 * 255), 1.0 / (0.229 * 255)),
+        "swap_rb": True,
+    },
+    "torchreid": {
+        "path": "models/torchreid/osnet_x1_0_same_domain_d.onnx",
+        "task": "reid",
+        "mean": (0.406 * 255, 0.456 * 255, 0.485 * 255),
+        "scale": (1.0 / (0.225 * 255), 1.0 / (0.224 * 255), 1.0 / (0.229 * 255)),
+        "swap_rb": True,
+    },
+}
+
+
+def fp32_model_path(name, repo_root=REPO_ROOT):
+    """Get the absolute path to the FP32 model of the given name."""
+    return os.path.join(repo_root, MODEL_SPECS[name]["path"])
+
+
+def int8_model_path(name, repo_root=REPO_ROOT):
+    """Get the absolute path to the INT8 model of the given name."""
+    return fp32_model_path(name, repo_root)[: -len(".onnx")] + INT8_SUFFIX
+
+
+def create_session(model_path, num_threads=0):
+    """Create the CPU session with the same optimisation level as CORTInferer."""
+    options = ort.SessionOptions()
+    options.graph_optimization_level = ort.GraphOptimizationLevel.ORT_ENABLE_EXTENDED
+    if num_threads > 0:
+        options.intra_op_num_threads = num_threads
+    return ort.InferenceSession(model_path, options, providers=["CPUExecutionProvider"])
+
+
+def input_info(session):
+    """Get the input name, fixed batch size (-1 if dynamic), height and width of the session."""
+    node = session.get_inputs()[0]
+    batch, _, height, width = node.shape
+    batch = batch if isinstance(batch, int) and batch > 0 else -1
+    return node.name, batch, int(height), int(width)
+
+
+def preprocess(image, width, height, spec):
+    """Preprocess the BGR image into the CHW float tensor as CInferer::PreProcessCore() does."""
+    resized = cv2.resize(image, (width, height), interpolation=cv2.INTER_LINEAR).astype(np.float32)
+
+    mean = np.array(spec["mean"], dtype=np.float32)
+    scale = np.array(spec["scale"], dtype=np.float32)
+
+    # For the historical reason, the mean values are in the order of the output channels if all the std values are same
+    if spec["swap_rb"] and len(set(spec["scale"])) == 1:
+        mean = mean[::-1]
+
+    tensor = (resized - mean) * scale
+    if spec["swap_rb"]:
+        tensor = tensor[:, :, ::-1]
+
+    return np.ascontiguousarray(tensor.transpose(2, 0, 1))
+
+
+def make_batches(tensors, batch):
+    """Pack the CHW tensors into NCHW batches. The fixed batch model is padded with zeros."""
+    size = batch if batch > 0 else 1
+    for start in range(0, len(tensors), size):
+        chunk = tensors[start:start + size]
+        count = len(chunk)
+        if batch > 0 and count < batch:
+            chunk = chunk + [np.zeros_like(chunk[0])] * (batch - count)
+        yield np.stack(chunk), count
+
+
+def load_frames(repo_root=REPO_ROOT, video_stride=30, max_video_frames=64):
+    """Load the full frames for the detection model.
+
+    The frames are the images directly under assets/images, and the frames sampled from the videos under assets/videos.
+    """
+    frames = []
+    for path in sorted(glob.glob(os.path.join(repo_root, "assets", "images", "*.jpg"))):
+        image = cv2.imread(path)
+        if image is not None:
+            frames.append((os.path.relpath(path, repo_root), image))
+
+    if video_stride > 0 and max_video_frames > 0:
+        for path in sorted(glob.glob(os.path.join(repo_root, "assets", "videos", "*.mp4"))):
+            capture = cv2.VideoCapture(path)
+            index = 0
+            sampled = 0
+            while sampled < max_video_frames:
+                ok, image = capture.read()
+                if not ok:
+                    break
+                if index % video_stride == 0:
+                    frames.append(("%s#%d" % (os.path.relpath(path, repo_root), index), image))
+                    sampled += 1
+                index += 1
+            capture.release()
+
+    return frames
+
+
+def load_crops(repo_root=REPO_ROOT, subset=None):
+    """Load the person crops for the re-id models.
+
+    The crops are the images under assets/images/reid/query and assets/images/reid/gallery.
+    """
+    subsets = [subset] if subset else ["query", "gallery"]
+
+    crops = []
+    for name in subsets:
+        for path in sorted(glob.glob(os.path.join(repo_root, "assets", "images", "reid", name, "*.jpg"))):
+            image = cv2.imread(path)
+            if image is not None:
+                crops.append((os.path.relpath(path, repo_root), image))
+
+    return crops
+
+
+def load_calibration_images(name, repo_root=REPO_ROOT, video_stride=30, max_video_frames=64):
+    """Load the calibration images of the model: full frames for detection, person crops for re-id."""
+    if MODEL_SPECS[name]["task"] == "detection":
+        return load_frames(repo_root, video_stride, max_video_frames)
+    return load_crops(repo_root)
@@ -0,0 +1,239 @@
+"""Parity report of the INT8 models against the FP32 models.
+
+Detection: the boxes of both models are decoded and filtered as CYoloV7::PostProcess() does, and matched by IoU
+with the same class. The recall/precision of the INT8 boxes against the FP32 boxes, the IoU and the score error of the
+matched boxes are reported.
+Re-ID: the cosine similarity between the FP32 and INT8 embeddings of each crop, the error of the query-gallery
+similarity matrix, and the agreement of the top-1 / top-k gallery rankings are reported.
+The latency of both models is measured on the same images as well.
+
+Usage:
+    python tools/quantization/parity_report.py --report parity_report.md
+"""
+import argparse
+import os
+import sys
+import time
+
+import cv2
+import numpy as np
+
+import common
+
+
+def run_model(session, input_name, batch, tensors):
+    """Run the model on the CHW tensors and return the output of each image with the mean latency per image."""
+    outputs = []
+    elapsed = 0.0
+    for data, count in common.make_batches(tensors, batch):
+        start = time.perf_counter()
+        result = session.run(None, {input_name: data})[0]
+        elapsed += time.perf_counter() - start
+        outputs.extend(result[:count])
+    return outputs, 1000.0 * elapsed / max(1, len(tensors))
+
+
+def decode_detections(output, conf_thresh, nms_thresh):
+    """Decode the YoloV7 output of one image into the boxes [x1, y1, x2, y2], scores and class ids after NMS."""
+    output = output.reshape(-1, output.shape[-1])
+    output = output[output[:, 4] > conf_thresh]
+
+    class_ids = np.argmax(output[:, 5:], axis=1)
+    scores = output[np.arange(len(output)), 5 + class_ids] * output[:, 4]
+    keep = scores > conf_thresh
+    output, class_ids, scores = output[keep], class_ids[keep], scores[keep]
+
+    boxes = np.stack([output[:, 0] - 0.5 * output[:, 2], output[:, 1] - 0.5 * output[:, 3],
+                      output[:, 0] + 0.5 * output[:, 2], output[:, 1] + 0.5 * output[:, 3]], axis=1)
+
+    if len(boxes) == 0:
+        return boxes, scores, class_ids
+
+    rects = [[float(b[0]), float(b[1]), float(b[2] - b[0]), float(b[3] - b[1])] for b in boxes]
+    indices = cv2.dnn.NMSBoxesBatched(rects, scores.tolist(), class_ids.tolist(), conf_thresh, nms_thresh)
+    indices = np.array(indices, dtype=np.int64).reshape(-1)
+    return boxes[indices], scores[indices], class_ids[indices]
+
+
+def box_iou(box, boxes):
+    """IoU between one box and the boxes."""
+    x1 = np.maximum(box[0], boxes[:, 0])
+    y1 = np.maximum(box[1], boxes[:, 1])
+    x2 = np.minimum(box[2], boxes[:, 2])
+    y2 = np.minimum(box[3], boxes[:, 3])
+    inter = np.clip(x2 - x1, 0, None) * np.clip(y2 - y1, 0, None)
+    area = (box[2] - box[0]) * (box[3] - box[1])
+    areas = (boxes[:, 2] - boxes[:, 0]) * (boxes[:, 3] - boxes[:, 1])
+    return inter / np.maximum(area + areas - inter, 1e-6)
+
+
+def match_detections(ref, test, iou_thresh):
+    """Greedily match the test boxes to the reference boxes of the same class in the order of the reference scores."""
+    ref_boxes, ref_scores, ref_classes = ref
+    test_boxes, test_scores, test_classes = test
+
+    used = np.zeros(len(test_boxes), dtype=bool)
+    ious, score_errors = [], []
+    for i in np.argsort(-ref_scores):
+        if len(test_boxes) == 0:
+            break
+        iou = box_iou(ref_boxes[i], test_boxes)
+        iou[(test_classes != ref_classes[i]) | used] = 0.0
+        j = int(np.argmax(iou))
+        if iou[j] >= iou_thresh:
+            used[j] = True
+            ious.append(iou[j])
+            score_errors.append(abs(float(test_scores[j]) - float(ref_scores[i])))
+
+    return len(ious), ious, score_errors
+
+
+def report_detection(name, args, lines):
+    """Compare the detection results of the FP32 and INT8 models."""
+    spec = common.MODEL_SPECS[name]
+    sessions = [common.create_session(common.fp32_model_path(name, args.repo_root), args.threads),
+                common.create_session(common.int8_model_path(name, args.repo_root), args.threads)]
+    input_name, batch, height, width = common.input_info(sessions[0])
+
+    frames = common.load_frames(args.repo_root, args.video_stride, args.max_video_frames)
+    tensors = [common.preprocess(image, width, height, spec) for _, image in frames]
+
+    (fp32_outputs, fp32_ms), (int8_outputs, int8_ms) = [run_model(s, input_name, batch, tensors) for s in sessions]
+
+    total_ref, total_test, total_matched = 0, 0, 0
+    all_ious, all_errors = [], []
+    for fp32_output, int8_output in zip(fp32_outputs, int8_outputs):
+        ref = decode_detections(fp32_output, args.conf_thresh, args.nms_thresh)
+        test = decode_detections(int8_output, args.conf_thresh, args.nms_thresh)
+        matched, ious, errors = match_detections(ref, test, args.iou_thresh)
+        total_ref += len(ref[0])
+        total_test += len(test[0])
+        total_matched += matched
+        all_ious += ious
+        all_errors += errors
+
+    recall = total_matched / max(1, total_ref)
+    precision = total_matched / max(1, total_test)
+
+    lines += [
+        "## %s (detection)" % name,
+        "",
+        "| Metric | Value |",
+        "| --- | --- |",
+        "| Images | %d |" % len(frames),
+        "| FP32 boxes | %d |" % total_ref,
+        "| INT8 boxes | %d |" % total_test,
+        "| Recall of INT8 against FP32 | %.4f |" % recall,
+        "| Precision of INT8 against FP32 | %.4f |" % precision,
+        "| Mean IoU of matched boxes | %.4f |" % (np.mean(all_ious) if all_ious else 0.0),
+        "| Mean abs score error of matched boxes | %.4f |" % (np.mean(all_errors) if all_errors else 0.0),
+        "| FP32 latency (ms/image) | %.2f |" % fp32_ms,
+        "| INT8 latency (ms/image) | %.2f |" % int8_ms,
+        "| Speedup | %.2fx |" % (fp32_ms / max(int8_ms, 1e-6)),
+        "",
+    ]
+
+    return recall >= args.min_recall
+
+
+def normalise(features):
+    """L2-normalise the embeddings as CReID::Normalisation() does."""
+    features = np.asarray(features, dtype=np.float32).reshape(len(features), -1)
+    return features / np.maximum(np.linalg.norm(features, axis=1, keepdims=True), 1e-12)
+
+
+def report_reid(name, args, lines):
+    """Compare the re-id embeddings and the query-gallery similarities of the FP32 and INT8 models."""
+    spec = common.MODEL_SPECS[name]
+    sessions = [common.create_session(common.fp32_model_path(name, args.repo_root), args.threads),
+                common.create_session(common.int8_model_path(name, args.repo_root), args.threads)]
+    input_name, batch, height, width = common.input_info(sessions[0])
+
+    queries = common.load_crops(args.repo_root, "query")
+    gallery = common.load_crops(args.repo_root, "gallery")
+    crops = queries + gallery
+    tensors = [common.preprocess(image, width, height, spec) for _, image in crops]
+
+    (fp32_outputs, fp32_ms), (int8_outputs, int8_ms) = [run_model(s, input_name, batch, tensors) for s in sessions]
+    fp32_features = normalise(fp32_outputs)
+    int8_features = normalise(int8_outputs)
+
+    # Similarity between the FP32 and INT8 embeddings of the same crop
+    self_similarity = np.sum(fp32_features * int8_features, axis=1)
+
+    # Query-gallery similarity matrices and their rankings
+    nq = len(queries)
+    fp32_sim = fp32_features[:nq] @ fp32_features[nq:].T
+    int8_sim = int8_features[:nq] @ int8_features[nq:].T
+    k = min(args.top_k, len(gallery))
+
+    top1_agree, topk_overlap = 0.0, 0.0
+    if nq > 0 and k > 0:
+        fp32_rank = np.argsort(-fp32_sim, axis=1)[:, :k]
+        int8_rank = np.argsort(-int8_sim, axis=1)[:, :k]
+        top1_agree = float(np.mean(fp32_rank[:, 0] == int8_rank[:, 0]))
+        topk_overlap = float(np.mean([len(set(a) & set(b)) / k for a, b in zip(fp32_rank, int8_rank)]))
+
+    lines += [
+        "## %s (re-id)" % name,
+        "",
+        "| Metric | Value |",
+        "| --- | --- |",
+        "| Query / gallery crops | %d / %d |" % (nq, len(gallery)),
+        "| Mean cosine similarity of FP32 and INT8 embeddings | %.4f |" % float(np.mean(self_similarity)),
+        "| Min cosine similarity of FP32 and INT8 embeddings | %.4f |" % float(np.min(self_similarity)),
+        "| Max abs error of query-gallery similarity | %.4f |" % float(np.max(np.abs(fp32_sim - int8_sim), initial=0.0)),
+        "| Top-1 agreement | %.4f |" % top1_agree,
+        "| Top-%d overlap | %.4f |" % (k, topk_overlap),
+        "| FP32 latency (ms/crop) | %.2f |" % fp32_ms,
+        "| INT8 latency (ms/crop) | %.2f |" % int8_ms,
+        "| Speedup | %.2fx |" % (fp32_ms / max(int8_ms, 1e-6)),
+        "",
+    ]
+
+    return float(np.mean(self_similarity)) >= args.min_cosine
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Report the parity of the INT8 models against the FP32 models")
+    parser.add_argument("--models", nargs="+", choices=sorted(common.MODEL_SPECS), default=sorted(common.MODEL_SPECS),
+                        help="models to compare")
+    parser.add_argument("--repo-root", default=common.REPO_ROOT, help="root directory of the repository")
+    parser.add_argument("--report", default="", help="path to the markdown report. Printed only if empty")
+    parser.add_argument("--threads", type=int, default=1, help="intra-op threads of the sessions for the latency")
+    parser.add_argument("--conf-thresh", type=float, default=0.3, help="detection confidence threshold")
+    parser.add_argument("--nms-thresh", type=float, default=0.5, help="detection nms threshold")
+    parser.add_argument("--iou-thresh", type=float, default=0.5, help="IoU threshold to match the boxes")
+    parser.add_argument("--top-k", type=int, default=5, help="k of the re-id ranking agreement")
+    parser.add_argument("--min-recall", type=float, default=0.95, help="minimum detection recall to pass")
+    parser.add_argument("--min-cosine", type=float, default=0.98, help="minimum mean embedding cosine similarity to pass")
+    parser.add_argument("--video-stride", type=int, default=30, help="sample one frame every N frames of the videos")
+    parser.add_argument("--max-video-frames", type=int, default=64, help="maximum number of frames sampled per video")
+    args = parser.parse_args()
+
+    lines = ["# INT8 parity report", ""]
+    passed = True
+    for name in args.models:
+        if not os.path.isfile(common.int8_model_path(name, args.repo_root)):
+            print("[%s] INT8 model is not found. Run quantize_models.py first" % name)
+            passed = False
+            continue
+
+        if common.MODEL_SPECS[name]["task"] == "detection":
+            passed &= report_detection(name, args, lines)
+        else:
+            passed &= report_reid(name, args, lines)
+
+    lines.append("Result: **%s**" % ("PASS" if passed else "FAIL"))
+    report = "\n".join(lines) + "\n"
+
+    print(report)
+    if args.report:
+        with open(args.report, "w") as file:
+            file.write(report)
+
+    return 0 if passed else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,168 @@
+"""Offline calibration tool that generates the INT8 models by static QDQ quantization.
+
+The FP32 models are calibrated with the frames and person crops under assets/images (and optionally frames sampled
+from assets/videos), and written next to the FP32 models with the "_int8.onnx" suffix, which is the path
+CAIAnalysis loads when S_AnalysisParam::ePrecision is E_Precision::ePrINT8.
+
+Usage:
+    python tools/quantization/quantize_models.py                    # all the models
+    python tools/quantization/quantize_models.py --models yolo7     # the detection model only
+"""
+import argparse
+import os
+import sys
+import tempfile
+
+import onnx
+from onnxruntime.quantization import (CalibrationDataReader, CalibrationMethod, QuantFormat, QuantType,
+                                      quantize_static)
+from onnxruntime.quantization.shape_inference import quant_pre_process
+
+import common
+
+# Operators quantized by default. They cover the backbones of the models, so the activations stay in INT8
+# between the convolutions and ORT fuses the QDQ pairs into QLinearConv / QLinearMatMul kernels (VNNI on x86).
+DEFAULT_OP_TYPES = [
+    "Conv", "MatMul", "Gemm", "Add", "Mul", "Concat", "MaxPool", "AveragePool", "GlobalAveragePool",
+    "Resize", "Relu", "LeakyRelu", "Sigmoid", "Clip",
+]
+
+CALIBRATION_METHODS = {
+    "minmax": CalibrationMethod.MinMax,
+    "entropy": CalibrationMethod.Entropy,
+    "percentile": CalibrationMethod.Percentile,
+}
+
+
+class ImageCalibrationReader(CalibrationDataReader):
+    """Calibration data reader feeding the preprocessed images of the model batch by batch."""
+
+    def __init__(self, input_name, batches):
+        self.input_name = input_name
+        self.batches = iter(batches)
+
+    def get_next(self):
+        batch = next(self.batches, None)
+        return None if batch is None else {self.input_name: batch}
+
+
+def find_tail_nodes(model):
+    """Find the nodes after the last convolutions, from which no convolution or matmul is reachable.
+
+    They are the decoding of the detection head and the pooling/normalisation of the re-id embedding.
+    They are cheap but sensitive to the quantization error, so they are kept in FP32.
+    """
+    nodes = list(model.graph.node)
+    consumers = {}
+    for index, node in enumerate(nodes):
+        for name in node.input:
+            consumers.setdefault(name, []).append(index)
+
+    # The nodes of onnx graph are topologically sorted, so the consumers are visited before their producers in reverse
+    compute_ops = {"Conv", "MatMul", "Gemm"}
+    reaches_compute = [False] * len(nodes)
+    downstream = [False] * len(nodes)
+    for index in reversed(range(len(nodes))):
+        downstream[index] = any(reaches_compute[consumer]
+                                for output in nodes[index].output for consumer in consumers.get(output, []))
+        reaches_compute[index] = nodes[index].op_type in compute_ops or downstream[index]
+
+    return [node.name for index, node in enumerate(nodes) if node.op_type not in compute_ops and not downstream[index]]
+
+
+def name_nodes(model):
+    """Give the unique names to the unnamed nodes, so they can be excluded from the quantization by name."""
+    used = {node.name for node in model.graph.node if node.name}
+    for index, node in enumerate(model.graph.node):
+        if not node.name:
+            name = "%s_%d" % (node.op_type, index)
+            while name in used:
+                name += "_"
+            node.name = name
+            used.add(name)
+
+
+def quantize_model(name, args):
+    """Calibrate and quantize one model."""
+    spec = common.MODEL_SPECS[name]
+    fp32_path = common.fp32_model_path(name, args.repo_root)
+    int8_path = common.int8_model_path(name, args.repo_root)
+
+    if not os.path.isfile(fp32_path) or os.path.getsize(fp32_path) < 1024:
+        print("[%s] FP32 model is not found or not fetched from git lfs: %s" % (name, fp32_path))
+        return False
+
+    # Preprocess the calibration images with the input shape of the model
+    session = common.create_session(fp32_path)
+    input_name, batch, height, width = common.input_info(session)
+    del session
+
+    images = common.load_calibration_images(name, args.repo_root, args.video_stride, args.max_video_frames)
+    if not images:
+        print("[%s] No calibration image is found under assets" % name)
+        return False
+
+    tensors = [common.preprocess(image, width, height, spec) for _, image in images]
+    batches = [data for data, _ in common.make_batches(tensors, batch)]
+    print("[%s] Calibrating with %d images in %d batches" % (name, len(tensors), len(batches)))
+
+    with tempfile.TemporaryDirectory() as temp_dir:
+        # Fold the constants and infer the shapes before quantization, as recommended by onnxruntime
+        source_path = fp32_path
+        if not args.skip_preprocess:
+            source_path = os.path.join(temp_dir, name + "_prep.onnx")
+            quant_pre_process(fp32_path, source_path, skip_symbolic_shape=True)
+
+        model = onnx.load(source_path)
+        name_nodes(model)
+        source_path = os.path.join(temp_dir, name + "_named.onnx")
+        onnx.save(model, source_path)
+
+        nodes_to_exclude = [] if args.quantize_tail else find_tail_nodes(model)
+        print("[%s] Keeping %d tail nodes in FP32" % (name, len(nodes_to_exclude)))
+
+        quantize_static(
+            source_path,
+            int8_path,
+            ImageCalibrationReader(input_name, batches),
+            quant_format=QuantFormat.QDQ,
+            op_types_to_quantize=args.op_types,
+            per_channel=args.per_channel,
+            reduce_range=args.reduce_range,
+            activation_type=QuantType.QUInt8,
+            weight_type=QuantType.QInt8,
+            nodes_to_exclude=nodes_to_exclude,
+            calibrate_method=CALIBRATION_METHODS[args.method],
+            extra_options={"WeightSymmetric": True, "ActivationSymmetric": False},
+        )
+
+    print("[%s] INT8 model is written to %s" % (name, int8_path))
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate the INT8 models by static QDQ quantization")
+    parser.add_argument("--models", nargs="+", choices=sorted(common.MODEL_SPECS), default=sorted(common.MODEL_SPECS),
+                        help="models to quantize")
+    parser.add_argument("--repo-root", default=common.REPO_ROOT, help="root directory of the repository")
+    parser.add_argument("--method", choices=sorted(CALIBRATION_METHODS), default="minmax",
+                        help="calibration method of the activation ranges")
+    parser.add_argument("--no-per-channel", dest="per_channel", action="store_false",
+                        help="quantize the weights per tensor instead of per channel")
+    parser.add_argument("--reduce-range", action="store_true",
+                        help="quantize the weights to 7 bits. Use it for the CPUs without VNNI to avoid the saturation")
+    parser.add_argument("--op-types", nargs="+", default=DEFAULT_OP_TYPES, help="operator types to quantize")
+    parser.add_argument("--quantize-tail", action="store_true",
+                        help="also quantize the nodes after the last convolutions, which are kept in FP32 by default")
+    parser.add_argument("--skip-preprocess", action="store_true", help="skip the onnxruntime quantization preprocessing")
+    parser.add_argument("--video-stride", type=int, default=30,
+                        help="sample one frame every N frames of the videos for the detection model. 0 disables it")
+    parser.add_argument("--max-video-frames", type=int, default=64, help="maximum number of frames sampled per video")
+    args = parser.parse_args()
+
+    results = [quantize_model(name, args) for name in args.models]
+    return 0 if all(results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())